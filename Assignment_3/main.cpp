@@ -5,6 +5,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <cmath>
 #include <fstream>
 #ifdef __APPLE__
@@ -25,6 +26,9 @@
 
 #include "camera.h"
 #include "model.h"
+#include "texture_loader.hpp"
+#include "upload_context.hpp"
+#include "resource_resolver.hpp"
 #include "../common/include/common.hpp"
 
 // Settings
@@ -113,35 +117,38 @@ int main() {
     // Configure global opengl state
     glEnable(GL_DEPTH_TEST);
     
+    // Shared context on a loader thread: model buffers and textures are uploaded there
+    // while the render loop keeps running (falls back to this thread if unavailable)
+    std::unique_ptr<Common::UploadContext> uploads(new Common::UploadContext(window));
+    
     // Print current working directory for debugging
     char cwd[PATH_MAX];
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
         std::cout << "Current working directory: " << cwd << std::endl;
     }
     
-    // Helper function to find resource path
-    auto findResourcePath = [](const std::string& relativePath) -> std::string {
-        // Try paths in order: Debug dir, build dir, source dir
-        std::vector<std::string> pathsToTry = {
-            "../" + relativePath,  // From Debug directory (build/Assignment_3/Debug/)
-            relativePath,  // Current directory (if running from build/Assignment_3/)
-            "../../Assignment_3/" + relativePath,  // From project root
-            "../../../Assignment_3/" + relativePath  // From deeper in build tree
-        };
-        
-        std::cout << "Searching for: " << relativePath << std::endl;
-        for (const auto& path : pathsToTry) {
-            std::ifstream test(path);
-            if (test.good()) {
-                test.close();
-                std::cout << "  Found at: " << path << std::endl;
-                return path;
-            }
-            test.close();
+    // Index the asset directory once; every later lookup is a hash probe. The first of
+    // these that exists wins: Debug dir, build dir, source dir
+    Common::ResourceResolver &resources = Common::ResourceResolver::shared();
+    const char *resourceRoots[] = {
+        "../resource",  // From Debug directory (build/Assignment_3/Debug/)
+        "resource",  // Current directory (if running from build/Assignment_3/)
+        "../../Assignment_3/resource",  // From project root
+        "../../../Assignment_3/resource"  // From deeper in build tree
+    };
+    for (const char *root : resourceRoots) {
+        if (resources.mount(root, "resource")) {
+            break;
         }
-        std::cout << "  WARNING: Not found in any location!" << std::endl;
-        // Return original path if none found (will show error later)
-        return relativePath;
+    }
+    auto findResourcePath = [&resources](const std::string& relativePath) -> std::string {
+        std::string path = resources.find(relativePath);
+        if (path.empty()) {
+            resources.noteUnresolved(relativePath, "main");
+            // Return original path if not found (will show error later)
+            return relativePath;
+        }
+        return path;
     };
     
     // Build and compile shaders
@@ -156,6 +163,7 @@ int main() {
     std::string modelPath = findResourcePath("resource/Torque Twister/Torque Twister.obj");
     std::cout << "Loading model from: " << modelPath << std::endl;
     Model playerModel(modelPath.c_str());
+    resources.reportUnresolved();
     
     // Initialize items (boxes)
     items = {
@@ -184,6 +192,11 @@ int main() {
         // Input
         processInput(window);
         
+        // Textures decoded in the background replace their placeholders, a few per
+        // frame so a burst of finished decodes does not stall one frame
+        Common::TextureLoader::shared().uploadCompleted(4);
+        uploads->pollCompleted();
+        
         // Update camera to follow player
         camera.FollowTarget(playerPosition, 0.0f, 5.0f, 10.0f);
         
@@ -268,6 +281,7 @@ int main() {
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteVertexArrays(1, &cubeVAO);
     
+    uploads.reset();
     glfwTerminate();
     return 0;
 }
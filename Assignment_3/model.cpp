@@ -1,4 +1,13 @@
 #include "model.h"
+#include "obj_parser.h"
+#include "obj_stream.h"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "texture_loader.hpp"
+#include "texture_manager.hpp"
+#include "upload_context.hpp"
+#include "resource_resolver.hpp"
+#include "compressed_texture.hpp"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -7,11 +16,37 @@
 #include <cfloat>
 #include <map>
 #include <cctype>
+#include <cstring>
+#include <memory>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
 #include <stb_image.h>
 
+// Worker-thread image decode for Common::TextureLoader (stb_image is compiled into this file).
+// DDS / KTX files keep their blocks and mip chain; flipped like stb_image's output below.
+static bool decodeImageFile(const std::string &path, Common::DecodedImage &image) {
+    if (Common::isCompressedTextureFile(path)) {
+        return Common::loadCompressedTexture(path, image, true);
+    }
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    image.release = stbi_image_free;
+    return image.pixels != nullptr;
+}
+
+// Vertex streams of the interleaved Vertex array, for Common::packVertices
+static Common::VertexStreams vertexStreams(const std::vector<Vertex> &vertices) {
+    Common::VertexStreams streams;
+    streams.count = vertices.size();
+    streams.stride = sizeof(Vertex);
+    if (!vertices.empty()) {
+        streams.positions = &vertices[0].Position.x;
+        streams.normals = &vertices[0].Normal.x;
+        streams.texCoords = &vertices[0].TexCoords.x;
+    }
+    return streams;
+}
+
 // Mesh implementation
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
     this->vertices = vertices;
@@ -20,41 +55,211 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std:
     setupMesh();
 }
 
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+           std::vector<SubMesh> subMeshes, std::vector<MeshLod> lods, const Common::VertexFormat &format) {
+    this->vertices = vertices;
+    this->indices = indices;
+    this->textures = textures;
+    this->subMeshes = subMeshes;
+    this->lods = lods;
+    this->format = format;
+    setupMesh();
+}
+
+Mesh::Mesh(Common::CookedMeshFile &file, std::vector<Texture> textures, std::vector<SubMesh> subMeshes,
+           std::vector<MeshLod> lods) {
+    this->textures = textures;
+    this->subMeshes = subMeshes;
+    this->lods = lods;
+    setupCookedMesh(file);
+}
+
 void Mesh::setupMesh() {
-    glGenVertexArrays(1, &VAO);
+    // The GPU copy is packed to the mesh's vertex format; vertices keeps the float data
+    Common::VertexStreams streams = vertexStreams(vertices);
+    Common::VertexLayout layout = Common::makeVertexLayout(format, streams);
+    std::vector<unsigned char> packed(vertices.size() * layout.stride);
+    Common::packVertices(layout, streams, packed.data());
+    decode = layout.decode;
+    
+    indexSize = Common::indexSizeFor(vertices.size());
+    std::vector<uint16_t> shortIndices;
+    if (indexSize == sizeof(uint16_t)) {
+        shortIndices.resize(indices.size());
+        Common::narrowIndices(indices.data(), indices.size(), shortIndices.data());
+    }
+    
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
     
+    Common::UploadContext* uploads = Common::UploadContext::shared();
+    if (uploads) {
+        // Buffers are filled on the loader thread; VAOs are not shared between contexts,
+        // so Draw builds this one once the upload has completed
+        auto vertexData = std::make_shared<std::vector<unsigned char>>(std::move(packed));
+        auto indexData = std::make_shared<std::vector<unsigned char>>(indices.size() * indexSize);
+        std::memcpy(indexData->data(), shortIndices.empty() ? static_cast<const void*>(indices.data())
+                                                            : shortIndices.data(), indexData->size());
+        unsigned int vertexBuffer = VBO, indexBuffer = EBO;
+        std::shared_ptr<bool> ready = std::make_shared<bool>(false);
+        buffersReady = ready;
+        vertexAttributes = layout.attributes;
+        vertexStride = layout.stride;
+        VAO = 0;
+        // the names were made here; the loader context fills them only after this point
+        uploads->handOff();
+        uploads->submit([vertexBuffer, indexBuffer, vertexData, indexData]() {
+            // the element buffer binding belongs to a VAO, so it is filled as an array buffer
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertexData->size(), vertexData->data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, indexData->size(), indexData->data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }, [ready]() { *ready = true; });
+        return;
+    }
+    
+    glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
     
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * indexSize,
+                 shortIndices.empty() ? static_cast<const void*>(indices.data()) : shortIndices.data(), GL_STATIC_DRAW);
+    
+    // Vertex positions, normals and texture coordinates (locations 0, 1, 2)
+    for (const auto& attribute : layout.attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.glType,
+                              attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute.offset);
+    }
     
+    glBindVertexArray(0);
+}
+
+// For buffers uploaded by the UploadContext: false until they are complete, then creates
+// the vertex array on first use
+bool Mesh::vertexArrayReady() {
+    if (VAO != 0) {
+        return true;
+    }
+    if (!buffersReady || !*buffersReady) {
+        return false;
+    }
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    for (const auto& attribute : vertexAttributes) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.glType,
+                              attribute.normalized ? GL_TRUE : GL_FALSE, vertexStride, (void*)(size_t)attribute.offset);
+    }
+    glBindVertexArray(0);
+    return true;
+}
+
+// Uploads the cooked buffers straight from the file mapping, or in bounded chunks when
+// the file could not be mapped; no CPU copy of the mesh is kept
+void Mesh::setupCookedMesh(Common::CookedMeshFile &file) {
+    const unsigned long long vertexBytes = file.header.vertexCount * file.header.vertexStride;
+    const unsigned long long indexBytes = file.header.indexCount * file.header.indexSize;
+    const unsigned long long chunkBytes = 4u << 20;
+    indexSize = file.header.indexSize;
+    decode = Common::vertexDecodeFor(file.attributes, file.header.boundsMin, file.header.boundsMax);
+    const bool mapped = file.vertexData() && file.indexData();
+    std::vector<char> chunk;
+    if (!mapped) {
+        chunk.resize(static_cast<size_t>(std::min(chunkBytes, std::max(vertexBytes, indexBytes))));
+    }
     
-    // Vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
     
-    // Vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glBindVertexArray(VAO);
     
-    // Vertex texture coordinates
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, mapped ? file.vertexData() : nullptr, GL_STATIC_DRAW);
+    for (unsigned long long offset = 0; !mapped && offset < vertexBytes; offset += chunkBytes) {
+        unsigned long long bytes = std::min(chunkBytes, vertexBytes - offset);
+        if (!file.readVertexBytes(offset, bytes, chunk.data())) {
+            std::cout << "ERROR: Failed to read cooked vertex data" << std::endl;
+            break;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, chunk.data());
+    }
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, mapped ? file.indexData() : nullptr, GL_STATIC_DRAW);
+    for (unsigned long long offset = 0; !mapped && offset < indexBytes; offset += chunkBytes) {
+        unsigned long long bytes = std::min(chunkBytes, indexBytes - offset);
+        if (!file.readIndexBytes(offset, bytes, chunk.data())) {
+            std::cout << "ERROR: Failed to read cooked index data" << std::endl;
+            break;
+        }
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, bytes, chunk.data());
+    }
+    
+    // Attribute layout comes from the file
+    for (const auto& attribute : file.attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.glType,
+                              attribute.normalized ? GL_TRUE : GL_FALSE, file.header.vertexStride,
+                              (void*)(size_t)attribute.offset);
+    }
     
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(unsigned int shaderID) {
-    // Bind textures
-    if (!textures.empty()) {
+// The decode constants and texture_diffuse1 on unit 0: with the sub-mesh textures bound per
+// range, or textures[0] for a single draw
+void Mesh::buildMaterialBinding(Common::MaterialBinding &table) const {
+    table.setVec3("positionScale", decode.positionScale);
+    table.setVec3("positionOffset", decode.positionOffset);
+    table.setInt("octahedralNormals", decode.octahedralNormals ? 1 : 0);
+    if (!subMeshes.empty()) {
+        table.addSampler("texture_diffuse1", 0);
+    } else if (!textures.empty()) {
+        table.addTexture("texture_diffuse1", 0, GL_TEXTURE_2D, textures[0].id);
+    }
+}
+
+void Mesh::Draw(unsigned int shaderID, unsigned int lod) {
+    if (!vertexArrayReady()) {
+        return;
+    }
+    materialBindings.get(shaderID, [this](Common::MaterialBinding &table) { buildMaterialBinding(table); }).apply();
+    const GLenum indexType = Common::indexGLType(indexSize);
+    
+    if (!subMeshes.empty()) {
+        // past the last level this mesh has, its coarsest level is drawn
+        const std::vector<SubMesh>& ranges = (lod == 0 || lods.empty())
+            ? subMeshes : lods[std::min<size_t>(lod, lods.size()) - 1].subMeshes;
+        // Ranges are sorted by texture, so each texture is bound once per draw
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[0].id);
-        glUniform1i(glGetUniformLocation(shaderID, "texture_diffuse1"), 0);
-    } else {
+        glBindVertexArray(VAO);
+        unsigned int boundTexture = 0;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            const SubMesh& subMesh = ranges[i];
+            if (subMesh.indexCount == 0) {
+                continue;
+            }
+            if (i == 0 || subMesh.textureID != boundTexture) {
+                glBindTexture(GL_TEXTURE_2D, subMesh.textureID);
+                boundTexture = subMesh.textureID;
+            }
+            glDrawElements(GL_TRIANGLES, subMesh.indexCount, indexType,
+                           (void*)(size_t)(subMesh.indexOffset * indexSize));
+        }
+        glBindVertexArray(0);
+        return;
+    }
+    
+    // The binding table bound textures[0]
+    if (textures.empty()) {
         // Debug: check if textures are empty
         static bool warned = false;
         if (!warned) {
@@ -65,12 +270,24 @@ void Mesh::Draw(unsigned int shaderID) {
     
     // Draw mesh
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, indices.size(), indexType, 0);
     glBindVertexArray(0);
     
     glActiveTexture(GL_TEXTURE0);
 }
 
+// Bump whenever loadOBJ / obj_stream change what they produce, so stale caches are rebuilt
+static const char *kOBJImportVersion = "obj-import-2";
+
+static uint64_t objImportSettingsHash(const ModelLoadSettings &settings) {
+    std::string key = std::string(kOBJImportVersion) + ":vertex" + std::to_string(sizeof(Vertex))
+        + ":optimize" + std::to_string(settings.optimizeMesh ? 1 : 0) + ":lods" + std::to_string(settings.lodCount)
+        + ":format" + std::to_string(static_cast<unsigned>(settings.vertexFormat.position))
+        + std::to_string(settings.vertexFormat.octahedralNormals) + std::to_string(settings.vertexFormat.halfTexCoords)
+        + ":streams" + std::to_string(settings.vertexFormat.streams);
+    return Common::hashBytes(key.data(), key.size());
+}
+
 // Model implementation
 Model::Model(const char *path) {
     boundingBoxMin = glm::vec3(FLT_MAX);
@@ -78,6 +295,12 @@ Model::Model(const char *path) {
     loadModel(std::string(path));
 }
 
+Model::Model(const char *path, const ModelLoadSettings &settings) : settings(settings) {
+    boundingBoxMin = glm::vec3(FLT_MAX);
+    boundingBoxMax = glm::vec3(-FLT_MAX);
+    loadModel(std::string(path));
+}
+
 void Model::loadModel(std::string path) {
     size_t lastSlash = path.find_last_of("/\\");
     directory = (lastSlash != std::string::npos) ? path.substr(0, lastSlash) : ".";
@@ -87,130 +310,266 @@ void Model::loadModel(std::string path) {
         directory = ".";
     }
     
-    loadOBJ(path);
+    // Texture and MTL lookups go through the resolver's index; these are no-ops when the
+    // application already mounted the asset root that holds them
+    Common::ResourceResolver::shared().mount(directory);
+    Common::ResourceResolver::shared().mount(directory + "/../textures");
+    
+    // Warm start: a cooked mesh cooked from these exact bytes with these settings
+    // is uploaded from its mapping without touching the OBJ text. An OBJ with the size
+    // and modification time recorded in the cooked header is not even hashed.
+    cachePath = path + ".cmesh";
+    settingsHash = objImportSettingsHash(settings);
+    if (settings.useMeshCache && Common::hashSourceFile(path, cachePath, sourceHash, sourceStamp)) {
+        Common::CookedMeshFile cached;
+        if (cached.open(cachePath)) {
+            if (cached.matches(sourceHash, settingsHash)) {
+                std::cout << "Mesh cache hit: " << cachePath << std::endl;
+                loadCooked(cached, cachePath);
+                return;
+            }
+            std::cout << "Mesh cache is stale, re-importing: " << cachePath << std::endl;
+        }
+    }
+    
+    // Files too large to hold in memory are imported out of core into a cooked mesh
+    std::ifstream probe(path, std::ios::binary | std::ios::ate);
+    unsigned long long fileSize = probe.is_open() ? static_cast<unsigned long long>(probe.tellg()) : 0;
+    probe.close();
+    if (fileSize > 0 && fileSize >= settings.streamingThreshold) {
+        loadOBJStreaming(path);
+    } else {
+        loadOBJ(path);
+    }
 }
 
 void Model::loadOBJ(std::string path) {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> texCoords;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
     
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cout << "ERROR: Failed to open OBJ file: " << path << std::endl;
+    ObjData obj;
+    if (!parseOBJFile(path, obj)) {
         std::cout << "Current working directory might be wrong." << std::endl;
         std::cout << "Please ensure the executable is run from the build/Assignment 3/ directory." << std::endl;
         return;
     }
     std::cout << "Successfully opened OBJ file: " << path << std::endl;
     
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
+    if (!obj.positions.empty()) {
+        boundingBoxMin = obj.boundingBoxMin;
+        boundingBoxMax = obj.boundingBoxMax;
+    }
+    
+    for (const auto& mtlFile : obj.mtllibs) {
+        // Load material file
+        std::string mtlPath = directory + "/" + mtlFile;
+        std::cout << "Found mtllib: " << mtlFile << ", loading from: " << mtlPath << std::endl;
+        loadMTL(mtlPath);
+    }
+    
+    // Weld identical (v, vt, vn) corners so the mesh is truly indexed
+    std::vector<ObjCorner> uniqueCorners;
+    indexOBJCorners(obj.corners, uniqueCorners, indices);
+    vertices.resize(uniqueCorners.size());
+    for (size_t i = 0; i < uniqueCorners.size(); ++i) {
+        const ObjCorner& corner = uniqueCorners[i];
+        Vertex& vertex = vertices[i];
+        vertex.Position = (corner.position >= 0 && corner.position < static_cast<int>(obj.positions.size()))
+            ? obj.positions[corner.position] : glm::vec3(0.0f);
+        vertex.TexCoords = (corner.texCoord >= 0 && corner.texCoord < static_cast<int>(obj.texCoords.size()))
+            ? obj.texCoords[corner.texCoord] : glm::vec2(0.0f);
+        vertex.Normal = (corner.normal >= 0 && corner.normal < static_cast<int>(obj.normals.size()))
+            ? obj.normals[corner.normal] : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    if (!vertices.empty()) {
+        std::cout << "Vertex deduplication: " << obj.corners.size() << " -> " << vertices.size()
+                  << " vertices (" << static_cast<float>(obj.corners.size()) / vertices.size() << "x fewer)" << std::endl;
+    }
+    
+    collectTextures(textures);
+    
+    // One index range per material texture (usemtl); triangles are regrouped so every
+    // texture is one contiguous range, sorted by texture id for Mesh::Draw
+    std::vector<SubMesh> subMeshes;
+    if (!obj.materialRanges.empty() && !indices.empty()) {
+        unsigned int fallbackTexture = textures.empty() ? 0 : textures[0].id;
+        size_t triangleCount = indices.size() / 3;
+        std::vector<unsigned int> triangleTexture(triangleCount, fallbackTexture);
+        for (size_t r = 0; r < obj.materialRanges.size(); ++r) {
+            const ObjMaterialRange& range = obj.materialRanges[r];
+            size_t last = (r + 1 < obj.materialRanges.size()) ? obj.materialRanges[r + 1].firstCorner : obj.corners.size();
+            unsigned int textureID = materialTexture(range.name, fallbackTexture);
+            for (size_t t = range.firstCorner / 3; t < last / 3; ++t) {
+                triangleTexture[t] = textureID;
+            }
+        }
         
-        if (type == "v") {
-            glm::vec3 pos;
-            iss >> pos.x >> pos.y >> pos.z;
-            positions.push_back(pos);
-            
-            // Update bounding box
-            boundingBoxMin.x = std::min(boundingBoxMin.x, pos.x);
-            boundingBoxMin.y = std::min(boundingBoxMin.y, pos.y);
-            boundingBoxMin.z = std::min(boundingBoxMin.z, pos.z);
-            boundingBoxMax.x = std::max(boundingBoxMax.x, pos.x);
-            boundingBoxMax.y = std::max(boundingBoxMax.y, pos.y);
-            boundingBoxMax.z = std::max(boundingBoxMax.z, pos.z);
+        std::vector<unsigned int> textureIDs(triangleTexture);
+        std::sort(textureIDs.begin(), textureIDs.end());
+        textureIDs.erase(std::unique(textureIDs.begin(), textureIDs.end()), textureIDs.end());
+        
+        // stable counting sort of triangles by texture
+        std::vector<unsigned int> offsets(textureIDs.size() + 1, 0);
+        for (unsigned int textureID : triangleTexture) {
+            size_t bucket = std::lower_bound(textureIDs.begin(), textureIDs.end(), textureID) - textureIDs.begin();
+            offsets[bucket + 1] += 3;
         }
-        else if (type == "vt") {
-            glm::vec2 tex;
-            iss >> tex.x >> tex.y;
-            texCoords.push_back(tex);
+        for (size_t b = 0; b < textureIDs.size(); ++b) {
+            offsets[b + 1] += offsets[b];
         }
-        else if (type == "vn") {
-            glm::vec3 norm;
-            iss >> norm.x >> norm.y >> norm.z;
-            normals.push_back(norm);
+        for (size_t b = 0; b < textureIDs.size(); ++b) {
+            SubMesh subMesh;
+            subMesh.indexOffset = offsets[b];
+            subMesh.indexCount = offsets[b + 1] - offsets[b];
+            subMesh.textureID = textureIDs[b];
+            subMeshes.push_back(subMesh);
         }
-        else if (type == "f") {
-            std::vector<std::string> vertexTokens;
-            std::string vertexToken;
-            while (iss >> vertexToken) {
-                vertexTokens.push_back(vertexToken);
+        std::vector<unsigned int> sorted(indices.size());
+        for (size_t t = 0; t < triangleCount; ++t) {
+            size_t bucket = std::lower_bound(textureIDs.begin(), textureIDs.end(), triangleTexture[t]) - textureIDs.begin();
+            unsigned int& cursor = offsets[bucket];
+            sorted[cursor] = indices[t * 3];
+            sorted[cursor + 1] = indices[t * 3 + 1];
+            sorted[cursor + 2] = indices[t * 3 + 2];
+            cursor += 3;
+        }
+        indices.swap(sorted);
+        
+        // label each range with the first material that uses its texture
+        for (const ObjMaterialRange& range : obj.materialRanges) {
+            unsigned int textureID = materialTexture(range.name, fallbackTexture);
+            for (auto& subMesh : subMeshes) {
+                if (subMesh.textureID == textureID && subMesh.material.empty()) {
+                    subMesh.material = range.name;
+                }
             }
-
-            if (vertexTokens.size() < 3) {
-                continue; // Not enough vertices to form a face
+        }
+        std::cout << obj.materialRanges.size() << " material ranges drawn as " << subMeshes.size() << " submeshes" << std::endl;
+    }
+    
+    // Vertex cache / overdraw order inside each submesh, then vertices in fetch order
+    if (settings.optimizeMesh && !indices.empty()) {
+        std::vector<Common::IndexRange> ranges;
+        for (const auto& subMesh : subMeshes) {
+            ranges.push_back(Common::IndexRange{ subMesh.indexOffset, subMesh.indexCount });
+        }
+        Common::MeshOptimizationStats stats = Common::optimizeMesh(vertices.data(), vertices.size(), sizeof(Vertex),
+                                                                   offsetof(Vertex, Position), indices.data(), indices.size(), ranges);
+        vertices.resize(stats.verticesAfter);
+        std::cout << "Mesh optimization (" << stats.seconds * 1000.0 << " ms): ACMR " << stats.before.acmr << " -> "
+                  << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+    }
+    
+    // Simplified levels are appended to the index buffer, one range per submesh
+    std::vector<MeshLod> lods;
+    const size_t fullIndexCount = indices.size();
+    if (settings.lodCount > 0 && !indices.empty()) {
+        if (subMeshes.empty()) {
+            SubMesh whole;
+            whole.indexOffset = 0;
+            whole.indexCount = static_cast<unsigned int>(indices.size());
+            whole.textureID = textures.empty() ? 0 : textures[0].id;
+            subMeshes.push_back(whole);
+        }
+        std::vector<Common::IndexRange> ranges;
+        for (const auto& subMesh : subMeshes) {
+            ranges.push_back(Common::IndexRange{ subMesh.indexOffset, subMesh.indexCount });
+        }
+        std::vector<Common::LodLevel> levels;
+        Common::generateLodChain(indices, ranges, &vertices[0].Position.x, sizeof(Vertex), vertices.size(),
+                                 settings.lodCount, levels);
+        for (size_t level = 1; level < levels.size(); ++level) {
+            MeshLod lod;
+            lod.error = levels[level].error;
+            lod.subMeshes = subMeshes;
+            size_t triangles = 0;
+            for (size_t i = 0; i < subMeshes.size(); ++i) {
+                lod.subMeshes[i].indexOffset = static_cast<unsigned int>(levels[level].ranges[i].offset);
+                lod.subMeshes[i].indexCount = static_cast<unsigned int>(levels[level].ranges[i].count);
+                triangles += levels[level].ranges[i].count / 3;
             }
+            std::cout << "LOD " << level << ": " << triangles << " triangles, error " << lod.error << std::endl;
+            lods.push_back(lod);
+        }
+    }
+    
+    if (!vertices.empty()) {
+        std::cout << "Creating mesh with " << textures.size() << " textures, " << vertices.size() << " vertices and " << fullIndexCount / 3 << " triangles" << std::endl;
+        // an OBJ without vt uploads no uv stream (the shader reads the default (0, 0))
+        Common::VertexFormat format = settings.vertexFormat;
+        if (obj.texCoords.empty()) {
+            format.streams &= ~Common::StreamTexCoords;
+        }
+        const uint32_t packedStride = Common::makeVertexLayout(format, vertexStreams(vertices)).stride;
+        std::cout << "Vertex format: " << sizeof(Vertex) << " -> " << packedStride << " bytes per vertex, "
+                  << Common::indexSizeFor(vertices.size()) * 8 << "-bit indices" << std::endl;
+        Mesh mesh(vertices, indices, textures, subMeshes, lods, format);
+        meshes.push_back(mesh);
+        if (settings.useMeshCache) {
+            writeMeshCache(vertices, indices, subMeshes, lods, obj.mtllibs, format);
+        }
+    }
+}
 
-            auto parseFaceToken = [&](const std::string &face) {
-                std::stringstream ss(face);
-                std::string token;
-                int posIdx = -1, texIdx = -1, normIdx = -1;
-
-                if (std::getline(ss, token, '/')) {
-                    if (!token.empty()) posIdx = std::stoi(token) - 1;
-                }
-                if (std::getline(ss, token, '/')) {
-                    if (!token.empty()) texIdx = std::stoi(token) - 1;
-                }
-                if (std::getline(ss, token, '/')) {
-                    if (!token.empty()) normIdx = std::stoi(token) - 1;
-                }
-
-                Vertex vertex;
-                if (posIdx >= 0 && posIdx < static_cast<int>(positions.size())) {
-                    vertex.Position = positions[posIdx];
-                }
-                if (texIdx >= 0 && texIdx < static_cast<int>(texCoords.size())) {
-                    vertex.TexCoords = texCoords[texIdx];
-                } else {
-                    vertex.TexCoords = glm::vec2(0.0f);
+// Writes the welded, texture-sorted mesh as the cache entry for the next launch
+void Model::writeMeshCache(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                           const std::vector<SubMesh> &subMeshes, const std::vector<MeshLod> &lods,
+                           const std::vector<std::string> &libraries, const Common::VertexFormat &format) {
+    // level 0 first, then each simplified level with the same materials
+    std::vector<std::string> materialNames;
+    std::vector<Common::CookedSubMesh> cookedSubMeshes;
+    std::vector<Common::CookedLod> cookedLods;
+    for (size_t level = 0; level <= lods.size(); ++level) {
+        const std::vector<SubMesh>& ranges = level == 0 ? subMeshes : lods[level - 1].subMeshes;
+        Common::CookedLod cookedLod = { static_cast<uint32_t>(cookedSubMeshes.size()), static_cast<uint32_t>(ranges.size()),
+                                        level == 0 ? 0.0f : lods[level - 1].error, 0 };
+        cookedLods.push_back(cookedLod);
+        for (const auto& subMesh : ranges) {
+            Common::CookedSubMesh cooked = { subMesh.indexOffset, subMesh.indexCount, ~0u, 0 };
+            if (!subMesh.material.empty()) {
+                auto found = std::find(materialNames.begin(), materialNames.end(), subMesh.material);
+                cooked.material = static_cast<uint32_t>(found - materialNames.begin());
+                if (found == materialNames.end()) {
+                    materialNames.push_back(subMesh.material);
                 }
-                if (normIdx >= 0 && normIdx < static_cast<int>(normals.size())) {
-                    vertex.Normal = normals[normIdx];
-                } else {
-                    vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
-                }
-
-                return vertex;
-            };
-
-            // Parse all vertices in the face
-            std::vector<Vertex> faceVertices;
-            faceVertices.reserve(vertexTokens.size());
-            for (const auto &token : vertexTokens) {
-                faceVertices.push_back(parseFaceToken(token));
-            }
-
-            // Triangulate polygon using fan method
-            for (size_t i = 1; i + 1 < faceVertices.size(); ++i) {
-                unsigned int baseIndex = vertices.size();
-                vertices.push_back(faceVertices[0]);
-                vertices.push_back(faceVertices[i]);
-                vertices.push_back(faceVertices[i + 1]);
-
-                indices.push_back(baseIndex);
-                indices.push_back(baseIndex + 1);
-                indices.push_back(baseIndex + 2);
             }
+            cookedSubMeshes.push_back(cooked);
         }
-        else if (type == "mtllib") {
-            std::string mtlFile;
-            iss >> mtlFile;
-            // Load material file
-            std::string mtlPath = directory + "/" + mtlFile;
-            std::cout << "Found mtllib: " << mtlFile << ", loading from: " << mtlPath << std::endl;
-            loadMTL(mtlPath);
-        }
+    }
+    if (cookedSubMeshes.empty()) {
+        cookedSubMeshes.push_back(Common::CookedSubMesh{ 0, static_cast<uint32_t>(indices.size()), ~0u, 0 });
     }
     
-    file.close();
+    // Stored in the GPU format, packed against the model bounds so the header bounds
+    // recover the decode (Common::vertexDecodeFor)
+    Common::VertexStreams streams = vertexStreams(vertices);
+    Common::VertexLayout layout = Common::makeVertexLayout(format, streams, &boundingBoxMin.x, &boundingBoxMax.x);
+    std::vector<unsigned char> packed(vertices.size() * layout.stride);
+    Common::packVertices(layout, streams, packed.data());
     
+    Common::CookedMeshWriter writer;
+    bool ok = writer.open(cachePath, layout.stride, layout.attributes, Common::indexSizeFor(vertices.size()));
+    if (ok) {
+        if (!lods.empty()) {
+            writer.setLods(cookedLods);
+        }
+        writer.setSourceStamp(sourceStamp);
+        writer.appendVertices(packed.data(), vertices.size());
+        writer.appendIndices(indices.data(), indices.size());
+        ok = writer.finish(cookedSubMeshes, materialNames, libraries, &boundingBoxMin.x, &boundingBoxMax.x,
+                           sourceHash, settingsHash);
+    }
+    if (ok) {
+        std::cout << "Wrote mesh cache: " << cachePath << std::endl;
+    } else {
+        // a missing cache only costs the next launch a re-import
+        std::cout << "Warning: Could not write mesh cache: " << cachePath << std::endl;
+    }
+}
+
+// Textures of all materials, or a default texture if the model has no materials
+void Model::collectTextures(std::vector<Texture> &textures) {
     // Use textures from materials if available, otherwise try default texture paths
     if (textures.empty() && !materials.empty()) {
         std::cout << "Found " << materials.size() << " materials, loading textures..." << std::endl;
@@ -241,46 +600,131 @@ void Model::loadOBJ(std::string path) {
                 break;
             }
         }
+        if (textures.empty()) {
+            Common::ResourceResolver::shared().noteUnresolved(defaultTexturePaths[0], "default texture");
+        }
+    }
+}
+
+// Diffuse texture of a material (any texture if it has no diffuse map), or the fallback
+unsigned int Model::materialTexture(const std::string &material, unsigned int fallbackTexture) const {
+    auto found = materials.find(material);
+    if (found == materials.end() || found->second.empty()) {
+        return fallbackTexture;
+    }
+    for (const auto& texture : found->second) {
+        if (texture.type == "diffuse") {
+            return texture.id;
+        }
+    }
+    return found->second[0].id;
+}
+
+void Model::loadOBJStreaming(std::string path) {
+    // the cooked output doubles as the mesh cache entry
+    ObjStreamSettings streamSettings;
+    streamSettings.memoryBudget = settings.streamingMemoryBudget;
+    streamSettings.sourceHash = sourceHash;
+    streamSettings.settingsHash = settingsHash;
+    streamSettings.sourceStamp = sourceStamp;
+    ObjStreamStats stats;
+    std::cout << "Streaming OBJ import (" << (streamSettings.memoryBudget >> 20) << " MB budget): " << path << std::endl;
+    if (!streamOBJToCookedMesh(path, cachePath, streamSettings, stats)) {
+        return;
+    }
+    std::cout << "  " << stats.bytesRead / (1024.0 * 1024.0) << " MB in " << stats.seconds << " s, "
+              << stats.corners << " corners -> " << stats.vertices << " vertices, spilled "
+              << stats.spilledBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "  Peak memory: importer " << stats.peakTrackedBytes / (1024.0 * 1024.0) << " MB, process "
+              << stats.peakResidentBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    Common::CookedMeshFile file;
+    if (!file.open(cachePath)) {
+        std::cout << "ERROR: Failed to open cooked mesh: " << cachePath << std::endl;
+        return;
+    }
+    loadCooked(file, cachePath);
+}
+
+void Model::loadCooked(Common::CookedMeshFile &file, const std::string &cookedPath) {
+    if (file.header.vertexCount > 0) {
+        boundingBoxMin = glm::vec3(file.header.boundsMin[0], file.header.boundsMin[1], file.header.boundsMin[2]);
+        boundingBoxMax = glm::vec3(file.header.boundsMax[0], file.header.boundsMax[1], file.header.boundsMax[2]);
+    }
+    for (const auto& mtlFile : file.libraries) {
+        loadMTL(directory + "/" + mtlFile);
     }
     
-    if (!vertices.empty()) {
-        std::cout << "Creating mesh with " << textures.size() << " textures and " << vertices.size() << " vertices" << std::endl;
-        Mesh mesh(vertices, indices, textures);
-        meshes.push_back(mesh);
+    std::vector<Texture> textures;
+    collectTextures(textures);
+    unsigned int fallbackTexture = textures.empty() ? 0 : textures[0].id;
+    
+    std::vector<Common::CookedLod> levels = file.lods;
+    if (levels.empty()) {
+        levels.push_back(Common::CookedLod{ 0, static_cast<uint32_t>(file.subMeshes.size()), 0.0f, 0 });
+    }
+    std::vector<MeshLod> lods;
+    for (const auto& level : levels) {
+        std::vector<SubMesh> subMeshes;
+        for (uint32_t i = level.firstSubMesh; i < level.firstSubMesh + level.subMeshCount; ++i) {
+            const Common::CookedSubMesh& cooked = file.subMeshes[i];
+            SubMesh subMesh;
+            subMesh.indexOffset = cooked.indexOffset;
+            subMesh.indexCount = cooked.indexCount;
+            subMesh.material = cooked.material < file.materials.size() ? file.materials[cooked.material] : std::string();
+            subMesh.textureID = materialTexture(subMesh.material, fallbackTexture);
+            subMeshes.push_back(subMesh);
+        }
+        // draw in texture order; neighbouring ranges with the same texture become one draw
+        std::stable_sort(subMeshes.begin(), subMeshes.end(), [](const SubMesh& a, const SubMesh& b) {
+            return a.textureID < b.textureID;
+        });
+        MeshLod lod;
+        lod.error = level.error;
+        for (const auto& subMesh : subMeshes) {
+            if (!lod.subMeshes.empty() && lod.subMeshes.back().textureID == subMesh.textureID
+                && lod.subMeshes.back().indexOffset + lod.subMeshes.back().indexCount == subMesh.indexOffset) {
+                lod.subMeshes.back().indexCount += subMesh.indexCount;
+            } else {
+                lod.subMeshes.push_back(subMesh);
+            }
+        }
+        lods.push_back(lod);
+    }
+    std::vector<SubMesh> merged = lods[0].subMeshes;
+    lods.erase(lods.begin());
+    
+    if (file.header.indexCount > 0) {
+        std::cout << "Creating mesh from " << cookedPath << " with " << file.header.vertexCount << " vertices, "
+                  << merged.size() << " submeshes and " << lods.size() << " simplified levels" << std::endl;
+        meshes.push_back(Mesh(file, textures, merged, lods));
     }
 }
 
 void Model::loadMTL(std::string path) {
-    std::ifstream file(path);
+    Common::ResourceResolver &resolver = Common::ResourceResolver::shared();
+    std::string mtlFileName = path.substr(path.find_last_of("/\\") + 1);
+    std::string resolved = resolver.findFirst({ path, directory + "/" + mtlFileName });
+    std::ifstream file;
+    if (!resolved.empty()) {
+        file.open(resolved);
+    }
     if (!file.is_open()) {
-        // Try alternative paths
-        std::string mtlFileName = path.substr(path.find_last_of("/\\") + 1);
-        std::vector<std::string> altPaths = {
-            directory + "/" + mtlFileName,
-            "../" + path,
-            "../../" + path
-        };
-        std::cout << "MTL file not found at: " << path << ", trying alternatives..." << std::endl;
-        for (const auto& altPath : altPaths) {
-            std::cout << "  Trying: " << altPath << std::endl;
-            file.open(altPath);
-            if (file.is_open()) {
-                path = altPath;
-                std::cout << "  Found at: " << altPath << std::endl;
-                break;
-            }
-        }
-        if (!file.is_open()) {
-            std::cout << "Warning: Could not open MTL file: " << path << std::endl;
-            return;
-        }
+        resolver.noteUnresolved(path, "mtllib of " + directory);
+        return;
     }
+    path = resolved;
     
     std::cout << "Loading MTL file: " << path << std::endl;
     std::cout << "Directory: " << directory << std::endl;
     std::string currentMaterial;
     std::string line;
     
+    // Normalize directory path (remove trailing slashes)
+    std::string dir = directory;
+    while (!dir.empty() && (dir.back() == '/' || dir.back() == '\\')) {
+        dir.pop_back();
+    }
+    
     while (std::getline(file, line)) {
         std::istringstream iss(line);
         std::string type;
@@ -305,88 +749,49 @@ void Model::loadMTL(std::string path) {
                 texPath = texPath.substr(lastSlash + 1);
             }
             
-            std::cout << "  Processing texture: " << texPath << " for material: " << currentMaterial << std::endl;
-            
-            // Try multiple paths for texture
-            std::vector<std::string> texturePaths;
-            
             // Extract base name (filename without extension)
             size_t dotPos = texPath.find_last_of('.');
             std::string baseName = (dotPos != std::string::npos) ? texPath.substr(0, dotPos) : texPath;
+            std::string ext = (dotPos != std::string::npos) ? texPath.substr(dotPos) : std::string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
             
-            // Normalize directory path (remove trailing slashes)
-            std::string dir = directory;
-            while (!dir.empty() && (dir.back() == '/' || dir.back() == '\\')) {
-                dir.pop_back();
-            }
-            
-            // Try paths in order of priority:
-            // Note: stb_image doesn't support .dds, so we try .png versions first
-            // 1. Textures subfolder with PNG (convert .dds to .png) - highest priority
-            texturePaths.push_back(dir + "/Textures/" + baseName + ".png");
-            // 2. Textures folder (parent) with PNG
-            texturePaths.push_back(dir + "/../textures/" + baseName + ".png");
-            // 3. Same directory with PNG
-            texturePaths.push_back(dir + "/" + baseName + ".png");
-            // 4. Textures subfolder with original extension (skip .dds, stb_image doesn't support it)
-            if (dotPos != std::string::npos) {
-                std::string ext = texPath.substr(dotPos);
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                if (ext != ".dds") {
-                    texturePaths.push_back(dir + "/Textures/" + texPath);
+            // Candidates in order of priority, each a lookup in the resolver's index (which
+            // ignores case). A DDS / KTX original comes first, since it carries its own
+            // compressed mip chain; otherwise PNG versions come before the original extension
+            const std::string folders[] = { dir + "/Textures/", dir + "/../textures/", dir + "/" };
+            const bool compressed = Common::isCompressedTextureFile(texPath);
+            std::vector<std::string> texturePaths;
+            if (compressed) {
+                for (const auto& folder : folders) {
+                    texturePaths.push_back(folder + texPath);
                 }
             }
-            // 5. Textures folder (parent) with original extension (skip .dds)
-            if (dotPos != std::string::npos) {
-                std::string ext = texPath.substr(dotPos);
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                if (ext != ".dds") {
-                    texturePaths.push_back(dir + "/../textures/" + texPath);
-                }
+            for (const auto& folder : folders) {
+                texturePaths.push_back(folder + baseName + ".png");
             }
-            // 6. Same directory with original extension (skip .dds)
-            if (dotPos != std::string::npos) {
-                std::string ext = texPath.substr(dotPos);
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                if (ext != ".dds") {
-                    texturePaths.push_back(dir + "/" + texPath);
+            if (!ext.empty() && !compressed) {
+                for (const auto& folder : folders) {
+                    texturePaths.push_back(folder + texPath);
                 }
             }
-            // 7. Same directory with BMP
-            texturePaths.push_back(dir + "/" + baseName + ".bmp");
-            texturePaths.push_back(dir + "/../textures/" + baseName + ".bmp");
-            texturePaths.push_back(dir + "/Textures/" + baseName + ".bmp");
-            // 8. Same directory with TGA
-            texturePaths.push_back(dir + "/" + baseName + ".tga");
-            texturePaths.push_back(dir + "/../textures/" + baseName + ".tga");
-            texturePaths.push_back(dir + "/Textures/" + baseName + ".tga");
-            // 9. Try with different case variations (for Windows)
-            std::string baseNameLower = baseName;
-            std::transform(baseNameLower.begin(), baseNameLower.end(), baseNameLower.begin(), ::tolower);
-            texturePaths.push_back(dir + "/Textures/" + baseNameLower + ".png");
-            texturePaths.push_back(dir + "/../textures/" + baseNameLower + ".png");
-            texturePaths.push_back(dir + "/" + baseNameLower + ".png");
-            
-            bool textureLoaded = false;
-            for (const auto& texFile : texturePaths) {
-                std::cout << "    Trying: " << texFile << std::endl;
-                unsigned int textureID = TextureFromFile(texFile.c_str(), directory);
-                if (textureID != 0) {
-                    Texture texture;
-                    texture.id = textureID;
-                    texture.type = (type == "map_Kd") ? "diffuse" : ((type == "map_Ks") ? "specular" : "ambient");
-                    texture.path = texFile;
-                    materials[currentMaterial].push_back(texture);
-                    textureLoaded = true;
-                    std::cout << "    ✓ Loaded texture: " << texFile << " for material: " << currentMaterial << std::endl;
-                    break;
+            for (const char *fallback : { ".bmp", ".tga" }) {
+                // same directory first for these
+                for (int folder = 2; folder >= 0; folder--) {
+                    texturePaths.push_back(folders[folder] + baseName + fallback);
                 }
             }
             
-            if (!textureLoaded) {
-                std::cout << "    ✗ Warning: Could not load texture: " << texPath << " for material: " << currentMaterial << std::endl;
-                std::cout << "      Tried " << texturePaths.size() << " paths" << std::endl;
+            std::string texFile = resolver.findFirst(texturePaths);
+            if (texFile.empty()) {
+                resolver.noteUnresolved(texPath, "material " + currentMaterial);
+                continue;
             }
+            Texture texture;
+            texture.id = TextureFromFile(texFile.c_str(), directory);
+            texture.type = (type == "map_Kd") ? "diffuse" : ((type == "map_Ks") ? "specular" : "ambient");
+            texture.path = texFile;
+            materials[currentMaterial].push_back(texture);
+            std::cout << "  Loading texture: " << texFile << " for material: " << currentMaterial << std::endl;
         }
     }
     
@@ -395,73 +800,64 @@ void Model::loadMTL(std::string path) {
 }
 
 unsigned int Model::TextureFromFile(const char *path, const std::string &directory) {
-    std::string filename = std::string(path);
-    
-    // Normalize path separators for Windows (convert \ to /)
-    std::replace(filename.begin(), filename.end(), '\\', '/');
-    
-    // Remove double slashes
-    size_t pos = 0;
-    while ((pos = filename.find("//", pos)) != std::string::npos) {
-        filename.replace(pos, 2, "/");
-    }
-    
-    // Try the path as-is first
-    std::ifstream testFile(filename);
-    if (testFile.good()) {
-        testFile.close();
-    } else {
-        testFile.close();
-        // File doesn't exist at this path
+    // An index lookup rather than a filesystem probe; 0 if the file is not there
+    std::string filename = Common::ResourceResolver::shared().find(path);
+    if (filename.empty()) {
         return 0;
     }
     
-    unsigned int textureID = 0;
-    
-    int width, height, nrComponents;
+    // Decoded on the shared pool; the texture shows a placeholder until the render loop
+    // uploads it (Common::TextureLoader::uploadCompleted). The flip flag is global in
+    // stb_image and only ever set to true here, before any decode is queued.
     stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data && width > 0 && height > 0 && nrComponents > 0) {
-        glGenTextures(1, &textureID);
-        
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-        else {
-            stbi_image_free(data);
-            return 0; // Unsupported format
-        }
-        
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
-        stbi_image_free(data);
-        std::cout << "Texture loaded successfully: " << filename << std::endl;
-    } else {
-        if (data) {
-            stbi_image_free(data);
-        }
-        // Texture failed to load, return 0
-        textureID = 0;
+    // The worker loads the cooked file, compressed with its mip chain, in place of the image,
+    // cooking it there on the first import; this thread only acquires the texture.
+    // Shared with every other model that uses the same image; released in ~Model
+    unsigned int texture = Common::TextureManager::shared().acquire(
+        filename, Common::cookingDecoder(decodeImageFile, settings.textureCooking));
+    if (texture != 0) {
+        ownedTextures.push_back(texture);
     }
-    
-    return textureID;
+    return texture;
 }
 
-void Model::Draw(unsigned int shaderID) {
+Model::~Model() {
+    for (unsigned int texture : ownedTextures) {
+        Common::TextureManager::shared().release(texture);
+    }
+}
+
+void Model::Draw(unsigned int shaderID, unsigned int lod) {
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shaderID);
+        meshes[i].Draw(shaderID, lod);
+    }
+}
+
+unsigned int Model::getLodCount() const {
+    size_t count = 1;
+    for (const auto& mesh : meshes) {
+        count = std::max(count, mesh.lods.size() + 1);
+    }
+    return static_cast<unsigned int>(count);
+}
+
+// Largest error of the level over all meshes (a mesh with fewer levels draws its last one)
+float Model::getLodError(unsigned int lod) const {
+    float error = 0.0f;
+    for (const auto& mesh : meshes) {
+        if (lod > 0 && !mesh.lods.empty()) {
+            error = std::max(error, mesh.lods[std::min<size_t>(lod, mesh.lods.size()) - 1].error);
+        }
+    }
+    return error;
+}
+
+unsigned int Model::selectLod(float distance, float projectionScale, float maxPixelError) const {
+    std::vector<float> errors(getLodCount());
+    for (unsigned int lod = 0; lod < errors.size(); ++lod) {
+        errors[lod] = getLodError(lod);
     }
+    return Common::selectLod(errors.data(), errors.size(), distance, projectionScale, maxPixelError);
 }
 
 // Stub implementations for unused methods
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <glad/glad.h>
+#include "material_binding.hpp"
+#include "mesh_cache.hpp"
+#include "vertex_format.hpp"
+#include "texture_cache.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
 
 struct Vertex {
     glm::vec3 Position;
@@ -19,31 +24,106 @@ struct Texture {
     std::string path;
 };
 
+// A contiguous index range of a Mesh drawn with one diffuse texture.
+// Materials that share a texture are merged into one range.
+struct SubMesh {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    unsigned int textureID;
+    std::string material;
+};
+
+// A simplified level of a Mesh: its own index ranges over the same vertex buffer.
+struct MeshLod {
+    float error; // object-space distance to the full mesh
+    std::vector<SubMesh> subMeshes;
+};
+
 class Mesh {
 public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    std::vector<SubMesh> subMeshes; // sorted by textureID; empty means one draw with textures[0]
+    std::vector<MeshLod> lods;      // levels 1..n; level 0 is subMeshes
     unsigned int VAO;
     
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(unsigned int shaderID);
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+         std::vector<SubMesh> subMeshes, std::vector<MeshLod> lods = std::vector<MeshLod>(),
+         const Common::VertexFormat &format = Common::VertexFormat::full());
+    // GPU-only mesh uploaded from a cooked mesh file (vertices/indices stay empty); its
+    // vertex format is whatever the file's attribute table says
+    Mesh(Common::CookedMeshFile &file, std::vector<Texture> textures, std::vector<SubMesh> subMeshes,
+         std::vector<MeshLod> lods = std::vector<MeshLod>());
+    // Also sets the positionScale / positionOffset / octahedralNormals uniforms the vertex
+    // shader uses to decode a packed format (identity for full floats). Their locations and
+    // the texture_diffuse1 sampler's are resolved on the first draw with each program
+    void Draw(unsigned int shaderID, unsigned int lod = 0);
     
 private:
     unsigned int VBO, EBO;
+    Common::VertexFormat format;
+    Common::VertexDecode decode;
+    unsigned int indexSize = sizeof(unsigned int); // 2 when the mesh has at most 65536 vertices
+    // set when the buffers are being uploaded by a Common::UploadContext
+    std::shared_ptr<bool> buffersReady;
+    std::vector<Common::CookedAttribute> vertexAttributes;
+    unsigned int vertexStride = 0;
+    Common::MaterialBindings materialBindings;
+    void buildMaterialBinding(Common::MaterialBinding &table) const;
     void setupMesh();
+    bool vertexArrayReady();
+    void setupCookedMesh(Common::CookedMeshFile &file);
+};
+
+struct ModelLoadSettings {
+    // OBJ files at least this large are imported out of core (obj_stream.h)
+    unsigned long long streamingThreshold = 1ull << 30;
+    size_t streamingMemoryBudget = 256u << 20;  // 16 MB at least (ObjStreamSettings::memoryBudget)
+    // reorder triangles and vertices for the post-transform cache (mesh_optimizer.hpp);
+    // the out-of-core path keeps file order
+    bool optimizeMesh = true;
+    // simplified levels generated at import (mesh_simplifier.hpp), each about half the
+    // triangles of the previous; 0 disables. Not generated by the out-of-core path
+    unsigned int lodCount = 0;
+    // reuse / write <model>.cmesh, keyed by the source contents and these settings
+    bool useMeshCache = true;
+    // GPU vertex layout (vertex_format.hpp). Packed formats halve vertex memory but need the
+    // decode in the vertex shader; 16-bit indices are used automatically either way
+    Common::VertexFormat vertexFormat = Common::VertexFormat::full();
+    // material images are compressed to BC1/BC3/BC7 with their mip chain at import and
+    // cached in <image>.ctex (texture_cache.hpp); DDS / KTX files are used as they are
+    Common::TextureCookSettings textureCooking;
 };
 
 class Model {
 public:
     Model(const char *path);
-    void Draw(unsigned int shaderID);
+    Model(const char *path, const ModelLoadSettings &settings);
+    // Releases its textures (Common::TextureManager); not copyable for that reason
+    ~Model();
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    void Draw(unsigned int shaderID, unsigned int lod = 0);
     glm::vec3 getBoundingBoxMin() const { return boundingBoxMin; }
     glm::vec3 getBoundingBoxMax() const { return boundingBoxMax; }
     
+    // Levels of detail, including the full mesh
+    unsigned int getLodCount() const;
+    float getLodError(unsigned int lod) const;
+    // Coarsest level whose error stays within maxPixelError pixels at `distance` from the
+    // camera; projectionScale comes from Common::lodProjectionScale(fovY, viewportHeight)
+    unsigned int selectLod(float distance, float projectionScale, float maxPixelError = 1.0f) const;
+    
 private:
     std::vector<Mesh> meshes;
     std::string directory;
+    ModelLoadSettings settings;
+    std::string cachePath;
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    Common::FileStamp sourceStamp;
     glm::vec3 boundingBoxMin;
     glm::vec3 boundingBoxMax;
     
@@ -56,8 +136,17 @@ private:
     // Simple OBJ loader
     void loadOBJ(std::string path);
     void loadMTL(std::string path);
+    void loadOBJStreaming(std::string path);
+    void loadCooked(Common::CookedMeshFile &file, const std::string &cookedPath);
+    void writeMeshCache(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                        const std::vector<SubMesh> &subMeshes, const std::vector<MeshLod> &lods,
+                        const std::vector<std::string> &libraries, const Common::VertexFormat &format);
+    void collectTextures(std::vector<Texture> &textures);
+    unsigned int materialTexture(const std::string &material, unsigned int fallbackTexture) const;
     
     // Material storage
     std::map<std::string, std::vector<Texture>> materials;
+    // one Common::TextureManager reference per TextureFromFile call
+    std::vector<unsigned int> ownedTextures;
 };
 
@@ -0,0 +1,589 @@
+// OBJ loading benchmark.
+// Compares the previous std::getline/std::istringstream loader with the bulk-read
+// parser in obj_parser.cpp on one large file, single-threaded and chunked across a
+// thread pool. Without --obj a synthetic scanned-prop style mesh of --size-mb megabytes
+// is written next to the executable first (--relative writes negative face indices).
+//
+// --stream-budget-mb runs the out-of-core importer first (so the process peak RSS it
+// reports is its own) and checks the cooked mesh against the in-memory parse;
+// --stream-only skips everything that loads the whole file.
+//
+// The welded mesh is also run through the import optimizer (mesh_optimizer.hpp), which
+// reports ACMR/ATVR before and after and is checked to keep every triangle, and packed
+// into the compact vertex format (vertex_format.hpp) to report its size and decode error.
+//
+// usage: obj_benchmark [--obj PATH] [--size-mb N] [--repeat N] [--threads N]
+//                      [--relative] [--skip-legacy] [--keep]
+//                      [--stream-budget-mb N] [--stream-only]
+
+#include "obj_parser.h"
+#include "obj_stream.h"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "vertex_format.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+struct BenchOptions {
+    std::string objPath;
+    int sizeMB = 256;
+    int repeat = 1;
+    int threads = 0;
+    bool relative = false;
+    bool skipLegacy = false;
+    bool keep = false;
+    int streamBudgetMB = 0;
+    bool streamOnly = false;
+};
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsedMs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Writes a displaced sphere-like grid with positions, UVs and normals, quads and
+// triangles mixed, until the file reaches roughly `sizeMB` megabytes. Rows of vertices
+// and faces are interleaved like exporters writing one group after another; with
+// `relative` the faces use negative indices, which often reach into earlier parse chunks.
+static bool writeSyntheticOBJ(const std::string &path, int sizeMB, bool relative) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cout << "ERROR: Cannot write " << path << std::endl;
+        return false;
+    }
+    const size_t targetBytes = static_cast<size_t>(sizeMB) * 1024 * 1024;
+    // every grid cell costs about 3 vertex lines (~115 bytes) plus 1.5 faces (~60 bytes)
+    const int resolution = std::max(8, static_cast<int>(std::sqrt(targetBytes / 175.0)));
+    const int row = resolution + 1;
+
+    out << "# synthetic scan, " << resolution << "x" << resolution << " grid\n";
+    out << "mtllib synthetic.mtl\n";
+    char line[160];
+    for (int y = 0; y <= resolution; ++y) {
+        for (int x = 0; x <= resolution; ++x) {
+            float u = static_cast<float>(x) / resolution;
+            float v = static_cast<float>(y) / resolution;
+            float theta = u * 6.2831853f;
+            float phi = v * 3.1415926f;
+            float r = 1.0f + 0.05f * std::sin(theta * 17.0f) * std::cos(phi * 13.0f);
+            float nx = std::sin(phi) * std::cos(theta), ny = std::cos(phi), nz = std::sin(phi) * std::sin(theta);
+            int n = std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                r * nx, r * ny, r * nz, u, v, nx, ny, nz);
+            out.write(line, n);
+        }
+        if (y == 0) {
+            continue;
+        }
+        // a few material bands, so usemtl ranges also cross parse chunk boundaries
+        if (y % 16 == 1) {
+            out << "usemtl band_" << (y / 16) % 4 << "\n";
+        }
+        // faces of the row just closed; -1 is the last vertex written so far
+        const int written = (y + 1) * row;
+        const int shift = relative ? -(written + 1) : 0;
+        for (int x = 0; x < resolution; ++x) {
+            int a = (y - 1) * row + x + 1 + shift, b = a + 1, c = a + row + 1, d = a + row;
+            int n;
+            if ((x + y) % 2 == 0) {
+                n = std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                    a, a, a, b, b, b, c, c, c, d, d, d);
+            } else {
+                n = std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                    a, a, a, b, b, b, c, c, c, a, a, a, c, c, c, d, d, d);
+            }
+            out.write(line, n);
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+static bool sameObjData(const ObjData &a, const ObjData &b) {
+    if (a.materialRanges.size() != b.materialRanges.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.materialRanges.size(); ++i) {
+        if (a.materialRanges[i].name != b.materialRanges[i].name
+            || a.materialRanges[i].firstCorner != b.materialRanges[i].firstCorner) {
+            return false;
+        }
+    }
+    auto sameBytes = [](const void *x, const void *y, size_t bytes) {
+        return bytes == 0 || std::memcmp(x, y, bytes) == 0;
+    };
+    return a.positions.size() == b.positions.size() && a.texCoords.size() == b.texCoords.size()
+        && a.normals.size() == b.normals.size() && a.corners.size() == b.corners.size()
+        && sameBytes(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(glm::vec3))
+        && sameBytes(a.texCoords.data(), b.texCoords.data(), a.texCoords.size() * sizeof(glm::vec2))
+        && sameBytes(a.normals.data(), b.normals.data(), a.normals.size() * sizeof(glm::vec3))
+        && sameBytes(a.corners.data(), b.corners.data(), a.corners.size() * sizeof(ObjCorner))
+        && a.mtllibs == b.mtllibs
+        && a.boundingBoxMin == b.boundingBoxMin && a.boundingBoxMax == b.boundingBoxMax;
+}
+
+// The loader Model::loadOBJ used before obj_parser.cpp, kept as the reference.
+static void legacyLoadOBJ(const std::string &path, std::vector<BenchVertex> &vertices) {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    vertices.clear();
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string type;
+        iss >> type;
+
+        if (type == "v") {
+            glm::vec3 pos;
+            iss >> pos.x >> pos.y >> pos.z;
+            positions.push_back(pos);
+        } else if (type == "vt") {
+            glm::vec2 tex;
+            iss >> tex.x >> tex.y;
+            texCoords.push_back(tex);
+        } else if (type == "vn") {
+            glm::vec3 norm;
+            iss >> norm.x >> norm.y >> norm.z;
+            normals.push_back(norm);
+        } else if (type == "f") {
+            std::vector<std::string> vertexTokens;
+            std::string vertexToken;
+            while (iss >> vertexToken) {
+                vertexTokens.push_back(vertexToken);
+            }
+            if (vertexTokens.size() < 3) {
+                continue;
+            }
+
+            auto parseFaceToken = [&](const std::string &face) {
+                std::stringstream ss(face);
+                std::string token;
+                int posIdx = -1, texIdx = -1, normIdx = -1;
+                if (std::getline(ss, token, '/') && !token.empty()) posIdx = std::stoi(token) - 1;
+                if (std::getline(ss, token, '/') && !token.empty()) texIdx = std::stoi(token) - 1;
+                if (std::getline(ss, token, '/') && !token.empty()) normIdx = std::stoi(token) - 1;
+
+                BenchVertex vertex;
+                vertex.Position = (posIdx >= 0 && posIdx < static_cast<int>(positions.size())) ? positions[posIdx] : glm::vec3(0.0f);
+                vertex.TexCoords = (texIdx >= 0 && texIdx < static_cast<int>(texCoords.size())) ? texCoords[texIdx] : glm::vec2(0.0f);
+                vertex.Normal = (normIdx >= 0 && normIdx < static_cast<int>(normals.size())) ? normals[normIdx] : glm::vec3(0.0f, 1.0f, 0.0f);
+                return vertex;
+            };
+
+            std::vector<BenchVertex> faceVertices;
+            for (const auto &token : vertexTokens) {
+                faceVertices.push_back(parseFaceToken(token));
+            }
+            for (size_t i = 1; i + 1 < faceVertices.size(); ++i) {
+                vertices.push_back(faceVertices[0]);
+                vertices.push_back(faceVertices[i]);
+                vertices.push_back(faceVertices[i + 1]);
+            }
+        }
+    }
+}
+
+// obj_parser.cpp plus the same corner expansion Model::loadOBJ does.
+static void fastLoadOBJ(const std::string &path, unsigned int threads, std::vector<BenchVertex> &vertices) {
+    ObjData obj;
+    parseOBJFile(path, obj, threads);
+    vertices.resize(obj.corners.size());
+    for (size_t i = 0; i < obj.corners.size(); ++i) {
+        const ObjCorner &corner = obj.corners[i];
+        BenchVertex &vertex = vertices[i];
+        vertex.Position = (corner.position >= 0 && corner.position < static_cast<int>(obj.positions.size())) ? obj.positions[corner.position] : glm::vec3(0.0f);
+        vertex.TexCoords = (corner.texCoord >= 0 && corner.texCoord < static_cast<int>(obj.texCoords.size())) ? obj.texCoords[corner.texCoord] : glm::vec2(0.0f);
+        vertex.Normal = (corner.normal >= 0 && corner.normal < static_cast<int>(obj.normals.size())) ? obj.normals[corner.normal] : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+}
+
+static float maxDifference(const std::vector<BenchVertex> &a, const std::vector<BenchVertex> &b) {
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            diff = std::max(diff, std::fabs(a[i].Position[k] - b[i].Position[k]));
+            diff = std::max(diff, std::fabs(a[i].Normal[k] - b[i].Normal[k]));
+        }
+        for (int k = 0; k < 2; ++k) {
+            diff = std::max(diff, std::fabs(a[i].TexCoords[k] - b[i].TexCoords[k]));
+        }
+    }
+    return diff;
+}
+
+// The cooked mesh must hold, per submesh, the triangles of that material in file order:
+// faces before the first usemtl first, then every material in order of first use.
+static bool verifyCookedMesh(const std::string &cookedPath, const ObjData &obj) {
+    Common::CookedMeshFile cooked;
+    if (!cooked.open(cookedPath) || cooked.header.vertexStride != sizeof(BenchVertex)) {
+        return false;
+    }
+    std::vector<BenchVertex> vertices(cooked.header.vertexCount);
+    std::vector<uint32_t> indices(cooked.header.indexCount);
+    if (!cooked.readVertexBytes(0, vertices.size() * sizeof(BenchVertex), vertices.data())
+        || !cooked.readIndexBytes(0, indices.size() * sizeof(uint32_t), indices.data())
+        || indices.size() != obj.corners.size()) {
+        return false;
+    }
+
+    std::vector<std::pair<size_t, size_t>> expected; // corner ranges in cooked order
+    size_t unassigned = obj.materialRanges.empty() ? obj.corners.size() : obj.materialRanges[0].firstCorner;
+    if (unassigned > 0) {
+        expected.push_back(std::make_pair(size_t(0), unassigned));
+    }
+    for (const std::string &material : cooked.materials) {
+        for (size_t r = 0; r < obj.materialRanges.size(); ++r) {
+            if (obj.materialRanges[r].name == material) {
+                size_t last = r + 1 < obj.materialRanges.size() ? obj.materialRanges[r + 1].firstCorner : obj.corners.size();
+                expected.push_back(std::make_pair(obj.materialRanges[r].firstCorner, last));
+            }
+        }
+    }
+
+    size_t cookedIndex = 0;
+    for (const auto &range : expected) {
+        for (size_t i = range.first; i < range.second; ++i, ++cookedIndex) {
+            const ObjCorner &corner = obj.corners[i];
+            const BenchVertex &vertex = vertices[indices[cookedIndex]];
+            glm::vec3 position = corner.position >= 0 ? obj.positions[corner.position] : glm::vec3(0.0f);
+            glm::vec2 texCoord = corner.texCoord >= 0 ? obj.texCoords[corner.texCoord] : glm::vec2(0.0f);
+            glm::vec3 normal = corner.normal >= 0 ? obj.normals[corner.normal] : glm::vec3(0.0f, 1.0f, 0.0f);
+            if (vertex.Position != position || vertex.TexCoords != texCoord || vertex.Normal != normal) {
+                return false;
+            }
+        }
+    }
+    return cookedIndex == indices.size();
+}
+
+// Every triangle as its 24 attribute floats, rotated to start at its smallest corner, sorted;
+// equal for two index buffers that draw the same triangles with the same winding.
+static std::vector<std::vector<float>> canonicalTriangles(const std::vector<BenchVertex> &vertices,
+                                                          const std::vector<unsigned int> &indices) {
+    std::vector<std::vector<float>> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        std::vector<float> corners[3];
+        for (int c = 0; c < 3; ++c) {
+            const float *attributes = &vertices[indices[t * 3 + c]].Position.x;
+            corners[c].assign(attributes, attributes + 8);
+        }
+        int first = 0;
+        for (int c = 1; c < 3; ++c) {
+            if (corners[c] < corners[first]) {
+                first = c;
+            }
+        }
+        for (int c = 0; c < 3; ++c) {
+            const std::vector<float> &corner = corners[(first + c) % 3];
+            triangles[t].insert(triangles[t].end(), corner.begin(), corner.end());
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static BenchOptions parseOptions(int argc, char **argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--obj" && i + 1 < argc) {
+            options.objPath = argv[++i];
+        } else if (arg == "--size-mb" && i + 1 < argc) {
+            options.sizeMB = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--relative") {
+            options.relative = true;
+        } else if (arg == "--stream-budget-mb" && i + 1 < argc) {
+            options.streamBudgetMB = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--stream-only") {
+            options.streamOnly = true;
+        } else if (arg == "--skip-legacy") {
+            options.skipLegacy = true;
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            std::cout << "Warning: ignoring unknown argument " << arg << std::endl;
+        }
+    }
+    return options;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options = parseOptions(argc, argv);
+
+    bool generated = false;
+    if (options.objPath.empty()) {
+        options.objPath = "obj_benchmark_synthetic.obj";
+        std::cout << "Writing " << options.sizeMB << " MB synthetic OBJ to " << options.objPath << "..." << std::endl;
+        if (!writeSyntheticOBJ(options.objPath, options.sizeMB, options.relative)) {
+            return 1;
+        }
+        generated = true;
+    }
+
+    std::ifstream probe(options.objPath, std::ios::binary | std::ios::ate);
+    if (!probe.is_open()) {
+        std::cout << "ERROR: Cannot read " << options.objPath << std::endl;
+        return 1;
+    }
+    double megabytes = static_cast<double>(probe.tellg()) / (1024.0 * 1024.0);
+    probe.close();
+    std::cout << "File: " << options.objPath << " (" << megabytes << " MB)" << std::endl;
+
+    int status = 0;
+    bool streamed = false;
+    const std::string cookedPath = options.objPath + ".cooked";
+    if (options.streamBudgetMB > 0) {
+        ObjStreamSettings settings;
+        settings.memoryBudget = static_cast<size_t>(options.streamBudgetMB) << 20;
+        // keyed like Model's cache entry, so the warm start below can trust the stamp
+        Common::hashFile(options.objPath, settings.sourceHash);
+        Common::statFile(options.objPath, settings.sourceStamp);
+        ObjStreamStats stats;
+        streamed = streamOBJToCookedMesh(options.objPath, cookedPath, settings, stats);
+        std::cout << "Streaming import (" << options.streamBudgetMB << " MB budget): " << stats.seconds * 1000.0 << " ms, "
+                  << megabytes / stats.seconds << " MB/s, " << stats.corners << " corners -> " << stats.vertices
+                  << " vertices (" << stats.weldTableResets << " weld table resets)" << std::endl;
+        std::cout << "  spilled " << stats.spilledBytes / (1024.0 * 1024.0) << " MB, peak tracked "
+                  << stats.peakTrackedBytes / (1024.0 * 1024.0) << " MB, process peak RSS "
+                  << stats.peakResidentBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        if (!streamed) {
+            status = 1;
+        }
+    }
+    if (options.streamOnly) {
+        if (generated && !options.keep) {
+            std::remove(options.objPath.c_str());
+        }
+        if (streamed && !options.keep) {
+            std::remove(cookedPath.c_str());
+        }
+        return status;
+    }
+
+    std::vector<BenchVertex> fastVertices;
+    double fastMs = 1e30;
+    for (int r = 0; r < options.repeat; ++r) {
+        auto start = BenchClock::now();
+        fastLoadOBJ(options.objPath, 1, fastVertices);
+        fastMs = std::min(fastMs, elapsedMs(start));
+    }
+    std::cout << "obj_parser, 1 thread:  " << fastMs << " ms, " << megabytes / (fastMs / 1000.0) << " MB/s, "
+              << fastVertices.size() << " vertices" << std::endl;
+
+    // chunked parse on a pool; must match the single-threaded parse byte for byte
+    {
+        Common::ThreadPool pool(static_cast<size_t>(options.threads));
+        std::vector<char> buffer;
+        readFileBytes(options.objPath, buffer);
+        const char *begin = buffer.data();
+        const char *end = begin + buffer.size();
+
+        ObjData serial, parallel;
+        double serialMs = 1e30, parallelMs = 1e30;
+        for (int r = 0; r < options.repeat; ++r) {
+            auto start = BenchClock::now();
+            serial.clear();
+            parseOBJBuffer(begin, end, serial);
+            serialMs = std::min(serialMs, elapsedMs(start));
+
+            start = BenchClock::now();
+            parseOBJBufferParallel(begin, end, parallel, pool);
+            parallelMs = std::min(parallelMs, elapsedMs(start));
+        }
+        std::cout << "Parse only (file in memory): 1 thread " << serialMs << " ms, " << pool.size() << " threads "
+                  << parallelMs << " ms (" << serialMs / parallelMs << "x)" << std::endl;
+        if (!sameObjData(serial, parallel)) {
+            std::cout << "ERROR: parallel parse differs from the single-threaded parse" << std::endl;
+            status = 1;
+        }
+    }
+
+    std::vector<BenchVertex> parallelVertices;
+    double parallelMs = 1e30;
+    for (int r = 0; r < options.repeat; ++r) {
+        auto start = BenchClock::now();
+        fastLoadOBJ(options.objPath, static_cast<unsigned int>(options.threads), parallelVertices);
+        parallelMs = std::min(parallelMs, elapsedMs(start));
+    }
+    std::cout << "obj_parser, pooled:    " << parallelMs << " ms, " << megabytes / (parallelMs / 1000.0) << " MB/s" << std::endl;
+
+    // welding identical (v, vt, vn) corners, as Model::loadOBJ does
+    {
+        ObjData obj;
+        parseOBJFile(options.objPath, obj);
+        std::vector<ObjCorner> uniqueCorners;
+        std::vector<unsigned int> indices;
+        auto start = BenchClock::now();
+        indexOBJCorners(obj.corners, uniqueCorners, indices);
+        double dedupMs = elapsedMs(start);
+
+        bool consistent = indices.size() == obj.corners.size();
+        for (size_t i = 0; consistent && i < indices.size(); ++i) {
+            const ObjCorner &a = obj.corners[i];
+            const ObjCorner &b = uniqueCorners[indices[i]];
+            consistent = a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+        }
+        double before = obj.corners.size() * sizeof(BenchVertex) / (1024.0 * 1024.0);
+        double after = (uniqueCorners.size() * sizeof(BenchVertex) + indices.size() * sizeof(unsigned int)) / (1024.0 * 1024.0);
+        std::cout << "Deduplication: " << dedupMs << " ms, " << obj.corners.size() << " -> " << uniqueCorners.size()
+                  << " vertices (" << static_cast<double>(obj.corners.size()) / std::max<size_t>(1, uniqueCorners.size())
+                  << "x), vertex+index data " << before << " MB -> " << after << " MB" << std::endl;
+        if (!consistent) {
+            std::cout << "ERROR: deduplicated indices do not reproduce the corners" << std::endl;
+            status = 1;
+        }
+
+        // import optimization, as Model::loadOBJ does after grouping by material
+        std::vector<BenchVertex> vertices(uniqueCorners.size());
+        for (size_t i = 0; i < uniqueCorners.size(); ++i) {
+            const ObjCorner &corner = uniqueCorners[i];
+            vertices[i].Position = corner.position >= 0 ? obj.positions[corner.position] : glm::vec3(0.0f);
+            vertices[i].TexCoords = corner.texCoord >= 0 ? obj.texCoords[corner.texCoord] : glm::vec2(0.0f);
+            vertices[i].Normal = corner.normal >= 0 ? obj.normals[corner.normal] : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        std::vector<std::vector<float>> trianglesBefore = canonicalTriangles(vertices, indices);
+        Common::MeshOptimizationStats optimized = Common::optimizeMesh(vertices.data(), vertices.size(), sizeof(BenchVertex),
+                                                                       offsetof(BenchVertex, Position), indices.data(), indices.size());
+        vertices.resize(optimized.verticesAfter);
+        std::cout << "Mesh optimization: " << optimized.seconds * 1000.0 << " ms, ACMR " << optimized.before.acmr << " -> "
+                  << optimized.after.acmr << ", ATVR " << optimized.before.atvr << " -> " << optimized.after.atvr
+                  << " (32-entry FIFO)" << std::endl;
+        if (canonicalTriangles(vertices, indices) != trianglesBefore) {
+            std::cout << "ERROR: optimized mesh does not contain the same triangles" << std::endl;
+            status = 1;
+        }
+        
+        // compact vertex format, decoded the way the vertex shader does
+        Common::VertexStreams streams;
+        streams.count = vertices.size();
+        streams.stride = sizeof(BenchVertex);
+        if (!vertices.empty()) {
+            streams.positions = &vertices[0].Position.x;
+            streams.normals = &vertices[0].Normal.x;
+            streams.texCoords = &vertices[0].TexCoords.x;
+        }
+        Common::VertexLayout layout = Common::makeVertexLayout(Common::VertexFormat::compact(), streams);
+        std::vector<unsigned char> packed(vertices.size() * layout.stride);
+        start = BenchClock::now();
+        Common::packVertices(layout, streams, packed.data());
+        double packMs = elapsedMs(start);
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        float texCoordError = 0.0f;
+        float extent = 0.0f;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const unsigned char *vertex = packed.data() + i * layout.stride;
+            uint16_t position[3];
+            int16_t normal[2];
+            uint16_t texCoord[2];
+            std::memcpy(position, vertex + layout.attributes[0].offset, sizeof(position));
+            std::memcpy(normal, vertex + layout.attributes[1].offset, sizeof(normal));
+            std::memcpy(texCoord, vertex + layout.attributes[2].offset, sizeof(texCoord));
+            for (int axis = 0; axis < 3; ++axis) {
+                float decoded = layout.decode.positionOffset[axis] + layout.decode.positionScale[axis] * (position[axis] / 65535.0f);
+                positionError = std::max(positionError, std::fabs(decoded - vertices[i].Position[axis]));
+                extent = std::max(extent, layout.decode.positionScale[axis]);
+            }
+            float decodedNormal[3];
+            Common::octDecode(normal, decodedNormal);
+            glm::vec3 source = glm::normalize(vertices[i].Normal);
+            float cosine = std::min(1.0f, decodedNormal[0] * source.x + decodedNormal[1] * source.y + decodedNormal[2] * source.z);
+            normalError = std::max(normalError, std::acos(cosine) * 57.2957795f);
+            for (int axis = 0; axis < 2; ++axis) {
+                texCoordError = std::max(texCoordError, std::fabs(Common::halfToFloat(texCoord[axis]) - vertices[i].TexCoords[axis]));
+            }
+        }
+        const uint32_t indexSize = Common::indexSizeFor(vertices.size());
+        double fullMB = (vertices.size() * sizeof(BenchVertex) + indices.size() * sizeof(unsigned int)) / (1024.0 * 1024.0);
+        double packedMB = (packed.size() + indices.size() * indexSize) / (1024.0 * 1024.0);
+        std::cout << "Compact vertices: " << packMs << " ms, " << sizeof(BenchVertex) << " -> " << layout.stride
+                  << " bytes per vertex, " << indexSize * 8 << "-bit indices, vertex+index data " << fullMB << " MB -> "
+                  << packedMB << " MB" << std::endl;
+        std::cout << "  max error: position " << positionError << " (" << positionError / std::max(extent, 1e-30f) * 100.0f
+                  << "% of the bounds), normal " << normalError << " degrees, uv " << texCoordError << std::endl;
+    }
+
+    if (options.relative && !options.skipLegacy) {
+        std::cout << "Skipping the istringstream loader: it does not support relative indices" << std::endl;
+    } else if (!options.skipLegacy) {
+        std::vector<BenchVertex> legacyVertices;
+        double legacyMs = 1e30;
+        for (int r = 0; r < options.repeat; ++r) {
+            auto start = BenchClock::now();
+            legacyLoadOBJ(options.objPath, legacyVertices);
+            legacyMs = std::min(legacyMs, elapsedMs(start));
+        }
+        std::cout << "istringstream: " << legacyMs << " ms, " << megabytes / (legacyMs / 1000.0) << " MB/s, "
+                  << legacyVertices.size() << " vertices" << std::endl;
+        std::cout << "Speedup: " << legacyMs / fastMs << "x" << std::endl;
+
+        float diff = maxDifference(fastVertices, legacyVertices);
+        std::cout << "Max attribute difference: " << diff << std::endl;
+        if (legacyVertices.size() != fastVertices.size() || diff > 1e-6f) {
+            std::cout << "ERROR: parsers disagree" << std::endl;
+            status = 1;
+        }
+    }
+
+    if (streamed) {
+        // Warm start as Model sees it: check the source against the cache key (its stamp,
+        // or a full hash if that changed), map the cooked file and touch every byte
+        // glBufferData would read
+        auto warmStart = BenchClock::now();
+        uint64_t sourceHash = 0;
+        Common::FileStamp sourceStamp;
+        Common::hashSourceFile(options.objPath, cookedPath, sourceHash, sourceStamp);
+        double hashMs = elapsedMs(warmStart);
+        Common::CookedMeshFile cached;
+        uint64_t checksum = 0;
+        if (cached.open(cookedPath) && cached.vertexData() && cached.indexData()) {
+            const size_t vertexBytes = static_cast<size_t>(cached.header.vertexCount * cached.header.vertexStride);
+            const size_t indexBytes = static_cast<size_t>(cached.header.indexCount * cached.header.indexSize);
+            checksum = Common::hashBytes(cached.vertexData(), vertexBytes) ^ Common::hashBytes(cached.indexData(), indexBytes);
+        }
+        cached.close();
+        double warmMs = elapsedMs(warmStart);
+        std::cout << "Warm start from cache: " << warmMs << " ms (source check " << hashMs << " ms), checksum "
+                  << std::hex << checksum << std::dec << std::endl;
+
+        ObjData obj;
+        parseOBJFile(options.objPath, obj, 1);
+        bool matches = verifyCookedMesh(cookedPath, obj);
+        std::cout << "Streamed cooked mesh " << (matches ? "matches" : "DIFFERS FROM") << " the in-memory parse" << std::endl;
+        if (!matches) {
+            status = 1;
+        }
+        if (!options.keep) {
+            std::remove(cookedPath.c_str());
+        }
+    }
+
+    if (generated && !options.keep) {
+        std::remove(options.objPath.c_str());
+    }
+    return status;
+}
@@ -0,0 +1,530 @@
+#include "obj_parser.h"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Numbers are scanned by hand instead of std::from_chars: floating point from_chars
+// is missing on the macOS deployment target and older GCC/Clang standard libraries.
+
+namespace {
+
+const double kPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Slow path for the rare spellings the fast scanner does not handle (nan, inf, hex floats).
+const char *parseFloatFallback(const char *p, const char *end, float &value) {
+    char token[64];
+    size_t length = 0;
+    while (p + length < end && length + 1 < sizeof(token) && !isBlank(p[length]) && p[length] != '\n') {
+        token[length] = p[length];
+        ++length;
+    }
+    token[length] = '\0';
+    char *tokenEnd = token;
+    value = std::strtof(token, &tokenEnd);
+    return p + (tokenEnd - token);
+}
+
+// Parses [+-]digits[.digits][(e|E)[+-]digits]. Leaves `value` untouched and returns `p`
+// when there is no number at `p`.
+const char *parseFloat(const char *p, const char *end, float &value) {
+    p = skipBlanks(p, end);
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    unsigned long long mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+
+    while (p < end && isDigit(*p)) {
+        anyDigits = true;
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) {
+                ++significantDigits;
+            }
+        } else {
+            ++exponent; // digits past the 19th only scale the value
+        }
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && isDigit(*p)) {
+            anyDigits = true;
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) {
+                    ++significantDigits;
+                }
+                --exponent;
+            }
+            ++p;
+        }
+    }
+    if (!anyDigits) {
+        if (p < end && (*p == 'n' || *p == 'N' || *p == 'i' || *p == 'I')) {
+            return parseFloatFallback(start, end, value);
+        }
+        return start;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *exponentStart = p;
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            ++p;
+        }
+        if (p < end && isDigit(*p)) {
+            int e = 0;
+            while (p < end && isDigit(*p)) {
+                if (e < 10000) {
+                    e = e * 10 + (*p - '0');
+                }
+                ++p;
+            }
+            exponent += negativeExponent ? -e : e;
+        } else {
+            p = exponentStart; // "1e" is the number 1 followed by garbage
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        if (exponent >= 0) {
+            result = exponent <= 22 ? result * kPowersOf10[exponent] : result * std::pow(10.0, exponent);
+        } else {
+            result = -exponent <= 22 ? result / kPowersOf10[-exponent] : result * std::pow(10.0, exponent);
+        }
+    }
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+// Parses [+-]digits; returns `p` unchanged if there is no integer.
+const char *parseInt(const char *p, const char *end, int &value) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p >= end || !isDigit(*p)) {
+        return start;
+    }
+    long long result = 0;
+    while (p < end && isDigit(*p)) {
+        if (result < 0x7fffffff) {
+            result = result * 10 + (*p - '0');
+        }
+        ++p;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    return p;
+}
+
+// Where the corners of one parse pass end up. A chunk parsed on its own does not know how
+// many elements the chunks before it read, so relative indices are resolved against the
+// chunk-local count and recorded in `relativeFixups` (corner * 3 + attribute) to be
+// shifted once the chunk offsets are known. Without fix-ups, relative indices are
+// resolved right away against the local counts plus the `*Base` counts (elements read
+// before `data`, e.g. by earlier windows of a streamed file).
+struct ParseTarget {
+    ObjData &data;
+    std::vector<size_t> *relativeFixups;
+    size_t positionBase;
+    size_t texCoordBase;
+    size_t normalBase;
+};
+
+// OBJ indices are 1-based, negative ones count back from the last element read so far.
+// Sets `relative` when the result still has to be shifted by a chunk offset.
+inline int resolveIndex(int index, size_t count, bool deferRelative, bool &relative) {
+    relative = false;
+    if (index > 0) {
+        return index - 1;
+    }
+    if (index < 0) {
+        long long resolved = static_cast<long long>(count) + index;
+        if (deferRelative) {
+            relative = true;
+            return static_cast<int>(resolved);
+        }
+        return resolved >= 0 ? static_cast<int>(resolved) : -1;
+    }
+    return -1;
+}
+
+// Parses one face corner "v", "v/vt", "v//vn" or "v/vt/vn". Bit k of `relativeMask`
+// is set when attribute k needs a relative fix-up.
+const char *parseCorner(const char *p, const char *end, const ParseTarget &target, ObjCorner &corner,
+                        unsigned int &relativeMask, bool &ok) {
+    const ObjData &data = target.data;
+    const bool defer = target.relativeFixups != nullptr;
+    corner.position = -1;
+    corner.texCoord = -1;
+    corner.normal = -1;
+    relativeMask = 0;
+    bool relative = false;
+
+    int index = 0;
+    const char *next = parseInt(p, end, index);
+    ok = next != p;
+    if (!ok) {
+        return p;
+    }
+    corner.position = resolveIndex(index, target.positionBase + data.positions.size(), defer, relative);
+    relativeMask |= relative ? 1u : 0u;
+    p = next;
+
+    if (p < end && *p == '/') {
+        ++p;
+        next = parseInt(p, end, index);
+        if (next != p) {
+            corner.texCoord = resolveIndex(index, target.texCoordBase + data.texCoords.size(), defer, relative);
+            relativeMask |= relative ? 2u : 0u;
+            p = next;
+        }
+        if (p < end && *p == '/') {
+            ++p;
+            next = parseInt(p, end, index);
+            if (next != p) {
+                corner.normal = resolveIndex(index, target.normalBase + data.normals.size(), defer, relative);
+                relativeMask |= relative ? 4u : 0u;
+                p = next;
+            }
+        }
+    }
+    // skip anything unexpected up to the next blank so one bad corner does not derail the line
+    while (p < end && !isBlank(*p) && *p != '\n') {
+        ++p;
+    }
+    return p;
+}
+
+inline void pushCorner(const ParseTarget &target, const ObjCorner &corner, unsigned int relativeMask) {
+    if (relativeMask != 0) {
+        size_t slot = target.data.corners.size() * 3;
+        for (unsigned int k = 0; k < 3; ++k) {
+            if (relativeMask & (1u << k)) {
+                target.relativeFixups->push_back(slot + k);
+            }
+        }
+    }
+    target.data.corners.push_back(corner);
+}
+
+inline size_t hashCorner(const ObjCorner &corner) {
+    // 32-bit multiplicative mixing, good enough spread for sequential OBJ indices
+    unsigned int h = static_cast<unsigned int>(corner.position) * 0x9E3779B1u;
+    h ^= static_cast<unsigned int>(corner.texCoord) * 0x85EBCA77u;
+    h ^= static_cast<unsigned int>(corner.normal) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    return h;
+}
+
+inline bool sameCorner(const ObjCorner &a, const ObjCorner &b) {
+    return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+inline bool startsWord(const char *p, const char *end, const char *word, size_t length) {
+    return static_cast<size_t>(end - p) > length && std::memcmp(p, word, length) == 0 && isBlank(p[length]);
+}
+
+// The rest of the line without surrounding blanks, so names with spaces survive.
+std::string restOfLine(const char *p, const char *lineEnd) {
+    const char *nameBegin = skipBlanks(p, lineEnd);
+    const char *nameEnd = lineEnd;
+    while (nameEnd > nameBegin && isBlank(nameEnd[-1])) {
+        --nameEnd;
+    }
+    return std::string(nameBegin, nameEnd);
+}
+
+// A usemtl with no faces since the previous one replaces it, so runs never start empty.
+void beginMaterialRange(ObjData &out, const std::string &name, size_t firstCorner) {
+    if (!out.materialRanges.empty() && out.materialRanges.back().firstCorner == firstCorner) {
+        out.materialRanges.back().name = name;
+    } else {
+        out.materialRanges.push_back(ObjMaterialRange{ name, firstCorner });
+    }
+}
+
+void parseRange(const char *begin, const char *end, const ParseTarget &target) {
+    ObjData &out = target.data;
+    const char *p = begin;
+    while (p < end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        p = skipBlanks(p, lineEnd);
+
+        if (p + 1 < lineEnd && p[0] == 'v') {
+            if (isBlank(p[1])) {
+                glm::vec3 pos(0.0f);
+                const char *q = parseFloat(p + 2, lineEnd, pos.x);
+                q = parseFloat(q, lineEnd, pos.y);
+                parseFloat(q, lineEnd, pos.z);
+                out.positions.push_back(pos);
+                out.boundingBoxMin = glm::min(out.boundingBoxMin, pos);
+                out.boundingBoxMax = glm::max(out.boundingBoxMax, pos);
+            } else if (p[1] == 't' && p + 2 < lineEnd && isBlank(p[2])) {
+                glm::vec2 tex(0.0f);
+                const char *q = parseFloat(p + 3, lineEnd, tex.x);
+                parseFloat(q, lineEnd, tex.y);
+                out.texCoords.push_back(tex);
+            } else if (p[1] == 'n' && p + 2 < lineEnd && isBlank(p[2])) {
+                glm::vec3 norm(0.0f);
+                const char *q = parseFloat(p + 3, lineEnd, norm.x);
+                q = parseFloat(q, lineEnd, norm.y);
+                parseFloat(q, lineEnd, norm.z);
+                out.normals.push_back(norm);
+            }
+        } else if (p + 1 < lineEnd && p[0] == 'f' && isBlank(p[1])) {
+            // fan triangulation straight into the corner list, no per-face storage
+            ObjCorner first = {}, previous = {}, corner = {};
+            unsigned int firstMask = 0, previousMask = 0, mask = 0;
+            int count = 0;
+            const char *q = p + 2;
+            while (true) {
+                q = skipBlanks(q, lineEnd);
+                bool ok = false;
+                q = parseCorner(q, lineEnd, target, corner, mask, ok);
+                if (!ok) {
+                    break;
+                }
+                if (count == 0) {
+                    first = corner;
+                    firstMask = mask;
+                } else if (count >= 2) {
+                    pushCorner(target, first, firstMask);
+                    pushCorner(target, previous, previousMask);
+                    pushCorner(target, corner, mask);
+                }
+                previous = corner;
+                previousMask = mask;
+                ++count;
+            }
+        } else if (startsWord(p, lineEnd, "usemtl", 6)) {
+            beginMaterialRange(out, restOfLine(p + 6, lineEnd), out.corners.size());
+        } else if (startsWord(p, lineEnd, "mtllib", 6)) {
+            // e.g. "mtllib Torque Twister.mtl"
+            std::string name = restOfLine(p + 6, lineEnd);
+            if (!name.empty()) {
+                out.mtllibs.push_back(name);
+            }
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+} // namespace
+
+ObjData::ObjData() {
+    clear();
+}
+
+void ObjData::clear() {
+    positions.clear();
+    texCoords.clear();
+    normals.clear();
+    corners.clear();
+    mtllibs.clear();
+    materialRanges.clear();
+    boundingBoxMin = glm::vec3(FLT_MAX);
+    boundingBoxMax = glm::vec3(-FLT_MAX);
+}
+
+void parseOBJBuffer(const char *begin, const char *end, ObjData &out) {
+    ParseTarget target = { out, nullptr, 0, 0, 0 };
+    parseRange(begin, end, target);
+}
+
+void parseOBJWindow(const char *begin, const char *end, ObjData &out, size_t positionBase, size_t texCoordBase,
+                    size_t normalBase) {
+    out.clear();
+    ParseTarget target = { out, nullptr, positionBase, texCoordBase, normalBase };
+    parseRange(begin, end, target);
+}
+
+void parseOBJBufferParallel(const char *begin, const char *end, ObjData &out, Common::ThreadPool &pool) {
+    const size_t size = static_cast<size_t>(end - begin);
+    const size_t minChunkBytes = 1 << 20;
+    size_t chunkCount = std::min(pool.size() * 4, size / minChunkBytes);
+    if (pool.size() <= 1 || chunkCount <= 1) {
+        parseOBJBuffer(begin, end, out);
+        return;
+    }
+
+    // line-aligned chunk boundaries
+    std::vector<const char *> bounds(1, begin);
+    for (size_t c = 1; c < chunkCount; ++c) {
+        const char *split = std::max(begin + size * c / chunkCount, bounds.back());
+        const char *newline = split < end ? static_cast<const char *>(std::memchr(split, '\n', end - split)) : nullptr;
+        const char *chunkStart = newline ? newline + 1 : end;
+        if (chunkStart > bounds.back() && chunkStart < end) {
+            bounds.push_back(chunkStart);
+        }
+    }
+    bounds.push_back(end);
+    chunkCount = bounds.size() - 1;
+
+    std::vector<ObjData> chunks(chunkCount);
+    std::vector<std::vector<size_t>> fixups(chunkCount);
+    pool.parallelFor(chunkCount, [&](size_t c) {
+        ParseTarget target = { chunks[c], &fixups[c], 0, 0, 0 };
+        parseRange(bounds[c], bounds[c + 1], target);
+    });
+
+    // element offsets of every chunk, then copy into place and shift relative indices
+    std::vector<size_t> positionBase(chunkCount + 1, 0), texCoordBase(chunkCount + 1, 0);
+    std::vector<size_t> normalBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+    for (size_t c = 0; c < chunkCount; ++c) {
+        positionBase[c + 1] = positionBase[c] + chunks[c].positions.size();
+        texCoordBase[c + 1] = texCoordBase[c] + chunks[c].texCoords.size();
+        normalBase[c + 1] = normalBase[c] + chunks[c].normals.size();
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+    }
+    out.clear();
+    out.positions.resize(positionBase[chunkCount]);
+    out.texCoords.resize(texCoordBase[chunkCount]);
+    out.normals.resize(normalBase[chunkCount]);
+    out.corners.resize(cornerBase[chunkCount]);
+
+    pool.parallelFor(chunkCount, [&](size_t c) {
+        ObjData &chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), out.positions.begin() + positionBase[c]);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), out.texCoords.begin() + texCoordBase[c]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), out.normals.begin() + normalBase[c]);
+        ObjCorner *corners = out.corners.data() + cornerBase[c];
+        std::copy(chunk.corners.begin(), chunk.corners.end(), corners);
+
+        const long long bases[3] = {
+            static_cast<long long>(positionBase[c]),
+            static_cast<long long>(texCoordBase[c]),
+            static_cast<long long>(normalBase[c])
+        };
+        for (size_t slot : fixups[c]) {
+            ObjCorner &corner = corners[slot / 3];
+            int &index = (slot % 3 == 0) ? corner.position : (slot % 3 == 1) ? corner.texCoord : corner.normal;
+            long long resolved = bases[slot % 3] + index;
+            index = resolved >= 0 ? static_cast<int>(resolved) : -1;
+        }
+        std::vector<glm::vec3>().swap(chunk.positions);
+        std::vector<glm::vec2>().swap(chunk.texCoords);
+        std::vector<glm::vec3>().swap(chunk.normals);
+        std::vector<ObjCorner>().swap(chunk.corners);
+    });
+
+    for (size_t c = 0; c < chunkCount; ++c) {
+        const ObjData &chunk = chunks[c];
+        for (const ObjMaterialRange &range : chunk.materialRanges) {
+            beginMaterialRange(out, range.name, cornerBase[c] + range.firstCorner);
+        }
+        out.mtllibs.insert(out.mtllibs.end(), chunk.mtllibs.begin(), chunk.mtllibs.end());
+        out.boundingBoxMin = glm::min(out.boundingBoxMin, chunk.boundingBoxMin);
+        out.boundingBoxMax = glm::max(out.boundingBoxMax, chunk.boundingBoxMax);
+    }
+}
+
+void indexOBJCorners(const std::vector<ObjCorner> &corners, std::vector<ObjCorner> &uniqueCorners,
+                     std::vector<unsigned int> &indices) {
+    uniqueCorners.clear();
+    indices.resize(corners.size());
+
+    // power of two table at most half full; slots hold an index into uniqueCorners
+    size_t capacity = 16;
+    while (capacity < corners.size() * 2) {
+        capacity <<= 1;
+    }
+    const size_t mask = capacity - 1;
+    std::vector<unsigned int> slots(capacity, ~0u);
+
+    for (size_t i = 0; i < corners.size(); ++i) {
+        const ObjCorner &corner = corners[i];
+        size_t slot = hashCorner(corner) & mask;
+        while (true) {
+            unsigned int existing = slots[slot];
+            if (existing == ~0u) {
+                existing = static_cast<unsigned int>(uniqueCorners.size());
+                slots[slot] = existing;
+                uniqueCorners.push_back(corner);
+                indices[i] = existing;
+                break;
+            }
+            if (sameCorner(uniqueCorners[existing], corner)) {
+                indices[i] = existing;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+}
+
+bool readFileBytes(const std::string &path, std::vector<char> &buffer) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    if (size < 0) {
+        return false;
+    }
+    buffer.resize(static_cast<size_t>(size));
+    file.seekg(0, std::ios::beg);
+    if (size > 0 && !file.read(buffer.data(), size)) {
+        std::cout << "ERROR: Failed to read file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseOBJFile(const std::string &path, ObjData &out, unsigned int threadCount) {
+    out.clear();
+    std::vector<char> buffer;
+    if (!readFileBytes(path, buffer)) {
+        std::cout << "ERROR: Failed to open OBJ file: " << path << std::endl;
+        return false;
+    }
+    const char *begin = buffer.data();
+    const char *end = begin + buffer.size();
+    if (threadCount == 1) {
+        parseOBJBuffer(begin, end, out);
+    } else if (threadCount == 0) {
+        parseOBJBufferParallel(begin, end, out, Common::ThreadPool::shared());
+    } else {
+        Common::ThreadPool pool(threadCount);
+        parseOBJBufferParallel(begin, end, out, pool);
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Common {
+    class ThreadPool;
+}
+
+// One triangle corner of an OBJ face. Indices are already 0-based and resolved
+// (relative indices included); -1 means the attribute was not given.
+struct ObjCorner {
+    int position;
+    int texCoord;
+    int normal;
+};
+
+// Faces from `firstCorner` up to the next range use material `name` (from usemtl).
+// Faces before the first usemtl have no range and no material.
+struct ObjMaterialRange {
+    std::string name;
+    size_t firstCorner;
+};
+
+// Raw OBJ contents. Faces are fan-triangulated, so every three corners form a triangle.
+struct ObjData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<std::string> mtllibs;
+    std::vector<ObjMaterialRange> materialRanges;
+    glm::vec3 boundingBoxMin;
+    glm::vec3 boundingBoxMax;
+
+    ObjData();
+    void clear();
+};
+
+// Reads the whole file into memory with one bulk read and parses it.
+// threadCount 0 parses on Common::ThreadPool::shared(), 1 on the calling thread,
+// N > 1 on a temporary pool of N workers; the result is identical in every case.
+// Returns false (and prints why) if the file cannot be read.
+bool parseOBJFile(const std::string &path, ObjData &out, unsigned int threadCount = 0);
+
+// Parses an in-memory OBJ text. No per-line allocations: lines are scanned in
+// place and numbers are converted by hand (locale independent).
+void parseOBJBuffer(const char *begin, const char *end, ObjData &out);
+
+// Parses one window of a file that is read piece by piece. The windows before it held
+// `positionBase` positions etc.; relative indices are resolved against those, so all
+// corner indices are file-global. `out` is cleared first and holds only this window.
+void parseOBJWindow(const char *begin, const char *end, ObjData &out, size_t positionBase, size_t texCoordBase,
+                    size_t normalBase);
+
+// Same result as parseOBJBuffer, but the text is split into line-aligned chunks that
+// are parsed concurrently and merged in order (relative indices are shifted by the
+// element counts of the preceding chunks). Small inputs are parsed on the caller.
+void parseOBJBufferParallel(const char *begin, const char *end, ObjData &out, Common::ThreadPool &pool);
+
+// Welds identical (v, vt, vn) triples into one vertex. `uniqueCorners` receives one
+// entry per distinct triple in first-use order and `indices` one entry per corner,
+// so `corners[i] == uniqueCorners[indices[i]]`. Uses an open-addressing hash table.
+void indexOBJCorners(const std::vector<ObjCorner> &corners, std::vector<ObjCorner> &uniqueCorners,
+                     std::vector<unsigned int> &indices);
+
+// Bulk-reads a file into `buffer`, shared with other loaders.
+bool readFileBytes(const std::string &path, std::vector<char> &buffer);
@@ -0,0 +1,470 @@
+#include "obj_stream.h"
+#include "obj_parser.h"
+#include "mesh_cache.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Same layout as the Vertex struct of model.h
+struct CookedVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+static_assert(sizeof(CookedVertex) == 32, "CookedVertex must match Vertex in model.h");
+
+const size_t kMinimumBudget = 16u << 20;
+const size_t kPageBytes = 64u << 10;
+
+// Append-only array in a temp file. Elements are written a whole page at a time, so the
+// file is a sequence of pages that a small 4-way set-associative LRU cache reads back.
+// The last, partial page stays in memory.
+template<typename T>
+class SpillArray {
+public:
+    SpillArray() : file(nullptr), count(0), flushed(0), pageElements(1), sets(1), clock(0), spilledBytes(0) {}
+    ~SpillArray() { close(); }
+
+    bool open(const std::string &path, size_t cacheBytes) {
+        this->path = path;
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            std::cout << "ERROR: Cannot create temp file: " << path << std::endl;
+            return false;
+        }
+        pageElements = std::max<size_t>(1, kPageBytes / sizeof(T));
+        sets = std::max<size_t>(1, cacheBytes / (kPageBytes * kWays));
+        tail.reserve(pageElements);
+        pages.resize(sets * kWays * pageElements);
+        slotPage.assign(sets * kWays, ~size_t(0));
+        slotStamp.assign(sets * kWays, 0);
+        return true;
+    }
+
+    void close() {
+        if (file) {
+            std::fclose(file);
+            file = nullptr;
+            std::remove(path.c_str());
+        }
+    }
+
+    bool push(const T &value) {
+        tail.push_back(value);
+        ++count;
+        return tail.size() < pageElements || flushTail();
+    }
+
+    // `index` must be below size()
+    bool get(size_t index, T &out) {
+        if (index >= flushed) {
+            out = tail[index - flushed];
+            return true;
+        }
+        size_t page = index / pageElements;
+        size_t first = (page % sets) * kWays;
+        size_t victim = first;
+        for (size_t slot = first; slot < first + kWays; ++slot) {
+            if (slotPage[slot] == page) {
+                slotStamp[slot] = ++clock;
+                out = pages[slot * pageElements + index % pageElements];
+                return true;
+            }
+            if (slotStamp[slot] < slotStamp[victim]) {
+                victim = slot;
+            }
+        }
+        T *data = &pages[victim * pageElements];
+        if (!Common::seekFile(file, static_cast<uint64_t>(page) * pageElements * sizeof(T))
+            || std::fread(data, sizeof(T), pageElements, file) != pageElements) {
+            return false;
+        }
+        slotPage[victim] = page;
+        slotStamp[victim] = ++clock;
+        out = data[index % pageElements];
+        return true;
+    }
+
+    // Reads `n` elements starting at `first` from the file; call flush() first.
+    bool read(size_t first, size_t n, T *out) {
+        return n == 0 || (Common::seekFile(file, static_cast<uint64_t>(first) * sizeof(T))
+            && std::fread(out, sizeof(T), n, file) == n);
+    }
+
+    bool flush() {
+        return tail.empty() || flushTail();
+    }
+
+    size_t size() const { return count; }
+    size_t bytesSpilled() const { return spilledBytes; }
+    size_t memoryBytes() const {
+        return (pages.capacity() + tail.capacity()) * sizeof(T)
+            + slotPage.capacity() * sizeof(size_t) + slotStamp.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static const size_t kWays = 4;
+    std::FILE *file;
+    std::string path;
+    std::vector<T> tail;
+    std::vector<T> pages;
+    std::vector<size_t> slotPage;
+    std::vector<uint64_t> slotStamp;
+    size_t count;
+    size_t flushed;
+    size_t pageElements;
+    size_t sets;
+    uint64_t clock;
+    size_t spilledBytes;
+
+    bool flushTail() {
+        // stdio needs a seek when switching from reading to writing
+        if (!Common::seekFile(file, static_cast<uint64_t>(flushed) * sizeof(T))
+            || std::fwrite(tail.data(), sizeof(T), tail.size(), file) != tail.size()) {
+            std::cout << "ERROR: Failed to write temp file: " << path << std::endl;
+            return false;
+        }
+        spilledBytes += tail.size() * sizeof(T);
+        flushed += tail.size();
+        tail.clear();
+        return true;
+    }
+};
+
+// Fixed-size (v, vt, vn) -> vertex table. When it is half full it is cleared, so corners
+// are only welded within a stretch of the file; OBJ exporters write faces close to the
+// vertices they use, which keeps the duplicates this causes rare.
+class WeldTable {
+public:
+    explicit WeldTable(size_t bytes) : used(0), resets(0) {
+        size_t capacity = 1024;
+        while (capacity * 2 * sizeof(Slot) <= bytes) {
+            capacity <<= 1;
+        }
+        slots.resize(capacity);
+        mask = capacity - 1;
+        reset();
+        resets = 0;
+    }
+
+    // Returns the slot for `corner`; `found` tells whether it already had a vertex.
+    uint32_t &lookup(const ObjCorner &corner, bool &found) {
+        if (used * 2 >= slots.size()) {
+            reset();
+        }
+        unsigned int h = static_cast<unsigned int>(corner.position) * 0x9E3779B1u;
+        h ^= static_cast<unsigned int>(corner.texCoord) * 0x85EBCA77u;
+        h ^= static_cast<unsigned int>(corner.normal) * 0xC2B2AE3Du;
+        h ^= h >> 15;
+        size_t index = h & mask;
+        while (true) {
+            Slot &slot = slots[index];
+            if (slot.vertex == kEmpty) {
+                slot.key = corner;
+                ++used;
+                found = false;
+                return slot.vertex;
+            }
+            if (slot.key.position == corner.position && slot.key.texCoord == corner.texCoord
+                && slot.key.normal == corner.normal) {
+                found = true;
+                return slot.vertex;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    size_t resetCount() const { return resets; }
+    size_t memoryBytes() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        ObjCorner key;
+        uint32_t vertex;
+    };
+    static const uint32_t kEmpty = ~0u;
+    std::vector<Slot> slots;
+    size_t mask;
+    size_t used;
+    size_t resets;
+
+    void reset() {
+        for (Slot &slot : slots) {
+            slot.vertex = kEmpty;
+        }
+        used = 0;
+        ++resets;
+    }
+};
+
+size_t objDataBytes(const ObjData &data) {
+    return data.positions.capacity() * sizeof(glm::vec3) + data.texCoords.capacity() * sizeof(glm::vec2)
+        + data.normals.capacity() * sizeof(glm::vec3) + data.corners.capacity() * sizeof(ObjCorner);
+}
+
+std::string fileName(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+size_t peakResidentMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#endif
+}
+
+bool streamOBJToCookedMesh(const std::string &objPath, const std::string &cookedPath,
+                           const ObjStreamSettings &settings, ObjStreamStats &stats) {
+    auto start = std::chrono::steady_clock::now();
+    stats = ObjStreamStats();
+
+    std::FILE *input = std::fopen(objPath.c_str(), "rb");
+    if (!input) {
+        std::cout << "ERROR: Failed to open OBJ file: " << objPath << std::endl;
+        return false;
+    }
+
+    // budget split: 1/32 read window (its parsed arrays take 1-7x that, depending on how
+    // face heavy the text is), 1/4 weld table, 1/4 attribute page caches, 1/32 vertex
+    // batch, the rest for the index copy buffer and slack
+    const size_t budget = std::max(settings.memoryBudget, kMinimumBudget);
+    if (settings.memoryBudget < kMinimumBudget) {
+        std::cout << "WARNING: Streaming memory budget raised from " << (settings.memoryBudget >> 20) << " MB to the "
+                  << (kMinimumBudget >> 20) << " MB minimum" << std::endl;
+    }
+    const size_t windowBytes = budget / 32;
+    const size_t cacheBytes = budget / 4;
+    const size_t batchVertices = budget / 32 / sizeof(CookedVertex);
+
+    std::string tempBase = settings.tempDirectory.empty()
+        ? cookedPath : settings.tempDirectory + "/" + fileName(cookedPath);
+    SpillArray<glm::vec3> positions, normals;
+    SpillArray<glm::vec2> texCoords;
+    SpillArray<uint32_t> indices;
+    Common::CookedMeshWriter writer;
+    const std::vector<Common::CookedAttribute> attributes = {
+        { 0, 3, 0x1406, 0, static_cast<uint32_t>(offsetof(CookedVertex, Position)) },
+        { 1, 3, 0x1406, 0, static_cast<uint32_t>(offsetof(CookedVertex, Normal)) },
+        { 2, 2, 0x1406, 0, static_cast<uint32_t>(offsetof(CookedVertex, TexCoords)) }
+    };
+    bool ok = positions.open(tempBase + ".positions.tmp", cacheBytes * 3 / 8)
+        && texCoords.open(tempBase + ".texcoords.tmp", cacheBytes * 2 / 8)
+        && normals.open(tempBase + ".normals.tmp", cacheBytes * 3 / 8)
+        && indices.open(tempBase + ".indices.tmp", 0)
+        && writer.open(cookedPath, sizeof(CookedVertex), attributes);
+    writer.setSourceStamp(settings.sourceStamp);
+
+    WeldTable weld(budget / 4);
+    std::vector<char> window(windowBytes);
+    std::vector<CookedVertex> batch;
+    batch.reserve(batchVertices);
+    ObjData part;
+    std::vector<ObjMaterialRange> ranges;
+    std::vector<std::string> libraries;
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    uint64_t vertexCount = 0;
+    size_t carry = 0;
+
+    auto trackMemory = [&]() {
+        size_t bytes = window.capacity() + objDataBytes(part) + weld.memoryBytes()
+            + batch.capacity() * sizeof(CookedVertex) + positions.memoryBytes() + texCoords.memoryBytes()
+            + normals.memoryBytes() + indices.memoryBytes() + ranges.capacity() * sizeof(ObjMaterialRange);
+        stats.peakTrackedBytes = std::max(stats.peakTrackedBytes, bytes);
+    };
+
+    while (ok) {
+        size_t got = std::fread(window.data() + carry, 1, windowBytes - carry, input);
+        stats.bytesRead += got;
+        size_t filled = carry + got;
+        bool atEnd = got < windowBytes - carry;
+        if (filled == 0) {
+            break;
+        }
+
+        // parse up to the last complete line, the rest moves to the next window
+        size_t parseEnd = filled;
+        if (!atEnd) {
+            while (parseEnd > 0 && window[parseEnd - 1] != '\n') {
+                --parseEnd;
+            }
+            if (parseEnd == 0) {
+                std::cout << "ERROR: OBJ line longer than the streaming window (" << windowBytes
+                          << " bytes), raise the memory budget" << std::endl;
+                ok = false;
+                break;
+            }
+        }
+        parseOBJWindow(window.data(), window.data() + parseEnd, part, positions.size(), texCoords.size(), normals.size());
+
+        for (const glm::vec3 &position : part.positions) {
+            ok = ok && positions.push(position);
+        }
+        for (const glm::vec2 &texCoord : part.texCoords) {
+            ok = ok && texCoords.push(texCoord);
+        }
+        for (const glm::vec3 &normal : part.normals) {
+            ok = ok && normals.push(normal);
+        }
+        if (!part.positions.empty()) {
+            boundsMin = glm::min(boundsMin, part.boundingBoxMin);
+            boundsMax = glm::max(boundsMax, part.boundingBoxMax);
+        }
+        libraries.insert(libraries.end(), part.mtllibs.begin(), part.mtllibs.end());
+        for (const ObjMaterialRange &range : part.materialRanges) {
+            size_t firstCorner = stats.corners + range.firstCorner;
+            if (!ranges.empty() && ranges.back().firstCorner == firstCorner) {
+                ranges.back().name = range.name;
+            } else {
+                ranges.push_back(ObjMaterialRange{ range.name, firstCorner });
+            }
+        }
+
+        // weld corners; new vertices gather their attributes from the spill arrays.
+        // Indices must point backwards, as the OBJ format requires; forward references
+        // (which the in-memory loader tolerates) get the default attributes here.
+        for (const ObjCorner &corner : part.corners) {
+            bool found = false;
+            uint32_t &vertex = weld.lookup(corner, found);
+            if (!found) {
+                if (vertexCount >= 0xFFFFFFFFu) {
+                    std::cout << "ERROR: More than 4G vertices, not supported by 32-bit indices" << std::endl;
+                    ok = false;
+                    break;
+                }
+                CookedVertex cooked;
+                cooked.Position = glm::vec3(0.0f);
+                cooked.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                cooked.TexCoords = glm::vec2(0.0f);
+                if (corner.position >= 0 && static_cast<size_t>(corner.position) < positions.size()) {
+                    ok = ok && positions.get(corner.position, cooked.Position);
+                }
+                if (corner.texCoord >= 0 && static_cast<size_t>(corner.texCoord) < texCoords.size()) {
+                    ok = ok && texCoords.get(corner.texCoord, cooked.TexCoords);
+                }
+                if (corner.normal >= 0 && static_cast<size_t>(corner.normal) < normals.size()) {
+                    ok = ok && normals.get(corner.normal, cooked.Normal);
+                }
+                vertex = static_cast<uint32_t>(vertexCount++);
+                batch.push_back(cooked);
+                if (batch.size() == batchVertices) {
+                    writer.appendVertices(batch.data(), batch.size());
+                    batch.clear();
+                }
+            }
+            ok = ok && indices.push(vertex);
+        }
+        stats.corners += part.corners.size();
+        trackMemory();
+
+        carry = filled - parseEnd;
+        std::memmove(window.data(), window.data() + parseEnd, carry);
+        if (atEnd) {
+            break;
+        }
+    }
+    std::fclose(input);
+
+    writer.appendVertices(batch.data(), batch.size());
+    std::vector<CookedVertex>().swap(batch);
+    ok = ok && indices.flush();
+
+    // one index range per material: faces before the first usemtl, then every material in
+    // order of first use, each gathering all of its runs
+    std::vector<std::string> materials;
+    std::vector<uint32_t> rangeMaterial(ranges.size());
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        auto existing = std::find(materials.begin(), materials.end(), ranges[r].name);
+        rangeMaterial[r] = static_cast<uint32_t>(existing - materials.begin());
+        if (existing == materials.end()) {
+            materials.push_back(ranges[r].name);
+        }
+    }
+    std::vector<Common::CookedSubMesh> subMeshes;
+    std::vector<uint32_t> copyBuffer(std::min<size_t>(budget / 32 / sizeof(uint32_t), 1u << 20));
+    auto copyIndices = [&](size_t first, size_t last) {
+        for (size_t i = first; ok && i < last; i += copyBuffer.size()) {
+            size_t n = std::min(copyBuffer.size(), last - i);
+            ok = indices.read(i, n, copyBuffer.data());
+            writer.appendIndices(copyBuffer.data(), n);
+        }
+    };
+    if (stats.corners > 0xFFFFFFFFu) {
+        std::cout << "ERROR: More than 4G indices, not supported by the cooked mesh format" << std::endl;
+        ok = false;
+    }
+    size_t unassigned = ranges.empty() ? stats.corners : ranges[0].firstCorner;
+    if (ok && unassigned > 0) {
+        subMeshes.push_back(Common::CookedSubMesh{ 0, static_cast<uint32_t>(unassigned), ~0u, 0 });
+        copyIndices(0, unassigned);
+    }
+    for (uint32_t m = 0; ok && m < materials.size(); ++m) {
+        Common::CookedSubMesh subMesh = { static_cast<uint32_t>(writer.indexCount()), 0, m, 0 };
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            if (rangeMaterial[r] == m) {
+                size_t last = r + 1 < ranges.size() ? ranges[r + 1].firstCorner : stats.corners;
+                copyIndices(ranges[r].firstCorner, last);
+            }
+        }
+        subMesh.indexCount = static_cast<uint32_t>(writer.indexCount()) - subMesh.indexOffset;
+        if (subMesh.indexCount > 0) {
+            subMeshes.push_back(subMesh);
+        }
+    }
+    trackMemory();
+
+    stats.positions = positions.size();
+    stats.texCoords = texCoords.size();
+    stats.normals = normals.size();
+    stats.vertices = static_cast<size_t>(vertexCount);
+    stats.weldTableResets = weld.resetCount();
+    stats.spilledBytes = positions.bytesSpilled() + texCoords.bytesSpilled() + normals.bytesSpilled()
+        + indices.bytesSpilled();
+
+    if (stats.positions == 0) {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+    }
+    ok = ok && writer.finish(subMeshes, materials, libraries, &boundsMin.x, &boundsMax.x,
+                             settings.sourceHash, settings.settingsHash);
+    if (!ok) {
+        writer.abandon();
+        std::cout << "ERROR: Streaming import failed: " << objPath << std::endl;
+    }
+
+    stats.peakResidentBytes = peakResidentMemory();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
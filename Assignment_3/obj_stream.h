@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mesh_cache.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Out-of-core OBJ import. The file is parsed in fixed-size windows; positions, UVs and
+// normals are spilled to temp files and read back through small page caches, indices
+// are spilled until the material ranges are known, and welded vertices go straight into
+// a cooked mesh (mesh_cache.hpp). Working memory stays within `memoryBudget`.
+struct ObjStreamSettings {
+    size_t memoryBudget;       // at least 16 MB: smaller budgets are raised to that (and say so)
+    std::string tempDirectory; // empty: next to the cooked file
+    uint64_t sourceHash;       // cache key stamped into the cooked header
+    uint64_t settingsHash;
+    Common::FileStamp sourceStamp;  // the OBJ's, recorded beside sourceHash
+
+    ObjStreamSettings() : memoryBudget(256u << 20), sourceHash(0), settingsHash(0) {}
+};
+
+struct ObjStreamStats {
+    size_t bytesRead = 0;
+    size_t positions = 0;
+    size_t texCoords = 0;
+    size_t normals = 0;
+    size_t corners = 0;
+    size_t vertices = 0;          // after welding; the weld table is reset when full
+    size_t weldTableResets = 0;
+    size_t spilledBytes = 0;      // written to temp files
+    size_t peakTrackedBytes = 0;  // largest sum of the importer's own buffers
+    size_t peakResidentBytes = 0; // process peak RSS reported by the OS, 0 if unknown
+    double seconds = 0.0;
+};
+
+// Imports `objPath` into the cooked mesh `cookedPath`. Submeshes are one index range per
+// usemtl material (faces before any usemtl come first, without material).
+// Returns false (and prints why) on failure; no partial cooked file is left behind.
+bool streamOBJToCookedMesh(const std::string &objPath, const std::string &cookedPath,
+                           const ObjStreamSettings &settings, ObjStreamStats &stats);
+
+// Process peak resident memory in bytes, 0 where the platform does not report it.
+size_t peakResidentMemory();
@@ -0,0 +1,170 @@
+// Upload context check.
+// Creates a hidden window and the shared loader context (upload_context.hpp), then
+// loads textures through Common::TextureLoader (decoded on the pool, uploaded with their
+// mip chain on the loader thread) and fills a buffer through UploadContext::submit,
+// while the render thread keeps clearing. Once pollCompleted()/finish() report them
+// done, every texture level and the buffer are read back on the render context and
+// compared with what was uploaded. Exits non-zero on any mismatch.
+//
+// Runs headless on Mesa:
+//   xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 ./upload_context_test
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "texture_loader.hpp"
+#include "upload_context.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    unsigned char texel(int size, int i) {
+        return static_cast<unsigned char>(i * 7 + size);
+    }
+
+    // "<size>": a size x size RGB pattern; anything else fails, like a missing file
+    bool decodePattern(const std::string& path, Common::DecodedImage& image) {
+        int size = std::atoi(path.c_str());
+        if (size <= 0) {
+            return false;
+        }
+        image.width = size;
+        image.height = size;
+        image.components = 3;
+        image.pixels = static_cast<unsigned char*>(std::malloc(size * size * 3));
+        image.release = std::free;
+        for (int i = 0; i < size * size * 3; i++) {
+            image.pixels[i] = texel(size, i);
+        }
+        return true;
+    }
+
+    bool checkTexture(unsigned int texture, int size) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        GLint width = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        if (size <= 0) {
+            // a failed load keeps its 1x1 placeholder
+            std::cout << "texture '" << size << "': placeholder " << width << "x" << width << std::endl;
+            return width == 1;
+        }
+        std::vector<unsigned char> level0(size * size * 3);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, level0.data());
+        bool same = width == size;
+        for (int i = 0; i < size * size * 3 && same; i++) {
+            same = level0[i] == texel(size, i);
+        }
+
+        // the whole chain down to 1x1 must exist, each level half the one above
+        int levels = 0;
+        int expected = size;
+        bool chain = true;
+        for (int level = 0; expected >= 1; level++, expected /= 2) {
+            GLint levelWidth = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &levelWidth);
+            chain = chain && levelWidth == expected;
+            levels++;
+        }
+        std::cout << "texture " << size << "x" << size << ": level 0 " << (same ? "matches" : "DIFFERS") << ", "
+                  << levels << " levels " << (chain ? "complete" : "INCOMPLETE") << std::endl;
+        return same && chain;
+    }
+}
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "upload_context_test", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+    std::cout << "GL " << glGetString(GL_VERSION) << " / " << glGetString(GL_RENDERER) << std::endl;
+
+    std::unique_ptr<Common::UploadContext> uploads(new Common::UploadContext(window));
+    if (!uploads->valid()) {
+        std::cout << "FAILED: no shared upload context" << std::endl;
+        return 1;
+    }
+
+    // textures: odd sizes, a 1x1, one that fails to decode
+    Common::TextureLoader& loader = Common::TextureLoader::shared();
+    const std::vector<int> sizes = { 37, 256, 1000, 1, 0, 513 };
+    std::vector<unsigned int> textures;
+    for (int size : sizes) {
+        textures.push_back(loader.load(std::to_string(size), decodePattern));
+    }
+
+    // a buffer filled on the loader thread
+    unsigned int buffer = 0;
+    glGenBuffers(1, &buffer);
+    auto data = std::make_shared<std::vector<unsigned char>>(1 << 20);
+    for (size_t i = 0; i < data->size(); i++) {
+        (*data)[i] = static_cast<unsigned char>(i * 13);
+    }
+    bool bufferDone = false;
+    uploads->handOff();
+    uploads->submit([buffer, data]() {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, data->size(), data->data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }, [&bufferDone]() { bufferDone = true; });
+
+    // the render thread keeps going while the uploads happen
+    int frames = 0;
+    while ((loader.pendingCount() > 0 || uploads->pendingCount() > 0) && frames < 1000) {
+        loader.uploadCompleted(4);
+        uploads->pollCompleted();
+        glClear(GL_COLOR_BUFFER_BIT);
+        glfwSwapBuffers(window);
+        frames++;
+    }
+    loader.finish();
+    uploads->finish();
+    std::cout << frames << " frames while loading" << std::endl;
+
+    bool ok = true;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        ok = checkTexture(textures[i], sizes[i]) && ok;
+    }
+
+    std::vector<unsigned char> back(data->size());
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, back.size(), back.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    const bool bufferSame = back == *data;
+    std::cout << "buffer: " << (bufferSame ? "matches" : "DIFFERS") << ", callback " << (bufferDone ? "ran" : "MISSING")
+              << std::endl;
+    ok = ok && bufferSame && bufferDone;
+
+    Common::TextureLoaderStats stats = loader.stats();
+    std::cout << "requested " << stats.requested << ", uploaded " << stats.uploaded << ", failed " << stats.failed
+              << std::endl;
+    ok = ok && stats.uploaded == sizes.size() - 1 && stats.failed == 1;
+
+    glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    glDeleteBuffers(1, &buffer);
+    uploads.reset();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,604 @@
+// Headless animation sampling benchmark.
+// Times Bone::Update, Animator::UpdateAnimation, two-clip blending, palette
+// generation, the batched IK stage, time-sliced updates and streamed clip
+// playback without creating a window or GL context, so it can run on CI boxes.
+// Debug builds also count heap allocations, so Animator::UpdateAnimation
+// asserts if anything on the per-frame path allocates.
+//
+// usage: anim_benchmark [--frames N] [--case-ms MS] [--budget-ms MS] [--json PATH] [--clip PATH]...
+//   --frames is the maximum number of simulated frames per case; a case stops
+//   early once it has run for --case-ms so slow configurations stay bounded.
+//   --clip loads a real clip (e.g. the Mixamo .dae files) in addition to the
+//   synthetic skeletons. Without it the Mixamo clips next to the build are used
+//   when they can be found.
+
+#include <learnopengl/animator.h>
+#include <learnopengl/animator_manager.h>
+#include <learnopengl/ik_solver.h>
+#include <learnopengl/streamed_animation.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+
+
+// settings
+const int MAX_BENCH_BONES = 100; // Animator palette / shader limit
+
+
+
+#ifndef NDEBUG
+// feeds AnimationAllocations (learnopengl/pose_pool.h) with every heap allocation of this process
+void* operator new(std::size_t size)
+{
+	AnimationAllocations::Count()++;
+	if (void* data = std::malloc(size ? size : 1))
+		return data;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* data) noexcept
+{
+	std::free(data);
+}
+
+void operator delete(void* data, std::size_t) noexcept
+{
+	std::free(data);
+}
+#endif
+
+struct BenchOptions
+{
+	int frames = 240;
+	double caseMs = 500.0;
+	double budgetMs = 1000.0 / 60.0;
+	std::string jsonPath = "anim_benchmark.json";
+	std::vector<std::string> clips;
+};
+
+struct BenchResult
+{
+	std::string name;
+	std::string clip;
+	int bones = 0;
+	int keys = 0;
+	int characters = 0;
+	int iterations = 0;
+	double totalNs = 0.0;
+	double nsPerBone = 0.0;
+	double nsPerCharacter = 0.0;
+	double charactersPerFrame = 0.0;
+};
+
+// keeps results alive so the optimizer cannot drop the work
+static volatile float g_Sink = 0.0f;
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ElapsedNs(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+
+
+// synthetic skeleton generator
+// ----------------------------
+// Builds a binary-tree rig (depth ~log2(bones), comparable to a Mixamo humanoid)
+// with an extra channel-less root node, and a clip with `keys` keys per track.
+struct SyntheticRig
+{
+	std::map<std::string, BoneInfo> boneInfoMap;
+	int boneCount = 0;
+};
+
+static AssimpNodeData BuildSyntheticNode(int index, int boneCount)
+{
+	AssimpNodeData node;
+	node.name = "bone_" + std::to_string(index);
+	node.transformation = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f));
+	for (int child = index * 2 + 1; child <= index * 2 + 2 && child < boneCount; ++child)
+		node.children.push_back(BuildSyntheticNode(child, boneCount));
+	node.childrenCount = static_cast<int>(node.children.size());
+	return node;
+}
+
+static Animation* BuildSyntheticClip(SyntheticRig& rig, int boneCount, int keyCount, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	const float duration = static_cast<float>(keyCount - 1);
+	std::vector<Bone> bones;
+	bones.reserve(boneCount);
+	for (int i = 0; i < boneCount; ++i)
+	{
+		std::string name = "bone_" + std::to_string(i);
+		if (rig.boneInfoMap.find(name) == rig.boneInfoMap.end())
+		{
+			rig.boneInfoMap[name].id = rig.boneCount++;
+			rig.boneInfoMap[name].offset = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f * i, 0.0f));
+		}
+
+		std::vector<KeyPosition> positions(keyCount);
+		std::vector<KeyRotation> rotations(keyCount);
+		std::vector<KeyScale> scales(keyCount);
+		for (int k = 0; k < keyCount; ++k)
+		{
+			float t = static_cast<float>(k);
+			positions[k].position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.05f;
+			positions[k].timeStamp = t;
+			rotations[k].orientation = glm::normalize(glm::quat(1.0f, unit(rng) * 0.3f, unit(rng) * 0.3f, unit(rng) * 0.3f));
+			rotations[k].timeStamp = t;
+			scales[k].scale = glm::vec3(1.0f);
+			scales[k].timeStamp = t;
+		}
+		bones.push_back(Bone(name, rig.boneInfoMap[name].id, std::move(positions), std::move(rotations), std::move(scales)));
+	}
+
+	AssimpNodeData root;
+	root.name = "Armature";
+	root.transformation = glm::mat4(1.0f);
+	root.children.push_back(BuildSyntheticNode(0, boneCount));
+	root.childrenCount = 1;
+
+	return new Animation(duration, 30, root, std::move(bones), rig.boneInfoMap);
+}
+
+
+
+// scenarios
+// ---------
+static BenchResult BenchBoneUpdate(int keyCount, const BenchOptions& options)
+{
+	SyntheticRig rig;
+	std::unique_ptr<Animation> clip(BuildSyntheticClip(rig, 1, keyCount, 7));
+	Bone* bone = clip->FindBone("bone_0");
+
+	const int iterations = options.frames * 256;
+	const float step = clip->GetDuration() / iterations;
+	float t = 0.0f;
+	auto start = BenchClock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		bone->Update(t);
+		t += step;
+		if (t >= clip->GetDuration())
+			t = 0.0f;
+	}
+	double ns = ElapsedNs(start);
+	g_Sink = g_Sink + bone->GetLocalTransform()[3][0];
+
+	BenchResult result;
+	result.name = "bone_update";
+	result.clip = "synthetic";
+	result.bones = 1;
+	result.keys = keyCount;
+	result.characters = 1;
+	result.iterations = iterations;
+	result.totalNs = ns;
+	result.nsPerBone = ns / iterations;
+	result.nsPerCharacter = result.nsPerBone;
+	return result;
+}
+
+// runs `frames` updates of `characters` animators sharing the clip(s)
+static BenchResult BenchAnimators(const std::string& name, const std::string& clipName, Animation* clip, Animation* blendClip,
+	int bones, int keys, int characters, const BenchOptions& options)
+{
+	std::vector<Animator> animators;
+	animators.reserve(characters);
+	for (int c = 0; c < characters; ++c)
+	{
+		animators.emplace_back(clip);
+		float phase = clip->GetDuration() * c / std::max(1, characters);
+		if (blendClip)
+			animators.back().PlayAnimation(clip, blendClip, phase, blendClip->GetDuration() - phase * 0.5f, 0.5f);
+		else
+			animators.back().PlayAnimation(clip, NULL, phase, 0.0f, 0.0f);
+	}
+
+	const float dt = 1.0f / 60.0f;
+	const double caseNs = options.caseMs * 1.0e6;
+	int frames = 0;
+	double ns = 0.0;
+	auto start = BenchClock::now();
+	while (frames < options.frames && ns < caseNs)
+	{
+		for (auto& animator : animators)
+			animator.UpdateAnimation(dt);
+		++frames;
+		ns = ElapsedNs(start);
+	}
+	for (auto& animator : animators)
+		g_Sink = g_Sink + animator.m_FinalBoneMatrices[0][3][0];
+
+	BenchResult result;
+	result.name = name;
+	result.clip = clipName;
+	result.bones = bones;
+	result.keys = keys;
+	result.characters = characters;
+	result.iterations = frames;
+	result.totalNs = ns;
+	result.nsPerCharacter = ns / (static_cast<double>(frames) * characters);
+	result.nsPerBone = result.nsPerCharacter / std::max(1, bones);
+	return result;
+}
+
+// cost of fetching the skinning palette the way main.cpp does every frame
+static BenchResult BenchPalette(Animation* clip, int bones, int characters, const BenchOptions& options)
+{
+	std::vector<Animator> animators(characters, Animator(clip));
+	for (auto& animator : animators)
+		animator.UpdateAnimation(0.0f);
+
+	auto start = BenchClock::now();
+	for (int f = 0; f < options.frames; ++f)
+		for (auto& animator : animators)
+		{
+			const PoseBuffer& transforms = animator.GetFinalBoneMatrices();
+			g_Sink = g_Sink + transforms[bones - 1][3][3];
+		}
+	double ns = ElapsedNs(start);
+
+	BenchResult result;
+	result.name = "palette";
+	result.clip = "synthetic";
+	result.bones = bones;
+	result.characters = characters;
+	result.iterations = options.frames;
+	result.totalNs = ns;
+	result.nsPerCharacter = ns / (static_cast<double>(options.frames) * characters);
+	result.nsPerBone = result.nsPerCharacter / std::max(1, bones);
+	return result;
+}
+
+// IK stage after sampling: two legs (two-bone) and a look-at (aim) per character.
+// Only the solver is timed; every other character has its IK LOD toggle off.
+static BenchResult BenchIK(Animation* clip, int bones, int characters, const BenchOptions& options)
+{
+	std::vector<Animator> animators(characters, Animator(clip));
+	for (int c = 0; c < characters; ++c)
+		animators[c].SetIKEnabled(c % 2 == 0);
+
+	TwoBoneIKChain leftLeg = TwoBoneIKChain::Find(*clip, "bone_1", "bone_3", "bone_7");
+	TwoBoneIKChain rightLeg = TwoBoneIKChain::Find(*clip, "bone_2", "bone_5", "bone_11");
+	int head = clip->FindNodeIndex("bone_4");
+
+	IKSolver solver;
+	const float dt = 1.0f / 60.0f;
+	const double caseNs = options.caseMs * 1.0e6;
+	int frames = 0;
+	double ns = 0.0;
+	double solverUs = 0.0;
+	auto caseStart = BenchClock::now();
+	while (frames < options.frames && ElapsedNs(caseStart) < caseNs)
+	{
+		for (auto& animator : animators)
+			animator.UpdateAnimation(dt);
+
+		auto start = BenchClock::now();
+		for (auto& animator : animators)
+		{
+			const PoseBuffer& pose = animator.GetGlobalPose();
+			solver.AddTwoBone(&animator, leftLeg, glm::vec3(pose[leftLeg.end][3]) + glm::vec3(0.0f, 0.02f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+			solver.AddTwoBone(&animator, rightLeg, glm::vec3(pose[rightLeg.end][3]) + glm::vec3(0.0f, 0.02f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+			solver.AddAim(&animator, head, glm::vec3(0.0f, 1.0f, 5.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+		solver.Solve();
+		ns += ElapsedNs(start);
+		solverUs += solver.GetStats().totalMicroseconds;
+		++frames;
+	}
+	for (auto& animator : animators)
+		g_Sink = g_Sink + animator.m_FinalBoneMatrices[7][3][1];
+
+	BenchResult result;
+	result.name = "ik";
+	result.clip = "synthetic";
+	result.bones = bones;
+	result.characters = characters;
+	result.iterations = frames;
+	result.totalNs = ns;
+	result.nsPerCharacter = ns / (static_cast<double>(frames) * characters);
+	result.nsPerBone = result.nsPerCharacter / std::max(1, bones);
+	std::cout << "ik: " << characters << " characters (" << solver.GetStats().skipped << " jobs LOD-skipped), solver "
+		<< solverUs / frames << " us/frame" << std::endl;
+	return result;
+}
+
+// Time-sliced updates through AnimatorManager with a fixed budget (adaptation is driven by
+// real frame times, which a headless loop does not have). Reports the cost per frame and
+// how many evaluations were deferred; a quarter of the crowd is visible.
+static BenchResult BenchSliced(Animation* clip, int bones, int characters, float budgetMicroseconds, const BenchOptions& options)
+{
+	std::vector<Animator> animators(characters, Animator(clip));
+	AnimatorManager manager(budgetMicroseconds);
+	manager.SetAdaptiveBudget(false);
+	for (int c = 0; c < characters; ++c)
+	{
+		int handle = manager.Add(&animators[c]);
+		manager.SetView(handle, c % 4 == 0, static_cast<float>(c));
+	}
+
+	const float dt = 1.0f / 60.0f;
+	const double caseNs = options.caseMs * 1.0e6;
+	int frames = 0;
+	double ns = 0.0;
+	long long evaluated = 0;
+	int maxSkipped = 0;
+	auto caseStart = BenchClock::now();
+	while (frames < options.frames && ElapsedNs(caseStart) < caseNs)
+	{
+		auto start = BenchClock::now();
+		manager.Update(dt);
+		ns += ElapsedNs(start);
+		evaluated += manager.GetStats().evaluated;
+		maxSkipped = std::max(maxSkipped, manager.GetStats().maxSkippedFrames);
+		++frames;
+	}
+	for (auto& animator : animators)
+		g_Sink = g_Sink + animator.m_FinalBoneMatrices[0][3][1];
+
+	BenchResult result;
+	result.name = "sliced";
+	result.clip = "synthetic";
+	result.bones = bones;
+	result.characters = characters;
+	result.iterations = frames;
+	result.totalNs = ns;
+	result.nsPerCharacter = ns / (static_cast<double>(frames) * characters);
+	result.nsPerBone = result.nsPerCharacter / std::max(1, bones);
+	std::cout << "sliced: " << characters << " characters, budget " << budgetMicroseconds << " us, "
+		<< static_cast<double>(evaluated) / frames << " evaluations/frame, " << manager.GetStats().totalDeferred
+		<< " deferred, oldest palette " << maxSkipped << " frames" << std::endl;
+	return result;
+}
+
+// Streamed playback of a long clip: cooks it to a block file next to the report and plays
+// it back from a bounded window. Frames run faster than real time, so misses here are an
+// upper bound for what a 60 Hz game would see.
+static BenchResult BenchStreamed(Animation* clip, int bones, int keys, int characters, const BenchOptions& options)
+{
+	BenchResult result;
+	result.name = "streamed";
+	result.clip = "synthetic";
+	result.bones = bones;
+	result.keys = keys;
+	result.characters = characters;
+
+	const std::string cookedPath = options.jsonPath + ".clip";
+	if (!StreamedAnimation::Cook(*clip, cookedPath))
+		return result;
+
+	StreamedAnimation stream(cookedPath, clip);
+	std::vector<Animator> animators(characters, Animator(clip));
+	for (auto& animator : animators)
+		animator.PlayStreamed(&stream);
+
+	const float dt = 1.0f / 60.0f;
+	const double caseNs = options.caseMs * 1.0e6;
+	int frames = 0;
+	double ns = 0.0;
+	auto caseStart = BenchClock::now();
+	while (frames < options.frames && ElapsedNs(caseStart) < caseNs)
+	{
+		auto start = BenchClock::now();
+		for (auto& animator : animators)
+			animator.UpdateAnimation(dt);
+		ns += ElapsedNs(start);
+		++frames;
+	}
+	for (auto& animator : animators)
+		g_Sink = g_Sink + animator.m_FinalBoneMatrices[0][3][1];
+
+	StreamStats stats = stream.GetStats();
+	size_t fullBytes = 0;
+	for (const Bone& bone : clip->GetBones())
+		fullBytes += bone.m_Positions.size() * sizeof(KeyPosition) + bone.m_Rotations.size() * sizeof(KeyRotation)
+			+ bone.m_Scales.size() * sizeof(KeyScale);
+	std::cout << "streamed: " << stream.GetBlockCount() << " blocks, resident " << stats.residentBytes / 1024
+		<< " KiB (full clip " << fullBytes / 1024 << " KiB), " << stats.blocksLoaded << " blocks loaded, "
+		<< stats.misses << " misses" << std::endl;
+	std::remove(cookedPath.c_str());
+
+	result.iterations = frames;
+	result.totalNs = ns;
+	result.nsPerCharacter = frames > 0 ? ns / (static_cast<double>(frames) * characters) : 0.0;
+	result.nsPerBone = result.nsPerCharacter / std::max(1, bones);
+	return result;
+}
+
+static int CountKeys(const Animation* clip)
+{
+	int keys = 0;
+	for (const auto& bone : clip->GetBones())
+		keys = std::max(keys, bone.m_NumRotations);
+	return keys;
+}
+
+
+
+// reporting
+// ---------
+static void PrintResult(BenchResult& result, const BenchOptions& options)
+{
+	double budgetNs = options.budgetMs * 1.0e6;
+	result.charactersPerFrame = result.nsPerCharacter > 0.0 ? budgetNs / result.nsPerCharacter : 0.0;
+
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-16s %-22s bones %4d  keys %5d  chars %4d  %10.2f ns/bone  %12.1f chars/frame",
+		result.name.c_str(), result.clip.c_str(), result.bones, result.keys, result.characters,
+		result.nsPerBone, result.charactersPerFrame);
+	std::cout << line << std::endl;
+}
+
+static std::string JsonEscape(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+static bool WriteJsonReport(const std::vector<BenchResult>& results, const BenchOptions& options)
+{
+	std::ofstream out(options.jsonPath);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR::BENCHMARK:: Cannot write report '" << options.jsonPath << "'" << std::endl;
+		return false;
+	}
+
+	out << "{\n";
+	out << "  \"frames\": " << options.frames << ",\n";
+	out << "  \"case_ms\": " << options.caseMs << ",\n";
+	out << "  \"budget_ms\": " << options.budgetMs << ",\n";
+	out << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& r = results[i];
+		out << "    {\"name\": \"" << JsonEscape(r.name) << "\", \"clip\": \"" << JsonEscape(r.clip) << "\""
+			<< ", \"bones\": " << r.bones << ", \"keys\": " << r.keys << ", \"characters\": " << r.characters
+			<< ", \"iterations\": " << r.iterations << ", \"total_ns\": " << r.totalNs
+			<< ", \"ns_per_bone\": " << r.nsPerBone << ", \"ns_per_character\": " << r.nsPerCharacter
+			<< ", \"characters_per_frame\": " << r.charactersPerFrame << "}"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+	return true;
+}
+
+static bool FileExists(const std::string& path)
+{
+	std::ifstream test(path);
+	return test.good();
+}
+
+static BenchOptions ParseOptions(int argc, char** argv)
+{
+	BenchOptions options;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc)
+			options.frames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--case-ms" && i + 1 < argc)
+			options.caseMs = std::atof(argv[++i]);
+		else if (arg == "--budget-ms" && i + 1 < argc)
+			options.budgetMs = std::atof(argv[++i]);
+		else if (arg == "--json" && i + 1 < argc)
+			options.jsonPath = argv[++i];
+		else if (arg == "--clip" && i + 1 < argc)
+			options.clips.push_back(argv[++i]);
+		else
+			std::cerr << "WARNING::BENCHMARK:: Ignoring unknown argument '" << arg << "'" << std::endl;
+	}
+
+	if (options.clips.empty())
+	{
+		// same relative layout main.cpp uses (executable runs from build/Assignment_4 or its Debug/ folder)
+		const char* mixamoClips[] = { "objects/mixamo/Idle.dae", "objects/mixamo/Snake Hip Hop Dance.dae" };
+		for (const char* clip : mixamoClips)
+		{
+			if (FileExists(std::string("../resources/") + clip))
+				options.clips.push_back(std::string("../resources/") + clip);
+			else if (FileExists(std::string("resources/") + clip))
+				options.clips.push_back(std::string("resources/") + clip);
+		}
+	}
+	return options;
+}
+
+
+
+int main(int argc, char** argv)
+{
+	BenchOptions options = ParseOptions(argc, argv);
+	std::vector<BenchResult> results;
+
+	const int boneCounts[] = { 20, 52, MAX_BENCH_BONES };
+	const int keyCounts[] = { 30, 120, 960 };
+	const int characterCounts[] = { 1, 32, 256 };
+
+	std::cout << "Animation benchmark: " << options.frames << " frames, " << options.budgetMs << " ms frame budget" << std::endl;
+
+	// Bone::Update across key counts
+	for (int keys : keyCounts)
+		results.push_back(BenchBoneUpdate(keys, options));
+
+	// Animator::UpdateAnimation across bones x keys x characters, plus blending and palette fetch
+	for (int bones : boneCounts)
+	{
+		for (int keys : keyCounts)
+		{
+			SyntheticRig rig;
+			std::unique_ptr<Animation> clip(BuildSyntheticClip(rig, bones, keys, 1));
+			std::unique_ptr<Animation> blendClip(BuildSyntheticClip(rig, bones, keys, 2));
+			for (int characters : characterCounts)
+			{
+				results.push_back(BenchAnimators("update", "synthetic", clip.get(), nullptr, bones, keys, characters, options));
+				results.push_back(BenchAnimators("blend", "synthetic", clip.get(), blendClip.get(), bones, keys, characters, options));
+			}
+		}
+
+		SyntheticRig rig;
+		std::unique_ptr<Animation> clip(BuildSyntheticClip(rig, bones, keyCounts[0], 3));
+		for (int characters : characterCounts)
+			results.push_back(BenchPalette(clip.get(), bones, characters, options));
+		for (int characters : characterCounts)
+			results.push_back(BenchIK(clip.get(), bones, characters, options));
+		for (int characters : characterCounts)
+			results.push_back(BenchSliced(clip.get(), bones, characters, 2000.0f, options));
+	}
+
+	// a five minute take at 30 keys/s, streamed instead of sampled from memory
+	{
+		const int streamKeys = 30 * 60 * 5;
+		SyntheticRig rig;
+		std::unique_ptr<Animation> clip(BuildSyntheticClip(rig, 52, streamKeys, 4));
+		for (int characters : characterCounts)
+			results.push_back(BenchStreamed(clip.get(), 52, streamKeys, characters, options));
+	}
+
+	// real clips (Mixamo rig), loaded through Assimp only - no Model/GL resources
+	std::map<std::string, BoneInfo> boneInfoMap;
+	int boneCount = 0;
+	for (const std::string& path : options.clips)
+	{
+		Animation clip(path, boneInfoMap, boneCount);
+		if (!clip.IsValid())
+			continue;
+		if (boneCount > MAX_BENCH_BONES)
+		{
+			std::cerr << "WARNING::BENCHMARK:: '" << path << "' has " << boneCount << " bones, skipping" << std::endl;
+			continue;
+		}
+		std::string clipName = path.substr(path.find_last_of("/\\") + 1);
+		for (int characters : characterCounts)
+			results.push_back(BenchAnimators("update", clipName, &clip, nullptr, boneCount, CountKeys(&clip), characters, options));
+	}
+
+	for (auto& result : results)
+		PrintResult(result, options);
+
+	if (!WriteJsonReport(results, options))
+		return 1;
+	std::cout << "JSON report written to " << options.jsonPath << " (checksum " << g_Sink << ")" << std::endl;
+	return 0;
+}
@@ -6,13 +6,27 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
+flat in ivec4 MaterialLayers;
+
 uniform sampler2D texture_diffuse1;
 
+// batched materials read their layer of a texture array page instead
+
+uniform bool materialArrays;
+
+uniform sampler2DArray texture_diffuse_array;
+
 void main()
 
 {    
 
-    FragColor = texture(texture_diffuse1, TexCoords);
+    if (materialArrays)
+
+        FragColor = texture(texture_diffuse_array, vec3(TexCoords, MaterialLayers.x));
+
+    else
+
+        FragColor = texture(texture_diffuse1, TexCoords);
 
 }
 
@@ -16,6 +16,11 @@ layout(location = 5) in ivec4 boneIds;
 
 layout(location = 6) in vec4 weights;
 
+// texture array layers of a batched material (diffuse, specular, normal, height), a constant
+// per draw or an instanced attribute (MaterialLayers in mesh.h)
+
+layout(location = 7) in ivec4 materialLayers;
+
 
 
 uniform mat4 projection;
@@ -26,6 +31,18 @@ uniform mat4 model;
 
 
 
+// packed vertex formats (Common::VertexDecode, set by Mesh::Draw):
+
+// position = positionOffset + positionScale * pos, and norm.xy may be octahedral
+
+uniform vec3 positionScale;
+
+uniform vec3 positionOffset;
+
+uniform bool octahedralNormals;
+
+
+
 const int MAX_BONES = 100;
 
 const int MAX_BONE_INFLUENCE = 4;
@@ -36,12 +53,36 @@ uniform mat4 finalBonesMatrices[MAX_BONES];
 
 out vec2 TexCoords;
 
+flat out ivec4 MaterialLayers;
+
+
+
+vec3 octDecode(vec2 e)
+
+{
+
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+    float t = max(-n.z, 0.0);
+
+    n.x += n.x >= 0.0 ? -t : t;
+
+    n.y += n.y >= 0.0 ? -t : t;
+
+    return normalize(n);
+
+}
+
 
 
 void main()
 
 {
 
+    vec3 position = positionOffset + positionScale * pos;
+
+    vec3 normal = octahedralNormals ? octDecode(norm.xy) : norm;
+
     vec4 totalPosition = vec4(0.0f);
 
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
@@ -56,20 +97,26 @@ void main()
 
         {
 
-            totalPosition = vec4(pos,1.0f);
+            totalPosition = vec4(position,1.0f);
 
             break;
 
         }
 
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(position,1.0f);
 
         totalPosition += localPosition * weights[i];
 
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
+        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * normal;
 
    }
 
+    // no bone influences (static meshes have no skin streams): use the bind pose
+
+    if(totalPosition.w == 0.0f)
+
+        totalPosition = vec4(position,1.0f);
+
 	
 
     mat4 viewModel = view * model;
@@ -78,5 +125,7 @@ void main()
 
 	TexCoords = tex;
 
+	MaterialLayers = materialLayers;
+
 }
 
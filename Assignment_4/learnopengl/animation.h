@@ -18,6 +18,19 @@ struct AssimpNodeData
 	std::vector<AssimpNodeData> children;
 };
 
+// one entry per AssimpNodeData in depth-first (pre-order) order, so a node's
+// descendants always form the contiguous range [index + 1, subtreeEnd)
+struct FlatNodeData
+{
+	int parent;     // -1 for the root
+	int subtreeEnd;
+	int boneIndex;  // index into the final bone matrices, -1 if the node has no bone info
+	int track;      // index into the clip's bones (keyframe tracks), -1 if the node is not animated
+	glm::mat4 offset;
+	glm::mat4 transformation; // bind-pose local transform, used by nodes without a track
+	std::string name;
+};
+
 class Animation
 {
 public:
@@ -39,35 +52,30 @@ public:
             return;
         }
 
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
-        if (!scene || !scene->mRootNode)
-        {
-            std::cerr << "ERROR::ANIMATION:: Failed to load animation '" << animationPath
-                      << "': " << importer.GetErrorString() << std::endl;
-            return;
-        }
-
-        if (scene->mNumAnimations == 0)
-        {
-            std::cerr << "ERROR::ANIMATION:: No animations found in file '" << animationPath << "'" << std::endl;
-            return;
-        }
+        Load(animationPath, model->GetBoneInfoMap(), model->GetBoneCount());
+    }
 
-        auto animation = scene->mAnimations[0];
-        if (!animation)
-        {
-            std::cerr << "ERROR::ANIMATION:: Animation data is null in file '" << animationPath << "'" << std::endl;
-            return;
-        }
+    // loads a clip against a bare bone table instead of a Model, so no GL context is needed
+    // (used by tools such as the headless animation benchmark)
+    Animation(const std::string& animationPath, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
+        : m_Duration(0.0f)
+        , m_TicksPerSecond(0)
+        , m_IsValid(false)
+    {
+        Load(animationPath, boneInfoMap, boneCount);
+    }
 
-        m_Duration = animation->mDuration;
-        m_TicksPerSecond = animation->mTicksPerSecond;
-        aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
-        globalTransformation = globalTransformation.Inverse();
-        ReadHierarchyData(m_RootNode, scene->mRootNode);
-        ReadMissingBones(animation, *model);
-        m_IsValid = true;
+    // builds a clip from already converted data (procedural/synthetic skeletons)
+    Animation(float duration, int ticksPerSecond, const AssimpNodeData& rootNode,
+        std::vector<Bone> bones, const std::map<std::string, BoneInfo>& boneInfoMap)
+        : m_Duration(duration)
+        , m_TicksPerSecond(ticksPerSecond)
+        , m_Bones(std::move(bones))
+        , m_RootNode(rootNode)
+        , m_BoneInfoMap(boneInfoMap)
+        , m_IsValid(true)
+    {
+        BuildFlatHierarchy();
     }
 
 	~Animation()
@@ -90,6 +98,24 @@ public:
     inline float GetTicksPerSecond() const { return m_TicksPerSecond; }
     inline float GetDuration() const { return m_Duration; }
     inline const AssimpNodeData& GetRootNode() const { return m_RootNode; }
+    inline const std::vector<Bone>& GetBones() const { return m_Bones; }
+
+    // keyframe track of a flat node, resolved once when the hierarchy is flattened
+    inline Bone* GetNodeBone(int flatIndex)
+    {
+        int track = m_FlatNodes[flatIndex].track;
+        return track >= 0 ? &m_Bones[track] : nullptr;
+    }
+    inline const std::vector<FlatNodeData>& GetFlatNodes() const { return m_FlatNodes; }
+
+    // index of a node in the flattened hierarchy, -1 if not found
+    int FindNodeIndex(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_FlatNodes.size(); ++i)
+            if (m_FlatNodes[i].name == name)
+                return static_cast<int>(i);
+        return -1;
+    }
     inline const std::map<std::string,BoneInfo>& GetBoneIDMap() const
 	{ 
 		return m_BoneInfoMap;
@@ -98,7 +124,41 @@ public:
     inline bool IsValid() const { return m_IsValid; }
 
 private:
-	void ReadMissingBones(const aiAnimation* animation, Model& model)
+    void Load(const std::string& animationPath, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
+        if (!scene || !scene->mRootNode)
+        {
+            std::cerr << "ERROR::ANIMATION:: Failed to load animation '" << animationPath
+                      << "': " << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        if (scene->mNumAnimations == 0)
+        {
+            std::cerr << "ERROR::ANIMATION:: No animations found in file '" << animationPath << "'" << std::endl;
+            return;
+        }
+
+        auto animation = scene->mAnimations[0];
+        if (!animation)
+        {
+            std::cerr << "ERROR::ANIMATION:: Animation data is null in file '" << animationPath << "'" << std::endl;
+            return;
+        }
+
+        m_Duration = animation->mDuration;
+        m_TicksPerSecond = animation->mTicksPerSecond;
+        aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
+        globalTransformation = globalTransformation.Inverse();
+        ReadHierarchyData(m_RootNode, scene->mRootNode);
+        ReadMissingBones(animation, boneInfoMap, boneCount);
+        BuildFlatHierarchy();
+        m_IsValid = true;
+    }
+
+	void ReadMissingBones(const aiAnimation* animation, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
 	{
         if (!animation)
         {
@@ -108,9 +168,6 @@ private:
 
 		int size = animation->mNumChannels;
 
-		auto& boneInfoMap = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
-		int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
-
 		//reading channels(bones engaged in an animation and their keyframes)
 		for (int i = 0; i < size; i++)
 		{
@@ -136,6 +193,44 @@ private:
 		m_BoneInfoMap = boneInfoMap;
 	}
 
+	void BuildFlatHierarchy()
+	{
+		m_FlatNodes.clear();
+		FlattenNode(m_RootNode, -1);
+	}
+
+	void FlattenNode(const AssimpNodeData& node, int parent)
+	{
+		int index = static_cast<int>(m_FlatNodes.size());
+		FlatNodeData flat;
+		flat.parent = parent;
+		flat.subtreeEnd = index + 1;
+		flat.boneIndex = -1;
+		flat.track = -1;
+		flat.offset = glm::mat4(1.0f);
+		flat.transformation = node.transformation;
+		flat.name = node.name;
+		auto boneInfo = m_BoneInfoMap.find(node.name);
+		if (boneInfo != m_BoneInfoMap.end())
+		{
+			flat.boneIndex = boneInfo->second.id;
+			flat.offset = boneInfo->second.offset;
+		}
+		for (size_t i = 0; i < m_Bones.size(); ++i)
+		{
+			if (m_Bones[i].GetBoneName() == node.name)
+			{
+				flat.track = static_cast<int>(i);
+				break;
+			}
+		}
+		m_FlatNodes.push_back(flat);
+
+		for (int i = 0; i < node.childrenCount; i++)
+			FlattenNode(node.children[i], index);
+		m_FlatNodes[index].subtreeEnd = static_cast<int>(m_FlatNodes.size());
+	}
+
 	void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src)
 	{
 		assert(src);
@@ -157,6 +252,7 @@ private:
 	std::vector<Bone> m_Bones;
 	AssimpNodeData m_RootNode;
 	std::map<std::string, BoneInfo> m_BoneInfoMap;
+	std::vector<FlatNodeData> m_FlatNodes;
     bool m_IsValid;
 };
 
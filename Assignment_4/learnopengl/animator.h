@@ -5,33 +5,58 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cassert>
 #include <map>
 #include <vector>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <learnopengl/animation.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/pose_pool.h>
+#include <learnopengl/streamed_animation.h>
 
 class Animator
 {
 public:
-	Animator(Animation* animation)
+	// pose and palette buffers come from `pool` (the shared default pool if null)
+	Animator(Animation* animation, PosePool* pool = NULL)
+		: m_FinalBoneMatrices(PoseAllocator<glm::mat4>(pool))
+		, m_LocalPose(PoseAllocator<glm::mat4>(pool))
+		, m_GlobalPose(PoseAllocator<glm::mat4>(pool))
 	{
 		m_CurrentTime = 0.0;
+		m_CurrentTime2 = 0.0;
+		m_DeltaTime = 0.0;
 		m_CurrentAnimation = animation;
 		m_CurrentAnimation2 = NULL;
+		m_StreamedAnimation = NULL;
 		m_blendAmount = 0;
+		m_NodeCursor = 0;
+		m_IKEnabled = true;
 
-		m_FinalBoneMatrices.reserve(100);
+		m_FinalBoneMatrices.assign(100, glm::mat4(1.0f));
 
-		for (int i = 0; i < 100; i++)
-			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+		ResizePose();
 	}
 
+	// allocation free once the pose buffers are sized (debug builds assert it, see AnimationAllocations)
 	void UpdateAnimation(float dt)
 	{
 		m_DeltaTime = dt;
-		if (m_CurrentAnimation)
+		ResizePose();
+#ifndef NDEBUG
+		size_t allocationsBefore = AnimationAllocations::Count();
+#endif
+		if (m_StreamedAnimation)
+		{
+			m_CurrentTime += m_StreamedAnimation->GetTicksPerSecond() * dt;
+			m_CurrentTime = fmod(m_CurrentTime, m_StreamedAnimation->GetDuration());
+
+			// a late block keeps last frame's local pose, playback never waits on disk
+			m_StreamedAnimation->Sample(m_CurrentTime, m_LocalPose);
+			PropagateSubtree(0);
+		}
+		else if (m_CurrentAnimation)
 		{
 			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
 			m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
@@ -42,17 +67,32 @@ public:
 				m_CurrentTime2 = fmod(m_CurrentTime2, m_CurrentAnimation2->GetDuration());
 			}
 
+			m_NodeCursor = 0;
 			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
 		}
+		assert(AnimationAllocations::Count() == allocationsBefore && "Animator::UpdateAnimation allocated");
 	}
 
 	void PlayAnimation(Animation* pAnimation, Animation* pAnimation2, float time1, float time2, float blend)
 	{
 		m_CurrentAnimation = pAnimation;
+		m_StreamedAnimation = NULL;
 		m_CurrentTime = time1;
 		m_CurrentAnimation2 = pAnimation2;
 		m_CurrentTime2 = time2;
 		m_blendAmount = blend;
+		ResizePose();
+	}
+
+	// plays a streamed clip on the skeleton it was opened with (no blending)
+	void PlayStreamed(StreamedAnimation* pAnimation, float time = 0.0f)
+	{
+		m_StreamedAnimation = pAnimation;
+		m_CurrentAnimation = pAnimation->GetSkeleton();
+		m_CurrentAnimation2 = NULL;
+		m_CurrentTime = time;
+		m_blendAmount = 0;
+		ResizePose();
 	}
 
 	glm::mat4 UpdateBlend(Bone* Bone1, Bone* Bone2) {
@@ -81,50 +121,93 @@ public:
 		return TRS;
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	void CalculateBoneTransform(const AssimpNodeData* node, const glm::mat4& parentTransform)
 	{
-		std::string nodeName = node->name;
+		// nodes are visited in the same depth-first order Animation::GetFlatNodes() uses
+		int flatIndex = m_NodeCursor++;
+		const FlatNodeData& flat = m_CurrentAnimation->GetFlatNodes()[flatIndex];
 		glm::mat4 nodeTransform = node->transformation;
 
-		Bone* Bone1 = m_CurrentAnimation->FindBone(nodeName);
+		Bone* Bone1 = m_CurrentAnimation->GetNodeBone(flatIndex);
 		Bone* Bone2 = NULL;
 		if (m_CurrentAnimation2) {
-			Bone2 = m_CurrentAnimation2->FindBone(nodeName);
+			Bone2 = m_CurrentAnimation2->FindBone(node->name);
 		}
 		
 		if (Bone1)
 		{
-			Bone1->Update(m_CurrentTime);
-			nodeTransform = Bone1->GetLocalTransform();
-
 			if (Bone2) {
 				nodeTransform = UpdateBlend(Bone1, Bone2);
 			}
+			else {
+				Bone1->Update(m_CurrentTime);
+				nodeTransform = Bone1->GetLocalTransform();
+			}
 		}
 
 		glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-		auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
-		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
-			m_FinalBoneMatrices[index] = globalTransformation * offset;
-		}
+		m_LocalPose[flatIndex] = nodeTransform;
+		m_GlobalPose[flatIndex] = globalTransformation;
+
+		if (flat.boneIndex >= 0)
+			m_FinalBoneMatrices[flat.boneIndex] = globalTransformation * flat.offset;
 
 		for (int i = 0; i < node->childrenCount; i++)
-			CalculateBoneTransform(&node->children[i], globalTransformation);
+			CalculateBoneTransform(&node->children[i], m_GlobalPose[flatIndex]);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	const PoseBuffer& GetFinalBoneMatrices() const
 	{
 		return m_FinalBoneMatrices;
 	}
 
+	// flattened pose of the last update, indexed like Animation::GetFlatNodes()
+	PoseBuffer& GetLocalPose() { return m_LocalPose; }
+	const PoseBuffer& GetGlobalPose() const { return m_GlobalPose; }
+
+	// recomputes global transforms and bone matrices of the subtree rooted at a flat node
+	// after its local transforms were edited (e.g. by the IK stage)
+	void PropagateSubtree(int first)
+	{
+		const std::vector<FlatNodeData>& nodes = m_CurrentAnimation->GetFlatNodes();
+		int end = nodes[first].subtreeEnd;
+		for (int i = first; i < end; ++i)
+		{
+			const FlatNodeData& node = nodes[i];
+			m_GlobalPose[i] = node.parent >= 0 ? m_GlobalPose[node.parent] * m_LocalPose[i] : m_LocalPose[i];
+			if (node.boneIndex >= 0)
+				m_FinalBoneMatrices[node.boneIndex] = m_GlobalPose[i] * node.offset;
+		}
+	}
+
+	// per-character LOD toggle for post-sampling passes such as IK
+	void SetIKEnabled(bool enabled) { m_IKEnabled = enabled; }
+	bool IsIKEnabled() const { return m_IKEnabled; }
+
+	Animation* GetCurrentAnimation() { return m_CurrentAnimation; }
+
 //private:
-	std::vector<glm::mat4> m_FinalBoneMatrices;
+	void ResizePose()
+	{
+		if (!m_CurrentAnimation)
+			return;
+		size_t nodeCount = m_CurrentAnimation->GetFlatNodes().size();
+		if (m_LocalPose.size() != nodeCount)
+		{
+			m_LocalPose.assign(nodeCount, glm::mat4(1.0f));
+			m_GlobalPose.assign(nodeCount, glm::mat4(1.0f));
+		}
+	}
+
+	PoseBuffer m_FinalBoneMatrices;
+	PoseBuffer m_LocalPose;
+	PoseBuffer m_GlobalPose;
+	int m_NodeCursor;
+	bool m_IKEnabled;
 	Animation* m_CurrentAnimation;
 	Animation* m_CurrentAnimation2;
+	StreamedAnimation* m_StreamedAnimation;
 	float m_CurrentTime;
 	float m_CurrentTime2;
 	float m_DeltaTime;
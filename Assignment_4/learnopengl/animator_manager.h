@@ -0,0 +1,210 @@
+#pragma once
+
+/* Time-sliced animator updates.
+   Every frame the manager evaluates full skeletons in priority order (visible first,
+   then near, stale characters move up) until the per-frame CPU budget is spent. Skipped
+   characters keep their last palette or extrapolate it, and catch up on the accumulated
+   time when they are evaluated again. The budget follows the measured frame time. */
+
+#include <glm/glm.hpp>
+#include <learnopengl/animator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+enum AnimatorSkipPolicy
+{
+	ANIMATOR_HOLD,        // keep the last evaluated palette
+	ANIMATOR_EXTRAPOLATE  // continue the last palette change linearly (at most one evaluation ahead)
+};
+
+struct AnimatorManagerStats
+{
+	int characters = 0;
+	int evaluated = 0;          // full evaluations this frame
+	int deferred = 0;           // characters skipped this frame
+	long long totalDeferred = 0; // skipped evaluations since the manager was created
+	int maxSkippedFrames = 0;   // oldest palette on screen, in frames
+	float budgetMicroseconds = 0.0f;
+	float usedMicroseconds = 0.0f;
+};
+
+class AnimatorManager
+{
+public:
+	AnimatorManager(float budgetMicroseconds = 2000.0f, float targetFrameMs = 1000.0f / 60.0f)
+		: m_BudgetMicroseconds(budgetMicroseconds)
+		, m_MinBudgetMicroseconds(budgetMicroseconds * 0.25f)
+		, m_MaxBudgetMicroseconds(budgetMicroseconds * 4.0f)
+		, m_TargetFrameMs(targetFrameMs)
+		, m_AdaptiveBudget(true)
+		, m_SkipPolicy(ANIMATOR_HOLD)
+		, m_EvaluationMicroseconds(0.0f)
+	{
+	}
+
+	// returns a handle for SetView/Remove; the animator must outlive its registration
+	int Add(Animator* animator)
+	{
+		Entry entry;
+		entry.animator = animator;
+		m_Entries.push_back(entry);
+		m_Order.reserve(m_Entries.size());
+		return static_cast<int>(m_Entries.size()) - 1;
+	}
+
+	void Remove(int handle)
+	{
+		m_Entries[handle].animator = NULL;
+	}
+
+	// visibility and camera distance drive the evaluation order
+	void SetView(int handle, bool visible, float distance)
+	{
+		m_Entries[handle].visible = visible;
+		m_Entries[handle].distance = distance;
+	}
+
+	void SetBudget(float microseconds) { m_BudgetMicroseconds = microseconds; }
+	void SetBudgetRange(float minMicroseconds, float maxMicroseconds)
+	{
+		m_MinBudgetMicroseconds = minMicroseconds;
+		m_MaxBudgetMicroseconds = maxMicroseconds;
+	}
+	void SetTargetFrameMs(float ms) { m_TargetFrameMs = ms; }
+	void SetAdaptiveBudget(bool adaptive) { m_AdaptiveBudget = adaptive; }
+	void SetSkipPolicy(AnimatorSkipPolicy policy) { m_SkipPolicy = policy; }
+
+	// dt is the measured duration of the last frame, it also drives the adaptive budget
+	void Update(float dt)
+	{
+		AdaptBudget(dt);
+
+		m_Order.clear();
+		for (size_t i = 0; i < m_Entries.size(); ++i)
+		{
+			if (!m_Entries[i].animator)
+				continue;
+			m_Entries[i].pendingTime += dt;
+			m_Order.push_back(static_cast<int>(i));
+		}
+
+		// visible before hidden, then by distance shrunk by how long the palette has been stale
+		std::sort(m_Order.begin(), m_Order.end(), [this](int a, int b) {
+			const Entry& ea = m_Entries[a];
+			const Entry& eb = m_Entries[b];
+			if (ea.visible != eb.visible)
+				return ea.visible;
+			return ea.distance / (1.0f + ea.skippedFrames) < eb.distance / (1.0f + eb.skippedFrames);
+		});
+
+		m_Stats.characters = static_cast<int>(m_Order.size());
+		m_Stats.evaluated = 0;
+		m_Stats.deferred = 0;
+		m_Stats.maxSkippedFrames = 0;
+		m_Stats.budgetMicroseconds = m_BudgetMicroseconds;
+
+		auto start = Clock::now();
+		float used = 0.0f;
+		for (int index : m_Order)
+		{
+			Entry& entry = m_Entries[index];
+			// the first character always runs so playback can never freeze entirely
+			bool fits = m_Stats.evaluated == 0 || used + m_EvaluationMicroseconds <= m_BudgetMicroseconds;
+			if (fits)
+			{
+				auto evalStart = Clock::now();
+				Evaluate(entry);
+				float cost = Microseconds(evalStart);
+				// running average cost of one evaluation, predicts whether the next one fits
+				m_EvaluationMicroseconds = m_EvaluationMicroseconds == 0.0f ? cost : m_EvaluationMicroseconds * 0.9f + cost * 0.1f;
+				used = Microseconds(start);
+				m_Stats.evaluated++;
+			}
+			else
+			{
+				Skip(entry);
+				m_Stats.deferred++;
+				m_Stats.maxSkippedFrames = std::max(m_Stats.maxSkippedFrames, entry.skippedFrames);
+			}
+		}
+		m_Stats.totalDeferred += m_Stats.deferred;
+		m_Stats.usedMicroseconds = used;
+	}
+
+	const AnimatorManagerStats& GetStats() const { return m_Stats; }
+	float GetBudget() const { return m_BudgetMicroseconds; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		Animator* animator = NULL;
+		bool visible = true;
+		float distance = 0.0f;
+		float pendingTime = 0.0f;  // seconds the animator is behind
+		float lastStep = 0.0f;     // dt of the last evaluation, scales extrapolation
+		int skippedFrames = 0;
+		PoseBuffer lastPalette;
+		PoseBuffer previousPalette;
+	};
+
+	std::vector<Entry> m_Entries;
+	std::vector<int> m_Order;
+	float m_BudgetMicroseconds;
+	float m_MinBudgetMicroseconds;
+	float m_MaxBudgetMicroseconds;
+	float m_TargetFrameMs;
+	bool m_AdaptiveBudget;
+	AnimatorSkipPolicy m_SkipPolicy;
+	float m_EvaluationMicroseconds;
+	AnimatorManagerStats m_Stats;
+
+	static float Microseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+	}
+
+	void Evaluate(Entry& entry)
+	{
+		entry.animator->UpdateAnimation(entry.pendingTime);
+		entry.lastStep = entry.pendingTime;
+		entry.pendingTime = 0.0f;
+		entry.skippedFrames = 0;
+
+		if (m_SkipPolicy == ANIMATOR_EXTRAPOLATE)
+		{
+			// swap keeps both buffers allocated after the first frames
+			std::swap(entry.previousPalette, entry.lastPalette);
+			entry.lastPalette = entry.animator->m_FinalBoneMatrices;
+		}
+	}
+
+	void Skip(Entry& entry)
+	{
+		entry.skippedFrames++;
+		if (m_SkipPolicy != ANIMATOR_EXTRAPOLATE || entry.lastStep <= 0.0f
+			|| entry.previousPalette.size() != entry.lastPalette.size())
+			return; // hold: the animator still has its last palette
+
+		float t = std::min(entry.pendingTime / entry.lastStep, 1.0f);
+		PoseBuffer& palette = entry.animator->m_FinalBoneMatrices;
+		for (size_t i = 0; i < palette.size() && i < entry.lastPalette.size(); ++i)
+			palette[i] = entry.lastPalette[i] + (entry.lastPalette[i] - entry.previousPalette[i]) * t;
+	}
+
+	// shrinks the budget quickly when frames run long, grows it slowly when there is headroom
+	void AdaptBudget(float dt)
+	{
+		if (!m_AdaptiveBudget || dt <= 0.0f)
+			return;
+		float frameMs = dt * 1000.0f;
+		if (frameMs > m_TargetFrameMs * 1.05f)
+			m_BudgetMicroseconds *= 0.85f;
+		else if (frameMs < m_TargetFrameMs * 0.9f)
+			m_BudgetMicroseconds *= 1.05f;
+		m_BudgetMicroseconds = std::min(std::max(m_BudgetMicroseconds, m_MinBudgetMicroseconds), m_MaxBudgetMicroseconds);
+	}
+};
@@ -5,6 +5,8 @@
 #include <list> //std::list
 #include <array> //std::array
 #include <memory> //std::unique_ptr
+#include <algorithm> //std::max
+#include <cmath> //std::tan
 
 class Transform
 {
@@ -383,6 +385,18 @@ Sphere generateSphereBV(const Model& model)
 	return Sphere((maxAABB + minAABB) * 0.5f, glm::length(minAABB - maxAABB));
 }
 
+//Camera information used to pick a level of detail (see Model::SelectLod)
+struct LodView
+{
+	glm::vec3 cameraPosition{ 0.f, 0.f, 0.f };
+	float projectionScale = 0.f; // pixels per unit at distance 1: viewportHeight / (2 * tan(fovY / 2))
+	float maxPixelError = 1.f;
+
+	LodView(const glm::vec3& position, float fovY, float viewportHeight, float maxError = 1.f)
+		: cameraPosition{ position }, projectionScale{ viewportHeight / (2.f * std::tan(fovY * 0.5f)) }, maxPixelError{ maxError }
+	{}
+};
+
 class Entity
 {
 public:
@@ -481,5 +495,30 @@ public:
 			child->drawSelfAndChild(frustum, ourShader, display, total);
 		}
 	}
+
+	//Same as above, drawing each model at the coarsest level that stays within view.maxPixelError
+	void drawSelfAndChild(const Frustum& frustum, const LodView& view, Shader& ourShader, unsigned int& display, unsigned int& total)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			//Distance to the closest point of the bounding sphere of the global AABB
+			const AABB globalAABB = getGlobalAABB();
+			const float distance = std::max(glm::length(globalAABB.center - view.cameraPosition) - glm::length(globalAABB.extents), 0.f);
+
+			//LOD errors are in model space, scale them with the entity
+			const glm::vec3 globalScale = transform.getGlobalScale();
+			const float scale = std::max(std::max(globalScale.x, globalScale.y), globalScale.z);
+
+			ourShader.setMat4("model", transform.getModelMatrix());
+			pModel->Draw(ourShader, pModel->SelectLod(distance, view.projectionScale * scale, view.maxPixelError));
+			display++;
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, view, ourShader, display, total);
+		}
+	}
 };
 #endif
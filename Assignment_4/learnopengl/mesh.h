@@ -7,13 +7,25 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include "material_binding.hpp"
+#include "mesh_simplifier.hpp"
+#include "texture_array.hpp"
+#include "vertex_format.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
 
+// Material batching (Common::TextureArrayPages): the array pages go to units
+// MATERIAL_ARRAY_UNIT + slot, bound to the texture_<type>_array samplers, and the layer of
+// each slot reaches the vertex shader as the ivec4 attribute MATERIAL_LAYER_ATTRIBUTE -
+// a constant per draw, or an instanced buffer per instance
+#define MATERIAL_ARRAY_UNIT 8
+#define MATERIAL_LAYER_ATTRIBUTE 7
+
 struct Vertex {
     // position
     glm::vec3 Position;
@@ -37,36 +49,180 @@ struct Texture {
     string path;
 };
 
+// the batched textures of a mesh: page and layer of its first texture of each type, in the
+// order diffuse, specular, normal, height; page 0 where it has none
+struct MaterialLayers {
+    unsigned int pages[4] = { 0, 0, 0, 0 };
+    int layers[4] = { 0, 0, 0, 0 };
+};
+
+// sampler names and slots of MaterialLayers
+inline int MaterialSlot(const string& type)
+{
+    if (type == "texture_diffuse") return 0;
+    if (type == "texture_specular") return 1;
+    if (type == "texture_normal") return 2;
+    if (type == "texture_height") return 3;
+    return -1;
+}
+
+// a level of detail: a range of Mesh::indices and its object-space distance to the full mesh
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<MeshLod>      lods;    // lods[0] is the full mesh, indices holds every level back to back; empty: no levels
     unsigned int VAO;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, optionally generating lodCount simplified levels (about half the triangles each).
+    // format is the GPU vertex layout; vertices always keeps the full float data
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, unsigned int lodCount = 0,
+         const Common::VertexFormat& format = Common::VertexFormat::full())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->format = format;
+
+        if (lodCount > 0 && !this->indices.empty())
+        {
+            vector<Common::LodLevel> levels;
+            Common::generateLodChain(this->indices, vector<Common::IndexRange>(), &this->vertices[0].Position.x, sizeof(Vertex),
+                                     this->vertices.size(), lodCount, levels);
+            for (const Common::LodLevel& level : levels)
+                lods.push_back({ (unsigned int)level.ranges[0].offset, (unsigned int)level.ranges[0].count, level.error });
+        }
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
-    void Draw(Shader &shader) 
+    // constructor with levels computed earlier (e.g. read from a mesh cache)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<MeshLod> lods,
+         const Common::VertexFormat& format = Common::VertexFormat::full())
+    {
+        this->vertices = vertices;
+        this->indices = indices;
+        this->textures = textures;
+        this->lods = lods;
+        this->format = format;
+        setupMesh();
+    }
+
+    unsigned int GetLodCount() const { return lods.empty() ? 1 : (unsigned int)lods.size(); }
+    // levels past the last one this mesh has report (and draw) its coarsest level
+    float GetLodError(unsigned int lod) const { return lods.empty() ? 0.0f : lods[std::min<size_t>(lod, lods.size() - 1)].error; }
+
+    // bytes per vertex on the GPU, for the streams this mesh uploads (Common::VertexStreamBits)
+    unsigned int GetVertexStride() const { return vertexStride; }
+    unsigned int GetVertexStreams() const { return format.streams; }
+
+    // draws with texture array layers from now on instead of binding textures
+    void SetMaterialLayers(const MaterialLayers& layers)
+    {
+        materialLayers = layers;
+        batched = true;
+        materialBindings.clear();
+    }
+    bool IsBatched() const { return batched; }
+
+    // textures changed after the mesh was drawn: its binding tables are resolved again
+    void ResetMaterialBindings() { materialBindings.clear(); }
+
+    // render the mesh; also sets the uniforms the vertex shader decodes a packed format with.
+    // Uniform locations and texture units come from a table built on the first draw with
+    // each shader program (Common::MaterialBinding), so drawing does no name lookups
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        unsigned int boundPages[4] = { 0, 0, 0, 0 };
+        Draw(shader, lod, boundPages);
+    }
+
+    // boundPages: the array page on each material unit, kept across the draws of a model so
+    // that meshes on the same pages bind nothing
+    void Draw(Shader &shader, unsigned int lod, unsigned int (&boundPages)[4])
+    {
+        bindMaterial(shader, boundPages);
+        glBindVertexArray(VAO);
+        drawLevel(lod, 0);
+        glBindVertexArray(0);
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // batched meshes only: instanceCount copies in one draw, each with its own layers from
+    // layerBuffer (one ivec4 per instance, see MaterialLayers). Where each copy goes is up to
+    // the shader (gl_InstanceID)
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int layerBuffer, unsigned int lod = 0)
+    {
+        unsigned int boundPages[4] = { 0, 0, 0, 0 };
+        bindMaterial(shader, boundPages);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+        glEnableVertexAttribArray(MATERIAL_LAYER_ATTRIBUTE);
+        glVertexAttribIPointer(MATERIAL_LAYER_ATTRIBUTE, 4, GL_INT, 4 * sizeof(int), (void*)0);
+        glVertexAttribDivisor(MATERIAL_LAYER_ATTRIBUTE, 1);
+        drawLevel(lod, instanceCount);
+        glDisableVertexAttribArray(MATERIAL_LAYER_ATTRIBUTE);
+        glVertexAttribDivisor(MATERIAL_LAYER_ATTRIBUTE, 0);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    void bindMaterial(Shader &shader, unsigned int (&boundPages)[4])
     {
-        // bind appropriate textures
+        materialBindings.get(shader.ID, [this](Common::MaterialBinding& table) { buildMaterialBinding(table); }).apply();
+        // a mesh without skin streams reads these constants instead: no bone influences,
+        // which the skinning shader treats as an unskinned vertex
+        if (!(format.streams & Common::StreamSkin))
+        {
+            glVertexAttribI4i(5, -1, -1, -1, -1);
+            glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+        if (!batched)
+            return;
+        for (int slot = 0; slot < 4; slot++)
+        {
+            if (materialLayers.pages[slot] == 0 || boundPages[slot] == materialLayers.pages[slot])
+                continue;
+            glActiveTexture(GL_TEXTURE0 + MATERIAL_ARRAY_UNIT + slot);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, materialLayers.pages[slot]);
+            boundPages[slot] = materialLayers.pages[slot];
+        }
+        glVertexAttribI4i(MATERIAL_LAYER_ATTRIBUTE, materialLayers.layers[0], materialLayers.layers[1],
+                          materialLayers.layers[2], materialLayers.layers[3]);
+    }
+
+    // the decode constants, and every sampler with its unit, whichever path the mesh draws
+    // with, so that no two sampler types share a unit: texture_<type>N on unit i for the i-th
+    // texture (bound here unless batched) and the texture_<type>_array samplers on their
+    // units (the pages are bound per draw, only when they change)
+    void buildMaterialBinding(Common::MaterialBinding& table)
+    {
+        table.setVec3("positionScale", decode.positionScale);
+        table.setVec3("positionOffset", decode.positionOffset);
+        table.setInt("octahedralNormals", decode.octahedralNormals ? 1 : 0);
+        table.setInt("materialArrays", batched ? 1 : 0);
+        table.addSampler("texture_diffuse_array", MATERIAL_ARRAY_UNIT + 0);
+        table.addSampler("texture_specular_array", MATERIAL_ARRAY_UNIT + 1);
+        table.addSampler("texture_normal_array", MATERIAL_ARRAY_UNIT + 2);
+        table.addSampler("texture_height_array", MATERIAL_ARRAY_UNIT + 3);
+
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -79,28 +235,75 @@ public:
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // the sampler reads unit i, where the texture is bound
+            if (batched)
+                table.addSampler((name + number).c_str(), i);
+            else
+                table.addTexture((name + number).c_str(), i, GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // with VAO bound; instanceCount 0: a plain draw
+    void drawLevel(unsigned int lod, unsigned int instanceCount)
+    {
+        unsigned int indexOffset = 0;
+        unsigned int indexCount = static_cast<unsigned int>(indices.size());
+        if (!lods.empty())
+        {
+            const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+            indexOffset = level.indexOffset;
+            indexCount = level.indexCount;
+        }
+        if (instanceCount > 0)
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, Common::indexGLType(indexSize),
+                                    (void*)(size_t)(indexOffset * indexSize), instanceCount);
+        else
+            glDrawElements(GL_TRIANGLES, indexCount, Common::indexGLType(indexSize), (void*)(size_t)(indexOffset * indexSize));
     }
 
-private:
     // render data 
     unsigned int VBO, EBO;
+    Common::VertexFormat format;
+    Common::VertexDecode decode;
+    unsigned int vertexStride = 0;
+    unsigned int indexSize = sizeof(unsigned int); // 2 when the mesh has at most 65536 vertices
+    MaterialLayers materialLayers;
+    bool batched = false;
+    Common::MaterialBindings materialBindings;  // per shader program, built on first draw
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        // pack the streams format.streams asks for into the GPU format; a skinned, normal
+        // mapped mesh in full floats is a plain copy of the Vertex array
+        Common::VertexStreams streams;
+        streams.count = vertices.size();
+        streams.stride = sizeof(Vertex);
+        if (!vertices.empty())
+        {
+            streams.positions = &vertices[0].Position.x;
+            streams.normals = &vertices[0].Normal.x;
+            streams.texCoords = &vertices[0].TexCoords.x;
+            streams.tangents = &vertices[0].Tangent.x;
+            streams.bitangents = &vertices[0].Bitangent.x;
+            streams.boneIds = vertices[0].m_BoneIDs;
+            streams.boneWeights = vertices[0].m_Weights;
+        }
+        Common::VertexLayout layout = Common::makeVertexLayout(format, streams);
+        vector<unsigned char> packed(vertices.size() * layout.stride);
+        Common::packVertices(layout, streams, packed.data());
+        decode = layout.decode;
+        vertexStride = layout.stride;
+
+        // 16-bit indices whenever every vertex fits
+        indexSize = Common::indexSizeFor(vertices.size());
+        vector<uint16_t> shortIndices;
+        if (indexSize == sizeof(uint16_t))
+        {
+            shortIndices.resize(indices.size());
+            Common::narrowIndices(indices.data(), indices.size(), shortIndices.data());
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -109,38 +312,38 @@ private:
         glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * indexSize,
+                     shortIndices.empty() ? (const void*)indices.data() : (const void*)shortIndices.data(), GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers: positions, normals, texture coords, tangents,
+        // bitangents, bone ids (integer, location 5) and weights
+        for (const Common::CookedAttribute& attribute : layout.attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            if (attribute.location == 5)
+                glVertexAttribIPointer(attribute.location, attribute.components, attribute.glType, layout.stride, (void*)(size_t)attribute.offset);
+            else
+                glVertexAttribPointer(attribute.location, attribute.components, attribute.glType,
+                                      attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute.offset);
+        }
         glBindVertexArray(0);
     }
 };
+
+// Coarsest level of a set of meshes whose error stays within maxPixelError pixels at `distance`;
+// projectionScale comes from Common::lodProjectionScale(fovY, viewportHeight)
+inline unsigned int SelectMeshLod(const vector<Mesh>& meshes, float distance, float projectionScale, float maxPixelError)
+{
+    unsigned int lodCount = 1;
+    for (const Mesh& mesh : meshes)
+        lodCount = std::max(lodCount, mesh.GetLodCount());
+    vector<float> errors(lodCount, 0.0f);
+    for (unsigned int lod = 0; lod < lodCount; lod++)
+        for (const Mesh& mesh : meshes)
+            errors[lod] = std::max(errors[lod], mesh.GetLodError(lod));
+    return Common::selectLod(errors.data(), errors.size(), distance, projectionScale, maxPixelError);
+}
 #endif
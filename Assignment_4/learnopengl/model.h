@@ -19,6 +19,11 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include "texture_loader.hpp"
+#include "texture_manager.hpp"
+#include "compressed_texture.hpp"
+#include "texture_cache.hpp"
+#include <unordered_set>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
@@ -27,37 +32,69 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// textures this model holds a Common::TextureManager reference on, one entry per image
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    unsigned int lodCount;
+    Common::VertexFormat vertexFormat;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. lodCount simplified levels are generated per mesh.
+    // vertexFormat is the GPU vertex layout; packed formats need the decode in the vertex shader (see anim_model.vs).
+    Model(string const &path, bool gamma = false, unsigned int lodCount = 0, const Common::VertexFormat& vertexFormat = Common::VertexFormat::full())
+        : gammaCorrection(gamma), lodCount(lodCount), vertexFormat(vertexFormat)
     {
         loadModel(path);
     }
 
+    // textures are shared with other models through Common::TextureManager and released here
+    ~Model()
+    {
+        for (const Texture& texture : textures_loaded)
+            Common::TextureManager::shared().release(texture.id);
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    void Draw(Shader &shader, unsigned int lod = 0)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, lod);
+    }
+
+    // coarsest level of detail that stays within maxPixelError pixels at distance
+    unsigned int SelectLod(float distance, float projectionScale, float maxPixelError = 1.0f) const
+    {
+        return SelectMeshLod(meshes, distance, projectionScale, maxPixelError);
     }
     
 private:
+    std::unordered_set<unsigned int> ownedTextureIds;  // ids in textures_loaded
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
+        // tangents only when some material has a normal or height map to use them
+        if (SceneNeedsTangents(scene))
+        {
+            scene = importer.ApplyPostProcessing(aiProcess_CalcTangentSpace);
+            if (!scene)
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return;
+            }
+        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
@@ -90,11 +127,22 @@ private:
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+
+        // only the streams this mesh has and its material uses are uploaded (no skin in static models)
+        Common::VertexFormat format = vertexFormat;
+        format.streams = 0;
+        if (mesh->HasNormals())
+            format.streams |= Common::StreamNormals;
+        if (mesh->HasTextureCoords(0))
+            format.streams |= Common::StreamTexCoords;
+        if (mesh->HasTangentsAndBitangents() && MaterialNeedsTangents(material))
+            format.streams |= Common::StreamTangents;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {};
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -118,6 +166,11 @@ private:
                 vec.x = mesh->mTextureCoords[0][i].x; 
                 vec.y = mesh->mTextureCoords[0][i].y;
                 vertex.TexCoords = vec;
+            }
+            else
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            if (format.streams & Common::StreamTangents)
+            {
                 // tangent
                 vector.x = mesh->mTangents[i].x;
                 vector.y = mesh->mTangents[i].y;
@@ -129,8 +182,6 @@ private:
                 vector.z = mesh->mBitangents[i].z;
                 vertex.Bitangent = vector;
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
         }
@@ -143,7 +194,6 @@ private:
                 indices.push_back(face.mIndices[j]);        
         }
         // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
@@ -165,7 +215,22 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, lodCount, format);
+    }
+
+    // normal and height maps are the only consumers of tangents
+    static bool MaterialNeedsTangents(const aiMaterial* material)
+    {
+        return material->GetTextureCount(aiTextureType_HEIGHT) > 0 || material->GetTextureCount(aiTextureType_AMBIENT) > 0
+            || material->GetTextureCount(aiTextureType_NORMALS) > 0;
+    }
+
+    static bool SceneNeedsTangents(const aiScene* scene)
+    {
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+            if (MaterialNeedsTangents(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex]))
+                return true;
+        return false;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -177,69 +242,45 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            // a texture another model (or this one) already loaded is shared, not loaded again
+            Texture texture;
+            texture.id = TextureFromFile(str.C_Str(), this->directory);
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            if (texture.id == 0)
+                continue;
+            textures.push_back(texture);
+            // the model keeps one reference per image; a repeat lookup gives its extra one back
+            if (!ownedTextureIds.insert(texture.id).second)
+                Common::TextureManager::shared().release(texture.id);
+            else
+                textures_loaded.push_back(texture);
         }
         return textures;
     }
 };
 
 
+// worker-thread decode for Common::TextureLoader; DDS / KTX files keep their compressed
+// blocks and mip chain, flipped like the stb_image output
+static bool DecodeImageFile(const string &path, Common::DecodedImage &image)
+{
+    if (Common::isCompressedTextureFile(path))
+        return Common::loadCompressedTexture(path, image, true);
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    image.release = stbi_image_free;
+    return image.pixels != nullptr;
+}
+
+// Returns at once with a placeholder texture; the file is decoded on the shared pool and
+// uploaded when the render loop calls Common::TextureLoader::shared().uploadCompleted().
+// Takes a Common::TextureManager reference, so an image already loaded is reused.
+// Images are block-compressed with their mip chain by the decode task on first use
+// (<image>.ctex, see Common::cookingDecoder) and that file is loaded from then on.
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return Common::TextureManager::shared().acquire(filename, Common::cookingDecoder(DecodeImageFile));
 }
 #endif
@@ -0,0 +1,147 @@
+#pragma once
+
+/* Pooled storage for pose, palette and other per-character matrix buffers.
+   Buffers are carved out of large pages and recycled through per-size free lists,
+   so creating/destroying characters does not touch the global heap once the pool
+   is warm, and the per-frame path never allocates at all (see AnimationAllocations). */
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// heap allocations made on the calling thread. Only counts when a translation unit
+// replaces the global operator new and bumps it (anim_benchmark.cpp does in debug
+// builds); otherwise it stays 0 and the debug checks built on it always pass.
+struct AnimationAllocations
+{
+	static size_t& Count()
+	{
+		static thread_local size_t count = 0;
+		return count;
+	}
+};
+
+class PosePool
+{
+public:
+	explicit PosePool(size_t pageMatrices = 4096)
+		: m_PageMatrices(pageMatrices)
+		, m_PageUsed(0)
+		, m_PageSize(0)
+		, m_LiveMatrices(0)
+		, m_ReservedMatrices(0)
+	{
+	}
+
+	PosePool(const PosePool&) = delete;
+	PosePool& operator=(const PosePool&) = delete;
+
+	glm::mat4* Acquire(size_t count)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_LiveMatrices += count;
+
+		auto freeList = m_FreeLists.find(count);
+		if (freeList != m_FreeLists.end() && !freeList->second.empty())
+		{
+			glm::mat4* data = freeList->second.back();
+			freeList->second.pop_back();
+			return data;
+		}
+
+		if (m_Pages.empty() || m_PageUsed + count > m_PageSize)
+		{
+			m_PageSize = count > m_PageMatrices ? count : m_PageMatrices;
+			m_Pages.emplace_back(new glm::mat4[m_PageSize]);
+			m_PageUsed = 0;
+			m_ReservedMatrices += m_PageSize;
+		}
+		glm::mat4* data = m_Pages.back().get() + m_PageUsed;
+		m_PageUsed += count;
+		return data;
+	}
+
+	void Release(glm::mat4* data, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_LiveMatrices -= count;
+		m_FreeLists[count].push_back(data);
+	}
+
+	// matrices handed out and matrices reserved in pages
+	size_t GetLiveMatrices()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_LiveMatrices;
+	}
+
+	size_t GetReservedMatrices()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_ReservedMatrices;
+	}
+
+	// pool shared by all animators that are not given one explicitly
+	static PosePool& Default()
+	{
+		static PosePool pool;
+		return pool;
+	}
+
+private:
+	std::mutex m_Mutex;
+	std::vector<std::unique_ptr<glm::mat4[]>> m_Pages;
+	std::map<size_t, std::vector<glm::mat4*>> m_FreeLists;
+	size_t m_PageMatrices;
+	size_t m_PageUsed;
+	size_t m_PageSize;
+	size_t m_LiveMatrices;
+	size_t m_ReservedMatrices;
+};
+
+// std allocator on top of a PosePool. Sizes are rounded up to whole matrices, so it also
+// works for the helper types some standard libraries rebind to (e.g. MSVC debug proxies).
+template<typename T>
+class PoseAllocator
+{
+public:
+	typedef T value_type;
+
+	PoseAllocator() : m_Pool(&PosePool::Default()) {}
+	explicit PoseAllocator(PosePool* pool) : m_Pool(pool ? pool : &PosePool::Default()) {}
+	template<typename U>
+	PoseAllocator(const PoseAllocator<U>& other) : m_Pool(other.GetPool()) {}
+
+	T* allocate(size_t n)
+	{
+		static_assert(alignof(T) <= alignof(glm::mat4), "PoseAllocator cannot align this type");
+		return reinterpret_cast<T*>(m_Pool->Acquire(Matrices(n)));
+	}
+
+	void deallocate(T* data, size_t n)
+	{
+		m_Pool->Release(reinterpret_cast<glm::mat4*>(data), Matrices(n));
+	}
+
+	PosePool* GetPool() const { return m_Pool; }
+
+	template<typename U>
+	bool operator==(const PoseAllocator<U>& other) const { return m_Pool == other.GetPool(); }
+	template<typename U>
+	bool operator!=(const PoseAllocator<U>& other) const { return m_Pool != other.GetPool(); }
+
+private:
+	PosePool* m_Pool;
+
+	static size_t Matrices(size_t n)
+	{
+		return (n * sizeof(T) + sizeof(glm::mat4) - 1) / sizeof(glm::mat4);
+	}
+};
+
+// pose / palette buffer type used by Animator and the passes that edit its pose
+typedef std::vector<glm::mat4, PoseAllocator<glm::mat4>> PoseBuffer;
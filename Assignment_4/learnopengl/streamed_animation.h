@@ -0,0 +1,478 @@
+#pragma once
+
+/* Streamed playback for long clips.
+   A clip is cooked once into a file of fixed-length key blocks (uniformly resampled
+   position/rotation/scale per track). At runtime only a sliding window of blocks around
+   the playback time is resident; upcoming blocks are read by a worker thread. If a block
+   is late the previous pose is held, the render thread never waits on disk.
+
+   File layout (native endianness):
+     StreamedClipHeader
+     trackCount x { uint32 nameLength, name bytes }
+     blockCount x uint64 block offsets
+     blockCount x { (samplesPerBlock + 1) x trackCount x StreamedKey }  (sample-major) */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/pose_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t STREAMED_CLIP_MAGIC = 0x50494C43; // "CLIP"
+const uint32_t STREAMED_CLIP_VERSION = 1;
+
+struct StreamedClipHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	float duration;        // ticks
+	float ticksPerSecond;
+	float ticksPerSample;
+	uint32_t samplesPerBlock;
+	uint32_t blockCount;
+	uint32_t trackCount;
+};
+
+struct StreamedKey
+{
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+struct StreamStats
+{
+	int blocksLoaded = 0;    // blocks read by the worker so far
+	int misses = 0;          // samples that held the previous pose because the block was not resident
+	size_t residentBytes = 0; // fixed size of the block window
+};
+
+class StreamedAnimation
+{
+public:
+	// aheadBlocks: how many blocks past the current one are prefetched
+	StreamedAnimation(const std::string& path, Animation* skeleton, int aheadBlocks = 2)
+		: m_Skeleton(skeleton)
+		, m_AheadBlocks(std::max(1, aheadBlocks))
+		, m_IsValid(false)
+		, m_Quit(false)
+		, m_CurrentBlock(-1)
+	{
+		std::memset(&m_Header, 0, sizeof(m_Header));
+		if (!skeleton || !skeleton->IsValid())
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: Skeleton is missing for '" << path << "'" << std::endl;
+			return;
+		}
+		if (!Open(path))
+			return;
+
+		// the window is the current block plus the prefetched ones, one extra slot lets the
+		// block behind stay readable while playback crosses a boundary
+		m_Slots.resize(m_AheadBlocks + 2);
+		m_Wanted.reserve(m_AheadBlocks + 2);
+		size_t blockKeys = static_cast<size_t>(m_Header.samplesPerBlock + 1) * m_Header.trackCount;
+		for (auto& slot : m_Slots)
+			slot.keys.resize(blockKeys);
+		m_Stats.residentBytes = m_Slots.size() * blockKeys * sizeof(StreamedKey);
+
+		// prime the first block synchronously so playback starts with a valid pose
+		m_Slots[0].block = 0;
+		m_Slots[0].state = SLOT_READY;
+		ReadBlock(m_File, 0, m_Slots[0].keys);
+		m_Stats.blocksLoaded = 1;
+
+		m_IsValid = true;
+		m_Worker = std::thread(&StreamedAnimation::WorkerLoop, this);
+	}
+
+	~StreamedAnimation()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WakeWorker.notify_all();
+		if (m_Worker.joinable())
+			m_Worker.join();
+	}
+
+	StreamedAnimation(const StreamedAnimation&) = delete;
+	StreamedAnimation& operator=(const StreamedAnimation&) = delete;
+
+	// resamples every bone track of a loaded clip into a block file
+	static bool Cook(const Animation& animation, const std::string& path,
+		float blockSeconds = 1.0f, float samplesPerSecond = 30.0f)
+	{
+		if (!animation.IsValid() || samplesPerSecond <= 0.0f || blockSeconds <= 0.0f)
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: Cannot cook '" << path << "' from an invalid clip" << std::endl;
+			return false;
+		}
+
+		const std::vector<Bone>& bones = animation.GetBones();
+		StreamedClipHeader header;
+		header.magic = STREAMED_CLIP_MAGIC;
+		header.version = STREAMED_CLIP_VERSION;
+		header.duration = animation.GetDuration();
+		header.ticksPerSecond = animation.GetTicksPerSecond();
+		header.ticksPerSample = header.ticksPerSecond / samplesPerSecond;
+		header.samplesPerBlock = std::max(1u, static_cast<uint32_t>(std::lround(blockSeconds * samplesPerSecond)));
+		uint32_t sampleCount = static_cast<uint32_t>(std::ceil(header.duration / header.ticksPerSample)) + 1;
+		header.blockCount = std::max(1u, (sampleCount - 1 + header.samplesPerBlock - 1) / header.samplesPerBlock);
+		header.trackCount = static_cast<uint32_t>(bones.size());
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: Cannot write '" << path << "'" << std::endl;
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const Bone& bone : bones)
+		{
+			uint32_t length = static_cast<uint32_t>(bone.m_Name.size());
+			file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			file.write(bone.m_Name.data(), length);
+		}
+
+		size_t blockKeys = static_cast<size_t>(header.samplesPerBlock + 1) * header.trackCount;
+		uint64_t offset = static_cast<uint64_t>(file.tellp()) + header.blockCount * sizeof(uint64_t);
+		for (uint32_t block = 0; block < header.blockCount; ++block)
+		{
+			file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+			offset += blockKeys * sizeof(StreamedKey);
+		}
+
+		// blocks overlap by one sample so interpolation never needs the next block
+		std::vector<StreamedKey> keys(blockKeys);
+		for (uint32_t block = 0; block < header.blockCount; ++block)
+		{
+			for (uint32_t sample = 0; sample <= header.samplesPerBlock; ++sample)
+			{
+				uint32_t global = std::min(block * header.samplesPerBlock + sample, sampleCount - 1);
+				float time = std::min(global * header.ticksPerSample, header.duration);
+				for (uint32_t track = 0; track < header.trackCount; ++track)
+				{
+					StreamedKey& key = keys[sample * header.trackCount + track];
+					const Bone& bone = bones[track];
+					key.position = SampleTrack(bone.m_Positions, time, glm::vec3(0.0f));
+					key.rotation = SampleRotation(bone.m_Rotations, time);
+					key.scale = SampleTrack(bone.m_Scales, time, glm::vec3(1.0f));
+				}
+			}
+			file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(StreamedKey));
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	// writes the local pose at `time` (ticks) for every flat node of the skeleton; also moves the
+	// resident window. Returns false (pose left untouched for streamed tracks) if the block is late.
+	// One window per instance, so animators sharing an instance must play it in lockstep: at
+	// different offsets each moves the window away from the others and they miss every frame.
+	// A crowd playing the clip at different times needs one StreamedAnimation per offset.
+	bool Sample(float time, PoseBuffer& localPose)
+	{
+		if (!m_IsValid)
+			return false;
+
+		float sample = std::max(0.0f, time / m_Header.ticksPerSample);
+		int block = std::min(static_cast<int>(sample) / static_cast<int>(m_Header.samplesPerBlock),
+			static_cast<int>(m_Header.blockCount) - 1);
+		float inBlock = std::min(sample - block * static_cast<float>(m_Header.samplesPerBlock),
+			static_cast<float>(m_Header.samplesPerBlock));
+		if (block != m_CurrentBlock)
+			MoveWindow(block);
+
+		const Slot* slot = FindReady(block);
+		if (!slot)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stats.misses++;
+			return false;
+		}
+
+		uint32_t s0 = std::min(static_cast<uint32_t>(inBlock), m_Header.samplesPerBlock - 1);
+		float factor = inBlock - s0;
+		const StreamedKey* k0 = &slot->keys[s0 * m_Header.trackCount];
+		const StreamedKey* k1 = k0 + m_Header.trackCount;
+
+		const std::vector<FlatNodeData>& nodes = m_Skeleton->GetFlatNodes();
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			int track = m_NodeTracks[i];
+			if (track < 0)
+			{
+				localPose[i] = nodes[i].transformation;
+				continue;
+			}
+			glm::vec3 position = glm::mix(k0[track].position, k1[track].position, factor);
+			glm::quat rotation = glm::normalize(glm::slerp(k0[track].rotation, k1[track].rotation, factor));
+			glm::vec3 scale = glm::mix(k0[track].scale, k1[track].scale, factor);
+			localPose[i] = glm::translate(glm::mat4(1.0f), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+		}
+		return true;
+	}
+
+	Animation* GetSkeleton() { return m_Skeleton; }
+	float GetDuration() const { return m_Header.duration; }
+	float GetTicksPerSecond() const { return m_Header.ticksPerSecond; }
+	int GetBlockCount() const { return static_cast<int>(m_Header.blockCount); }
+	bool IsValid() const { return m_IsValid; }
+
+	StreamStats GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Stats;
+	}
+
+private:
+	enum SlotState { SLOT_FREE, SLOT_REQUESTED, SLOT_LOADING, SLOT_READY };
+
+	struct Slot
+	{
+		int block = -1;
+		SlotState state = SLOT_FREE;
+		std::vector<StreamedKey> keys;
+	};
+
+	StreamedClipHeader m_Header;
+	std::vector<uint64_t> m_BlockOffsets;
+	std::vector<int> m_NodeTracks; // flat node -> track, -1 if the node is not animated
+	std::ifstream m_File;          // read only by the worker after construction
+	Animation* m_Skeleton;
+	int m_AheadBlocks;
+	bool m_IsValid;
+
+	std::vector<Slot> m_Slots;
+	std::vector<int> m_Wanted; // scratch for MoveWindow, reserved up front
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeWorker;
+	std::thread m_Worker;
+	bool m_Quit;
+	int m_CurrentBlock;
+	StreamStats m_Stats;
+
+	bool Open(const std::string& path)
+	{
+		m_File.open(path, std::ios::binary);
+		if (!m_File)
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: Cannot open '" << path << "'" << std::endl;
+			return false;
+		}
+		m_File.read(reinterpret_cast<char*>(&m_Header), sizeof(m_Header));
+		if (!m_File || m_Header.magic != STREAMED_CLIP_MAGIC || m_Header.version != STREAMED_CLIP_VERSION
+			|| m_Header.samplesPerBlock == 0 || m_Header.blockCount == 0 || m_Header.ticksPerSample <= 0.0f)
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: '" << path << "' is not a cooked clip (or has an old version)" << std::endl;
+			return false;
+		}
+
+		const std::vector<FlatNodeData>& nodes = m_Skeleton->GetFlatNodes();
+		m_NodeTracks.assign(nodes.size(), -1);
+		for (uint32_t track = 0; track < m_Header.trackCount; ++track)
+		{
+			uint32_t length = 0;
+			m_File.read(reinterpret_cast<char*>(&length), sizeof(length));
+			std::string name(length, '\0');
+			m_File.read(&name[0], length);
+			int node = m_Skeleton->FindNodeIndex(name);
+			if (node >= 0)
+				m_NodeTracks[node] = static_cast<int>(track);
+		}
+
+		m_BlockOffsets.resize(m_Header.blockCount);
+		m_File.read(reinterpret_cast<char*>(m_BlockOffsets.data()), m_BlockOffsets.size() * sizeof(uint64_t));
+		if (!m_File)
+		{
+			std::cerr << "ERROR::STREAMED_CLIP:: '" << path << "' is truncated" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadBlock(std::ifstream& file, int block, std::vector<StreamedKey>& keys)
+	{
+		file.clear();
+		file.seekg(static_cast<std::streamoff>(m_BlockOffsets[block]));
+		file.read(reinterpret_cast<char*>(keys.data()), keys.size() * sizeof(StreamedKey));
+		return static_cast<bool>(file);
+	}
+
+	const Slot* FindReady(int block)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const Slot& slot : m_Slots)
+			if (slot.block == block && slot.state == SLOT_READY)
+				return &slot;
+		return NULL;
+	}
+
+	// keeps [block - 1, block + ahead] (wrapping, clips loop) and queues missing blocks
+	void MoveWindow(int block)
+	{
+		int count = static_cast<int>(m_Header.blockCount);
+		std::vector<int>& wanted = m_Wanted;
+		wanted.clear();
+		for (int i = -1; i <= m_AheadBlocks; ++i)
+		{
+			int b = ((block + i) % count + count) % count;
+			if (std::find(wanted.begin(), wanted.end(), b) == wanted.end())
+				wanted.push_back(b);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_CurrentBlock = block;
+			// free everything outside the window, a slot being read is released by the worker
+			for (Slot& slot : m_Slots)
+			{
+				bool keep = std::find(wanted.begin(), wanted.end(), slot.block) != wanted.end();
+				if (!keep && slot.state != SLOT_LOADING)
+				{
+					slot.state = SLOT_FREE;
+					slot.block = -1;
+				}
+			}
+			// request in playback order, the block behind is never fetched again
+			for (size_t i = 1; i < wanted.size(); ++i)
+			{
+				int b = wanted[i];
+				bool present = false;
+				for (const Slot& slot : m_Slots)
+					present = present || slot.block == b;
+				if (present)
+					continue;
+				for (Slot& slot : m_Slots)
+				{
+					if (slot.state == SLOT_FREE)
+					{
+						slot.block = b;
+						slot.state = SLOT_REQUESTED;
+						break;
+					}
+				}
+			}
+		}
+		m_WakeWorker.notify_one();
+	}
+
+	void WorkerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (true)
+		{
+			m_WakeWorker.wait(lock, [this]() { return m_Quit || NextRequest() != NULL; });
+			if (m_Quit)
+				return;
+
+			Slot* slot = NextRequest();
+			int block = slot->block;
+			slot->state = SLOT_LOADING;
+
+			lock.unlock();
+			bool ok = ReadBlock(m_File, block, slot->keys);
+			lock.lock();
+
+			if (!ok)
+				std::cerr << "ERROR::STREAMED_CLIP:: Failed to read block " << block << std::endl;
+			// the window may have moved on while the block was read
+			bool stillWanted = ok && m_CurrentBlock >= 0 && InWindow(block);
+			slot->state = stillWanted ? SLOT_READY : SLOT_FREE;
+			if (!stillWanted)
+				slot->block = -1;
+			if (ok)
+				m_Stats.blocksLoaded++;
+		}
+	}
+
+	// nearest requested block first (caller holds the lock)
+	Slot* NextRequest()
+	{
+		Slot* best = NULL;
+		int bestDistance = 0;
+		int count = static_cast<int>(m_Header.blockCount);
+		for (Slot& slot : m_Slots)
+		{
+			if (slot.state != SLOT_REQUESTED)
+				continue;
+			int distance = ((slot.block - m_CurrentBlock) % count + count) % count;
+			if (!best || distance < bestDistance)
+			{
+				best = &slot;
+				bestDistance = distance;
+			}
+		}
+		return best;
+	}
+
+	bool InWindow(int block) const
+	{
+		int count = static_cast<int>(m_Header.blockCount);
+		int distance = ((block - m_CurrentBlock) % count + count) % count;
+		return distance <= m_AheadBlocks || distance == count - 1;
+	}
+
+	template<typename Key>
+	static const Key* FindKeys(const std::vector<Key>& keys, float time, float& factor)
+	{
+		// clamps outside the key range instead of extrapolating
+		if (keys.size() == 1 || time <= keys.front().timeStamp)
+		{
+			factor = 0.0f;
+			return &keys.front();
+		}
+		if (time >= keys.back().timeStamp)
+		{
+			factor = 0.0f;
+			return &keys.back();
+		}
+		// binary search: Cook samples every track at every sample, so a scan would be
+		// quadratic in the keys of a long clip
+		size_t index = std::upper_bound(keys.begin(), keys.end(), time,
+			[](float t, const Key& key) { return t < key.timeStamp; }) - keys.begin() - 1;
+		float span = keys[index + 1].timeStamp - keys[index].timeStamp;
+		factor = span > 0.0f ? (time - keys[index].timeStamp) / span : 0.0f;
+		return &keys[index];
+	}
+
+	template<typename Key>
+	static glm::vec3 SampleTrack(const std::vector<Key>& keys, float time, const glm::vec3& fallback)
+	{
+		if (keys.empty())
+			return fallback;
+		float factor;
+		const Key* key = FindKeys(keys, time, factor);
+		if (factor == 0.0f)
+			return Value(*key);
+		return glm::mix(Value(key[0]), Value(key[1]), factor);
+	}
+
+	static glm::quat SampleRotation(const std::vector<KeyRotation>& keys, float time)
+	{
+		if (keys.empty())
+			return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		float factor;
+		const KeyRotation* key = FindKeys(keys, time, factor);
+		if (factor == 0.0f)
+			return glm::normalize(key->orientation);
+		return glm::normalize(glm::slerp(key[0].orientation, key[1].orientation, factor));
+	}
+
+	static glm::vec3 Value(const KeyPosition& key) { return key.position; }
+	static glm::vec3 Value(const KeyScale& key) { return key.scale; }
+};
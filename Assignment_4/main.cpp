@@ -20,8 +20,14 @@
 
 #include <learnopengl/animator.h>
 
+#include <learnopengl/animator_manager.h>
+
 #include <learnopengl/model_animation.h>
 
+#include "texture_loader.hpp"
+
+#include "texture_streamer.hpp"
+
 
 
 
@@ -216,7 +222,9 @@ int main()
 
 	// Resources are in build/Assignment_4/resources/, but executable runs from Debug/
 	// Use relative paths going up one level
-	Model ourModel("../resources/objects/mixamo/Ch34_nonPBR.dae");
+	// packed vertices (36 instead of 88 bytes each); anim_model.vs decodes them. The 2K maps
+	// stream in by mip level as the character's size on screen asks for them
+	Model ourModel("../resources/objects/mixamo/Ch34_nonPBR.dae", false, 0, Common::VertexFormat::compact(), true);
 
 	Animation idleAnimation("../resources/objects/mixamo/Idle.dae", &ourModel);
 
@@ -232,6 +240,18 @@ int main()
 
 	Animator animator(&idleAnimation);
 
+	// evaluates skeletons under a per-frame CPU budget (matters once there are crowds)
+	AnimatorManager animatorManager;
+
+	int characterHandle = animatorManager.Add(&animator);
+
+	// uniform names are built once instead of per bone per frame
+	std::vector<std::string> boneUniformNames;
+
+	for (size_t i = 0; i < animator.GetFinalBoneMatrices().size(); ++i)
+
+		boneUniformNames.push_back("finalBonesMatrices[" + std::to_string(i) + "]");
+
 	// enum AnimState charState = IDLE;
 
 	// float blendAmount = 0.0f;
@@ -272,6 +292,12 @@ int main()
 
 		processInput(window);
 
+		// textures decoded since the last frame replace their placeholders
+
+		Common::TextureLoader::shared().uploadCompleted(4);
+
+		Common::TextureStreamer::shared().update();
+
 		if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) 
 
 			animator.PlayAnimation(&idleAnimation, NULL, 0.0f, 0.0f, 0.0f);
@@ -518,7 +544,9 @@ int main()
 
 
 
-		animator.UpdateAnimation(deltaTime);
+		animatorManager.SetView(characterHandle, true, glm::length(camera.Position - glm::vec3(0.0f, -0.4f, 0.0f)));
+
+		animatorManager.Update(deltaTime);
 
 		
 
@@ -550,11 +578,11 @@ int main()
 
 
 
-        auto transforms = animator.GetFinalBoneMatrices();
+        const PoseBuffer& transforms = animator.GetFinalBoneMatrices();
 
-		for (int i = 0; i < transforms.size(); ++i)
+		for (size_t i = 0; i < transforms.size(); ++i)
 
-			ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+			ourShader.setMat4(boneUniformNames[i], transforms[i]);
 
 
 
@@ -570,6 +598,11 @@ int main()
 
 		ourShader.setMat4("model", model);
 
+		const float projectionScale = Common::lodProjectionScale(glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+
+		ourModel.RequestTextures(Common::projectedSize(ourModel.GetBoundingRadius() * 0.5f,
+		                                               glm::length(camera.Position - glm::vec3(0.0f, -0.4f, 0.0f)), projectionScale));
+
 		ourModel.Draw(ourShader);
 
 
@@ -6,7 +6,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "upload_context.hpp"
+
 #include <iostream>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -17,12 +20,17 @@ namespace Common {
     public:
         GLFWwindow* window;
         int width, height;
+        // Shared context on a loader thread, if requested and available (upload_context.hpp)
+        std::unique_ptr<UploadContext> uploads;
         
-        Window(int width = 800, int height = 600, const char* title = "MyOpenGLBook");
+        // uploadThread: also create an UploadContext, so textures and meshes loaded
+        // afterwards are uploaded beside the render loop
+        Window(int width = 800, int height = 600, const char* title = "MyOpenGLBook", bool uploadThread = false);
         ~Window();
         
         bool shouldClose();
         void swapBuffers();
+        // Also hands finished background uploads back to the render thread
         void pollEvents();
         void processInput();
         
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "texture_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Common {
+    // Block-compressed (BCn / S3TC) textures from DDS and KTX files. The blocks are uploaded
+    // as they are with glCompressedTexImage2D, prebuilt mip chain included; a format the
+    // GL does not expose is decoded to RGBA8 on the CPU instead.
+
+    enum class BlockFormat : uint32_t {
+        BC1,  // DXT1: RGB + 1-bit alpha, 8 bytes per 4x4 block
+        BC2,  // DXT3: RGB + explicit 4-bit alpha, 16 bytes
+        BC3,  // DXT5: RGB + interpolated alpha, 16 bytes
+        BC4,  // one channel (red), 8 bytes
+        BC5,  // two channels (red, green), 16 bytes; normal maps
+        BC7   // high quality RGBA, 16 bytes
+    };
+
+    size_t blockBytes(BlockFormat format);
+    // GL internal format (linear, not sRGB, like the stb_image path)
+    unsigned int blockGLFormat(BlockFormat format);
+    // Bytes of one level of the given size
+    size_t compressedLevelSize(BlockFormat format, int width, int height);
+    // Block format of a GL compressed internal format (sRGB variants included)
+    bool blockFormatFromGL(unsigned int glFormat, BlockFormat& format);
+
+    // BC7 two-subset partitions (bit i set: texel i is in subset 1) and the texel of subset 1
+    // whose index is stored without its top bit; shared by the decoder and the encoder
+    extern const uint16_t BC7_PARTITIONS_2[64];
+    extern const unsigned char BC7_ANCHORS_2[64];
+
+    // Decodes a width x height level of blocks to RGBA8, rows top to bottom as stored.
+    // Channels a format lacks read as 0 (colour) and 255 (alpha).
+    void decodeBlocks(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
+
+    // GL thread, with a context current: records which formats the driver takes, for the
+    // worker-thread loaders below. Until it has run every format is decoded on the CPU.
+    void detectCompressedTextureSupport();
+    bool compressedFormatSupported(BlockFormat format);
+
+    // .dds or .ktx (case-insensitive)
+    bool isCompressedTextureFile(const std::string& path);
+
+    // Worker thread: reads a DDS (DXT1/3/5, ATI1/2, BC4/5, DX10 BC1-5/7, uncompressed 32-bit)
+    // or KTX 1 file into image, level by level. flipVertically turns the stored top-down
+    // rows into GL's bottom-up order: BC1-5 blocks are flipped in place, BC7 (whose blocks
+    // cannot be) is decoded and flipped on the CPU, as is any level with a partial block row.
+    bool loadCompressedTexture(const std::string& path, DecodedImage& image, bool flipVertically = true);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Common {
+    // What drawing a material sets on one shader program, resolved once: the names of its
+    // samplers and constant uniforms are looked up when the table is built, so apply() is
+    // only glUniform / glBindTexture calls on stored locations. Names the program does not
+    // use are dropped at build time.
+    class MaterialBinding {
+    public:
+        explicit MaterialBinding(unsigned int program = 0);
+
+        unsigned int program() const { return programId; }
+
+        // the named sampler reads texture unit `unit`
+        void addSampler(const char* name, int unit);
+        // ... and texture (a target such as GL_TEXTURE_2D) is bound to that unit; the binding
+        // is kept even when the program lacks the sampler, so units stay as the material says
+        void addTexture(const char* name, int unit, unsigned int target, unsigned int texture);
+
+        // constant uniforms, set on every apply()
+        void setInt(const char* name, int value);
+        void setVec3(const char* name, const float* value);
+
+        // GL thread, with program() in use
+        void apply() const;
+
+    private:
+        struct TextureBinding {
+            int location;   // -1: bind only
+            int unit;
+            unsigned int target;
+            unsigned int texture;
+        };
+        struct Constant {
+            int location;
+            int components;  // 1: int, 3: vec3
+            int intValue;
+            float floatValues[3];
+        };
+
+        unsigned int programId;
+        std::vector<TextureBinding> textures;
+        std::vector<Constant> constants;
+    };
+
+    // The binding tables of one material, one per shader program it is drawn with
+    class MaterialBindings {
+    public:
+        // table for program, built by build(MaterialBinding&) the first time program is seen.
+        // A program id reused after glDeleteProgram needs clear() first
+        template <typename Build>
+        const MaterialBinding& get(unsigned int program, Build build) {
+            for (const MaterialBinding& table : tables) {
+                if (table.program() == program) {
+                    return table;
+                }
+            }
+            tables.emplace_back(program);
+            build(tables.back());
+            return tables.back();
+        }
+
+        // the material changed: tables are rebuilt on their next get()
+        void clear() { tables.clear(); }
+        size_t size() const { return tables.size(); }
+
+    private:
+        std::vector<MaterialBinding> tables;
+    };
+}
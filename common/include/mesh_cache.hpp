@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Common {
+    // Cooked mesh file: GPU-ready vertex and index buffers plus the tables needed to draw
+    // them, written by the importers and uploaded without parsing.
+    //
+    // layout: header | attributes | vertex data | index data | submeshes | lods | strings | extra
+    // Vertex and index data start on 16-byte boundaries. A cooked file is a cache entry:
+    // it is valid for a source only while sourceHash and settingsHash both match. The
+    // source's size and modification time are recorded too, so that an untouched source
+    // need not be hashed again (hashSourceFile).
+    const uint32_t COOKED_MESH_MAGIC = 0x48534D43; // "CMSH"
+    const uint32_t COOKED_MESH_VERSION = 4;
+
+    struct CookedMeshHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;     // hash of the source file the mesh was cooked from
+        uint64_t settingsHash;   // hash of the import settings
+        uint32_t vertexStride;
+        uint32_t attributeCount;
+        uint32_t indexSize;      // bytes per index, 2 or 4
+        uint32_t subMeshCount;
+        uint32_t materialCount;  // material names (usemtl / aiMaterial)
+        uint32_t libraryCount;   // material libraries (mtllib)
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t attributeOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t subMeshOffset;
+        uint64_t stringOffset;   // material names then libraries, each uint32 length + bytes
+        uint64_t extraOffset;    // importer-specific blob (e.g. the Assimp bone table)
+        uint64_t extraBytes;
+        uint32_t lodCount;       // 0: all submeshes are one level
+        uint32_t reserved;
+        uint64_t lodOffset;
+        uint64_t sourceSize;     // FileStamp of the source when sourceHash was taken
+        uint64_t sourceTime;
+    };
+
+    // One glVertexAttribPointer call. glType is the GL enum value (0x1406 = GL_FLOAT).
+    struct CookedAttribute {
+        uint32_t location;
+        uint32_t components;
+        uint32_t glType;
+        uint32_t normalized;
+        uint32_t offset;
+    };
+
+    // Index range drawn with one material. Indices are relative to baseVertex.
+    struct CookedSubMesh {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        uint32_t material;       // index into the material names, ~0u for none
+        uint32_t baseVertex;
+    };
+
+    // Level of detail: a run of submeshes (same count and materials as LOD 0) drawing a
+    // simplified index buffer over the shared vertices. error is object-space distance.
+    struct CookedLod {
+        uint32_t firstSubMesh;
+        uint32_t subMeshCount;
+        float error;
+        uint32_t reserved;
+    };
+
+    // 64-bit safe seek (plain fseek takes a 32-bit long on Windows)
+    bool seekFile(std::FILE* file, uint64_t offset);
+
+    // 64-bit content hash (XXH64). Streaming so multi-gigabyte sources hash in bounded memory.
+    class Hasher64 {
+    public:
+        explicit Hasher64(uint64_t seed = 0);
+        void update(const void* data, size_t size);
+        uint64_t digest() const;
+
+    private:
+        uint64_t lanes[4];
+        uint64_t totalBytes;
+        unsigned char buffer[32];
+        size_t buffered;
+        uint64_t seed;
+    };
+
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+    // hash of a file's contents; false if it cannot be read
+    bool hashFile(const std::string& path, uint64_t& hash);
+
+    // Size and modification time of a file; equal stamps stand in for equal contents
+    struct FileStamp {
+        uint64_t size = 0;
+        uint64_t time = 0;   // 0: no stamp
+    };
+    // false if the file does not exist
+    bool statFile(const std::string& path, FileStamp& stamp);
+
+    // Hash of source for checking the cooked mesh at cookedPath against it: the sourceHash
+    // recorded in that file when source still has the stamp recorded with it, so a warm
+    // start reads a header instead of the whole source; hashFile otherwise (and a hash that
+    // turns out unchanged refreshes the recorded stamp). stamp receives source's, for
+    // CookedMeshWriter::setSourceStamp. False if source cannot be read.
+    bool hashSourceFile(const std::string& source, const std::string& cookedPath, uint64_t& hash, FileStamp& stamp);
+
+    // Streams a cooked mesh to disk: vertices first, then indices, then the tables.
+    // The header is written last, so a file that was not finished never validates.
+    class CookedMeshWriter {
+    public:
+        CookedMeshWriter();
+        ~CookedMeshWriter();
+
+        // indexSize 2 stores 16-bit indices (every index must be below 65536)
+        bool open(const std::string& path, uint32_t vertexStride, const std::vector<CookedAttribute>& attributes,
+                  uint32_t indexSize = sizeof(uint32_t));
+        void appendVertices(const void* data, uint64_t count);
+        void appendIndices(const uint32_t* data, uint64_t count);
+        bool finish(const std::vector<CookedSubMesh>& subMeshes, const std::vector<std::string>& materials,
+                    const std::vector<std::string>& libraries, const float boundsMin[3], const float boundsMax[3],
+                    uint64_t sourceHash = 0, uint64_t settingsHash = 0);
+        // optional importer-specific blob, written by finish()
+        void setExtraData(const void* data, size_t bytes);
+        // optional level table over the submeshes passed to finish()
+        void setLods(const std::vector<CookedLod>& lods) { this->lods = lods; }
+        // optional, after open(): the stamp of the source sourceHash was taken from
+        void setSourceStamp(const FileStamp& stamp) {
+            header.sourceSize = stamp.size;
+            header.sourceTime = stamp.time;
+        }
+        // closes and deletes an unfinished file
+        void abandon();
+
+        uint64_t vertexCount() const { return header.vertexCount; }
+        uint64_t indexCount() const { return header.indexCount; }
+
+    private:
+        std::FILE* file;
+        std::string path;
+        CookedMeshHeader header;
+        std::vector<CookedAttribute> attributes;
+        std::vector<unsigned char> extra;
+        std::vector<CookedLod> lods;
+        bool failed;
+
+        void write(const void* data, uint64_t bytes);
+        void padTo16();
+    };
+
+    // Header and tables of a cooked mesh. The file is memory-mapped where the platform
+    // allows, so vertex and index data can go to glBufferData without a copy; otherwise
+    // they are read on demand.
+    class CookedMeshFile {
+    public:
+        CookedMeshHeader header;
+        std::vector<CookedAttribute> attributes;
+        std::vector<CookedSubMesh> subMeshes;
+        std::vector<std::string> materials;
+        std::vector<std::string> libraries;
+        std::vector<unsigned char> extra;
+        std::vector<CookedLod> lods;     // empty: one level made of all submeshes
+
+        CookedMeshFile();
+        ~CookedMeshFile();
+
+        CookedMeshFile(const CookedMeshFile&) = delete;
+        CookedMeshFile& operator=(const CookedMeshFile&) = delete;
+
+        // Validates magic, version and section bounds. Prints why and returns false otherwise.
+        bool open(const std::string& path);
+        void close();
+
+        // true if the file was cooked from this source with these settings
+        bool matches(uint64_t sourceHash, uint64_t settingsHash) const {
+            return header.sourceHash == sourceHash && header.settingsHash == settingsHash;
+        }
+
+        // mapped vertex / index sections, nullptr if the file could not be mapped
+        const void* vertexData() const { return mapping ? mapping + header.vertexOffset : nullptr; }
+        const void* indexData() const { return mapping ? mapping + header.indexOffset : nullptr; }
+
+        // byte ranges relative to the vertex / index sections
+        bool readVertexBytes(uint64_t offset, uint64_t bytes, void* out);
+        bool readIndexBytes(uint64_t offset, uint64_t bytes, void* out);
+
+    private:
+        std::FILE* file;
+        uint64_t fileSize;
+        const unsigned char* mapping;
+        void* mappingHandle;     // Windows file mapping object
+
+        bool readAt(uint64_t offset, uint64_t bytes, void* out);
+        void mapFile(const std::string& path);
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // Import-time triangle and vertex reordering, shared by the OBJ and Assimp loaders.
+    // Operates on plain 32-bit triangle lists and interleaved vertex buffers.
+
+    // Post-transform cache efficiency of an index buffer on a FIFO cache.
+    struct VertexCacheStats {
+        size_t triangles = 0;
+        size_t transforms = 0;   // vertex shader invocations (cache misses)
+        float acmr = 0.0f;       // transforms per triangle: 3 worst, ~0.5 ideal
+        float atvr = 0.0f;       // transforms per referenced vertex: 1 ideal
+    };
+
+    // Contiguous run of indices that must stay together (one submesh).
+    struct IndexRange {
+        size_t offset;
+        size_t count;
+    };
+
+    struct MeshOptimizationStats {
+        VertexCacheStats before;
+        VertexCacheStats after;
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;  // unreferenced vertices are dropped
+        double seconds = 0.0;
+    };
+
+    VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                        unsigned cacheSize = 32);
+
+    // Tipsify (Sander et al. 2007): reorders triangles for a FIFO cache of cacheSize.
+    // If clusters is given it receives the first triangle of every run that started
+    // after a dead end; those are the hard boundaries optimizeOverdraw may reorder at.
+    void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                             unsigned cacheSize = 16, std::vector<uint32_t>* clusters = nullptr);
+
+    // Splits the Tipsify clusters further while their cache efficiency stays within
+    // threshold of the whole cluster, then orders clusters outside-in (most outward
+    // facing first) so near surfaces tend to draw before the ones they hide.
+    // positions points at the first vertex's float3 position, positionStride in bytes.
+    void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                          const float* positions, size_t positionStride, size_t vertexCount,
+                          const std::vector<uint32_t>& clusters, unsigned cacheSize = 16, float threshold = 1.05f);
+
+    // Renumbers vertices in first-use order and rewrites the vertex buffer to match, so
+    // fetches walk memory forwards. Returns the new vertex count.
+    size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+                               uint32_t* indices, size_t indexCount);
+
+    // All three passes: cache and overdraw order inside every range (ranges keep their
+    // offsets and sizes), then one vertex fetch pass over the whole buffer. An empty
+    // range list treats the index buffer as one range. The caller shrinks its vertex
+    // array to stats.verticesAfter.
+    MeshOptimizationStats optimizeMesh(void* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset,
+                                       uint32_t* indices, size_t indexCount,
+                                       const std::vector<IndexRange>& ranges = std::vector<IndexRange>());
+}
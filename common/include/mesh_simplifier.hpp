@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mesh_optimizer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // Quadric-error edge collapse (Garland & Heckbert) that only moves vertices onto
+    // existing neighbours, so every LOD indexes the original vertex buffer.
+    //
+    // UV / normal seams (one position split into two vertices) only collapse along the
+    // seam, both sides together; open borders only collapse along the border. Vertices
+    // where more than two attribute sets meet are never moved.
+    //
+    // Writes at most indexCount indices to destination and returns how many it wrote.
+    // Stops at targetIndexCount or when the next collapse would move the surface by more
+    // than targetError (object-space distance); resultError receives the largest error.
+    size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                        const float* positions, size_t positionStride, size_t vertexCount,
+                        size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+    // One level of detail: index ranges (one per submesh, same order as LOD 0) and the
+    // largest object-space distance between it and LOD 0.
+    struct LodLevel {
+        std::vector<IndexRange> ranges;
+        float error = 0.0f;
+    };
+
+    // Appends up to lodCount simplified levels to indices, each with about half the
+    // triangles of the one before, vertex-cache ordered. lods[0] is the input itself.
+    // Stops early once a level no longer gets meaningfully smaller.
+    void generateLodChain(std::vector<uint32_t>& indices, const std::vector<IndexRange>& baseRanges,
+                          const float* positions, size_t positionStride, size_t vertexCount,
+                          unsigned lodCount, std::vector<LodLevel>& lods);
+
+    // Pixels per object-space unit at distance 1 for a perspective projection.
+    float lodProjectionScale(float fovY, float viewportHeight);
+
+    // Coarsest level whose error, projected at `distance`, stays within maxPixelError.
+    unsigned selectLod(const float* lodErrors, size_t lodCount, float distance, float projectionScale,
+                       float maxPixelError);
+}
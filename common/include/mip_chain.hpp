@@ -0,0 +1,19 @@
+#pragma once
+
+#include "texture_loader.hpp"
+
+namespace Common {
+    // Turns a 1-, 3- or 4-component image without levels into RGBA8 (grey fills R, G and B;
+    // alpha is 255 where there was none). The pixels are reallocated with malloc.
+    bool expandToRGBA8(DecodedImage& image);
+
+    enum class MipFilter {
+        Box,     // 2x2 average, what glGenerateMipmap does
+        Kaiser   // Kaiser-windowed sinc: keeps distant mips sharper, for offline cooking
+    };
+
+    // Appends the full mip chain to an RGBA8 image without levels: each level halves the
+    // previous one (rounding down, at least 1). The box filter folds the last row or column
+    // of an odd size into its neighbour. Fills image.levels; level 0 is unchanged.
+    bool generateMipChain(DecodedImage& image, MipFilter filter = MipFilter::Box);
+}
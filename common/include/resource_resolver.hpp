@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+    // Index of the files under a few asset directories, built by scanning each directory
+    // once. Lookups are a hash probe on a normalized key (lower case, '/' separators,
+    // "." and "dir/.." folded), so they make no filesystem calls and match the way
+    // Windows-authored assets spell paths ("Textures\Foo.PNG" finds textures/foo.png).
+    //
+    // Each file is indexed both under its path as scanned ("../resource/car/a.png") and,
+    // when the directory was mounted with an alias, under the alias ("resource/car/a.png").
+    // Earlier mounts win when two provide the same key.
+    class ResourceResolver {
+    public:
+        // Scans directory recursively. alias, if not empty, is the virtual name of its root.
+        // Returns false if it is not a readable directory; mounting a directory that is
+        // already mounted, or inside one that is, is a no-op.
+        bool mount(const std::string& directory, const std::string& alias = "");
+        // true if path lies under a mounted directory, i.e. find() can answer for it
+        bool covers(const std::string& path) const;
+
+        // On-disk path of the file, or "" if it is not in the index
+        std::string find(const std::string& path) const;
+        // First candidate that is indexed, or "" if none is
+        std::string findFirst(const std::vector<std::string>& candidates) const;
+
+        // Remembers a path that could not be resolved, and who wanted it, for the report
+        void noteUnresolved(const std::string& path, const std::string& requestedBy);
+        // Prints every path noted since the last report in one block, then forgets them.
+        // Prints nothing if all resolved.
+        void reportUnresolved();
+
+        size_t fileCount() const;
+
+        // Lower case, '/' separated, without "." / "dir/.." components or a trailing '/'
+        static std::string normalize(const std::string& path);
+
+        // Process-wide index used by the model loaders
+        static ResourceResolver& shared();
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::string> files;  // normalized key -> on-disk path
+        std::vector<std::string> roots;                        // normalized mounted directories and aliases
+        std::vector<std::pair<std::string, std::string>> unresolved;  // path, requested by
+
+        bool coversLocked(const std::string& key) const;
+    };
+}
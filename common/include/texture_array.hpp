@@ -0,0 +1,85 @@
+#pragma once
+
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+    // Where an image ended up: one layer of a GL_TEXTURE_2D_ARRAY page
+    struct TextureLayer {
+        unsigned int page = 0;   // 0: the image could not be read
+        int layer = 0;
+    };
+
+    // Material batching. Images of the same format, size and mip count are packed as the
+    // layers of GL_TEXTURE_2D_ARRAY pages, so draws that differ only in their textures bind
+    // nothing in between: the shader gets a layer index instead (per draw, or per instance
+    // from an instanced attribute). Images without a mip chain get a box-filtered one.
+    class TextureArrayPages {
+    public:
+        explicit TextureArrayPages(ThreadPool& pool = ThreadPool::shared());
+
+        TextureArrayPages(const TextureArrayPages&) = delete;
+        TextureArrayPages& operator=(const TextureArrayPages&) = delete;
+
+        // Queues an image for the next build(); a path queued again (by its normalized
+        // spelling) with a decoder of the same key shares the first one's layer. Returns the
+        // index for layer().
+        size_t add(const std::string& path, const ImageDecoder& decoder);
+
+        // GL thread: decodes the images queued since the last build on the pool and uploads
+        // them into new pages of at most maxLayers layers (and GL_MAX_ARRAY_TEXTURE_LAYERS).
+        // Waits for the decodes, which cook the images on a cold start (cookingDecoder):
+        // seconds for a model with many large textures. buildAsync() does not wait.
+        void build(int maxLayers = 64);
+        // GL thread: starts decoding the images queued since the last build and returns at
+        // once; their layers stay unbuilt (page 0) until uploadCompleted() makes the pages.
+        // Does nothing while an earlier build is still decoding.
+        void buildAsync(int maxLayers = 64);
+        // GL thread, typically once per frame: makes the pages of a buildAsync() whose
+        // decodes have all finished. True when it did, so that layers can be fetched again.
+        bool uploadCompleted();
+        // GL thread: waits for a buildAsync() and makes its pages
+        void finish();
+        bool pending() const { return decoding != nullptr; }
+
+        TextureLayer layer(size_t index) const;
+        const std::vector<unsigned int>& pages() const { return pageTextures; }
+
+        // GL thread: deletes every page; layers handed out before are invalid afterwards
+        void clear();
+
+    private:
+        struct Image {
+            std::string path;
+            ImageDecodeFunction decode;
+            TextureLayer layer;
+        };
+
+        // images[first, first + decoded.size()) on their way to the pool; the tasks share it,
+        // so clear() can drop it while they run
+        struct Build {
+            size_t first = 0;
+            int maxLayers = 0;
+            std::vector<DecodedImage> decoded;
+            std::vector<char> ok;
+            ~Build();
+        };
+
+        ThreadPool& pool;
+        std::vector<Image> images;
+        std::unordered_map<std::string, size_t> byPath;
+        size_t built = 0;  // images[0, built) have their layer
+        std::vector<unsigned int> pageTextures;
+        std::shared_ptr<Build> decoding;
+        std::vector<std::future<void>> decodeTasks;
+
+        void uploadPages(Build& build);
+    };
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "mip_chain.hpp"
+#include "texture_compressor.hpp"
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Common {
+    // Cooked texture file: every mip level of a texture in the form glCompressedTexImage2D
+    // (or, uncompressed, glTexImage2D) takes it, written at import so later launches
+    // neither decode nor mipmap. It is mapped at load and its levels uploaded as they are.
+    //
+    // layout: header | level table | level data (each level on a 16-byte boundary)
+    // Like a cooked mesh it is a cache entry, valid for a source only while sourceHash and
+    // settingsHash both match.
+    const uint32_t COOKED_TEXTURE_MAGIC = 0x58455443; // "CTEX"
+    const uint32_t COOKED_TEXTURE_VERSION = 1;
+
+    struct CookedTextureHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;     // hash of the image file the texture was cooked from
+        uint64_t settingsHash;   // hash of the TextureCookSettings
+        uint32_t glFormat;       // GL compressed internal format of the blocks, 0 for RGBA8
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint64_t levelOffset;    // the level table
+    };
+
+    struct CookedTextureLevel {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    enum class CookedTextureFormat {
+        Auto,   // BC1 when every texel is opaque, BC3 otherwise
+        BC1,
+        BC3,
+        BC7,
+        RGBA8   // decoded texels: no compression artefacts, four times the size of BC3
+    };
+
+    struct TextureCookSettings {
+        // cook images at import; off loads the source image itself
+        bool enabled = true;
+        CookedTextureFormat format = CookedTextureFormat::Auto;
+        TextureCompressionPreset preset = TextureCompressionPreset::Balanced;
+        MipFilter mipFilter = MipFilter::Kaiser;
+        // flip the rows at cook time, for a decode that does not flip itself
+        bool flipVertically = false;
+
+        uint64_t hash() const;
+    };
+
+    // <source>.ctex, beside the image like <model>.cmesh
+    std::string cookedTexturePath(const std::string& source);
+
+    // Returns the cooked file for the image at source, cooking it first unless a matching
+    // one exists. decode reads the source (and applies the caller's flip); the mip chain is
+    // built from that and each level encoded on pool, which must not be the pool this runs
+    // on. "" if the source cannot be read or the file not written, or for DDS / KTX
+    // sources, which are compressed already; load the source then. Any thread: an offline
+    // cook step calls it directly, model loads go through cookingDecoder.
+    std::string cookTexture(const std::string& source, ImageDecodeFunction decode,
+                            const TextureCookSettings& settings = TextureCookSettings(),
+                            ThreadPool& pool = ThreadPool::shared());
+
+    // The cooked file for source if one matching the source and settings exists, "" otherwise;
+    // never cooks
+    std::string findCookedTexture(const std::string& source, const TextureCookSettings& settings = TextureCookSettings());
+
+    // Worker-thread decode for the image files themselves: loads <source>.ctex as
+    // loadCookedTexture does, cooking it first (cookTexture, encoding on cookingPool()) when
+    // it is missing or stale, so the GL thread only acquires the texture and a cold start
+    // cooks on the loader's pool. Sources with nothing to cook, or whose file cannot be
+    // written, are read with decode itself; with cooking disabled in settings it is decode.
+    // Its key mixes decode's key with settings.hash(), so the same image cooked two ways,
+    // or through two different decoders, is two textures.
+    ImageDecoder cookingDecoder(ImageDecoder decode, const TextureCookSettings& settings = TextureCookSettings());
+
+    // Pool cookingDecoder encodes on; its own, since the decoder runs on a pool task and
+    // ThreadPool::parallelFor must not wait on the pool it runs on
+    ThreadPool& cookingPool();
+
+    // Worker-thread ImageDecodeFunction for cooked files: maps the file and hands out its
+    // levels in place (read-only; release unmaps), so a warm load costs the read alone.
+    // Blocks the GL lacks the format for (see compressedFormatSupported) are decoded to
+    // RGBA8 instead.
+    bool loadCookedTexture(const std::string& path, DecodedImage& image);
+
+    // Header and level table of a cooked file, checked as loadCookedTexture checks them; for
+    // readers that want single levels (texture_streamer.hpp)
+    bool readCookedTextureLevels(const std::string& path, CookedTextureHeader& header,
+                                 std::vector<CookedTextureLevel>& levels);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "compressed_texture.hpp"
+#include "thread_pool.hpp"
+
+namespace Common {
+    // Encoder effort. Fast fits each block's colours along their bounding box diagonal;
+    // Balanced uses the principal axis and one least-squares refinement of the endpoints;
+    // Quality refines until the error stops falling and, for BC7, also tries the 2-subset
+    // mode 1 on the best partitions of opaque blocks.
+    enum class TextureCompressionPreset {
+        Fast,
+        Balanced,
+        Quality
+    };
+
+    // Encodes a width x height RGBA8 image (rows as stored) into BC1, BC3 or BC7 blocks,
+    // compressedLevelSize(format, width, height) bytes. Partial edge blocks repeat the edge
+    // texels. BC1 ignores alpha (always the opaque 4-colour mode).
+    // Rows of blocks are spread over pool, so it must not be called from one of its tasks.
+    void encodeBlocks(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* blocks,
+                      TextureCompressionPreset preset = TextureCompressionPreset::Balanced,
+                      ThreadPool& pool = ThreadPool::shared());
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Common {
+    // One mip level inside DecodedImage::pixels
+    struct ImageLevel {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    // Pixels decoded by an ImageDecodeFunction. release frees pixels (e.g. stbi_image_free).
+    struct DecodedImage {
+        int width = 0;
+        int height = 0;
+        int components = 0;      // 1, 3 or 4 bytes per pixel (4 for block-compressed data)
+        unsigned char* pixels = nullptr;
+        void (*release)(void*) = nullptr;
+        // GL internal format of block-compressed data (compressed_texture.hpp), 0 for pixels
+        unsigned int compressedFormat = 0;
+        // Prebuilt mip chain, level 0 first. Empty: pixels is level 0 alone and the
+        // upload generates the mipmaps (not possible for compressed data).
+        std::vector<ImageLevel> levels;
+    };
+
+    // Decodes an image file; runs on a worker thread, so it must not touch GL. The
+    // application supplies it so the stb_image implementation stays in one module. A plain
+    // function, or a callable carrying settings (cookingDecoder, texture_cache.hpp).
+    typedef std::function<bool(const std::string& path, DecodedImage& image)> ImageDecodeFunction;
+
+    // An ImageDecodeFunction with an identity, for tables that share textures: two decoders
+    // with the same key turn the same file into the same image. A plain function is keyed by
+    // its address; a callable carrying settings has to be given a key covering them (see
+    // cookingDecoder), since std::function cannot tell two such callables apart.
+    struct ImageDecoder {
+        typedef bool (*Function)(const std::string& path, DecodedImage& image);
+
+        ImageDecoder(Function function);
+        ImageDecoder(ImageDecodeFunction decode, uint64_t key) : decode(std::move(decode)), key(key) {}
+
+        ImageDecodeFunction decode;
+        uint64_t key;
+    };
+
+    // Specifies every level of image into the texture bound to GL_TEXTURE_2D and sets its
+    // filtering. base is where the level offsets point: image.pixels, or null when the
+    // data sits at offset 0 of a bound pixel unpack buffer. Any context, GL thread.
+    void specifyTextureImage(const DecodedImage& image, const unsigned char* base);
+    // Bytes of image.pixels the upload reads
+    size_t decodedImageSize(const DecodedImage& image);
+
+    struct TextureLoaderStats {
+        size_t requested = 0;
+        size_t uploaded = 0;
+        size_t failed = 0;       // these keep their placeholder
+        double decodeSeconds = 0.0;  // summed over workers
+    };
+
+    // Asynchronous texture loading: load() returns a GL texture name at once, bound to a
+    // 1x1 placeholder, and decodes the file on a thread pool. Decoded images wait in a
+    // completion queue until uploadCompleted() runs on the GL thread; the upload replaces
+    // the placeholder in the same texture object, so anything holding the name (materials,
+    // submeshes) shows the real image from then on.
+    //
+    // When an UploadContext exists (upload_context.hpp), decoded images are uploaded on its
+    // loader thread through a pixel buffer instead, mipmaps included, and uploadCompleted()
+    // only reports decode failures; the context's pollCompleted() reports the rest.
+    class TextureLoader {
+    public:
+        explicit TextureLoader(ThreadPool& pool = ThreadPool::shared());
+        ~TextureLoader();
+
+        TextureLoader(const TextureLoader&) = delete;
+        TextureLoader& operator=(const TextureLoader&) = delete;
+
+        // GL thread. placeholder is one RGBA pixel; mid grey if null.
+        unsigned int load(const std::string& path, ImageDecodeFunction decode, const unsigned char* placeholder = nullptr);
+
+        // GL thread, typically once per frame: uploads (with mipmaps) at most maxUploads
+        // decoded textures. Returns how many were uploaded.
+        size_t uploadCompleted(size_t maxUploads = SIZE_MAX);
+
+        // GL thread: waits for every queued decode and uploads it
+        void finish();
+
+        // GL thread: deletes a texture returned by load(). If its load is still in flight
+        // the name stays reserved until it completes, so a late upload can never land in
+        // a texture that reused the name.
+        void discard(unsigned int texture);
+
+        // loads whose upload has not happened yet
+        size_t pendingCount() const;
+        TextureLoaderStats stats() const;
+
+        // Process-wide loader on ThreadPool::shared(), used by the model loaders.
+        static TextureLoader& shared();
+
+    private:
+        struct State;
+        // shared with in-flight decode tasks, so destroying the loader never waits on them
+        std::shared_ptr<State> state;
+        ThreadPool& pool;
+    };
+}
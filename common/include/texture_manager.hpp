@@ -0,0 +1,64 @@
+#pragma once
+
+#include "texture_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+    struct TextureManagerStats {
+        size_t textures = 0;      // live GL textures
+        size_t references = 0;    // outstanding acquire() calls
+        size_t pathHits = 0;      // acquires answered by the path index
+        size_t contentHits = 0;   // new paths whose bytes matched a loaded texture
+        size_t loads = 0;         // textures handed to the TextureLoader
+        size_t deleted = 0;
+    };
+
+    // Process-wide texture table. A texture is loaded once per distinct file and decoder:
+    // lookups go by normalized path (ResourceResolver::normalize) first, then by a hash of
+    // the file's bytes, both together with the decoder's key, so the same image reached
+    // through another spelling or copied under another name shares one GL texture while
+    // the same file decoded another way (other cook settings) gets its own. Every acquire()
+    // takes a reference; the texture is deleted when the last one is released. GL thread only.
+    class TextureManager {
+    public:
+        explicit TextureManager(TextureLoader& loader = TextureLoader::shared());
+
+        TextureManager(const TextureManager&) = delete;
+        TextureManager& operator=(const TextureManager&) = delete;
+
+        // Texture for the file at path, loaded asynchronously (TextureLoader::load) on first
+        // use with decoder. 0, with no reference taken, if the file cannot be read.
+        unsigned int acquire(const std::string& path, const ImageDecoder& decoder);
+        // Another reference to a texture acquire() returned
+        void addReference(unsigned int texture);
+        // Drops one reference; the last one deletes the texture. Unknown names are ignored.
+        void release(unsigned int texture);
+
+        size_t referenceCount(unsigned int texture) const;
+        TextureManagerStats stats() const;
+
+        // Table used by the model loaders, on TextureLoader::shared()
+        static TextureManager& shared();
+
+    private:
+        struct Entry {
+            uint64_t contentHash;  // of the bytes, mixed with decoderKey
+            uint64_t decoderKey;
+            size_t references;
+            std::vector<std::string> paths;  // normalized paths that point here with decoderKey
+        };
+
+        TextureLoader& loader;
+        std::unordered_map<std::string, unsigned int> byPath;  // pathKey(path, decoderKey)
+        std::unordered_map<uint64_t, unsigned int> byContent;
+        std::unordered_map<unsigned int, Entry> entries;
+        TextureManagerStats counters;
+
+        static std::string pathKey(const std::string& path, uint64_t decoderKey);
+    };
+}
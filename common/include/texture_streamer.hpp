@@ -0,0 +1,120 @@
+#pragma once
+
+#include "compressed_texture.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+    struct TextureStreamerStats {
+        size_t textures = 0;        // open streamed textures
+        size_t fullyResident = 0;   // textures with every level they were last asked for
+        size_t pendingLoads = 0;    // levels being read or uploaded
+        size_t residentBytes = 0;   // GPU memory of the resident levels
+        size_t pendingBytes = 0;    // ... and of the levels on their way
+        size_t budgetBytes = 0;
+        size_t levelsLoaded = 0;    // since the streamer was made
+        size_t levelsEvicted = 0;
+        size_t deferredLoads = 0;   // loads the budget held back in the last update()
+    };
+
+    struct StreamedTextureInfo {
+        unsigned int levelCount = 0;
+        unsigned int residentLevel = 0;   // finest level on the GPU
+        unsigned int wantedLevel = 0;     // finest level the last update() asked for
+        size_t residentBytes = 0;
+        bool loading = false;
+    };
+
+    // Mip-level streaming of cooked textures (texture_cache.hpp) under a GPU memory budget.
+    // open() uploads only the coarse tail of a texture, the levels no larger than tailSize
+    // texels on a side, and later levels arrive one at a time, coarse to fine, as request()
+    // asks for them: each is read on the pool and uploaded on the UploadContext's thread when
+    // there is one, on the GL thread in update() otherwise. A level is shown from the moment
+    // it is complete by lowering GL_TEXTURE_BASE_LEVEL, so drawing never waits.
+    //
+    // When resident and pending levels would exceed the budget, textures drop their finest
+    // level again: those holding more than they were asked for first, then those asked for
+    // longest ago. The tail is never evicted. GL thread only, apart from the pool work.
+    class TextureStreamer {
+    public:
+        explicit TextureStreamer(ThreadPool& pool = ThreadPool::shared());
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        // Texture for the cooked file at path with its tail uploaded; opening the same file
+        // again takes another reference to it. 0 if the file is missing or corrupt.
+        unsigned int open(const std::string& path);
+        // Drops one reference; the last one deletes the texture once no level is in flight
+        void close(unsigned int texture);
+
+        // texture is drawn about screenSize pixels across (along its larger side); the largest
+        // request since the last update() picks the level it streams towards. A texture
+        // nobody asks for in a frame is left to drift back down to its tail.
+        void request(unsigned int texture, float screenSize);
+
+        // Once per frame: adopts finished levels (uploading at most maxUploads of them when
+        // there is no UploadContext), evicts down to the budget and starts the next loads
+        void update(size_t maxUploads = 4);
+
+        void setBudget(size_t bytes);
+        size_t budget() const { return budgetBytes; }
+        // Side of the largest level open() uploads at once; affects textures opened later
+        void setTailSize(int texels);
+
+        TextureStreamerStats stats() const;
+        bool textureInfo(unsigned int texture, StreamedTextureInfo& info) const;
+
+        // Streamer used by the model loaders
+        static TextureStreamer& shared();
+
+    private:
+        struct Entry {
+            std::string path;
+            std::string key;                          // normalized path
+            unsigned int glFormat = 0;                // as uploaded: 0 for RGBA8
+            BlockFormat blockFormat = BlockFormat::BC1;
+            bool decodeBlocks = false;                // blocks the GL lacks, decoded on the pool
+            std::vector<CookedTextureLevel> levels;
+            unsigned int tailLevel = 0;
+            unsigned int residentLevel = 0;
+            unsigned int wantedLevel = 0;
+            float requestedSize = 0.0f;               // largest request since the last update
+            uint64_t lastRequest = 0;                 // update() count of the last request
+            size_t references = 0;
+            bool loading = false;
+            bool closed = false;                      // deleted once its load lands
+        };
+        struct State;
+
+        std::shared_ptr<State> state;
+        ThreadPool& pool;
+        std::unordered_map<unsigned int, Entry> entries;
+        std::unordered_map<std::string, unsigned int> byPath;
+        size_t budgetBytes = 256u << 20;
+        int tailSize = 64;
+        uint64_t frame = 1;
+        size_t residentBytes = 0;
+        size_t pendingBytes = 0;
+        size_t levelsLoaded = 0;
+        size_t levelsEvicted = 0;
+        size_t deferredLoads = 0;
+
+        size_t levelBytes(const Entry& entry, unsigned int level) const;
+        void startLoad(unsigned int texture, Entry& entry);
+        bool evictFrom(unsigned int texture, Entry& entry);
+        bool evictOne(unsigned int keep, bool overResidentOnly);
+    };
+
+    // Pixels across the screen of a sphere of radius at distance, for TextureStreamer::request;
+    // projectionScale comes from lodProjectionScale(fovY, viewportHeight)
+    float projectedSize(float radius, float distance, float projectionScale);
+}
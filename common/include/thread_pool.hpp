@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Common {
+    // Fixed-size worker pool shared by the asset loading code.
+    class ThreadPool {
+    public:
+        // threadCount 0 uses one worker per hardware thread
+        explicit ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const { return workers.size(); }
+
+        // Queues a task and returns a future for its result.
+        template<typename F>
+        auto submit(F task) -> std::future<decltype(task())> {
+            typedef decltype(task()) Result;
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+            std::future<Result> result = packaged->get_future();
+            enqueue([packaged]() { (*packaged)(); });
+            return result;
+        }
+
+        // Runs body(i) for i in [0, count) on the pool and waits for all of them.
+        // The first exception thrown by a body is rethrown here. Must not be called
+        // from a task running on the same pool (it would wait on its own workers).
+        void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+        // Process-wide pool sized to the machine.
+        static ThreadPool& shared();
+
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping;
+
+        void enqueue(std::function<void()> task);
+        void workerLoop();
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+namespace Common {
+    struct DecodedImage;
+}
+
+namespace Common {
+    // Second GL context, shared with a window's, made current on a loader thread so that
+    // glTexImage2D / glBufferData / glGenerateMipmap run beside the render loop instead of
+    // inside it. Each submitted upload is followed by a fence; its completion callback runs
+    // on the render thread in pollCompleted() once the GPU has signalled that fence, which
+    // is the point where the render context may use the objects.
+    //
+    // Object names are shared between the contexts, so the render thread can create a
+    // texture or buffer name and let the loader thread fill it. Container objects (VAOs,
+    // framebuffers) are not shared and must still be made on the render thread. GL orders
+    // nothing across contexts by itself: the render thread calls handOff() after touching
+    // an object it passes on (a placeholder image, a respecified level), and the uploads
+    // submitted from then on wait for those commands on the GPU.
+    class UploadContext {
+    public:
+        // Render (main) thread, with `shareWith` created and GLAD loaded: creates a hidden
+        // 1x1 window sharing its objects, using the window hints currently set. If that
+        // fails, valid() is false and callers should upload on the render thread.
+        explicit UploadContext(GLFWwindow* shareWith);
+        // Render thread: finishes outstanding uploads and destroys the hidden window
+        ~UploadContext();
+
+        UploadContext(const UploadContext&) = delete;
+        UploadContext& operator=(const UploadContext&) = delete;
+
+        bool valid() const { return context != nullptr; }
+
+        // Any thread. upload runs on the loader thread with the shared context current;
+        // complete (optional) runs later on the render thread from pollCompleted().
+        void submit(std::function<void()> upload, std::function<void()> complete = std::function<void()>());
+
+        // Render thread: fences (and flushes) the render context's commands so far; every
+        // upload submitted after this call waits for them before it runs
+        void handOff();
+
+        // Loader thread only (inside an upload): copies the image through a pixel unpack
+        // buffer into texture, with its mip chain (generated if the image has none). The
+        // texture is left bound to GL_TEXTURE_2D of the loader context.
+        void uploadTexture(unsigned int texture, const DecodedImage& image);
+
+        // Render thread, once per frame: runs the callbacks of uploads whose fence has
+        // signalled, in submission order. Returns how many ran.
+        size_t pollCompleted();
+        // Render thread: waits for every submitted upload and runs its callback
+        void finish();
+
+        // uploads whose callback has not run yet
+        size_t pendingCount() const;
+
+        // The context the loaders use when one exists (the most recently created valid
+        // one), or nullptr: textures and meshes then upload on the render thread.
+        static UploadContext* shared();
+
+    private:
+        struct Job {
+            std::function<void()> upload;
+            std::function<void()> complete;
+            void* waitFor = nullptr;  // GLsync of the latest handOff(), or null
+        };
+        struct Fenced {
+            void* fence;  // GLsync
+            std::function<void()> complete;
+        };
+
+        GLFWwindow* context = nullptr;
+        std::thread thread;
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Job> jobs;
+        std::deque<Fenced> fenced;
+        size_t running = 0;  // jobs taken by the loader thread but not fenced yet
+        bool stopping = false;
+        unsigned int pixelBuffer = 0;  // loader thread's PBO, respecified per texture
+        void* renderFence = nullptr;   // latest handOff(); the loader deletes it once a job took it
+        bool renderFenceTaken = false;
+
+        void loaderLoop();
+    };
+}
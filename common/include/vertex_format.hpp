@@ -0,0 +1,106 @@
+#pragma once
+
+#include "mesh_cache.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+    // Packed GPU vertex layouts, shared by both Mesh classes. Streams keep the attribute
+    // locations the shaders use (0 position, 1 normal, 2 uv, 3 tangent, 4 bitangent,
+    // 5 bone ids, 6 bone weights); a stream that is not given, or not in
+    // VertexFormat::streams, is left out.
+
+    // Optional vertex streams (positions are always present)
+    enum VertexStreamBits : uint32_t {
+        StreamNormals = 1u << 0,
+        StreamTexCoords = 1u << 1,
+        StreamTangents = 1u << 2,   // tangents and bitangents
+        StreamSkin = 1u << 3,       // bone ids and weights
+        StreamAll = 0xFu
+    };
+
+    enum class PositionEncoding : uint32_t {
+        Float,    // 3 x float
+        Half,     // 3 x half, relative to the bounds centre
+        Unorm16   // 3 x 16-bit, quantized over the bounds
+    };
+
+    struct VertexFormat {
+        PositionEncoding position = PositionEncoding::Float;
+        bool octahedralNormals = false;  // normals, tangents and bitangents as 2 x snorm16
+        bool halfTexCoords = false;      // uv as 2 x half (steps of 1/2048 below 1.0)
+        bool compactSkin = false;        // bone ids as 4 x int16, weights as 4 x unorm8
+        // streams a mesh actually uploads; importers clear what the mesh or its material
+        // does not use (no normal map: no tangents, no bones: no skin)
+        uint32_t streams = StreamAll;
+
+        // 32-bit floats everywhere; needs no decode in the shader
+        static VertexFormat full() { return VertexFormat(); }
+        // Everything packed: 16 bytes instead of 32 for position/normal/uv,
+        // 36 instead of 88 for a skinned vertex with tangents
+        static VertexFormat compact() {
+            VertexFormat format;
+            format.position = PositionEncoding::Unorm16;
+            format.octahedralNormals = true;
+            format.halfTexCoords = true;
+            format.compactSkin = true;
+            return format;
+        }
+    };
+
+    // Source streams: each pointer is the first vertex's element, all share one stride in bytes.
+    struct VertexStreams {
+        size_t count = 0;
+        size_t stride = 0;
+        const float* positions = nullptr;    // 3 floats, required
+        const float* normals = nullptr;      // 3 floats
+        const float* texCoords = nullptr;    // 2 floats
+        const float* tangents = nullptr;     // 3 floats
+        const float* bitangents = nullptr;   // 3 floats
+        const int* boneIds = nullptr;        // 4 ints, -1 for an unused slot
+        const float* boneWeights = nullptr;  // 4 floats
+    };
+
+    // What the vertex shader does to undo the packing:
+    //   position = positionOffset + positionScale * attribute
+    //   normal   = octahedralNormals ? octDecode(attribute.xy) : attribute   (also tangents)
+    // Full-float layouts decode with scale 1 and offset 0.
+    struct VertexDecode {
+        float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+        float positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+        bool octahedralNormals = false;
+    };
+
+    // Interleaved layout. Location 5 (bone ids) is an integer attribute and goes through
+    // glVertexAttribIPointer; every other attribute through glVertexAttribPointer.
+    struct VertexLayout {
+        uint32_t stride = 0;
+        std::vector<CookedAttribute> attributes;
+        VertexDecode decode;
+    };
+
+    // Layout for the streams present and wanted by format.streams. Positions are packed relative to boundsMin/boundsMax
+    // if given (they must contain every position), otherwise to the positions' own bounds.
+    VertexLayout makeVertexLayout(const VertexFormat& format, const VertexStreams& streams,
+                                  const float* boundsMin = nullptr, const float* boundsMax = nullptr);
+    // Writes streams.count vertices of layout.stride bytes
+    void packVertices(const VertexLayout& layout, const VertexStreams& streams, void* destination);
+
+    // Decode of a cooked layout, from its attributes and the bounds it was packed with
+    VertexDecode vertexDecodeFor(const std::vector<CookedAttribute>& attributes,
+                                 const float boundsMin[3], const float boundsMax[3]);
+
+    // 2 (GL_UNSIGNED_SHORT) when every vertex is addressable with 16 bits, else 4
+    inline uint32_t indexSizeFor(size_t vertexCount) { return vertexCount <= 65536 ? 2 : 4; }
+    inline uint32_t indexGLType(uint32_t indexSize) { return indexSize == 2 ? 0x1403u : 0x1405u; }
+    void narrowIndices(const uint32_t* indices, size_t count, uint16_t* destination);
+
+    // IEEE half precision, round to nearest even
+    uint16_t floatToHalf(float value);
+    float halfToFloat(uint16_t value);
+    // Octahedral unit vector encoding (Meyer et al. 2010); at most about 0.04 degrees off at 16 bits
+    void octEncode(const float normal[3], int16_t encoded[2]);
+    void octDecode(const int16_t encoded[2], float normal[3]);
+}
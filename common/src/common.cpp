@@ -3,7 +3,7 @@
 namespace Common {
 
 // Window implementation
-Window::Window(int width, int height, const char* title) : width(width), height(height) {
+Window::Window(int width, int height, const char* title, bool uploadThread) : width(width), height(height) {
     // Initialize GLFW
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -35,9 +35,18 @@ Window::Window(int width, int height, const char* title) : width(width), height(
     glEnable(GL_DEPTH_TEST);
     
     printOpenGLInfo();
+    
+    if (uploadThread) {
+        uploads.reset(new UploadContext(window));
+        if (!uploads->valid()) {
+            uploads.reset();
+        }
+    }
 }
 
 Window::~Window() {
+    // the shared context has to go before GLFW does
+    uploads.reset();
     glfwTerminate();
 }
 
@@ -51,6 +60,9 @@ void Window::swapBuffers() {
 
 void Window::pollEvents() {
     glfwPollEvents();
+    if (uploads) {
+        uploads->pollCompleted();
+    }
 }
 
 void Window::processInput() {
@@ -0,0 +1,867 @@
+#include "compressed_texture.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace Common {
+    const uint16_t BC7_PARTITIONS_2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+    };
+
+    const unsigned char BC7_ANCHORS_2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+    };
+
+    namespace {
+        const unsigned int kGLCompressedRGBDXT1 = 0x83F0;
+        const unsigned int kGLCompressedRGBADXT1 = 0x83F1;
+        const unsigned int kGLCompressedRGBADXT3 = 0x83F2;
+        const unsigned int kGLCompressedRGBADXT5 = 0x83F3;
+        const unsigned int kGLCompressedSRGBDXT1 = 0x8C4C;
+        const unsigned int kGLCompressedSRGBAlphaDXT1 = 0x8C4D;
+        const unsigned int kGLCompressedSRGBAlphaDXT3 = 0x8C4E;
+        const unsigned int kGLCompressedSRGBAlphaDXT5 = 0x8C4F;
+        const unsigned int kGLCompressedRedRGTC1 = 0x8DBB;
+        const unsigned int kGLCompressedRGRGTC2 = 0x8DBD;
+        const unsigned int kGLCompressedRGBABPTC = 0x8E8C;
+        const unsigned int kGLCompressedSRGBAlphaBPTC = 0x8E8D;
+
+        std::atomic<uint32_t> supportedFormats(0);
+
+        uint32_t formatBit(BlockFormat format) {
+            return 1u << static_cast<uint32_t>(format);
+        }
+
+        uint32_t readU32(const unsigned char* data) {
+            return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+        }
+
+        uint32_t fourCC(const char* code) {
+            return readU32(reinterpret_cast<const unsigned char*>(code));
+        }
+
+        // ---- block decoders -------------------------------------------------------------
+
+        void expand565(uint16_t color, unsigned char rgb[3]) {
+            unsigned int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+            rgb[0] = static_cast<unsigned char>((r << 3) | (r >> 2));
+            rgb[1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+            rgb[2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+        }
+
+        // BC1 colour block; alwaysFourColors for the colour half of BC2/BC3
+        void decodeColorBlock(const unsigned char* block, unsigned char out[16][4], bool alwaysFourColors) {
+            uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+            uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+            unsigned char palette[4][4];
+            expand565(c0, palette[0]);
+            expand565(c1, palette[1]);
+            palette[0][3] = palette[1][3] = 255;
+            if (c0 > c1 || alwaysFourColors) {
+                for (int c = 0; c < 3; c++) {
+                    palette[2][c] = static_cast<unsigned char>((2 * palette[0][c] + palette[1][c]) / 3);
+                    palette[3][c] = static_cast<unsigned char>((palette[0][c] + 2 * palette[1][c]) / 3);
+                }
+                palette[2][3] = palette[3][3] = 255;
+            } else {
+                for (int c = 0; c < 3; c++) {
+                    palette[2][c] = static_cast<unsigned char>((palette[0][c] + palette[1][c]) / 2);
+                    palette[3][c] = 0;
+                }
+                palette[2][3] = 255;
+                palette[3][3] = 0;
+            }
+            uint32_t indices = readU32(block + 4);
+            for (int i = 0; i < 16; i++) {
+                std::memcpy(out[i], palette[(indices >> (2 * i)) & 3], 4);
+            }
+        }
+
+        // BC4 block (also the alpha of BC3 and each channel of BC5) into out[i][channel]
+        void decodeChannelBlock(const unsigned char* block, unsigned char out[16][4], int channel) {
+            unsigned int a0 = block[0], a1 = block[1];
+            unsigned char palette[8];
+            palette[0] = static_cast<unsigned char>(a0);
+            palette[1] = static_cast<unsigned char>(a1);
+            if (a0 > a1) {
+                for (int i = 1; i < 7; i++) {
+                    palette[i + 1] = static_cast<unsigned char>(((7 - i) * a0 + i * a1 + 3) / 7);
+                }
+            } else {
+                for (int i = 1; i < 5; i++) {
+                    palette[i + 1] = static_cast<unsigned char>(((5 - i) * a0 + i * a1 + 2) / 5);
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+            uint64_t indices = 0;
+            for (int i = 0; i < 6; i++) {
+                indices |= uint64_t(block[2 + i]) << (8 * i);
+            }
+            for (int i = 0; i < 16; i++) {
+                out[i][channel] = palette[(indices >> (3 * i)) & 7];
+            }
+        }
+
+        // BC7 (Khronos / D3D11 BPTC) -------------------------------------------------------
+
+        struct BC7Mode {
+            int subsets, partitionBits, rotationBits, indexSelectionBits;
+            int colorBits, alphaBits, endpointPBits, sharedPBits, indexBits, index2Bits;
+        };
+
+        const BC7Mode kBC7Modes[8] = {
+            { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+            { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+            { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+            { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+            { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+            { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+            { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+            { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+        };
+
+        // two bits per pixel, pixel 0 in the low bits
+        const uint32_t kBC7Partitions3[64] = {
+            0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+            0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+            0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+            0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+            0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+            0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+            0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+            0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+        };
+
+        const unsigned char kBC7Anchor3Second[64] = {
+            3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+            3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+            8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+            3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+        };
+        const unsigned char kBC7Anchor3Third[64] = {
+            15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+            15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+            15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+            15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+        };
+
+        const unsigned char kBC7Weights2[4] = { 0, 21, 43, 64 };
+        const unsigned char kBC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        const unsigned char kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        class BlockBits {
+        public:
+            explicit BlockBits(const unsigned char* block) : position(0) {
+                std::memcpy(bytes, block, 16);
+            }
+            unsigned int read(int count) {
+                unsigned int value = 0;
+                for (int i = 0; i < count; i++, position++) {
+                    value |= ((bytes[position >> 3] >> (position & 7)) & 1u) << i;
+                }
+                return value;
+            }
+        private:
+            unsigned char bytes[16];
+            int position;
+        };
+
+        const unsigned char* bc7Weights(int bits) {
+            return bits == 2 ? kBC7Weights2 : (bits == 3 ? kBC7Weights3 : kBC7Weights4);
+        }
+
+        void decodeBC7Block(const unsigned char* block, unsigned char out[16][4]) {
+            int modeIndex = 0;
+            while (modeIndex < 8 && !(block[0] & (1 << modeIndex))) {
+                modeIndex++;
+            }
+            if (modeIndex == 8) {
+                // reserved mode: the format defines it as transparent black
+                std::memset(out, 0, 16 * 4);
+                return;
+            }
+            const BC7Mode& mode = kBC7Modes[modeIndex];
+            BlockBits bits(block);
+            bits.read(modeIndex + 1);
+            unsigned int partition = bits.read(mode.partitionBits);
+            unsigned int rotation = bits.read(mode.rotationBits);
+            unsigned int indexSelection = bits.read(mode.indexSelectionBits);
+
+            // endpoints[subset * 2 + end][channel]
+            unsigned int endpoints[6][4];
+            const int endpointCount = mode.subsets * 2;
+            for (int channel = 0; channel < 3; channel++) {
+                for (int e = 0; e < endpointCount; e++) {
+                    endpoints[e][channel] = bits.read(mode.colorBits);
+                }
+            }
+            for (int e = 0; e < endpointCount; e++) {
+                endpoints[e][3] = mode.alphaBits ? bits.read(mode.alphaBits) : 255;
+            }
+
+            int colorPrecision = mode.colorBits, alphaPrecision = mode.alphaBits;
+            if (mode.endpointPBits || mode.sharedPBits) {
+                unsigned int pBits[6];
+                if (mode.endpointPBits) {
+                    for (int e = 0; e < endpointCount; e++) {
+                        pBits[e] = bits.read(1);
+                    }
+                } else {
+                    for (int subset = 0; subset < mode.subsets; subset++) {
+                        pBits[subset * 2] = pBits[subset * 2 + 1] = bits.read(1);
+                    }
+                }
+                for (int e = 0; e < endpointCount; e++) {
+                    for (int channel = 0; channel < 4; channel++) {
+                        if (channel < 3 || mode.alphaBits) {
+                            endpoints[e][channel] = (endpoints[e][channel] << 1) | pBits[e];
+                        }
+                    }
+                }
+                colorPrecision++;
+                if (mode.alphaBits) {
+                    alphaPrecision++;
+                }
+            }
+            for (int e = 0; e < endpointCount; e++) {
+                for (int channel = 0; channel < 4; channel++) {
+                    int precision = channel < 3 ? colorPrecision : alphaPrecision;
+                    if (channel == 3 && !mode.alphaBits) {
+                        continue;
+                    }
+                    unsigned int value = endpoints[e][channel] << (8 - precision);
+                    endpoints[e][channel] = value | (value >> precision);
+                }
+            }
+
+            // subset of every pixel and the anchors whose index has its top bit dropped
+            int subsetOf[16];
+            int anchors[3] = { 0, 0, 0 };
+            for (int i = 0; i < 16; i++) {
+                if (mode.subsets == 2) {
+                    subsetOf[i] = (BC7_PARTITIONS_2[partition] >> i) & 1;
+                } else if (mode.subsets == 3) {
+                    subsetOf[i] = (kBC7Partitions3[partition] >> (2 * i)) & 3;
+                } else {
+                    subsetOf[i] = 0;
+                }
+            }
+            if (mode.subsets == 2) {
+                anchors[1] = BC7_ANCHORS_2[partition];
+            } else if (mode.subsets == 3) {
+                anchors[1] = kBC7Anchor3Second[partition];
+                anchors[2] = kBC7Anchor3Third[partition];
+            }
+
+            unsigned int colorIndex[16], alphaIndex[16];
+            for (int i = 0; i < 16; i++) {
+                bool anchor = i == anchors[subsetOf[i]];
+                colorIndex[i] = bits.read(mode.indexBits - (anchor ? 1 : 0));
+            }
+            if (mode.index2Bits) {
+                for (int i = 0; i < 16; i++) {
+                    alphaIndex[i] = bits.read(mode.index2Bits - (i == 0 ? 1 : 0));
+                }
+            }
+
+            int colorIndexBits = mode.indexBits, alphaIndexBits = mode.indexBits;
+            const unsigned int* colorIndices = colorIndex;
+            const unsigned int* alphaIndices = colorIndex;
+            if (mode.index2Bits) {
+                alphaIndexBits = mode.index2Bits;
+                alphaIndices = alphaIndex;
+                if (indexSelection) {
+                    std::swap(colorIndexBits, alphaIndexBits);
+                    std::swap(colorIndices, alphaIndices);
+                }
+            }
+            const unsigned char* colorWeights = bc7Weights(colorIndexBits);
+            const unsigned char* alphaWeights = bc7Weights(alphaIndexBits);
+
+            for (int i = 0; i < 16; i++) {
+                const unsigned int* e0 = endpoints[subsetOf[i] * 2];
+                const unsigned int* e1 = endpoints[subsetOf[i] * 2 + 1];
+                unsigned int w = colorWeights[colorIndices[i]];
+                for (int channel = 0; channel < 3; channel++) {
+                    out[i][channel] = static_cast<unsigned char>(((64 - w) * e0[channel] + w * e1[channel] + 32) >> 6);
+                }
+                w = alphaWeights[alphaIndices[i]];
+                out[i][3] = static_cast<unsigned char>(((64 - w) * e0[3] + w * e1[3] + 32) >> 6);
+                if (rotation) {
+                    std::swap(out[i][3], out[i][rotation - 1]);
+                }
+            }
+        }
+
+        void decodeBlock(BlockFormat format, const unsigned char* block, unsigned char out[16][4]) {
+            switch (format) {
+            case BlockFormat::BC1:
+                decodeColorBlock(block, out, false);
+                break;
+            case BlockFormat::BC2:
+                decodeColorBlock(block + 8, out, true);
+                for (int i = 0; i < 16; i++) {
+                    unsigned int alpha = (block[i / 2] >> (4 * (i & 1))) & 15;
+                    out[i][3] = static_cast<unsigned char>(alpha * 17);
+                }
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock(block + 8, out, true);
+                decodeChannelBlock(block, out, 3);
+                break;
+            case BlockFormat::BC4:
+                for (int i = 0; i < 16; i++) {
+                    out[i][1] = out[i][2] = 0;
+                    out[i][3] = 255;
+                }
+                decodeChannelBlock(block, out, 0);
+                break;
+            case BlockFormat::BC5:
+                for (int i = 0; i < 16; i++) {
+                    out[i][2] = 0;
+                    out[i][3] = 255;
+                }
+                decodeChannelBlock(block, out, 0);
+                decodeChannelBlock(block + 8, out, 1);
+                break;
+            case BlockFormat::BC7:
+                decodeBC7Block(block, out);
+                break;
+            }
+        }
+
+        // ---- flipping ---------------------------------------------------------------
+
+        // Reverses the first `rows` rows of a 3-bit-index (BC3 alpha / BC4) block
+        void flipChannelBlock(unsigned char* block, int rows) {
+            uint64_t indices = 0;
+            for (int i = 0; i < 6; i++) {
+                indices |= uint64_t(block[2 + i]) << (8 * i);
+            }
+            uint64_t flipped = indices;
+            for (int row = 0; row < rows; row++) {
+                uint64_t bitsOfRow = (indices >> (12 * row)) & 0xFFF;
+                int target = rows - 1 - row;
+                flipped &= ~(uint64_t(0xFFF) << (12 * target));
+                flipped |= bitsOfRow << (12 * target);
+            }
+            for (int i = 0; i < 6; i++) {
+                block[2 + i] = static_cast<unsigned char>(flipped >> (8 * i));
+            }
+        }
+
+        void flipColorBlock(unsigned char* block, int rows) {
+            std::reverse(block + 4, block + 4 + rows);
+        }
+
+        void flipBlock(BlockFormat format, unsigned char* block, int rows) {
+            switch (format) {
+            case BlockFormat::BC1:
+                flipColorBlock(block, rows);
+                break;
+            case BlockFormat::BC2:
+                for (int row = 0; row < rows / 2; row++) {
+                    std::swap(block[2 * row], block[2 * (rows - 1 - row)]);
+                    std::swap(block[2 * row + 1], block[2 * (rows - 1 - row) + 1]);
+                }
+                flipColorBlock(block + 8, rows);
+                break;
+            case BlockFormat::BC3:
+                flipChannelBlock(block, rows);
+                flipColorBlock(block + 8, rows);
+                break;
+            case BlockFormat::BC4:
+                flipChannelBlock(block, rows);
+                break;
+            case BlockFormat::BC5:
+                flipChannelBlock(block, rows);
+                flipChannelBlock(block + 8, rows);
+                break;
+            case BlockFormat::BC7:
+                break;
+            }
+        }
+
+        // Flips a level in place by swapping block rows and the pixel rows inside each block.
+        // Only for levels that are a whole number of block rows high, or one partial one.
+        void flipLevelBlocks(BlockFormat format, unsigned char* data, int width, int height) {
+            const size_t blockSize = blockBytes(format);
+            const int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+            const size_t rowBytes = blocksWide * blockSize;
+            const int rowsPerBlock = std::min(height, 4);
+            std::vector<unsigned char> swap(rowBytes);
+            for (int y = 0; y < blocksHigh / 2; y++) {
+                unsigned char* a = data + y * rowBytes;
+                unsigned char* b = data + (blocksHigh - 1 - y) * rowBytes;
+                std::memcpy(swap.data(), a, rowBytes);
+                std::memcpy(a, b, rowBytes);
+                std::memcpy(b, swap.data(), rowBytes);
+            }
+            for (size_t block = 0; block < size_t(blocksWide) * blocksHigh; block++) {
+                flipBlock(format, data + block * blockSize, rowsPerBlock);
+            }
+        }
+
+        void flipRows(unsigned char* pixels, int width, int height, int components) {
+            const size_t rowBytes = size_t(width) * components;
+            std::vector<unsigned char> swap(rowBytes);
+            for (int y = 0; y < height / 2; y++) {
+                unsigned char* a = pixels + y * rowBytes;
+                unsigned char* b = pixels + (height - 1 - y) * rowBytes;
+                std::memcpy(swap.data(), a, rowBytes);
+                std::memcpy(a, b, rowBytes);
+                std::memcpy(b, swap.data(), rowBytes);
+            }
+        }
+
+        // ---- containers ----------------------------------------------------------------
+
+        enum class SourceLayout { Blocks, RGBA32Masked, RGBA8, RGB8 };
+
+        struct ParsedTexture {
+            SourceLayout layout = SourceLayout::Blocks;
+            BlockFormat format = BlockFormat::BC1;
+            uint32_t masks[4] = { 0, 0, 0, 0 };  // RGBA32Masked: R, G, B, A bit masks
+            int width = 0;
+            int height = 0;
+            bool topDown = true;                 // first stored row is the top of the image
+            std::vector<ImageLevel> levels;      // offsets into the file
+        };
+
+        size_t sourceLevelSize(const ParsedTexture& texture, int width, int height) {
+            switch (texture.layout) {
+            case SourceLayout::Blocks:
+                return compressedLevelSize(texture.format, width, height);
+            case SourceLayout::RGB8:
+                return size_t(width) * height * 3;
+            default:
+                return size_t(width) * height * 4;
+            }
+        }
+
+        bool blockFormatFromDXGI(uint32_t dxgiFormat, BlockFormat& format) {
+            switch (dxgiFormat) {
+            case 70: case 71: case 72: format = BlockFormat::BC1; return true;
+            case 73: case 74: case 75: format = BlockFormat::BC2; return true;
+            case 76: case 77: case 78: format = BlockFormat::BC3; return true;
+            case 79: case 80: format = BlockFormat::BC4; return true;
+            case 82: case 83: format = BlockFormat::BC5; return true;
+            case 97: case 98: case 99: format = BlockFormat::BC7; return true;
+            default: return false;
+            }
+        }
+
+        // Fills levels from consecutive data starting at offset; false if the file is short
+        bool layoutLevels(ParsedTexture& texture, size_t offset, int levelCount, size_t fileSize) {
+            int width = texture.width, height = texture.height;
+            for (int level = 0; level < levelCount; level++) {
+                size_t size = sourceLevelSize(texture, width, height);
+                if (offset + size > fileSize) {
+                    // keep the levels that are there, if any
+                    return !texture.levels.empty();
+                }
+                texture.levels.push_back(ImageLevel{ width, height, offset, size });
+                offset += size;
+                if (width == 1 && height == 1) {
+                    break;
+                }
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            return !texture.levels.empty();
+        }
+
+        bool parseDDS(const std::vector<unsigned char>& file, ParsedTexture& texture, std::string& error) {
+            if (file.size() < 128 || readU32(&file[4]) != 124) {
+                error = "truncated DDS header";
+                return false;
+            }
+            const unsigned char* header = &file[4];
+            const uint32_t flags = readU32(header + 4);
+            texture.height = static_cast<int>(readU32(header + 8));
+            texture.width = static_cast<int>(readU32(header + 12));
+            const uint32_t mipCount = readU32(header + 24);
+            const unsigned char* pixelFormat = header + 72;
+            const uint32_t pixelFlags = readU32(pixelFormat + 4);
+            const uint32_t code = readU32(pixelFormat + 8);
+            const uint32_t caps2 = readU32(header + 108);
+            if ((caps2 & 0x200) || (flags & 0x800000)) {
+                error = "cube maps and volume textures are not supported";
+                return false;
+            }
+            size_t offset = 128;
+
+            if (pixelFlags & 0x4) {  // DDPF_FOURCC
+                if (code == fourCC("DXT1")) {
+                    texture.format = BlockFormat::BC1;
+                } else if (code == fourCC("DXT2") || code == fourCC("DXT3")) {
+                    texture.format = BlockFormat::BC2;
+                } else if (code == fourCC("DXT4") || code == fourCC("DXT5")) {
+                    texture.format = BlockFormat::BC3;
+                } else if (code == fourCC("ATI1") || code == fourCC("BC4U")) {
+                    texture.format = BlockFormat::BC4;
+                } else if (code == fourCC("ATI2") || code == fourCC("BC5U")) {
+                    texture.format = BlockFormat::BC5;
+                } else if (code == fourCC("DX10")) {
+                    if (file.size() < 148) {
+                        error = "truncated DX10 header";
+                        return false;
+                    }
+                    uint32_t dxgiFormat = readU32(&file[128]);
+                    uint32_t arraySize = readU32(&file[140]);
+                    if (!blockFormatFromDXGI(dxgiFormat, texture.format)) {
+                        error = "unsupported DXGI format " + std::to_string(dxgiFormat);
+                        return false;
+                    }
+                    if (arraySize > 1) {
+                        error = "texture arrays are not supported";
+                        return false;
+                    }
+                    offset = 148;
+                } else {
+                    error = "unsupported FourCC";
+                    return false;
+                }
+            } else if ((pixelFlags & 0x40) && readU32(pixelFormat + 12) == 32) {  // DDPF_RGB, 32 bits
+                texture.layout = SourceLayout::RGBA32Masked;
+                for (int c = 0; c < 3; c++) {
+                    texture.masks[c] = readU32(pixelFormat + 16 + 4 * c);
+                }
+                texture.masks[3] = (pixelFlags & 0x1) ? readU32(pixelFormat + 28) : 0;
+            } else {
+                error = "unsupported pixel format";
+                return false;
+            }
+
+            int levelCount = ((flags & 0x20000) && mipCount > 0) ? static_cast<int>(mipCount) : 1;
+            if (texture.width <= 0 || texture.height <= 0 || !layoutLevels(texture, offset, levelCount, file.size())) {
+                error = "truncated image data";
+                return false;
+            }
+            return true;
+        }
+
+        bool parseKTX(const std::vector<unsigned char>& file, ParsedTexture& texture, std::string& error) {
+            if (file.size() < 64 || readU32(&file[12]) != 0x04030201) {
+                error = "truncated or big-endian KTX header";
+                return false;
+            }
+            const uint32_t glType = readU32(&file[16]);
+            const uint32_t glFormat = readU32(&file[24]);
+            const uint32_t glInternalFormat = readU32(&file[28]);
+            texture.width = static_cast<int>(readU32(&file[36]));
+            texture.height = static_cast<int>(readU32(&file[40]));
+            const uint32_t depth = readU32(&file[44]);
+            const uint32_t arrayElements = readU32(&file[48]);
+            const uint32_t faces = readU32(&file[52]);
+            const uint32_t mipLevels = readU32(&file[56]);
+            const uint32_t keyValueBytes = readU32(&file[60]);
+            if (depth > 1 || arrayElements > 1 || faces > 1) {
+                error = "only 2D textures are supported";
+                return false;
+            }
+            if (glType == 0) {
+                if (!blockFormatFromGL(glInternalFormat, texture.format)) {
+                    error = "unsupported compressed format";
+                    return false;
+                }
+            } else if (glType == GL_UNSIGNED_BYTE && glFormat == GL_RGBA) {
+                texture.layout = SourceLayout::RGBA8;
+            } else if (glType == GL_UNSIGNED_BYTE && glFormat == GL_RGB) {
+                texture.layout = SourceLayout::RGB8;
+            } else {
+                error = "unsupported pixel format";
+                return false;
+            }
+
+            // KTX data is in GL order (first row at t = 0) unless KTXorientation says T=d
+            texture.topDown = false;
+            size_t position = 64;
+            const size_t keyValueEnd = 64 + size_t(keyValueBytes);
+            if (keyValueEnd > file.size()) {
+                error = "truncated key/value data";
+                return false;
+            }
+            while (position + 4 <= keyValueEnd) {
+                uint32_t size = readU32(&file[position]);
+                position += 4;
+                if (position + size > keyValueEnd) {
+                    break;
+                }
+                std::string entry(reinterpret_cast<const char*>(&file[position]), size);
+                if (entry.compare(0, 15, std::string("KTXorientation\0", 15)) == 0 && entry.find("T=d") != std::string::npos) {
+                    texture.topDown = true;
+                }
+                position += (size + 3) & ~size_t(3);
+            }
+
+            position = keyValueEnd;
+            int width = texture.width, height = std::max(texture.height, 1);
+            texture.height = height;
+            for (uint32_t level = 0; level < std::max(mipLevels, 1u); level++) {
+                if (position + 4 > file.size()) {
+                    break;
+                }
+                size_t size = readU32(&file[position]);
+                position += 4;
+                if (position + size > file.size() || size < sourceLevelSize(texture, width, height)) {
+                    break;
+                }
+                texture.levels.push_back(ImageLevel{ width, height, position, sourceLevelSize(texture, width, height) });
+                position += (size + 3) & ~size_t(3);
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            if (texture.width <= 0 || texture.levels.empty()) {
+                error = "truncated image data";
+                return false;
+            }
+            return true;
+        }
+
+        int maskShift(uint32_t mask) {
+            int shift = 0;
+            while (mask && !(mask & 1)) {
+                mask >>= 1;
+                shift++;
+            }
+            return shift;
+        }
+
+        // One level of a non-block layout as RGBA8 rows, as stored
+        void convertLevel(const ParsedTexture& texture, const unsigned char* source, int width, int height,
+                          unsigned char* rgba) {
+            const size_t count = size_t(width) * height;
+            if (texture.layout == SourceLayout::RGBA8) {
+                std::memcpy(rgba, source, count * 4);
+            } else if (texture.layout == SourceLayout::RGB8) {
+                for (size_t i = 0; i < count; i++) {
+                    rgba[4 * i + 0] = source[3 * i + 0];
+                    rgba[4 * i + 1] = source[3 * i + 1];
+                    rgba[4 * i + 2] = source[3 * i + 2];
+                    rgba[4 * i + 3] = 255;
+                }
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    uint32_t pixel = readU32(source + 4 * i);
+                    for (int c = 0; c < 4; c++) {
+                        uint32_t mask = texture.masks[c];
+                        if (!mask) {
+                            rgba[4 * i + c] = c == 3 ? 255 : 0;
+                            continue;
+                        }
+                        uint32_t value = (pixel & mask) >> maskShift(mask);
+                        uint32_t maximum = mask >> maskShift(mask);
+                        rgba[4 * i + c] = static_cast<unsigned char>((value * 255 + maximum / 2) / maximum);
+                    }
+                }
+            }
+        }
+    }
+
+    bool blockFormatFromGL(unsigned int glFormat, BlockFormat& format) {
+        switch (glFormat) {
+        case kGLCompressedRGBDXT1: case kGLCompressedRGBADXT1:
+        case kGLCompressedSRGBDXT1: case kGLCompressedSRGBAlphaDXT1:
+            format = BlockFormat::BC1;
+            return true;
+        case kGLCompressedRGBADXT3: case kGLCompressedSRGBAlphaDXT3:
+            format = BlockFormat::BC2;
+            return true;
+        case kGLCompressedRGBADXT5: case kGLCompressedSRGBAlphaDXT5:
+            format = BlockFormat::BC3;
+            return true;
+        case kGLCompressedRedRGTC1:
+            format = BlockFormat::BC4;
+            return true;
+        case kGLCompressedRGRGTC2:
+            format = BlockFormat::BC5;
+            return true;
+        case kGLCompressedRGBABPTC: case kGLCompressedSRGBAlphaBPTC:
+            format = BlockFormat::BC7;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    size_t blockBytes(BlockFormat format) {
+        return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+    }
+
+    unsigned int blockGLFormat(BlockFormat format) {
+        switch (format) {
+        case BlockFormat::BC1: return kGLCompressedRGBADXT1;
+        case BlockFormat::BC2: return kGLCompressedRGBADXT3;
+        case BlockFormat::BC3: return kGLCompressedRGBADXT5;
+        case BlockFormat::BC4: return kGLCompressedRedRGTC1;
+        case BlockFormat::BC5: return kGLCompressedRGRGTC2;
+        case BlockFormat::BC7: return kGLCompressedRGBABPTC;
+        }
+        return 0;
+    }
+
+    size_t compressedLevelSize(BlockFormat format, int width, int height) {
+        return size_t((width + 3) / 4) * size_t((height + 3) / 4) * blockBytes(format);
+    }
+
+    void decodeBlocks(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba) {
+        const int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+        const size_t blockSize = blockBytes(format);
+        unsigned char texels[16][4];
+        for (int by = 0; by < blocksHigh; by++) {
+            for (int bx = 0; bx < blocksWide; bx++) {
+                decodeBlock(format, blocks + (size_t(by) * blocksWide + bx) * blockSize, texels);
+                for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+                    for (int x = 0; x < 4 && bx * 4 + x < width; x++) {
+                        std::memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+                    }
+                }
+            }
+        }
+    }
+
+    void detectCompressedTextureSupport() {
+        GLint major = 0, minor = 0, extensionCount = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        uint32_t formats = 0;
+        if (major >= 3) {
+            formats |= formatBit(BlockFormat::BC4) | formatBit(BlockFormat::BC5);  // RGTC is core in 3.0
+        }
+        if (major > 4 || (major == 4 && minor >= 2)) {
+            formats |= formatBit(BlockFormat::BC7);  // BPTC is core in 4.2
+        }
+        for (GLint i = 0; i < extensionCount; i++) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (!name) {
+                continue;
+            }
+            if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+                formats |= formatBit(BlockFormat::BC1) | formatBit(BlockFormat::BC2) | formatBit(BlockFormat::BC3);
+            } else if (std::strcmp(name, "GL_ARB_texture_compression_bptc") == 0) {
+                formats |= formatBit(BlockFormat::BC7);
+            } else if (std::strcmp(name, "GL_ARB_texture_compression_rgtc") == 0) {
+                formats |= formatBit(BlockFormat::BC4) | formatBit(BlockFormat::BC5);
+            }
+        }
+        supportedFormats = formats;
+    }
+
+    bool compressedFormatSupported(BlockFormat format) {
+        return (supportedFormats.load() & formatBit(format)) != 0;
+    }
+
+    bool isCompressedTextureFile(const std::string& path) {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos) {
+            return false;
+        }
+        std::string extension = path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".dds" || extension == ".ktx";
+    }
+
+    bool loadCompressedTexture(const std::string& path, DecodedImage& image, bool flipVertically) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) {
+            return false;
+        }
+        std::vector<unsigned char> file(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(file.data()), file.size())) {
+            return false;
+        }
+
+        static const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+        ParsedTexture texture;
+        std::string error;
+        bool parsed;
+        if (file.size() >= 4 && std::memcmp(file.data(), "DDS ", 4) == 0) {
+            parsed = parseDDS(file, texture, error);
+        } else if (file.size() >= 12 && std::memcmp(file.data(), ktxIdentifier, 12) == 0) {
+            parsed = parseKTX(file, texture, error);
+        } else {
+            parsed = false;
+            error = "not a DDS or KTX file";
+        }
+        if (!parsed) {
+            std::cout << "Compressed texture " << path << ": " << error << std::endl;
+            return false;
+        }
+
+        const bool flip = flipVertically && texture.topDown;
+        bool keepBlocks = texture.layout == SourceLayout::Blocks && compressedFormatSupported(texture.format);
+        if (keepBlocks && flip) {
+            // blocks can be flipped in place unless a level ends in a partial block row
+            keepBlocks = texture.format != BlockFormat::BC7;
+            for (const auto& level : texture.levels) {
+                keepBlocks = keepBlocks && (level.height % 4 == 0 || level.height < 4);
+            }
+        }
+
+        size_t total = 0;
+        for (auto& level : texture.levels) {
+            total += keepBlocks ? level.size : size_t(level.width) * level.height * 4;
+        }
+        unsigned char* pixels = static_cast<unsigned char*>(std::malloc(std::max<size_t>(total, 1)));
+        if (!pixels) {
+            return false;
+        }
+
+        image.levels.clear();
+        size_t offset = 0;
+        for (const auto& level : texture.levels) {
+            const unsigned char* source = file.data() + level.offset;
+            unsigned char* destination = pixels + offset;
+            size_t size;
+            if (keepBlocks) {
+                size = level.size;
+                std::memcpy(destination, source, size);
+                if (flip) {
+                    flipLevelBlocks(texture.format, destination, level.width, level.height);
+                }
+            } else {
+                size = size_t(level.width) * level.height * 4;
+                if (texture.layout == SourceLayout::Blocks) {
+                    decodeBlocks(texture.format, source, level.width, level.height, destination);
+                } else {
+                    convertLevel(texture, source, level.width, level.height, destination);
+                }
+                if (flip) {
+                    flipRows(destination, level.width, level.height, 4);
+                }
+            }
+            image.levels.push_back(ImageLevel{ level.width, level.height, offset, size });
+            offset += size;
+        }
+
+        image.width = texture.width;
+        image.height = texture.height;
+        image.components = 4;
+        image.pixels = pixels;
+        image.release = std::free;
+        image.compressedFormat = keepBlocks ? blockGLFormat(texture.format) : 0;
+        return true;
+    }
+}
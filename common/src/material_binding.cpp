@@ -0,0 +1,52 @@
+#include "material_binding.hpp"
+
+#include <glad/glad.h>
+
+namespace Common {
+    MaterialBinding::MaterialBinding(unsigned int program) : programId(program) {
+    }
+
+    void MaterialBinding::addSampler(const char* name, int unit) {
+        const GLint location = glGetUniformLocation(programId, name);
+        if (location >= 0) {
+            textures.push_back(TextureBinding{ location, unit, 0, 0 });
+        }
+    }
+
+    void MaterialBinding::addTexture(const char* name, int unit, unsigned int target, unsigned int texture) {
+        textures.push_back(TextureBinding{ glGetUniformLocation(programId, name), unit, target, texture });
+    }
+
+    void MaterialBinding::setInt(const char* name, int value) {
+        const GLint location = glGetUniformLocation(programId, name);
+        if (location >= 0) {
+            constants.push_back(Constant{ location, 1, value, { 0.0f, 0.0f, 0.0f } });
+        }
+    }
+
+    void MaterialBinding::setVec3(const char* name, const float* value) {
+        const GLint location = glGetUniformLocation(programId, name);
+        if (location >= 0) {
+            constants.push_back(Constant{ location, 3, 0, { value[0], value[1], value[2] } });
+        }
+    }
+
+    void MaterialBinding::apply() const {
+        for (const Constant& constant : constants) {
+            if (constant.components == 1) {
+                glUniform1i(constant.location, constant.intValue);
+            } else {
+                glUniform3fv(constant.location, 1, constant.floatValues);
+            }
+        }
+        for (const TextureBinding& binding : textures) {
+            if (binding.location >= 0) {
+                glUniform1i(binding.location, binding.unit);
+            }
+            if (binding.target != 0) {
+                glActiveTexture(GL_TEXTURE0 + binding.unit);
+                glBindTexture(binding.target, binding.texture);
+            }
+        }
+    }
+}
@@ -0,0 +1,533 @@
+#include "mesh_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+static_assert(sizeof(CookedMeshHeader) == 176, "CookedMeshHeader layout must not have padding");
+static_assert(sizeof(CookedAttribute) == 20, "CookedAttribute layout must not have padding");
+static_assert(sizeof(CookedSubMesh) == 16, "CookedSubMesh layout must not have padding");
+static_assert(sizeof(CookedLod) == 16, "CookedLod layout must not have padding");
+
+bool seekFile(std::FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t tellFile(std::FILE* file) {
+#ifdef _WIN32
+    return static_cast<uint64_t>(_ftelli64(file));
+#else
+    return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+// Hasher64 implementation (XXH64)
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t hashRound(uint64_t lane, uint64_t input) {
+    lane += input * PRIME64_2;
+    return rotl64(lane, 31) * PRIME64_1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t lane) {
+    hash ^= hashRound(0, lane);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+Hasher64::Hasher64(uint64_t seed) : totalBytes(0), buffered(0), seed(seed) {
+    lanes[0] = seed + PRIME64_1 + PRIME64_2;
+    lanes[1] = seed + PRIME64_2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME64_1;
+}
+
+void Hasher64::update(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    totalBytes += size;
+
+    if (buffered + size < 32) {
+        std::memcpy(buffer + buffered, p, size);
+        buffered += size;
+        return;
+    }
+    if (buffered > 0) {
+        size_t fill = 32 - buffered;
+        std::memcpy(buffer + buffered, p, fill);
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = hashRound(lanes[i], read64(buffer + i * 8));
+        }
+        p += fill;
+        buffered = 0;
+    }
+    for (; p + 32 <= end; p += 32) {
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = hashRound(lanes[i], read64(p + i * 8));
+        }
+    }
+    buffered = static_cast<size_t>(end - p);
+    std::memcpy(buffer, p, buffered);
+}
+
+uint64_t Hasher64::digest() const {
+    uint64_t hash;
+    if (totalBytes >= 32) {
+        hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            hash = mergeRound(hash, lanes[i]);
+        }
+    } else {
+        hash = seed + PRIME64_5;
+    }
+    hash += totalBytes;
+
+    const unsigned char* p = buffer;
+    const unsigned char* end = buffer + buffered;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= hashRound(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= (*p) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    Hasher64 hasher(seed);
+    hasher.update(data, size);
+    return hasher.digest();
+}
+
+bool hashFile(const std::string& path, uint64_t& hash) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    Hasher64 hasher;
+    std::vector<unsigned char> chunk(1u << 20);
+    size_t bytes;
+    while ((bytes = std::fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+        hasher.update(chunk.data(), bytes);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    hash = hasher.digest();
+    return ok;
+}
+
+bool statFile(const std::string& path, FileStamp& stamp) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    const uintmax_t size = fs::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    const fs::file_time_type time = fs::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    stamp.size = size;
+    stamp.time = static_cast<uint64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool hashSourceFile(const std::string& source, const std::string& cookedPath, uint64_t& hash, FileStamp& stamp) {
+    if (!statFile(source, stamp)) {
+        return false;
+    }
+    CookedMeshHeader header;
+    std::FILE* file = std::fopen(cookedPath.c_str(), "rb");
+    const bool cooked = file && std::fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == COOKED_MESH_MAGIC && header.version == COOKED_MESH_VERSION;
+    if (file) {
+        std::fclose(file);
+    }
+    if (cooked && stamp.time != 0 && header.sourceSize == stamp.size && header.sourceTime == stamp.time) {
+        hash = header.sourceHash;
+        return true;
+    }
+    if (!hashFile(source, hash)) {
+        return false;
+    }
+    if (cooked && header.sourceHash == hash) {
+        // touched but not changed: record the new stamp so the next start trusts it again
+        header.sourceSize = stamp.size;
+        header.sourceTime = stamp.time;
+        file = std::fopen(cookedPath.c_str(), "r+b");
+        if (file) {
+            std::fwrite(&header, sizeof(header), 1, file);
+            std::fclose(file);
+        }
+    }
+    return true;
+}
+
+// CookedMeshWriter implementation
+CookedMeshWriter::CookedMeshWriter() : file(nullptr), failed(false) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+CookedMeshWriter::~CookedMeshWriter() {
+    if (file) {
+        abandon();
+    }
+}
+
+void CookedMeshWriter::write(const void* data, uint64_t bytes) {
+    if (!failed && bytes > 0 && std::fwrite(data, 1, static_cast<size_t>(bytes), file) != bytes) {
+        std::cout << "ERROR: Failed to write cooked mesh: " << path << std::endl;
+        failed = true;
+    }
+}
+
+void CookedMeshWriter::padTo16() {
+    static const char zeros[16] = {};
+    uint64_t position = tellFile(file);
+    write(zeros, (16 - position % 16) % 16);
+}
+
+bool CookedMeshWriter::open(const std::string& path, uint32_t vertexStride, const std::vector<CookedAttribute>& attributes,
+                            uint32_t indexSize) {
+    this->path = path;
+    this->attributes = attributes;
+    extra.clear();
+    lods.clear();
+    failed = false;
+    std::memset(&header, 0, sizeof(header));
+    header.vertexStride = vertexStride;
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    header.indexSize = indexSize == sizeof(uint16_t) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "ERROR: Cannot create cooked mesh: " << path << std::endl;
+        return false;
+    }
+    // the real header goes in last; zeros fail the magic check until then
+    write(&header, sizeof(header));
+    header.attributeOffset = sizeof(header);
+    write(attributes.data(), attributes.size() * sizeof(CookedAttribute));
+    padTo16();
+    header.vertexOffset = tellFile(file);
+    return !failed;
+}
+
+void CookedMeshWriter::appendVertices(const void* data, uint64_t count) {
+    if (header.indexCount > 0) {
+        std::cout << "ERROR: Cooked mesh vertices must be written before indices" << std::endl;
+        failed = true;
+        return;
+    }
+    write(data, count * header.vertexStride);
+    header.vertexCount += count;
+}
+
+void CookedMeshWriter::appendIndices(const uint32_t* data, uint64_t count) {
+    if (header.indexOffset == 0) {
+        padTo16();
+        header.indexOffset = tellFile(file);
+    }
+    if (header.indexSize == sizeof(uint32_t)) {
+        write(data, count * sizeof(uint32_t));
+    } else {
+        // narrowed in small batches; the caller guarantees every index fits
+        uint16_t narrow[4096];
+        for (uint64_t first = 0; first < count; first += 4096) {
+            uint64_t batch = std::min<uint64_t>(4096, count - first);
+            for (uint64_t i = 0; i < batch; ++i) {
+                narrow[i] = static_cast<uint16_t>(data[first + i]);
+            }
+            write(narrow, batch * sizeof(uint16_t));
+        }
+    }
+    header.indexCount += count;
+}
+
+bool CookedMeshWriter::finish(const std::vector<CookedSubMesh>& subMeshes, const std::vector<std::string>& materials,
+                              const std::vector<std::string>& libraries, const float boundsMin[3], const float boundsMax[3],
+                              uint64_t sourceHash, uint64_t settingsHash) {
+    if (!file) {
+        return false;
+    }
+    if (header.indexOffset == 0) {
+        padTo16();
+        header.indexOffset = tellFile(file);
+    }
+    header.subMeshOffset = tellFile(file);
+    header.subMeshCount = static_cast<uint32_t>(subMeshes.size());
+    write(subMeshes.data(), subMeshes.size() * sizeof(CookedSubMesh));
+
+    header.lodOffset = tellFile(file);
+    header.lodCount = static_cast<uint32_t>(lods.size());
+    for (const CookedLod& lod : lods) {
+        if (lod.firstSubMesh + lod.subMeshCount > subMeshes.size()) {
+            std::cout << "ERROR: Cooked mesh LOD references missing submeshes: " << path << std::endl;
+            failed = true;
+        }
+    }
+    write(lods.data(), lods.size() * sizeof(CookedLod));
+
+    header.stringOffset = tellFile(file);
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    header.libraryCount = static_cast<uint32_t>(libraries.size());
+    for (const std::vector<std::string>* table : { &materials, &libraries }) {
+        for (const std::string& name : *table) {
+            uint32_t length = static_cast<uint32_t>(name.size());
+            write(&length, sizeof(length));
+            write(name.data(), length);
+        }
+    }
+
+    header.extraOffset = tellFile(file);
+    header.extraBytes = extra.size();
+    write(extra.data(), extra.size());
+
+    std::memcpy(header.boundsMin, boundsMin, sizeof(header.boundsMin));
+    std::memcpy(header.boundsMax, boundsMax, sizeof(header.boundsMax));
+    header.sourceHash = sourceHash;
+    header.settingsHash = settingsHash;
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+    if (!seekFile(file, 0)) {
+        failed = true;
+    }
+    write(&header, sizeof(header));
+
+    bool ok = !failed && std::fclose(file) == 0;
+    file = nullptr;
+    if (!ok) {
+        std::remove(path.c_str());
+    }
+    return ok;
+}
+
+void CookedMeshWriter::setExtraData(const void* data, size_t bytes) {
+    const unsigned char* begin = static_cast<const unsigned char*>(data);
+    extra.assign(begin, begin + bytes);
+}
+
+void CookedMeshWriter::abandon() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+        std::remove(path.c_str());
+    }
+}
+
+// CookedMeshFile implementation
+CookedMeshFile::CookedMeshFile() : file(nullptr), fileSize(0), mapping(nullptr), mappingHandle(nullptr) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+CookedMeshFile::~CookedMeshFile() {
+    close();
+}
+
+void CookedMeshFile::close() {
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        mappingHandle = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(mapping), static_cast<size_t>(fileSize));
+#endif
+        mapping = nullptr;
+    }
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+// Read-only mapping of the whole file; on failure the FILE* read path is used instead
+void CookedMeshFile::mapFile(const std::string& path) {
+    if (fileSize == 0 || fileSize != static_cast<uint64_t>(static_cast<size_t>(fileSize))) {
+        return;
+    }
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    HANDLE mappingObject = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (!mappingObject) {
+        return;
+    }
+    void* view = MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mappingObject);
+        return;
+    }
+    mapping = static_cast<const unsigned char*>(view);
+    mappingHandle = mappingObject;
+#else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(fileSize), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (view == MAP_FAILED) {
+        return;
+    }
+    // the buffers are read front to back once, straight into the driver
+    madvise(view, static_cast<size_t>(fileSize), MADV_SEQUENTIAL);
+    mapping = static_cast<const unsigned char*>(view);
+#endif
+}
+
+bool CookedMeshFile::readAt(uint64_t offset, uint64_t bytes, void* out) {
+    if (offset + bytes > fileSize || !seekFile(file, offset)) {
+        return false;
+    }
+    return bytes == 0 || std::fread(out, 1, static_cast<size_t>(bytes), file) == bytes;
+}
+
+bool CookedMeshFile::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    fileSize = tellFile(file);
+
+    if (!readAt(0, sizeof(header), &header) || header.magic != COOKED_MESH_MAGIC) {
+        std::cout << "Cooked mesh is incomplete or not a cooked mesh: " << path << std::endl;
+        close();
+        return false;
+    }
+    if (header.version != COOKED_MESH_VERSION) {
+        std::cout << "Cooked mesh has version " << header.version << ", expected " << COOKED_MESH_VERSION << ": " << path << std::endl;
+        close();
+        return false;
+    }
+    if (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t)) {
+        std::cout << "ERROR: Cooked mesh has " << header.indexSize << "-byte indices: " << path << std::endl;
+        close();
+        return false;
+    }
+    uint64_t vertexBytes = header.vertexCount * header.vertexStride;
+    uint64_t indexBytes = header.indexCount * header.indexSize;
+    if (header.vertexOffset + vertexBytes > fileSize || header.indexOffset + indexBytes > fileSize
+        || header.subMeshOffset + header.subMeshCount * sizeof(CookedSubMesh) > fileSize
+        || header.lodOffset + header.lodCount * sizeof(CookedLod) > fileSize
+        || header.extraOffset + header.extraBytes > fileSize) {
+        std::cout << "ERROR: Cooked mesh is truncated: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    attributes.resize(header.attributeCount);
+    subMeshes.resize(header.subMeshCount);
+    lods.resize(header.lodCount);
+    bool ok = readAt(header.attributeOffset, attributes.size() * sizeof(CookedAttribute), attributes.data())
+        && readAt(header.subMeshOffset, subMeshes.size() * sizeof(CookedSubMesh), subMeshes.data())
+        && readAt(header.lodOffset, lods.size() * sizeof(CookedLod), lods.data());
+    for (size_t i = 0; ok && i < lods.size(); ++i) {
+        ok = lods[i].firstSubMesh + lods[i].subMeshCount <= subMeshes.size();
+    }
+
+    uint64_t offset = header.stringOffset;
+    materials.clear();
+    libraries.clear();
+    for (uint32_t i = 0; ok && i < header.materialCount + header.libraryCount; ++i) {
+        uint32_t length = 0;
+        ok = readAt(offset, sizeof(length), &length) && offset + sizeof(length) + length <= fileSize;
+        std::string name(ok ? length : 0, '\0');
+        ok = ok && readAt(offset + sizeof(length), length, &name[0]);
+        offset += sizeof(length) + length;
+        (i < header.materialCount ? materials : libraries).push_back(name);
+    }
+    extra.resize(static_cast<size_t>(header.extraBytes));
+    ok = ok && readAt(header.extraOffset, extra.size(), extra.data());
+    if (!ok) {
+        std::cout << "ERROR: Cooked mesh tables are corrupt: " << path << std::endl;
+        close();
+        return false;
+    }
+    mapFile(path);
+    return true;
+}
+
+bool CookedMeshFile::readVertexBytes(uint64_t offset, uint64_t bytes, void* out) {
+    if (!file || offset + bytes > header.vertexCount * header.vertexStride) {
+        return false;
+    }
+    if (mapping) {
+        std::memcpy(out, mapping + header.vertexOffset + offset, static_cast<size_t>(bytes));
+        return true;
+    }
+    return readAt(header.vertexOffset + offset, bytes, out);
+}
+
+bool CookedMeshFile::readIndexBytes(uint64_t offset, uint64_t bytes, void* out) {
+    if (!file || offset + bytes > header.indexCount * header.indexSize) {
+        return false;
+    }
+    if (mapping) {
+        std::memcpy(out, mapping + header.indexOffset + offset, static_cast<size_t>(bytes));
+        return true;
+    }
+    return readAt(header.indexOffset + offset, bytes, out);
+}
+
+}
@@ -0,0 +1,360 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace Common {
+
+static bool indicesInRange(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// FIFO cache simulated with timestamps: a vertex is resident while fewer than
+// cacheSize misses happened since it was loaded
+struct FifoCache {
+    std::vector<uint32_t> loadedAt;
+    uint32_t time;
+    unsigned size;
+
+    FifoCache(size_t vertexCount, unsigned cacheSize) : loadedAt(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    // returns true on a miss
+    bool access(uint32_t vertex) {
+        if (time - loadedAt[vertex] > size) {
+            loadedAt[vertex] = time++;
+            return true;
+        }
+        return false;
+    }
+
+    void reset() {
+        // pushing the clock past every timestamp empties the cache without touching the array
+        time += size + 1;
+    }
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+    if (indexCount == 0 || !indicesInRange(indices, indexCount, vertexCount)) {
+        return stats;
+    }
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t uniqueVertices = 0;
+    for (size_t i = 0; i < stats.triangles * 3; ++i) {
+        stats.transforms += cache.access(indices[i]) ? 1 : 0;
+        if (!referenced[indices[i]]) {
+            referenced[indices[i]] = true;
+            ++uniqueVertices;
+        }
+    }
+    stats.acmr = static_cast<float>(stats.transforms) / stats.triangles;
+    stats.atvr = static_cast<float>(stats.transforms) / uniqueVertices;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         unsigned cacheSize, std::vector<uint32_t>* clusters) {
+    const size_t triangleCount = indexCount / 3;
+    if (clusters) {
+        clusters->clear();
+    }
+    if (triangleCount == 0 || !indicesInRange(indices, triangleCount * 3, vertexCount)) {
+        if (destination != indices) {
+            std::memmove(destination, indices, indexCount * sizeof(uint32_t));
+        }
+        if (clusters && triangleCount > 0) {
+            clusters->push_back(0);
+        }
+        return;
+    }
+
+    // vertex -> triangle adjacency (CSR)
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        ++adjacencyOffset[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int c = 0; c < 3; ++c) {
+                adjacency[cursor[indices[t * 3 + c]]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        live[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+    }
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t time = cacheSize + 1;
+    size_t nextInOrder = 0;
+    int64_t fanning = 0;
+    bool newCluster = true;
+
+    while (fanning >= 0) {
+        const uint32_t f = static_cast<uint32_t>(fanning);
+        if (newCluster && clusters) {
+            clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+        newCluster = false;
+
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacencyOffset[f]; a < adjacencyOffset[f + 1]; ++a) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            for (int c = 0; c < 3; ++c) {
+                uint32_t v = indices[t * 3 + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // next fanning vertex: the candidate that stays in cache longest while its
+        // remaining triangles are emitted
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if (best < 0) {
+            // dead end: most recently used vertex with work left, else the next in input order
+            newCluster = true;
+            while (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) {
+                    best = v;
+                    break;
+                }
+            }
+            while (best < 0 && nextInOrder < vertexCount) {
+                if (live[nextInOrder] > 0) {
+                    best = static_cast<int64_t>(nextInOrder);
+                }
+                ++nextInOrder;
+            }
+        }
+        fanning = best;
+    }
+
+    std::memcpy(destination, output.data(), output.size() * sizeof(uint32_t));
+    // a trailing partial triangle is carried over untouched
+    for (size_t i = triangleCount * 3; i < indexCount; ++i) {
+        destination[i] = indices[i];
+    }
+}
+
+void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                      const float* positions, size_t positionStride, size_t vertexCount,
+                      const std::vector<uint32_t>& clusters, unsigned cacheSize, float threshold) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || clusters.empty() || !indicesInRange(indices, triangleCount * 3, vertexCount)) {
+        if (destination != indices) {
+            std::memmove(destination, indices, indexCount * sizeof(uint32_t));
+        }
+        return;
+    }
+
+    auto position = [positions, positionStride](uint32_t v) {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * positionStride);
+    };
+
+    // soft boundaries: inside each hard cluster, close a cluster as soon as its own
+    // ACMR gets within threshold of the whole hard cluster's
+    std::vector<uint32_t> boundaries;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        if (begin >= end) {
+            continue;
+        }
+        cache.reset();
+        size_t clusterMisses = 0;
+        for (size_t i = begin * 3; i < end * 3; ++i) {
+            clusterMisses += cache.access(indices[i]) ? 1 : 0;
+        }
+        const float clusterACMR = static_cast<float>(clusterMisses) / (end - begin);
+
+        boundaries.push_back(static_cast<uint32_t>(begin));
+        cache.reset();
+        size_t start = begin;
+        size_t misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+            }
+            float acmr = static_cast<float>(misses) / (t - start + 1);
+            if (t + 1 < end && acmr <= clusterACMR * threshold) {
+                boundaries.push_back(static_cast<uint32_t>(t + 1));
+                cache.reset();
+                start = t + 1;
+                misses = 0;
+            }
+        }
+    }
+
+    // mesh centroid, then per cluster an area-weighted centroid and normal
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        const float* p = position(indices[i]);
+        for (int k = 0; k < 3; ++k) {
+            meshCentroid[k] += p[k];
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        meshCentroid[k] /= static_cast<double>(triangleCount * 3);
+    }
+
+    std::vector<float> sortKey(boundaries.size());
+    for (size_t c = 0; c < boundaries.size(); ++c) {
+        size_t begin = boundaries[c];
+        size_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangleCount;
+        double centroid[3] = { 0.0, 0.0, 0.0 };
+        double normal[3] = { 0.0, 0.0, 0.0 };
+        double totalArea = 0.0;
+        for (size_t t = begin; t < end; ++t) {
+            const float* a = position(indices[t * 3]);
+            const float* b = position(indices[t * 3 + 1]);
+            const float* d = position(indices[t * 3 + 2]);
+            double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                centroid[k] += (a[k] + b[k] + d[k]) / 3.0 * area;
+                normal[k] += n[k];
+            }
+            totalArea += area;
+        }
+        double normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (totalArea <= 0.0 || normalLength <= 0.0) {
+            sortKey[c] = 0.0f;
+            continue;
+        }
+        double key = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            key += (centroid[k] / totalArea - meshCentroid[k]) * normal[k] / normalLength;
+        }
+        sortKey[c] = static_cast<float>(key);
+    }
+
+    std::vector<uint32_t> order(boundaries.size());
+    for (size_t c = 0; c < order.size(); ++c) {
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b) {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+    for (uint32_t c : order) {
+        size_t begin = boundaries[c];
+        size_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangleCount;
+        output.insert(output.end(), indices + begin * 3, indices + end * 3);
+    }
+    output.insert(output.end(), indices + triangleCount * 3, indices + indexCount);
+    std::memcpy(destination, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride, uint32_t* indices, size_t indexCount) {
+    if (!indicesInRange(indices, indexCount, vertexCount)) {
+        return vertexCount;
+    }
+    const uint32_t unassigned = ~0u;
+    std::vector<uint32_t> remap(vertexCount, unassigned);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t& target = remap[indices[i]];
+        if (target == unassigned) {
+            target = next++;
+        }
+        indices[i] = target;
+    }
+
+    unsigned char* bytes = static_cast<unsigned char*>(vertices);
+    std::vector<unsigned char> original(bytes, bytes + vertexCount * vertexStride);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] != unassigned) {
+            std::memcpy(bytes + remap[v] * vertexStride, original.data() + v * vertexStride, vertexStride);
+        }
+    }
+    return next;
+}
+
+MeshOptimizationStats optimizeMesh(void* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset,
+                                   uint32_t* indices, size_t indexCount, const std::vector<IndexRange>& ranges) {
+    auto start = std::chrono::steady_clock::now();
+    MeshOptimizationStats stats;
+    stats.verticesBefore = vertexCount;
+    stats.verticesAfter = vertexCount;
+    stats.before = analyzeVertexCache(indices, indexCount, vertexCount);
+    if (indexCount == 0 || !indicesInRange(indices, indexCount, vertexCount)) {
+        stats.after = stats.before;
+        return stats;
+    }
+
+    std::vector<IndexRange> work = ranges;
+    if (work.empty()) {
+        work.push_back(IndexRange{ 0, indexCount });
+    }
+    const float* positions = reinterpret_cast<const float*>(static_cast<const unsigned char*>(vertices) + positionOffset);
+    std::vector<uint32_t> scratch;
+    std::vector<uint32_t> clusters;
+    for (const IndexRange& range : work) {
+        if (range.offset + range.count > indexCount || range.count < 3) {
+            continue;
+        }
+        uint32_t* rangeIndices = indices + range.offset;
+        scratch.resize(range.count);
+        optimizeVertexCache(scratch.data(), rangeIndices, range.count, vertexCount, 16, &clusters);
+        optimizeOverdraw(rangeIndices, scratch.data(), range.count, positions, vertexStride, vertexCount, clusters);
+    }
+    stats.verticesAfter = optimizeVertexFetch(vertices, vertexCount, vertexStride, indices, indexCount);
+    stats.after = analyzeVertexCache(indices, indexCount, stats.verticesAfter);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+}
@@ -0,0 +1,454 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace Common {
+
+// Symmetric 4x4 plane quadric: sum of w * (n.p + d)^2 over the accumulated planes
+struct Quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+};
+
+static void addPlane(Quadric& q, const double n[3], double d, double weight) {
+    q.a2 += weight * n[0] * n[0];
+    q.ab += weight * n[0] * n[1];
+    q.ac += weight * n[0] * n[2];
+    q.ad += weight * n[0] * d;
+    q.b2 += weight * n[1] * n[1];
+    q.bc += weight * n[1] * n[2];
+    q.bd += weight * n[1] * d;
+    q.c2 += weight * n[2] * n[2];
+    q.cd += weight * n[2] * d;
+    q.d2 += weight * d * d;
+    q.weight += weight;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other) {
+    q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+    q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+    q.c2 += other.c2; q.cd += other.cd; q.d2 += other.d2;
+    q.weight += other.weight;
+}
+
+static double evaluate(const Quadric& q, const double p[3]) {
+    const double x = p[0], y = p[1], z = p[2];
+    double value = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+        + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+        + q.c2 * z * z + 2.0 * q.cd * z + q.d2;
+    return std::max(value, 0.0);
+}
+
+static void cross(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double dot(const double a[3], const double b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+enum VertexKind : unsigned char {
+    VERTEX_MANIFOLD, // interior, moves anywhere
+    VERTEX_BORDER,   // on an open boundary, moves along it
+    VERTEX_SEAM,     // one of two vertices sharing a position, moves along the seam with its twin
+    VERTEX_LOCKED
+};
+
+// Borders and seams get a plane through the edge, perpendicular to the triangle,
+// weighted up so collapses keep their outline
+static const double kBorderWeight = 10.0;
+
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                    const float* positions, size_t positionStride, size_t vertexCount,
+                    size_t targetIndexCount, float targetError, float* resultError) {
+    const size_t triangleCount = indexCount / 3;
+    if (resultError) {
+        *resultError = 0.0f;
+    }
+    bool valid = true;
+    for (size_t i = 0; i < triangleCount * 3 && valid; ++i) {
+        valid = indices[i] < vertexCount;
+    }
+    if (triangleCount == 0 || !valid || targetIndexCount >= triangleCount * 3) {
+        std::memmove(destination, indices, triangleCount * 3 * sizeof(uint32_t));
+        return triangleCount * 3;
+    }
+
+    // work on the vertices this range uses, renumbered 0..n-1
+    std::vector<uint32_t> globalIds(indices, indices + triangleCount * 3);
+    std::sort(globalIds.begin(), globalIds.end());
+    globalIds.erase(std::unique(globalIds.begin(), globalIds.end()), globalIds.end());
+    const size_t n = globalIds.size();
+    std::vector<uint32_t> local(triangleCount * 3);
+    for (size_t i = 0; i < local.size(); ++i) {
+        local[i] = static_cast<uint32_t>(std::lower_bound(globalIds.begin(), globalIds.end(), indices[i]) - globalIds.begin());
+    }
+    std::vector<double> position(n * 3);
+    for (size_t v = 0; v < n; ++v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + globalIds[v] * positionStride);
+        position[v * 3] = p[0];
+        position[v * 3 + 1] = p[1];
+        position[v * 3 + 2] = p[2];
+    }
+    auto pos = [&position](uint32_t v) { return &position[v * 3]; };
+
+    // vertices that share a position: pairs are seam twins, larger groups are locked
+    std::vector<uint32_t> byPosition(n);
+    for (size_t v = 0; v < n; ++v) {
+        byPosition[v] = static_cast<uint32_t>(v);
+    }
+    std::sort(byPosition.begin(), byPosition.end(), [&pos](uint32_t a, uint32_t b) {
+        return std::lexicographical_compare(pos(a), pos(a) + 3, pos(b), pos(b) + 3);
+    });
+    std::vector<uint32_t> twin(n, ~0u);
+    std::vector<uint32_t> groupSize(n, 1);
+    for (size_t begin = 0; begin < n;) {
+        size_t end = begin + 1;
+        while (end < n && std::equal(pos(byPosition[begin]), pos(byPosition[begin]) + 3, pos(byPosition[end]))) {
+            ++end;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            groupSize[byPosition[i]] = static_cast<uint32_t>(end - begin);
+        }
+        if (end - begin == 2) {
+            twin[byPosition[begin]] = byPosition[begin + 1];
+            twin[byPosition[begin + 1]] = byPosition[begin];
+        }
+        begin = end;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edgeCount;
+    auto countEdges = [&edgeCount, &local]() {
+        edgeCount.clear();
+        edgeCount.reserve(local.size());
+        for (size_t t = 0; t < local.size(); t += 3) {
+            for (int e = 0; e < 3; ++e) {
+                ++edgeCount[edgeKey(local[t + e], local[t + (e + 1) % 3])];
+            }
+        }
+    };
+    auto isOpen = [&edgeCount](uint32_t a, uint32_t b) {
+        auto found = edgeCount.find(edgeKey(a, b));
+        return found != edgeCount.end() && found->second == 1;
+    };
+
+    // triangle planes weighted by area, plus edge planes along borders and seams
+    std::vector<Quadric> quadrics(n);
+    std::memset(quadrics.data(), 0, n * sizeof(Quadric));
+    countEdges();
+    for (size_t t = 0; t < local.size(); t += 3) {
+        const double* p0 = pos(local[t]);
+        const double* p1 = pos(local[t + 1]);
+        const double* p2 = pos(local[t + 2]);
+        double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        double normal[3];
+        cross(e1, e2, normal);
+        double length = std::sqrt(dot(normal, normal));
+        if (length <= 0.0) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            normal[k] /= length;
+        }
+        const double area = length * 0.5;
+        for (int c = 0; c < 3; ++c) {
+            addPlane(quadrics[local[t + c]], normal, -dot(normal, p0), area);
+        }
+        for (int e = 0; e < 3; ++e) {
+            uint32_t a = local[t + e];
+            uint32_t b = local[t + (e + 1) % 3];
+            if (!isOpen(a, b)) {
+                continue;
+            }
+            const double* pa = pos(a);
+            const double* pb = pos(b);
+            double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            double edgeNormal[3];
+            cross(edge, normal, edgeNormal);
+            double edgeLength = std::sqrt(dot(edgeNormal, edgeNormal));
+            if (edgeLength <= 0.0) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                edgeNormal[k] /= edgeLength;
+            }
+            const double weight = dot(edge, edge) * kBorderWeight;
+            addPlane(quadrics[a], edgeNormal, -dot(edgeNormal, pa), weight);
+            addPlane(quadrics[b], edgeNormal, -dot(edgeNormal, pa), weight);
+        }
+    }
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+    std::vector<VertexKind> kind(n);
+    std::vector<uint32_t> openEdges(n);
+    std::vector<bool> nonManifold(n);
+    std::vector<uint32_t> adjacencyOffset(n + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> remap(n);
+    std::vector<bool> touched(n);
+    std::vector<Collapse> candidates;
+    const double errorLimit = static_cast<double>(targetError) * targetError;
+    double maxError = 0.0;
+
+    // replacing `from` by `to` must not turn any surviving triangle around
+    auto flips = [&](uint32_t from, uint32_t to) {
+        for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a) {
+            const uint32_t* tri = &local[adjacency[a] * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                continue;
+            }
+            const double* before[3] = { pos(tri[0]), pos(tri[1]), pos(tri[2]) };
+            const double* after[3] = { before[0], before[1], before[2] };
+            for (int c = 0; c < 3; ++c) {
+                if (tri[c] == from) {
+                    after[c] = pos(to);
+                }
+            }
+            double b1[3] = { before[1][0] - before[0][0], before[1][1] - before[0][1], before[1][2] - before[0][2] };
+            double b2[3] = { before[2][0] - before[0][0], before[2][1] - before[0][1], before[2][2] - before[0][2] };
+            double a1[3] = { after[1][0] - after[0][0], after[1][1] - after[0][1], after[1][2] - after[0][2] };
+            double a2[3] = { after[2][0] - after[0][0], after[2][1] - after[0][1], after[2][2] - after[0][2] };
+            double normalBefore[3], normalAfter[3];
+            cross(b1, b2, normalBefore);
+            cross(a1, a2, normalAfter);
+            if (dot(normalBefore, normalAfter) <= 0.0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto sharedTriangles = [&](uint32_t from, uint32_t to) {
+        size_t shared = 0;
+        for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a) {
+            const uint32_t* tri = &local[adjacency[a] * 3];
+            shared += (tri[0] == to || tri[1] == to || tri[2] == to) ? 1 : 0;
+        }
+        return shared;
+    };
+    auto touchAround = [&](uint32_t vertex) {
+        touched[vertex] = true;
+        for (uint32_t a = adjacencyOffset[vertex]; a < adjacencyOffset[vertex + 1]; ++a) {
+            const uint32_t* tri = &local[adjacency[a] * 3];
+            touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+        }
+    };
+
+    while (local.size() > targetIndexCount) {
+        // classify against the current topology
+        countEdges();
+        std::fill(openEdges.begin(), openEdges.end(), 0);
+        std::fill(nonManifold.begin(), nonManifold.end(), false);
+        for (const auto& edge : edgeCount) {
+            uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+            uint32_t b = static_cast<uint32_t>(edge.first);
+            if (edge.second == 1) {
+                ++openEdges[a];
+                ++openEdges[b];
+            } else if (edge.second > 2) {
+                nonManifold[a] = nonManifold[b] = true;
+            }
+        }
+        for (size_t v = 0; v < n; ++v) {
+            if (nonManifold[v] || groupSize[v] > 2) {
+                kind[v] = VERTEX_LOCKED;
+            } else if (groupSize[v] == 2) {
+                kind[v] = (openEdges[v] == 2 && openEdges[twin[v]] == 2) ? VERTEX_SEAM : VERTEX_LOCKED;
+            } else if (openEdges[v] == 0) {
+                kind[v] = VERTEX_MANIFOLD;
+            } else {
+                kind[v] = openEdges[v] == 2 ? VERTEX_BORDER : VERTEX_LOCKED;
+            }
+        }
+
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (uint32_t v : local) {
+            ++adjacencyOffset[v + 1];
+        }
+        for (size_t v = 0; v < n; ++v) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        adjacency.resize(local.size());
+        {
+            std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < local.size(); ++i) {
+                adjacency[cursor[local[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        auto allowed = [&](uint32_t from, uint32_t to) {
+            switch (kind[from]) {
+            case VERTEX_MANIFOLD:
+                return true;
+            case VERTEX_BORDER:
+                return kind[to] != VERTEX_MANIFOLD && isOpen(from, to);
+            case VERTEX_SEAM:
+                return kind[to] == VERTEX_SEAM && isOpen(from, to) && twin[from] != to
+                    && isOpen(twin[from], twin[to]);
+            default:
+                return false;
+            }
+        };
+        auto cost = [&](uint32_t from, uint32_t to) {
+            Quadric q = quadrics[from];
+            addQuadric(q, quadrics[to]);
+            if (kind[from] == VERTEX_SEAM) {
+                addQuadric(q, quadrics[twin[from]]);
+                addQuadric(q, quadrics[twin[to]]);
+            }
+            return q.weight > 0.0 ? evaluate(q, pos(to)) / q.weight : 0.0;
+        };
+
+        candidates.clear();
+        for (const auto& edge : edgeCount) {
+            uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+            uint32_t b = static_cast<uint32_t>(edge.first);
+            Collapse best = { 0, 0, DBL_MAX };
+            if (allowed(a, b)) {
+                best = Collapse{ a, b, cost(a, b) };
+            }
+            if (allowed(b, a)) {
+                double reverse = cost(b, a);
+                if (reverse < best.cost) {
+                    best = Collapse{ b, a, reverse };
+                }
+            }
+            if (best.cost < DBL_MAX) {
+                candidates.push_back(best);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost;
+        });
+
+        for (size_t v = 0; v < n; ++v) {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        const size_t trianglesToRemove = (local.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        size_t collapses = 0;
+        for (const Collapse& collapse : candidates) {
+            if (collapse.cost > errorLimit || removed >= trianglesToRemove) {
+                break;
+            }
+            const uint32_t from = collapse.from;
+            const uint32_t to = collapse.to;
+            const bool seam = kind[from] == VERTEX_SEAM;
+            if (touched[from] || touched[to] || (seam && (touched[twin[from]] || touched[twin[to]]))) {
+                continue;
+            }
+            if (flips(from, to) || (seam && flips(twin[from], twin[to]))) {
+                continue;
+            }
+            removed += sharedTriangles(from, to);
+            remap[from] = to;
+            addQuadric(quadrics[to], quadrics[from]);
+            touchAround(from);
+            touched[to] = true;
+            if (seam) {
+                removed += sharedTriangles(twin[from], twin[to]);
+                remap[twin[from]] = twin[to];
+                addQuadric(quadrics[twin[to]], quadrics[twin[from]]);
+                touchAround(twin[from]);
+                touched[twin[to]] = true;
+            }
+            maxError = std::max(maxError, collapse.cost);
+            ++collapses;
+        }
+        if (collapses == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < local.size(); t += 3) {
+            uint32_t a = remap[local[t]], b = remap[local[t + 1]], c = remap[local[t + 2]];
+            if (a != b && b != c && a != c) {
+                local[write++] = a;
+                local[write++] = b;
+                local[write++] = c;
+            }
+        }
+        local.resize(write);
+    }
+
+    for (size_t i = 0; i < local.size(); ++i) {
+        destination[i] = globalIds[local[i]];
+    }
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(maxError));
+    }
+    return local.size();
+}
+
+void generateLodChain(std::vector<uint32_t>& indices, const std::vector<IndexRange>& baseRanges,
+                      const float* positions, size_t positionStride, size_t vertexCount,
+                      unsigned lodCount, std::vector<LodLevel>& lods) {
+    lods.clear();
+    LodLevel base;
+    base.ranges = baseRanges;
+    if (base.ranges.empty()) {
+        base.ranges.push_back(IndexRange{ 0, indices.size() });
+    }
+    lods.push_back(base);
+
+    std::vector<uint32_t> scratch;
+    for (unsigned level = 1; level <= lodCount; ++level) {
+        const LodLevel& previous = lods.back();
+        const size_t firstNewIndex = indices.size();
+        LodLevel lod;
+        size_t previousCount = 0;
+        float levelError = 0.0f;
+        for (const IndexRange& range : previous.ranges) {
+            previousCount += range.count;
+            scratch.resize(range.count);
+            float error = 0.0f;
+            size_t target = range.count / 6 * 3;
+            size_t count = simplifyMesh(scratch.data(), indices.data() + range.offset, range.count,
+                                        positions, positionStride, vertexCount, target, FLT_MAX, &error);
+            optimizeVertexCache(scratch.data(), scratch.data(), count, vertexCount);
+            lod.ranges.push_back(IndexRange{ indices.size(), count });
+            indices.insert(indices.end(), scratch.begin(), scratch.begin() + count);
+            levelError = std::max(levelError, error);
+        }
+        // a level that barely shrinks (everything left is locked) is not worth drawing
+        if ((indices.size() - firstNewIndex) * 10 > previousCount * 9) {
+            indices.resize(firstNewIndex);
+            break;
+        }
+        lod.error = previous.error + levelError;
+        lods.push_back(lod);
+    }
+}
+
+float lodProjectionScale(float fovY, float viewportHeight) {
+    return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+unsigned selectLod(const float* lodErrors, size_t lodCount, float distance, float projectionScale,
+                   float maxPixelError) {
+    const float pixelsPerUnit = projectionScale / std::max(distance, 1e-4f);
+    unsigned chosen = 0;
+    for (size_t lod = 1; lod < lodCount; ++lod) {
+        if (lodErrors[lod] * pixelsPerUnit <= maxPixelError) {
+            chosen = static_cast<unsigned>(lod);
+        }
+    }
+    return chosen;
+}
+
+}
@@ -0,0 +1,280 @@
+#include "mip_chain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2 1
+#include <emmintrin.h>
+#else
+#define MIP_CHAIN_SSE2 0
+#endif
+
+namespace Common {
+    namespace {
+        void releaseImage(DecodedImage& image) {
+            if (image.pixels && image.release) {
+                image.release(image.pixels);
+            }
+            image.pixels = nullptr;
+        }
+
+        // Box texel at (x0, y0) over columns x rows source texels
+        void boxTexel(const unsigned char* source, int sourceWidth, int x0, int y0, int columns, int rows,
+                      unsigned char* out) {
+            unsigned int sum[4] = { 0, 0, 0, 0 };
+            for (int row = 0; row < rows; row++) {
+                const unsigned char* texel = source + (size_t(y0 + row) * sourceWidth + x0) * 4;
+                for (int column = 0; column < columns; column++, texel += 4) {
+                    sum[0] += texel[0];
+                    sum[1] += texel[1];
+                    sum[2] += texel[2];
+                    sum[3] += texel[3];
+                }
+            }
+            const unsigned int count = rows * columns;
+            for (int c = 0; c < 4; c++) {
+                out[c] = static_cast<unsigned char>((sum[c] + count / 2) / count);
+            }
+        }
+
+        // One level from the one above. Each target texel averages a 2x2 footprint; at an odd
+        // size the last one also takes the leftover row / column (2x3, 3x2 or 3x3)
+        void downsampleBox(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* target,
+                           int width, int height) {
+            for (int y = 0; y < height; y++) {
+                const int y0 = std::min(2 * y, sourceHeight - 1);
+                const int rows = y == height - 1 ? sourceHeight - y0 : 2;
+                unsigned char* out = target + size_t(y) * width * 4;
+                int x = 0;
+#if MIP_CHAIN_SSE2
+                if (rows == 2) {
+                    // plain 2x2 texels, two per step; the folded last column goes the slow way
+                    const int plainColumns = width - (sourceWidth & 1);
+                    const __m128i zero = _mm_setzero_si128();
+                    const __m128i two = _mm_set1_epi16(2);
+                    const unsigned char* row0 = source + size_t(y0) * sourceWidth * 4;
+                    const unsigned char* row1 = row0 + size_t(sourceWidth) * 4;
+                    for (; x + 2 <= plainColumns; x += 2) {
+                        // four source texels of each row: t0 t1 | t2 t3
+                        __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+                        __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+                        __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                        __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                        low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+                        high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+                        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), two), 2);
+                        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packus_epi16(sum, zero));
+                    }
+                }
+#endif
+                for (; x < width; x++) {
+                    const int x0 = std::min(2 * x, sourceWidth - 1);
+                    const int columns = x == width - 1 ? sourceWidth - x0 : 2;
+                    boxTexel(source, sourceWidth, x0, y0, columns, rows, out + 4 * x);
+                }
+            }
+        }
+
+        // Kaiser-windowed sinc, two lobes either side (alpha 4): sharper than the box
+        // without its aliasing, at the cost of a little ringing, clamped at 0 and 255
+        const double kPi = 3.14159265358979323846;
+        const double kKaiserAlpha = 4.0;
+        const double kKaiserLobes = 2.0;
+
+        double besselI0(double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 32 && term > sum * 1e-12; k++) {
+                const double half = x / (2.0 * k);
+                term *= half * half;
+                sum += term;
+            }
+            return sum;
+        }
+
+        double kaiser(double t) {
+            if (std::fabs(t) >= kKaiserLobes) {
+                return 0.0;
+            }
+            const double sinc = t == 0.0 ? 1.0 : std::sin(kPi * t) / (kPi * t);
+            const double window = t / kKaiserLobes;
+            return sinc * besselI0(kKaiserAlpha * std::sqrt(1.0 - window * window)) / besselI0(kKaiserAlpha);
+        }
+
+        // Normalised source taps of every target texel along one axis; edges clamp
+        struct FilterTaps {
+            std::vector<int> first;      // per target texel
+            std::vector<int> count;
+            std::vector<float> weights;  // count[i] weights from weightOffset[i]
+            std::vector<size_t> weightOffset;
+        };
+
+        FilterTaps kaiserTaps(int sourceSize, int size) {
+            FilterTaps taps;
+            const double scale = double(sourceSize) / size;
+            const double radius = kKaiserLobes * scale;
+            for (int i = 0; i < size; i++) {
+                const double center = (i + 0.5) * scale;
+                const int first = static_cast<int>(std::floor(center - radius));
+                const int last = static_cast<int>(std::ceil(center + radius));
+                taps.first.push_back(first);
+                taps.count.push_back(last - first + 1);
+                taps.weightOffset.push_back(taps.weights.size());
+                double total = 0.0;
+                for (int tap = first; tap <= last; tap++) {
+                    total += kaiser((tap + 0.5 - center) / scale);
+                }
+                for (int tap = first; tap <= last; tap++) {
+                    taps.weights.push_back(static_cast<float>(kaiser((tap + 0.5 - center) / scale) / total));
+                }
+            }
+            return taps;
+        }
+
+        // A texel as four floats, in one SSE register where available
+#if MIP_CHAIN_SSE2
+        typedef __m128 Texel;
+        inline Texel zeroTexel() { return _mm_setzero_ps(); }
+        inline Texel loadTexel(const float* in) { return _mm_loadu_ps(in); }
+        inline void storeTexel(float* out, Texel value) { _mm_storeu_ps(out, value); }
+        inline Texel madd(Texel sum, Texel value, float weight) {
+            return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight)));
+        }
+        inline Texel texelFromBytes(const unsigned char* in) {
+            int bits;
+            std::memcpy(&bits, in, 4);
+            const __m128i zero = _mm_setzero_si128();
+            __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero);
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        }
+        inline void texelToBytes(Texel value, unsigned char* out) {
+            // round to nearest, saturate to 0..255
+            __m128i words = _mm_packs_epi32(_mm_cvtps_epi32(value), _mm_setzero_si128());
+            int bits = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+            std::memcpy(out, &bits, 4);
+        }
+#else
+        struct Texel {
+            float c[4];
+        };
+        inline Texel zeroTexel() { return Texel{ { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+        inline Texel loadTexel(const float* in) { return Texel{ { in[0], in[1], in[2], in[3] } }; }
+        inline void storeTexel(float* out, Texel value) { std::memcpy(out, value.c, sizeof(value.c)); }
+        inline Texel madd(Texel sum, Texel value, float weight) {
+            for (int c = 0; c < 4; c++) {
+                sum.c[c] += value.c[c] * weight;
+            }
+            return sum;
+        }
+        inline Texel texelFromBytes(const unsigned char* in) {
+            return Texel{ { float(in[0]), float(in[1]), float(in[2]), float(in[3]) } };
+        }
+        inline void texelToBytes(Texel value, unsigned char* out) {
+            for (int c = 0; c < 4; c++) {
+                out[c] = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, std::nearbyint(value.c[c]))));
+            }
+        }
+#endif
+
+        // Separable Kaiser: per target row, the vertical taps into a float row of the source
+        // width, then the horizontal taps out of it
+        void downsampleKaiser(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* target,
+                              int width, int height) {
+            const FilterTaps columns = kaiserTaps(sourceWidth, width);
+            const FilterTaps rows = kaiserTaps(sourceHeight, height);
+            std::vector<float> row(size_t(sourceWidth) * 4);
+            for (int y = 0; y < height; y++) {
+                const float* rowWeights = rows.weights.data() + rows.weightOffset[y];
+                for (int x = 0; x < sourceWidth; x++) {
+                    Texel sum = zeroTexel();
+                    for (int tap = 0; tap < rows.count[y]; tap++) {
+                        const int sourceY = std::min(std::max(rows.first[y] + tap, 0), sourceHeight - 1);
+                        sum = madd(sum, texelFromBytes(source + (size_t(sourceY) * sourceWidth + x) * 4),
+                                   rowWeights[tap]);
+                    }
+                    storeTexel(row.data() + 4 * x, sum);
+                }
+                unsigned char* out = target + size_t(y) * width * 4;
+                for (int x = 0; x < width; x++) {
+                    const float* columnWeights = columns.weights.data() + columns.weightOffset[x];
+                    Texel sum = zeroTexel();
+                    for (int tap = 0; tap < columns.count[x]; tap++) {
+                        const int sourceX = std::min(std::max(columns.first[x] + tap, 0), sourceWidth - 1);
+                        sum = madd(sum, loadTexel(row.data() + 4 * sourceX), columnWeights[tap]);
+                    }
+                    texelToBytes(sum, out + 4 * x);
+                }
+            }
+        }
+    }
+
+    bool expandToRGBA8(DecodedImage& image) {
+        if (!image.pixels || image.compressedFormat != 0 || !image.levels.empty()) {
+            return false;
+        }
+        if (image.components == 4) {
+            return true;
+        }
+        const size_t count = size_t(image.width) * image.height;
+        unsigned char* rgba = static_cast<unsigned char*>(std::malloc(count * 4));
+        if (!rgba) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (image.components == 1) {
+                rgba[4 * i + 0] = rgba[4 * i + 1] = rgba[4 * i + 2] = image.pixels[i];
+            } else {
+                std::memcpy(rgba + 4 * i, image.pixels + 3 * i, 3);
+            }
+            rgba[4 * i + 3] = 255;
+        }
+        releaseImage(image);
+        image.pixels = rgba;
+        image.release = std::free;
+        image.components = 4;
+        return true;
+    }
+
+    bool generateMipChain(DecodedImage& image, MipFilter filter) {
+        if (!image.pixels || image.components != 4 || image.compressedFormat != 0 || !image.levels.empty()) {
+            return false;
+        }
+        std::vector<ImageLevel> levels;
+        size_t total = 0;
+        int width = image.width, height = image.height;
+        while (true) {
+            size_t size = size_t(width) * height * 4;
+            levels.push_back(ImageLevel{ width, height, total, size });
+            total += size;
+            if (width == 1 && height == 1) {
+                break;
+            }
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        unsigned char* pixels = static_cast<unsigned char*>(std::malloc(total));
+        if (!pixels) {
+            return false;
+        }
+        std::memcpy(pixels, image.pixels, levels[0].size);
+        for (size_t level = 1; level < levels.size(); level++) {
+            const ImageLevel& above = levels[level - 1];
+            if (filter == MipFilter::Kaiser) {
+                downsampleKaiser(pixels + above.offset, above.width, above.height, pixels + levels[level].offset,
+                                 levels[level].width, levels[level].height);
+            } else {
+                downsampleBox(pixels + above.offset, above.width, above.height, pixels + levels[level].offset,
+                              levels[level].width, levels[level].height);
+            }
+        }
+        releaseImage(image);
+        image.pixels = pixels;
+        image.release = std::free;
+        image.levels = levels;
+        return true;
+    }
+}
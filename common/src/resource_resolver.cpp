@@ -0,0 +1,165 @@
+#include "resource_resolver.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace Common {
+    namespace {
+        bool underRoot(const std::string& key, const std::string& root) {
+            if (root == ".") {
+                // the current directory holds every relative path that does not climb out
+                return key.compare(0, 3, "../") != 0 && key != ".." && (key.empty() || key[0] != '/');
+            }
+            return key.size() > root.size() && key.compare(0, root.size(), root) == 0 && key[root.size()] == '/';
+        }
+    }
+
+    std::string ResourceResolver::normalize(const std::string& path) {
+        std::vector<std::string> parts;
+        const bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+        std::string part;
+        for (size_t i = 0; i <= path.size(); i++) {
+            char c = i < path.size() ? path[i] : '/';
+            if (c != '/' && c != '\\') {
+                part += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                continue;
+            }
+            if (part.empty() || part == ".") {
+                // doubled separators and "." add nothing
+            } else if (part == ".." && !parts.empty() && parts.back() != "..") {
+                parts.pop_back();
+            } else if (part != ".." || !absolute) {
+                parts.push_back(part);
+            }
+            part.clear();
+        }
+
+        std::string key = absolute ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (i > 0) {
+                key += '/';
+            }
+            key += parts[i];
+        }
+        return key.empty() ? "." : key;
+    }
+
+    bool ResourceResolver::mount(const std::string& directory, const std::string& alias) {
+        namespace fs = std::filesystem;
+        const std::string root = normalize(directory);
+        const std::string aliasRoot = alias.empty() ? std::string() : normalize(alias);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (std::find(roots.begin(), roots.end(), root) != roots.end() || coversLocked(root)) {
+                return true;
+            }
+        }
+
+        std::error_code error;
+        if (!fs::is_directory(directory, error)) {
+            return false;
+        }
+        // Scanned outside the lock; only the merge below needs it
+        std::vector<std::pair<std::string, std::string>> scanned;
+        fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, error);
+        for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+            std::error_code typeError;
+            if (!it->is_regular_file(typeError)) {
+                continue;
+            }
+            std::string relative = it->path().lexically_relative(directory).generic_string();
+            scanned.emplace_back(relative, it->path().generic_string());
+        }
+        if (error) {
+            std::cout << "Warning: Could not scan resource directory " << directory << ": " << error.message() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& file : scanned) {
+            std::string key = normalize(root + "/" + file.first);
+            files.emplace(key, file.second);
+            if (!aliasRoot.empty()) {
+                files.emplace(normalize(aliasRoot + "/" + file.first), file.second);
+            }
+        }
+        roots.push_back(root);
+        if (!aliasRoot.empty()) {
+            roots.push_back(aliasRoot);
+        }
+        std::cout << "Indexed " << scanned.size() << " files under " << directory
+                  << (aliasRoot.empty() ? "" : " as " + aliasRoot) << std::endl;
+        return true;
+    }
+
+    bool ResourceResolver::coversLocked(const std::string& key) const {
+        for (const auto& root : roots) {
+            if (underRoot(key, root)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ResourceResolver::covers(const std::string& path) const {
+        std::string key = normalize(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        return coversLocked(key);
+    }
+
+    std::string ResourceResolver::find(const std::string& path) const {
+        std::string key = normalize(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = files.find(key);
+        return found == files.end() ? std::string() : found->second;
+    }
+
+    std::string ResourceResolver::findFirst(const std::vector<std::string>& candidates) const {
+        for (const auto& candidate : candidates) {
+            std::string path = find(candidate);
+            if (!path.empty()) {
+                return path;
+            }
+        }
+        return std::string();
+    }
+
+    void ResourceResolver::noteUnresolved(const std::string& path, const std::string& requestedBy) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : unresolved) {
+            if (entry.first == path && entry.second == requestedBy) {
+                return;
+            }
+        }
+        unresolved.emplace_back(path, requestedBy);
+    }
+
+    void ResourceResolver::reportUnresolved() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (unresolved.empty()) {
+            return;
+        }
+        std::cout << "Warning: " << unresolved.size() << " resource(s) not found in " << roots.size()
+                  << " indexed location(s):" << std::endl;
+        for (const auto& entry : unresolved) {
+            std::cout << "  " << entry.first;
+            if (!entry.second.empty()) {
+                std::cout << " (" << entry.second << ")";
+            }
+            std::cout << std::endl;
+        }
+        unresolved.clear();
+    }
+
+    size_t ResourceResolver::fileCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return files.size();
+    }
+
+    ResourceResolver& ResourceResolver::shared() {
+        static ResourceResolver resolver;
+        return resolver;
+    }
+}
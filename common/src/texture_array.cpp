@@ -0,0 +1,202 @@
+#include "texture_array.hpp"
+#include "compressed_texture.hpp"
+#include "mip_chain.hpp"
+#include "resource_resolver.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+namespace Common {
+    namespace {
+        void releaseImage(DecodedImage& image) {
+            if (image.pixels && image.release) {
+                image.release(image.pixels);
+            }
+            image.pixels = nullptr;
+        }
+
+        // Pixels ready for a page: RGBA8 or blocks, with their mip chain
+        bool prepareImage(DecodedImage& image) {
+            if (!image.pixels || image.width <= 0 || image.height <= 0) {
+                return false;
+            }
+            if (image.compressedFormat != 0 || !image.levels.empty()) {
+                return image.compressedFormat != 0 || image.components == 4;
+            }
+            return expandToRGBA8(image) && generateMipChain(image);
+        }
+    }
+
+    TextureArrayPages::TextureArrayPages(ThreadPool& pool) : pool(pool) {
+    }
+
+    size_t TextureArrayPages::add(const std::string& path, const ImageDecoder& decoder) {
+        const std::string key = ResourceResolver::normalize(path) + '|' + std::to_string(decoder.key);
+        auto known = byPath.find(key);
+        if (known != byPath.end()) {
+            return known->second;
+        }
+        images.push_back(Image{ path, decoder.decode, TextureLayer() });
+        byPath[key] = images.size() - 1;
+        return images.size() - 1;
+    }
+
+    TextureArrayPages::Build::~Build() {
+        for (auto& image : decoded) {
+            releaseImage(image);
+        }
+    }
+
+    void TextureArrayPages::build(int maxLayers) {
+        finish();
+        buildAsync(maxLayers);
+        finish();
+    }
+
+    void TextureArrayPages::buildAsync(int maxLayers) {
+        if (decoding || built == images.size()) {
+            return;
+        }
+        // the decoders ask which block formats can stay compressed; this is the GL thread
+        static bool formatsDetected = false;
+        if (!formatsDetected) {
+            detectCompressedTextureSupport();
+            formatsDetected = true;
+        }
+        std::shared_ptr<Build> batch = std::make_shared<Build>();
+        batch->first = built;
+        batch->maxLayers = maxLayers;
+        batch->decoded.resize(images.size() - built);
+        batch->ok.assign(batch->decoded.size(), 0);
+        for (size_t i = 0; i < batch->decoded.size(); i++) {
+            const Image& image = images[batch->first + i];
+            decodeTasks.push_back(pool.submit([batch, i, path = image.path, decode = image.decode]() {
+                batch->ok[i] = decode(path, batch->decoded[i]) && prepareImage(batch->decoded[i]);
+            }));
+        }
+        decoding = batch;
+    }
+
+    bool TextureArrayPages::uploadCompleted() {
+        if (!decoding) {
+            return false;
+        }
+        for (const auto& task : decodeTasks) {
+            if (task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return false;
+            }
+        }
+        finish();
+        return true;
+    }
+
+    void TextureArrayPages::finish() {
+        if (!decoding) {
+            return;
+        }
+        std::shared_ptr<Build> batch = decoding;
+        std::vector<std::future<void>> tasks;
+        tasks.swap(decodeTasks);
+        decoding.reset();
+        for (auto& task : tasks) {
+            task.get();  // rethrows what a decoder threw
+        }
+        uploadPages(*batch);
+    }
+
+    void TextureArrayPages::uploadPages(Build& batch) {
+        GLint limit = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &limit);
+        const int pageLayers = std::max(1, limit > 0 ? std::min(batch.maxLayers, int(limit)) : batch.maxLayers);
+
+        const size_t first = batch.first;
+        const std::vector<DecodedImage>& decoded = batch.decoded;
+        const std::vector<char>& ok = batch.ok;
+
+        // same GL format, size and level count share pages, in the order they were added
+        typedef std::tuple<unsigned int, int, int, size_t> PageKey;
+        std::map<PageKey, std::vector<size_t>> groups;
+        for (size_t i = 0; i < decoded.size(); i++) {
+            if (!ok[i]) {
+                std::cout << "Texture failed to load at path: " << images[first + i].path << std::endl;
+                continue;
+            }
+            const DecodedImage& image = decoded[i];
+            groups[PageKey(image.compressedFormat, image.width, image.height, image.levels.size())].push_back(i);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (const auto& group : groups) {
+            const std::vector<size_t>& members = group.second;
+            for (size_t start = 0; start < members.size(); start += pageLayers) {
+                const size_t count = std::min(members.size() - start, size_t(pageLayers));
+                const DecodedImage& shape = decoded[members[start]];
+                const GLsizei layers = (GLsizei)count;
+
+                unsigned int page = 0;
+                glGenTextures(1, &page);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, page);
+                for (size_t level = 0; level < shape.levels.size(); level++) {
+                    const ImageLevel& mip = shape.levels[level];
+                    if (shape.compressedFormat != 0) {
+                        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, shape.compressedFormat, mip.width,
+                                               mip.height, layers, 0, (GLsizei)(mip.size * count), nullptr);
+                    } else {
+                        glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, GL_RGBA8, mip.width, mip.height, layers, 0,
+                                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                    }
+                }
+                for (size_t member = 0; member < count; member++) {
+                    const size_t index = members[start + member];
+                    const DecodedImage& image = decoded[index];
+                    for (size_t level = 0; level < image.levels.size(); level++) {
+                        const ImageLevel& mip = image.levels[level];
+                        if (image.compressedFormat != 0) {
+                            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)member,
+                                                      mip.width, mip.height, 1, image.compressedFormat,
+                                                      (GLsizei)mip.size, image.pixels + mip.offset);
+                        } else {
+                            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)member, mip.width,
+                                            mip.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels + mip.offset);
+                        }
+                    }
+                    images[first + index].layer = TextureLayer{ page, (int)member };
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)shape.levels.size() - 1);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                                shape.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                pageTextures.push_back(page);
+                std::cout << "Texture array page: " << count << " layers of " << shape.width << "x" << shape.height
+                          << (shape.compressedFormat != 0 ? " (compressed)" : "") << std::endl;
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        built = first + decoded.size();
+    }
+
+    TextureLayer TextureArrayPages::layer(size_t index) const {
+        return index < built ? images[index].layer : TextureLayer();
+    }
+
+    void TextureArrayPages::clear() {
+        if (!pageTextures.empty()) {
+            glDeleteTextures((GLsizei)pageTextures.size(), pageTextures.data());
+        }
+        pageTextures.clear();
+        // decodes still running finish into a batch nobody reads
+        decoding.reset();
+        decodeTasks.clear();
+        images.clear();
+        byPath.clear();
+        built = 0;
+    }
+}
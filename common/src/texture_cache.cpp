@@ -0,0 +1,477 @@
+#include "texture_cache.hpp"
+#include "compressed_texture.hpp"
+#include "mesh_cache.hpp"
+#include "mip_chain.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+    static_assert(sizeof(CookedTextureHeader) == 48, "CookedTextureHeader layout must not have padding");
+    static_assert(sizeof(CookedTextureLevel) == 24, "CookedTextureLevel layout must not have padding");
+
+    namespace {
+        // Bump whenever the encoder or the mip filter change what they produce
+        const uint32_t kEncoderVersion = 2;
+
+        void releaseImage(DecodedImage& image) {
+            if (image.pixels && image.release) {
+                image.release(image.pixels);
+            }
+            image.pixels = nullptr;
+        }
+
+        size_t alignTo16(size_t offset) {
+            return (offset + 15) & ~size_t(15);
+        }
+
+        void flipRows(unsigned char* pixels, int width, int height) {
+            const size_t stride = size_t(width) * 4;
+            std::vector<unsigned char> row(stride);
+            for (int y = 0; y < height / 2; y++) {
+                unsigned char* top = pixels + size_t(y) * stride;
+                unsigned char* bottom = pixels + size_t(height - 1 - y) * stride;
+                std::memcpy(row.data(), top, stride);
+                std::memcpy(top, bottom, stride);
+                std::memcpy(bottom, row.data(), stride);
+            }
+        }
+
+#ifndef _WIN32
+        // munmap needs the length the release callback does not get
+        std::mutex mappedSizesMutex;
+        std::unordered_map<void*, size_t> mappedSizes;
+#endif
+
+        void unmapCookedFile(void* view) {
+#ifdef _WIN32
+            UnmapViewOfFile(view);
+#else
+            size_t size = 0;
+            {
+                std::lock_guard<std::mutex> lock(mappedSizesMutex);
+                auto it = mappedSizes.find(view);
+                if (it == mappedSizes.end()) {
+                    return;
+                }
+                size = it->second;
+                mappedSizes.erase(it);
+            }
+            munmap(view, size);
+#endif
+        }
+
+        // Read-only mapping of the whole file, release set to what frees it; where the file
+        // cannot be mapped it is read into malloc'd memory instead
+        unsigned char* readCookedFile(const std::string& path, size_t& size, void (*&release)(void*)) {
+#ifdef _WIN32
+            HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (handle != INVALID_HANDLE_VALUE) {
+                LARGE_INTEGER fileSize;
+                HANDLE mappingObject = nullptr;
+                if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart > 0
+                    && uint64_t(fileSize.QuadPart) == uint64_t(size_t(fileSize.QuadPart))) {
+                    mappingObject = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                }
+                CloseHandle(handle);
+                if (mappingObject) {
+                    // the view keeps the mapping alive
+                    void* view = MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0);
+                    CloseHandle(mappingObject);
+                    if (view) {
+                        size = static_cast<size_t>(fileSize.QuadPart);
+                        release = unmapCookedFile;
+                        return static_cast<unsigned char*>(view);
+                    }
+                }
+            }
+#else
+            int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor >= 0) {
+                struct stat status;
+                void* view = MAP_FAILED;
+                if (fstat(descriptor, &status) == 0 && status.st_size > 0
+                    && uint64_t(status.st_size) == uint64_t(size_t(status.st_size))) {
+                    size = static_cast<size_t>(status.st_size);
+                    view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                }
+                ::close(descriptor);
+                if (view != MAP_FAILED) {
+                    // read front to back once, straight into the upload
+                    madvise(view, size, MADV_SEQUENTIAL);
+                    std::lock_guard<std::mutex> lock(mappedSizesMutex);
+                    mappedSizes[view] = size;
+                    release = unmapCookedFile;
+                    return static_cast<unsigned char*>(view);
+                }
+            }
+#endif
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+            if (!file) {
+                return nullptr;
+            }
+            unsigned char* bytes = nullptr;
+            if (std::fseek(file, 0, SEEK_END) == 0) {
+                long end = std::ftell(file);
+                size = end > 0 ? static_cast<size_t>(end) : 0;
+                bytes = size > 0 && seekFile(file, 0) ? static_cast<unsigned char*>(std::malloc(size)) : nullptr;
+                if (bytes && std::fread(bytes, 1, size, file) != size) {
+                    std::free(bytes);
+                    bytes = nullptr;
+                }
+            }
+            std::fclose(file);
+            release = std::free;
+            return bytes;
+        }
+
+        BlockFormat blockFormatFor(CookedTextureFormat format, const DecodedImage& image) {
+            if (format == CookedTextureFormat::BC3) {
+                return BlockFormat::BC3;
+            }
+            if (format == CookedTextureFormat::BC7) {
+                return BlockFormat::BC7;
+            }
+            if (format == CookedTextureFormat::Auto) {
+                const size_t texels = size_t(image.width) * image.height;
+                for (size_t i = 0; i < texels; i++) {
+                    if (image.pixels[4 * i + 3] != 255) {
+                        return BlockFormat::BC3;
+                    }
+                }
+            }
+            return BlockFormat::BC1;
+        }
+
+        // Every level of an RGBA8 mip chain encoded into cooked
+        bool encodeMipChain(const DecodedImage& image, BlockFormat format, TextureCompressionPreset preset,
+                            ThreadPool& pool, DecodedImage& cooked) {
+            size_t total = 0;
+            for (const auto& level : image.levels) {
+                size_t size = compressedLevelSize(format, level.width, level.height);
+                cooked.levels.push_back(ImageLevel{ level.width, level.height, total, size });
+                total += size;
+            }
+            cooked.pixels = static_cast<unsigned char*>(std::malloc(total));
+            cooked.release = std::free;
+            if (!cooked.pixels) {
+                return false;
+            }
+            for (size_t level = 0; level < image.levels.size(); level++) {
+                const ImageLevel& pixels = image.levels[level];
+                encodeBlocks(format, image.pixels + pixels.offset, pixels.width, pixels.height,
+                             cooked.pixels + cooked.levels[level].offset, preset, pool);
+            }
+            cooked.width = image.width;
+            cooked.height = image.height;
+            cooked.components = 4;
+            cooked.compressedFormat = blockGLFormat(format);
+            return true;
+        }
+
+        // Header and level table agree with each other and with a file of fileSize bytes
+        bool validCookedTexture(const CookedTextureHeader& header, const std::vector<CookedTextureLevel>& levels,
+                                uint64_t fileSize, BlockFormat& format) {
+            const bool compressed = header.glFormat != 0;
+            bool ok = header.magic == COOKED_TEXTURE_MAGIC && header.version == COOKED_TEXTURE_VERSION
+                && header.levelCount > 0 && header.levelCount <= 32 && levels.size() == header.levelCount
+                && (!compressed || blockFormatFromGL(header.glFormat, format));
+            for (size_t level = 0; level < levels.size() && ok; level++) {
+                const CookedTextureLevel& entry = levels[level];
+                ok = entry.size == (compressed ? compressedLevelSize(format, entry.width, entry.height)
+                                               : uint64_t(entry.width) * entry.height * 4)
+                    && entry.offset <= fileSize && entry.size <= fileSize - entry.offset;
+            }
+            return ok;
+        }
+
+        bool readHeader(std::FILE* file, CookedTextureHeader& header) {
+            return std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == COOKED_TEXTURE_MAGIC
+                && header.version == COOKED_TEXTURE_VERSION;
+        }
+
+        // The cooked file at path was made from this source with these settings; exists tells
+        // a stale file from a missing one
+        bool cookedFileCurrent(const std::string& path, uint64_t sourceHash, uint64_t settingsHash, bool& exists) {
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+            exists = file != nullptr;
+            if (!file) {
+                return false;
+            }
+            CookedTextureHeader header;
+            bool current = readHeader(file, header) && header.sourceHash == sourceHash
+                && header.settingsHash == settingsHash;
+            std::fclose(file);
+            return current;
+        }
+
+        // Writes header, level table and level data; the header goes last, so a file that
+        // was not finished never validates
+        bool writeCookedTexture(const std::string& path, const DecodedImage& image, uint64_t sourceHash,
+                                uint64_t settingsHash) {
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if (!file) {
+                return false;
+            }
+            CookedTextureHeader header;
+            std::memset(&header, 0, sizeof(header));
+            bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+            std::vector<CookedTextureLevel> levels;
+            size_t offset = alignTo16(sizeof(header) + image.levels.size() * sizeof(CookedTextureLevel));
+            for (const auto& level : image.levels) {
+                CookedTextureLevel entry = { static_cast<uint32_t>(level.width), static_cast<uint32_t>(level.height),
+                                             offset, level.size };
+                levels.push_back(entry);
+                offset = alignTo16(offset + level.size);
+            }
+            ok = ok && std::fwrite(levels.data(), sizeof(CookedTextureLevel), levels.size(), file) == levels.size();
+            for (size_t level = 0; level < levels.size() && ok; level++) {
+                ok = seekFile(file, levels[level].offset)
+                    && std::fwrite(image.pixels + image.levels[level].offset, 1, image.levels[level].size, file)
+                        == image.levels[level].size;
+            }
+
+            header.magic = COOKED_TEXTURE_MAGIC;
+            header.version = COOKED_TEXTURE_VERSION;
+            header.sourceHash = sourceHash;
+            header.settingsHash = settingsHash;
+            header.glFormat = image.compressedFormat;
+            header.width = static_cast<uint32_t>(image.width);
+            header.height = static_cast<uint32_t>(image.height);
+            header.levelCount = static_cast<uint32_t>(levels.size());
+            header.levelOffset = sizeof(header);
+            ok = ok && seekFile(file, 0) && std::fwrite(&header, sizeof(header), 1, file) == 1;
+            ok = std::fclose(file) == 0 && ok;
+            if (!ok) {
+                std::remove(path.c_str());
+            }
+            return ok;
+        }
+    }
+
+    uint64_t TextureCookSettings::hash() const {
+        const uint32_t key[6] = { kEncoderVersion, static_cast<uint32_t>(format), static_cast<uint32_t>(preset),
+                                  static_cast<uint32_t>(mipFilter), flipVertically ? 1u : 0u, 0 };
+        return hashBytes(key, sizeof(key));
+    }
+
+    std::string cookedTexturePath(const std::string& source) {
+        return source + ".ctex";
+    }
+
+    std::string cookTexture(const std::string& source, ImageDecodeFunction decode, const TextureCookSettings& settings,
+                            ThreadPool& pool) {
+        if (isCompressedTextureFile(source)) {
+            return "";
+        }
+        uint64_t sourceHash = 0;
+        if (!hashFile(source, sourceHash)) {
+            return "";
+        }
+        const uint64_t settingsHash = settings.hash();
+        const std::string path = cookedTexturePath(source);
+        bool exists = false;
+        if (cookedFileCurrent(path, sourceHash, settingsHash, exists)) {
+            return path;
+        }
+        if (exists) {
+            std::cout << "Texture cache is stale, re-cooking: " << path << std::endl;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        DecodedImage image;
+        if (!decode(source, image) || !image.pixels || image.compressedFormat != 0 || !image.levels.empty()
+            || !expandToRGBA8(image)) {
+            releaseImage(image);
+            return "";
+        }
+        if (settings.flipVertically) {
+            flipRows(image.pixels, image.width, image.height);
+        }
+        if (!generateMipChain(image, settings.mipFilter)) {
+            releaseImage(image);
+            return "";
+        }
+
+        DecodedImage cooked;
+        if (settings.format == CookedTextureFormat::RGBA8) {
+            // the mip chain as it is
+            cooked = image;
+            image.pixels = nullptr;
+        } else if (!encodeMipChain(image, blockFormatFor(settings.format, image), settings.preset, pool, cooked)) {
+            releaseImage(image);
+            return "";
+        }
+        releaseImage(image);
+
+        // written under a name of its own and renamed into place, so a reader never sees a
+        // partial file and two threads cooking the same image cannot interleave their writes
+        const std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+            + ".tmp";
+        bool written = writeCookedTexture(temporary, cooked, sourceHash, settingsHash);
+        if (written && std::rename(temporary.c_str(), path.c_str()) != 0) {
+            // Windows does not rename over an existing file
+            std::remove(path.c_str());
+            written = std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if (!written) {
+            std::remove(temporary.c_str());
+        }
+        releaseImage(cooked);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!written) {
+            // a missing cache only means the source image is loaded instead
+            std::cout << "Warning: Could not write texture cache: " << path << std::endl;
+            return "";
+        }
+        std::cout << "Cooked texture: " << path << " (" << cooked.width << "x" << cooked.height << ", "
+                  << cooked.levels.size() << " levels, " << ms << " ms)" << std::endl;
+        return path;
+    }
+
+    std::string findCookedTexture(const std::string& source, const TextureCookSettings& settings) {
+        uint64_t sourceHash = 0;
+        bool exists = false;
+        if (isCompressedTextureFile(source) || !hashFile(source, sourceHash)) {
+            return "";
+        }
+        const std::string path = cookedTexturePath(source);
+        return cookedFileCurrent(path, sourceHash, settings.hash(), exists) ? path : "";
+    }
+
+    ImageDecoder cookingDecoder(ImageDecoder decode, const TextureCookSettings& settings) {
+        if (!settings.enabled) {
+            return decode;
+        }
+        const uint64_t settingsHash = settings.hash();
+        const ImageDecodeFunction inner = decode.decode;
+        return ImageDecoder([inner, settings](const std::string& source, DecodedImage& image) {
+            const std::string cooked = cookTexture(source, inner, settings, cookingPool());
+            if (!cooked.empty() && loadCookedTexture(cooked, image)) {
+                return true;
+            }
+            return inner(source, image);
+        }, hashBytes(&settingsHash, sizeof(settingsHash), decode.key));
+    }
+
+    ThreadPool& cookingPool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    bool loadCookedTexture(const std::string& path, DecodedImage& image) {
+        size_t fileSize = 0;
+        void (*release)(void*) = nullptr;
+        unsigned char* bytes = readCookedFile(path, fileSize, release);
+        if (!bytes) {
+            return false;
+        }
+        CookedTextureHeader header;
+        std::memset(&header, 0, sizeof(header));
+        if (fileSize >= sizeof(header)) {
+            std::memcpy(&header, bytes, sizeof(header));
+        }
+        BlockFormat format = BlockFormat::BC1;
+        std::vector<CookedTextureLevel> levels;
+        bool ok = header.levelCount <= 32
+            && header.levelOffset + uint64_t(header.levelCount) * sizeof(CookedTextureLevel) <= fileSize;
+        if (ok) {
+            levels.resize(header.levelCount);
+            std::memcpy(levels.data(), bytes + header.levelOffset, levels.size() * sizeof(CookedTextureLevel));
+        }
+        if (!ok || !validCookedTexture(header, levels, fileSize, format)) {
+            release(bytes);
+            std::cout << "Texture cache is corrupt: " << path << std::endl;
+            return false;
+        }
+        const bool compressed = header.glFormat != 0;
+
+        image.width = static_cast<int>(header.width);
+        image.height = static_cast<int>(header.height);
+        image.components = 4;
+        image.levels.clear();
+        if (!compressed || compressedFormatSupported(format)) {
+            // the levels stay where they are in the file
+            for (const auto& level : levels) {
+                image.levels.push_back(ImageLevel{ static_cast<int>(level.width), static_cast<int>(level.height),
+                                                   static_cast<size_t>(level.offset), static_cast<size_t>(level.size) });
+            }
+            image.pixels = bytes;
+            image.release = release;
+            image.compressedFormat = header.glFormat;
+            return true;
+        }
+
+        // blocks the GL cannot take are decoded here, on the worker, level by level
+        size_t total = 0;
+        for (const auto& level : levels) {
+            size_t size = size_t(level.width) * level.height * 4;
+            image.levels.push_back(ImageLevel{ static_cast<int>(level.width), static_cast<int>(level.height), total, size });
+            total += size;
+        }
+        unsigned char* pixels = static_cast<unsigned char*>(std::malloc(total));
+        for (size_t level = 0; level < levels.size() && pixels; level++) {
+            decodeBlocks(format, bytes + levels[level].offset, levels[level].width, levels[level].height,
+                         pixels + image.levels[level].offset);
+        }
+        release(bytes);
+        if (!pixels) {
+            image.levels.clear();
+            return false;
+        }
+        image.pixels = pixels;
+        image.release = std::free;
+        image.compressedFormat = 0;
+        return true;
+    }
+
+    bool readCookedTextureLevels(const std::string& path, CookedTextureHeader& header,
+                                 std::vector<CookedTextureLevel>& levels) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        bool ok = readHeader(file, header) && header.levelCount > 0 && header.levelCount <= 32;
+        if (ok) {
+            levels.resize(header.levelCount);
+            ok = seekFile(file, header.levelOffset)
+                && std::fread(levels.data(), sizeof(CookedTextureLevel), levels.size(), file) == levels.size();
+        }
+        uint64_t fileSize = 0;
+        if (ok && std::fseek(file, 0, SEEK_END) == 0) {
+            fileSize = static_cast<uint64_t>(std::ftell(file));
+        }
+        std::fclose(file);
+        BlockFormat format;
+        if (!ok || !validCookedTexture(header, levels, fileSize, format)) {
+            std::cout << "Texture cache is corrupt: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
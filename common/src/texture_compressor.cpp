@@ -0,0 +1,779 @@
+#include "texture_compressor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Common {
+    namespace {
+        typedef float Texels[16][4];  // RGBA, 0..255
+
+        void fetchBlock(const unsigned char* rgba, int width, int height, int bx, int by, Texels texels) {
+            for (int y = 0; y < 4; y++) {
+                const int row = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    const unsigned char* texel = rgba + (size_t(row) * width + std::min(bx * 4 + x, width - 1)) * 4;
+                    for (int c = 0; c < 4; c++) {
+                        texels[y * 4 + x][c] = texel[c];
+                    }
+                }
+            }
+        }
+
+        float clampChannel(float value) {
+            return std::min(255.0f, std::max(0.0f, value));
+        }
+
+        // Line through the texels: their mean and direction, over the first `channels`
+        // channels. Fast takes the bounding box diagonal (oriented by the covariance signs),
+        // the others the principal axis by power iteration.
+        void fitLine(const Texels texels, const int* members, int count, int channels, bool principal,
+                     float mean[4], float axis[4]) {
+            float low[4], high[4];
+            for (int c = 0; c < 4; c++) {
+                mean[c] = 0.0f;
+                axis[c] = 0.0f;
+                low[c] = 255.0f;
+                high[c] = 0.0f;
+            }
+            for (int i = 0; i < count; i++) {
+                for (int c = 0; c < channels; c++) {
+                    float value = texels[members[i]][c];
+                    mean[c] += value;
+                    low[c] = std::min(low[c], value);
+                    high[c] = std::max(high[c], value);
+                }
+            }
+            for (int c = 0; c < channels; c++) {
+                mean[c] /= count;
+            }
+            float covariance[4][4] = {};
+            for (int i = 0; i < count; i++) {
+                float d[4];
+                for (int c = 0; c < channels; c++) {
+                    d[c] = texels[members[i]][c] - mean[c];
+                }
+                for (int a = 0; a < channels; a++) {
+                    for (int b = a; b < channels; b++) {
+                        covariance[a][b] += d[a] * d[b];
+                    }
+                }
+            }
+            for (int a = 0; a < channels; a++) {
+                for (int b = 0; b < a; b++) {
+                    covariance[a][b] = covariance[b][a];
+                }
+            }
+
+            if (!principal) {
+                // the widest channel leads; the others follow the sign of their covariance with it
+                int lead = 0;
+                for (int c = 1; c < channels; c++) {
+                    if (high[c] - low[c] > high[lead] - low[lead]) {
+                        lead = c;
+                    }
+                }
+                for (int c = 0; c < channels; c++) {
+                    axis[c] = (high[c] - low[c]) * (c != lead && covariance[lead][c] < 0.0f ? -1.0f : 1.0f);
+                }
+                return;
+            }
+            for (int c = 0; c < channels; c++) {
+                axis[c] = high[c] - low[c];
+            }
+            for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (int a = 0; a < channels; a++) {
+                    for (int b = 0; b < channels; b++) {
+                        next[a] += covariance[a][b] * axis[b];
+                    }
+                }
+                float length = 0.0f;
+                for (int c = 0; c < channels; c++) {
+                    length = std::max(length, std::fabs(next[c]));
+                }
+                if (length < 1e-6f) {
+                    break;
+                }
+                for (int c = 0; c < channels; c++) {
+                    axis[c] = next[c] / length;
+                }
+            }
+        }
+
+        // Endpoints at the extreme projections of the texels onto the line
+        void lineEndpoints(const Texels texels, const int* members, int count, int channels, const float mean[4],
+                           const float axis[4], float endpoints[2][4]) {
+            float lengthSquared = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                lengthSquared += axis[c] * axis[c];
+            }
+            float low = 0.0f, high = 0.0f;
+            if (lengthSquared > 1e-6f) {
+                for (int i = 0; i < count; i++) {
+                    float t = 0.0f;
+                    for (int c = 0; c < channels; c++) {
+                        t += (texels[members[i]][c] - mean[c]) * axis[c];
+                    }
+                    low = std::min(low, t / lengthSquared);
+                    high = std::max(high, t / lengthSquared);
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                endpoints[0][c] = c < channels ? clampChannel(mean[c] + low * axis[c]) : 255.0f;
+                endpoints[1][c] = c < channels ? clampChannel(mean[c] + high * axis[c]) : 255.0f;
+            }
+        }
+
+        // Least-squares endpoints for fixed interpolation weights (0 = first endpoint,
+        // 1 = second). False if the weights cannot separate two endpoints.
+        bool refineEndpoints(const Texels texels, const int* members, int count, int channels, const float* weights,
+                             float endpoints[2][4]) {
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < count; i++) {
+                float b = weights[i], a = 1.0f - b;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < channels; c++) {
+                    ax[c] += a * texels[members[i]][c];
+                    bx[c] += b * texels[members[i]][c];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) < 1e-6f) {
+                return false;
+            }
+            for (int c = 0; c < channels; c++) {
+                endpoints[0][c] = clampChannel((bb * ax[c] - ab * bx[c]) / determinant);
+                endpoints[1][c] = clampChannel((aa * bx[c] - ab * ax[c]) / determinant);
+            }
+            return true;
+        }
+
+        int refinementPasses(TextureCompressionPreset preset) {
+            return preset == TextureCompressionPreset::Fast ? 0 : (preset == TextureCompressionPreset::Balanced ? 1 : 8);
+        }
+
+        const int kAllTexels[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+        // ---- BC1 colour block (also the colour half of BC3) ---------------------------
+
+        uint16_t pack565(const float color[4]) {
+            int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+            int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+            int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void unpack565(uint16_t color, int rgb[3]) {
+            int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+            rgb[0] = (r << 3) | (r >> 2);
+            rgb[1] = (g << 2) | (g >> 4);
+            rgb[2] = (b << 3) | (b >> 2);
+        }
+
+        struct ColorBlock {
+            uint16_t color0;
+            uint16_t color1;
+            uint32_t indices;
+            float error;
+            float weights[16];  // of each texel's pick, for the refinement
+        };
+
+        // Quantizes the endpoints and picks each texel's palette entry. color0 > color1 keeps
+        // BC1 in its 4-colour mode; equal endpoints leave every index at 0.
+        ColorBlock fitColorIndices(const Texels texels, const float endpoints[2][4]) {
+            static const float kWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            ColorBlock block;
+            block.color0 = pack565(endpoints[0]);
+            block.color1 = pack565(endpoints[1]);
+            if (block.color0 < block.color1) {
+                std::swap(block.color0, block.color1);
+            }
+            int palette[4][3];
+            unpack565(block.color0, palette[0]);
+            unpack565(block.color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            const int entries = block.color0 == block.color1 ? 1 : 4;
+            block.indices = 0;
+            block.error = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                float bestError = 1e30f;
+                for (int entry = 0; entry < entries; entry++) {
+                    float error = 0.0f;
+                    for (int c = 0; c < 3; c++) {
+                        float d = texels[i][c] - palette[entry][c];
+                        error += d * d;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        best = entry;
+                    }
+                }
+                block.indices |= uint32_t(best) << (2 * i);
+                block.error += bestError;
+                block.weights[i] = kWeights[best];
+            }
+            return block;
+        }
+
+        ColorBlock encodeColorBlock(const Texels texels, TextureCompressionPreset preset) {
+            float mean[4], axis[4], endpoints[2][4];
+            fitLine(texels, kAllTexels, 16, 3, preset != TextureCompressionPreset::Fast, mean, axis);
+            lineEndpoints(texels, kAllTexels, 16, 3, mean, axis, endpoints);
+            ColorBlock best = fitColorIndices(texels, endpoints);
+            for (int pass = 0; pass < refinementPasses(preset) && best.error > 0.0f; pass++) {
+                // the weights follow the block's own endpoint order, so the refit comes out in it
+                if (!refineEndpoints(texels, kAllTexels, 16, 3, best.weights, endpoints)) {
+                    break;
+                }
+                ColorBlock candidate = fitColorIndices(texels, endpoints);
+                if (candidate.error >= best.error) {
+                    break;
+                }
+                best = candidate;
+            }
+            return best;
+        }
+
+        void writeColorBlock(const ColorBlock& block, unsigned char* out) {
+            out[0] = static_cast<unsigned char>(block.color0);
+            out[1] = static_cast<unsigned char>(block.color0 >> 8);
+            out[2] = static_cast<unsigned char>(block.color1);
+            out[3] = static_cast<unsigned char>(block.color1 >> 8);
+            for (int i = 0; i < 4; i++) {
+                out[4 + i] = static_cast<unsigned char>(block.indices >> (8 * i));
+            }
+        }
+
+        // ---- BC3 alpha block ------------------------------------------------------------
+
+        // Palette of an alpha block, the same arithmetic as the decoder
+        void alphaPalette(int a0, int a1, int palette[8]) {
+            palette[0] = a0;
+            palette[1] = a1;
+            if (a0 > a1) {
+                for (int i = 1; i < 7; i++) {
+                    palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+                }
+            } else {
+                for (int i = 1; i < 5; i++) {
+                    palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        int fitAlphaIndices(const Texels texels, int a0, int a1, uint64_t& indices) {
+            int palette[8];
+            alphaPalette(a0, a1, palette);
+            indices = 0;
+            int total = 0;
+            for (int i = 0; i < 16; i++) {
+                int alpha = static_cast<int>(texels[i][3]);
+                int best = 0, bestError = 1 << 30;
+                for (int entry = 0; entry < 8; entry++) {
+                    int error = (alpha - palette[entry]) * (alpha - palette[entry]);
+                    if (error < bestError) {
+                        bestError = error;
+                        best = entry;
+                    }
+                }
+                indices |= uint64_t(best) << (3 * i);
+                total += bestError;
+            }
+            return total;
+        }
+
+        void encodeAlphaBlock(const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+            for (int i = 0; i < 16; i++) {
+                int alpha = static_cast<int>(texels[i][3]);
+                low = std::min(low, alpha);
+                high = std::max(high, alpha);
+                if (alpha != 0 && alpha != 255) {
+                    innerLow = std::min(innerLow, alpha);
+                    innerHigh = std::max(innerHigh, alpha);
+                }
+            }
+            // 8-value mode over the full range
+            int a0 = high, a1 = low;
+            uint64_t indices;
+            int error = fitAlphaIndices(texels, a0, a1, indices);
+            // 6-value mode: exact 0 and 255 come free, the rest spans only the inner values
+            if (preset != TextureCompressionPreset::Fast && error > 0 && innerLow <= innerHigh
+                && (low == 0 || high == 255)) {
+                uint64_t inner;
+                int innerError = fitAlphaIndices(texels, innerLow, innerHigh, inner);
+                if (innerError < error) {
+                    a0 = innerLow;
+                    a1 = innerHigh;
+                    indices = inner;
+                }
+            }
+            out[0] = static_cast<unsigned char>(a0);
+            out[1] = static_cast<unsigned char>(a1);
+            for (int i = 0; i < 6; i++) {
+                out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+            }
+        }
+
+        // ---- BC7 ------------------------------------------------------------------------
+
+        const int kBC7Weights2[4] = { 0, 21, 43, 64 };
+        const int kBC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        const int kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        class BitWriter {
+        public:
+            explicit BitWriter(unsigned char* out) : bytes(out), position(0) {
+                std::memset(bytes, 0, 16);
+            }
+            void write(unsigned int value, int count) {
+                for (int i = 0; i < count; i++, position++) {
+                    bytes[position >> 3] |= static_cast<unsigned char>(((value >> i) & 1u) << (position & 7));
+                }
+            }
+        private:
+            unsigned char* bytes;
+            int position;
+        };
+
+        const int* bc7Weights(int indexBits) {
+            return indexBits == 2 ? kBC7Weights2 : (indexBits == 3 ? kBC7Weights3 : kBC7Weights4);
+        }
+
+        // One subset of a BC7 mode: endpoints of `bits` bits per channel, maybe with a p-bit,
+        // interpolated with `indexBits`-bit weights
+        struct BC7SubsetLayout {
+            int channels;      // 4: RGBA, 3: RGB (alpha is 255, or encoded apart)
+            int bits;
+            int pBits;         // 0: none, 1: one per endpoint, 2: one shared by both endpoints
+            int indexBits;
+        };
+
+        struct BC7Subset {
+            int quantized[2][4];  // endpoint values without the p-bit
+            int pBits[2];
+            int decoded[2][4];
+            unsigned char indices[16];  // per member
+            float error;
+        };
+
+        int expandBC7(int value, int precision) {
+            value <<= 8 - precision;
+            return value | (value >> precision);
+        }
+
+        // Quantizes one endpoint for p-bit p (0 without p-bits); returns the squared error
+        float quantizeBC7Endpoint(const float endpoint[4], int p, const BC7SubsetLayout& layout, int quantized[4],
+                                  int decoded[4]) {
+            const int maximum = (1 << layout.bits) - 1;
+            const int pBit = layout.pBits ? 1 : 0;
+            const int precision = layout.bits + pBit;
+            float error = 0.0f;
+            for (int c = 0; c < layout.channels; c++) {
+                int estimate = static_cast<int>(
+                    std::floor((endpoint[c] * ((1 << precision) - 1) / 255.0f - p) / (1 << pBit) + 0.5f));
+                int best = 0;
+                float bestError = 1e30f;
+                for (int q = std::max(0, estimate - 1); q <= std::min(maximum, estimate + 1); q++) {
+                    int value = expandBC7((q << pBit) | p, precision);
+                    float d = endpoint[c] - value;
+                    if (d * d < bestError) {
+                        bestError = d * d;
+                        best = q;
+                    }
+                }
+                quantized[c] = best;
+                decoded[c] = expandBC7((best << pBit) | p, precision);
+                error += bestError;
+            }
+            for (int c = layout.channels; c < 4; c++) {
+                quantized[c] = maximum;
+                decoded[c] = 255;
+            }
+            return error;
+        }
+
+        void quantizeBC7Subset(const float endpoints[2][4], const BC7SubsetLayout& layout, BC7Subset& subset) {
+            if (layout.pBits == 0) {
+                quantizeBC7Endpoint(endpoints[0], 0, layout, subset.quantized[0], subset.decoded[0]);
+                quantizeBC7Endpoint(endpoints[1], 0, layout, subset.quantized[1], subset.decoded[1]);
+                subset.pBits[0] = subset.pBits[1] = 0;
+                return;
+            }
+            if (layout.pBits == 2) {
+                float bestError = 1e30f;
+                for (int p = 0; p < 2; p++) {
+                    int quantized[2][4], decoded[2][4];
+                    float error = quantizeBC7Endpoint(endpoints[0], p, layout, quantized[0], decoded[0])
+                        + quantizeBC7Endpoint(endpoints[1], p, layout, quantized[1], decoded[1]);
+                    if (error < bestError) {
+                        bestError = error;
+                        std::memcpy(subset.quantized, quantized, sizeof(quantized));
+                        std::memcpy(subset.decoded, decoded, sizeof(decoded));
+                        subset.pBits[0] = subset.pBits[1] = p;
+                    }
+                }
+                return;
+            }
+            for (int e = 0; e < 2; e++) {
+                float bestError = 1e30f;
+                for (int p = 0; p < 2; p++) {
+                    int quantized[4], decoded[4];
+                    float error = quantizeBC7Endpoint(endpoints[e], p, layout, quantized, decoded);
+                    if (error < bestError) {
+                        bestError = error;
+                        std::memcpy(subset.quantized[e], quantized, sizeof(quantized));
+                        std::memcpy(subset.decoded[e], decoded, sizeof(decoded));
+                        subset.pBits[e] = p;
+                    }
+                }
+            }
+        }
+
+        void fitBC7Indices(const Texels texels, const int* members, int count, const BC7SubsetLayout& layout,
+                           BC7Subset& subset, float* weights) {
+            const int* table = bc7Weights(layout.indexBits);
+            const int entries = 1 << layout.indexBits;
+            int palette[16][4];
+            for (int entry = 0; entry < entries; entry++) {
+                for (int c = 0; c < 4; c++) {
+                    palette[entry][c] = ((64 - table[entry]) * subset.decoded[0][c] + table[entry] * subset.decoded[1][c] + 32) >> 6;
+                }
+            }
+            subset.error = 0.0f;
+            for (int i = 0; i < count; i++) {
+                const float* texel = texels[members[i]];
+                int best = 0;
+                float bestError = 1e30f;
+                for (int entry = 0; entry < entries; entry++) {
+                    float error = 0.0f;
+                    for (int c = 0; c < layout.channels; c++) {
+                        float d = texel[c] - palette[entry][c];
+                        error += d * d;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        best = entry;
+                    }
+                }
+                subset.indices[i] = static_cast<unsigned char>(best);
+                subset.error += bestError;
+                weights[i] = table[best] / 64.0f;
+            }
+        }
+
+        BC7Subset encodeBC7Subset(const Texels texels, const int* members, int count, const BC7SubsetLayout& layout,
+                                  TextureCompressionPreset preset) {
+            float mean[4], axis[4], endpoints[2][4], weights[16];
+            fitLine(texels, members, count, layout.channels, preset != TextureCompressionPreset::Fast, mean, axis);
+            lineEndpoints(texels, members, count, layout.channels, mean, axis, endpoints);
+            BC7Subset best;
+            quantizeBC7Subset(endpoints, layout, best);
+            fitBC7Indices(texels, members, count, layout, best, weights);
+            for (int pass = 0; pass < refinementPasses(preset) && best.error > 0.0f; pass++) {
+                if (!refineEndpoints(texels, members, count, layout.channels, weights, endpoints)) {
+                    break;
+                }
+                BC7Subset candidate;
+                float candidateWeights[16];
+                quantizeBC7Subset(endpoints, layout, candidate);
+                fitBC7Indices(texels, members, count, layout, candidate, candidateWeights);
+                if (candidate.error >= best.error) {
+                    break;
+                }
+                best = candidate;
+                std::memcpy(weights, candidateWeights, sizeof(weights));
+            }
+            return best;
+        }
+
+        // The anchor texel's index is stored without its top bit, so it must be in the lower
+        // half: otherwise the endpoints swap and every index of the subset mirrors
+        void fixBC7Anchor(BC7Subset& subset, int count, int anchorMember, int indexBits) {
+            const int highest = (1 << indexBits) - 1;
+            if (subset.indices[anchorMember] <= highest / 2) {
+                return;
+            }
+            for (int c = 0; c < 4; c++) {
+                std::swap(subset.quantized[0][c], subset.quantized[1][c]);
+                std::swap(subset.decoded[0][c], subset.decoded[1][c]);
+            }
+            std::swap(subset.pBits[0], subset.pBits[1]);
+            for (int i = 0; i < count; i++) {
+                subset.indices[i] = static_cast<unsigned char>(highest - subset.indices[i]);
+            }
+        }
+
+        // Mode 6: one subset, RGBA 7.7.7.7 with a p-bit per endpoint, 4-bit indices
+        float encodeBC7Mode6(const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            const BC7SubsetLayout layout = { 4, 7, 1, 4 };
+            BC7Subset subset = encodeBC7Subset(texels, kAllTexels, 16, layout, preset);
+            fixBC7Anchor(subset, 16, 0, 4);
+            BitWriter bits(out);
+            bits.write(1u << 6, 7);
+            for (int c = 0; c < 4; c++) {
+                bits.write(subset.quantized[0][c], 7);
+                bits.write(subset.quantized[1][c], 7);
+            }
+            bits.write(subset.pBits[0], 1);
+            bits.write(subset.pBits[1], 1);
+            for (int i = 0; i < 16; i++) {
+                bits.write(subset.indices[i], i == 0 ? 3 : 4);
+            }
+            return subset.error;
+        }
+
+        // Alpha of mode 5: 8-bit endpoints and 2-bit indices of its own. Returns the error.
+        float encodeBC7Alpha(const Texels texels, TextureCompressionPreset preset, int endpoints[2],
+                             unsigned char indices[16]) {
+            endpoints[0] = endpoints[1] = 0;
+            float low = 255.0f, high = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                low = std::min(low, texels[i][3]);
+                high = std::max(high, texels[i][3]);
+            }
+            float bestError = 1e30f;
+            for (int pass = 0; pass <= refinementPasses(preset); pass++) {
+                int candidate[2] = { static_cast<int>(low + 0.5f), static_cast<int>(high + 0.5f) };
+                unsigned char picks[16];
+                float error = 0.0f, aa = 0.0f, ab = 0.0f, bb = 0.0f, ax = 0.0f, bx = 0.0f;
+                for (int i = 0; i < 16; i++) {
+                    int best = 0;
+                    float bestTexelError = 1e30f;
+                    for (int entry = 0; entry < 4; entry++) {
+                        int value = ((64 - kBC7Weights2[entry]) * candidate[0] + kBC7Weights2[entry] * candidate[1] + 32) >> 6;
+                        float d = texels[i][3] - value;
+                        if (d * d < bestTexelError) {
+                            bestTexelError = d * d;
+                            best = entry;
+                        }
+                    }
+                    picks[i] = static_cast<unsigned char>(best);
+                    error += bestTexelError;
+                    float b = kBC7Weights2[best] / 64.0f, a = 1.0f - b;
+                    aa += a * a;
+                    ab += a * b;
+                    bb += b * b;
+                    ax += a * texels[i][3];
+                    bx += b * texels[i][3];
+                }
+                if (error >= bestError) {
+                    break;
+                }
+                bestError = error;
+                endpoints[0] = candidate[0];
+                endpoints[1] = candidate[1];
+                std::memcpy(indices, picks, 16);
+                float determinant = aa * bb - ab * ab;
+                if (error == 0.0f || std::fabs(determinant) < 1e-6f) {
+                    break;
+                }
+                low = clampChannel((bb * ax - ab * bx) / determinant);
+                high = clampChannel((aa * bx - ab * ax) / determinant);
+            }
+            if (indices[0] > 1) {
+                std::swap(endpoints[0], endpoints[1]);
+                for (int i = 0; i < 16; i++) {
+                    indices[i] = static_cast<unsigned char>(3 - indices[i]);
+                }
+            }
+            return bestError;
+        }
+
+        // Mode 5: one subset, RGB 7.7.7 and alpha 8 with separate 2-bit indices, so alpha
+        // that does not follow the colour (cut-outs, masks) costs the colour nothing
+        float encodeBC7Mode5(const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            const BC7SubsetLayout layout = { 3, 7, 0, 2 };
+            BC7Subset color = encodeBC7Subset(texels, kAllTexels, 16, layout, preset);
+            fixBC7Anchor(color, 16, 0, 2);
+            int alphaEndpoints[2];
+            unsigned char alphaIndices[16];
+            float alphaError = encodeBC7Alpha(texels, preset, alphaEndpoints, alphaIndices);
+            BitWriter bits(out);
+            bits.write(1u << 5, 6);
+            bits.write(0, 2);  // no channel rotation
+            for (int c = 0; c < 3; c++) {
+                bits.write(color.quantized[0][c], 7);
+                bits.write(color.quantized[1][c], 7);
+            }
+            bits.write(alphaEndpoints[0], 8);
+            bits.write(alphaEndpoints[1], 8);
+            for (int i = 0; i < 16; i++) {
+                bits.write(color.indices[i], i == 0 ? 1 : 2);
+            }
+            for (int i = 0; i < 16; i++) {
+                bits.write(alphaIndices[i], i == 0 ? 1 : 2);
+            }
+            return color.error + alphaError;
+        }
+
+        // Error left after fitting each subset of a partition with a line: the variance off
+        // its principal axis, a cheap stand-in for a full encode when ranking partitions
+        float partitionLineError(const Texels texels, uint16_t partition) {
+            float total = 0.0f;
+            for (int s = 0; s < 2; s++) {
+                int members[16], count = 0;
+                for (int i = 0; i < 16; i++) {
+                    if (((partition >> i) & 1) == s) {
+                        members[count++] = i;
+                    }
+                }
+                float mean[4], axis[4];
+                fitLine(texels, members, count, 3, true, mean, axis);
+                float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+                for (int i = 0; i < count; i++) {
+                    float d[3], t = 0.0f, squared = 0.0f;
+                    for (int c = 0; c < 3; c++) {
+                        d[c] = texels[members[i]][c] - mean[c];
+                        t += d[c] * axis[c];
+                        squared += d[c] * d[c];
+                    }
+                    total += lengthSquared > 1e-6f ? squared - t * t / lengthSquared : squared;
+                }
+            }
+            return total;
+        }
+
+        // Mode 1: two subsets, RGB 6.6.6 with a p-bit shared per subset, 3-bit indices.
+        // Only for opaque blocks. Returns the error, or a huge one if nothing was written.
+        float encodeBC7Mode1(const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            const int kCandidates = 2;
+            int candidates[kCandidates] = { -1, -1 };
+            float candidateErrors[kCandidates] = { 1e30f, 1e30f };
+            for (int partition = 0; partition < 64; partition++) {
+                float error = partitionLineError(texels, BC7_PARTITIONS_2[partition]);
+                for (int slot = 0; slot < kCandidates; slot++) {
+                    if (error < candidateErrors[slot]) {
+                        for (int move = kCandidates - 1; move > slot; move--) {
+                            candidates[move] = candidates[move - 1];
+                            candidateErrors[move] = candidateErrors[move - 1];
+                        }
+                        candidates[slot] = partition;
+                        candidateErrors[slot] = error;
+                        break;
+                    }
+                }
+            }
+
+            const BC7SubsetLayout layout = { 3, 6, 2, 3 };
+            float bestError = 1e30f;
+            for (int candidate : candidates) {
+                if (candidate < 0) {
+                    continue;
+                }
+                const uint16_t partition = BC7_PARTITIONS_2[candidate];
+                int members[2][16], counts[2] = { 0, 0 };
+                for (int i = 0; i < 16; i++) {
+                    int s = (partition >> i) & 1;
+                    members[s][counts[s]++] = i;
+                }
+                BC7Subset subsets[2];
+                for (int s = 0; s < 2; s++) {
+                    subsets[s] = encodeBC7Subset(texels, members[s], counts[s], layout, preset);
+                }
+                float error = subsets[0].error + subsets[1].error;
+                if (error >= bestError) {
+                    continue;
+                }
+                bestError = error;
+
+                // anchors: texel 0 (always in subset 0) and the partition's anchor in subset 1
+                fixBC7Anchor(subsets[0], counts[0], 0, 3);
+                int anchorMember = 0;
+                while (members[1][anchorMember] != BC7_ANCHORS_2[candidate]) {
+                    anchorMember++;
+                }
+                fixBC7Anchor(subsets[1], counts[1], anchorMember, 3);
+
+                unsigned char indices[16];
+                for (int s = 0; s < 2; s++) {
+                    for (int i = 0; i < counts[s]; i++) {
+                        indices[members[s][i]] = subsets[s].indices[i];
+                    }
+                }
+                BitWriter bits(out);
+                bits.write(1u << 1, 2);
+                bits.write(candidate, 6);
+                for (int c = 0; c < 3; c++) {
+                    for (int s = 0; s < 2; s++) {
+                        bits.write(subsets[s].quantized[0][c], 6);
+                        bits.write(subsets[s].quantized[1][c], 6);
+                    }
+                }
+                bits.write(subsets[0].pBits[0], 1);
+                bits.write(subsets[1].pBits[0], 1);
+                for (int i = 0; i < 16; i++) {
+                    bool anchor = i == 0 || i == BC7_ANCHORS_2[candidate];
+                    bits.write(indices[i], anchor ? 2 : 3);
+                }
+            }
+            return bestError;
+        }
+
+        // Mode 6 always; beyond Fast, mode 5 for blocks with alpha and, at Quality, mode 1
+        // for opaque ones, keeping whichever decodes closest
+        void encodeBC7Block(const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            float error = encodeBC7Mode6(texels, preset, out);
+            if (preset == TextureCompressionPreset::Fast || error == 0.0f) {
+                return;
+            }
+            bool opaque = true;
+            for (int i = 0; i < 16; i++) {
+                opaque = opaque && texels[i][3] == 255.0f;
+            }
+            unsigned char candidate[16];
+            if (!opaque && encodeBC7Mode5(texels, preset, candidate) < error) {
+                std::memcpy(out, candidate, 16);
+            } else if (opaque && preset == TextureCompressionPreset::Quality
+                       && encodeBC7Mode1(texels, preset, candidate) < error) {
+                std::memcpy(out, candidate, 16);
+            }
+        }
+
+        void encodeBlock(BlockFormat format, const Texels texels, TextureCompressionPreset preset, unsigned char* out) {
+            switch (format) {
+            case BlockFormat::BC3:
+                encodeAlphaBlock(texels, preset, out);
+                writeColorBlock(encodeColorBlock(texels, preset), out + 8);
+                break;
+            case BlockFormat::BC7:
+                encodeBC7Block(texels, preset, out);
+                break;
+            default:
+                writeColorBlock(encodeColorBlock(texels, preset), out);
+                break;
+            }
+        }
+    }
+
+    void encodeBlocks(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* blocks,
+                      TextureCompressionPreset preset, ThreadPool& pool) {
+        const int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+        const size_t blockSize = blockBytes(format);
+        auto encodeRow = [&](size_t by) {
+            Texels texels;
+            for (int bx = 0; bx < blocksWide; bx++) {
+                fetchBlock(rgba, width, height, bx, static_cast<int>(by), texels);
+                encodeBlock(format, texels, preset, blocks + (by * blocksWide + bx) * blockSize);
+            }
+        };
+        // small levels are not worth a trip through the pool
+        if (size_t(blocksWide) * blocksHigh < 64) {
+            for (int by = 0; by < blocksHigh; by++) {
+                encodeRow(by);
+            }
+            return;
+        }
+        pool.parallelFor(blocksHigh, encodeRow);
+    }
+}
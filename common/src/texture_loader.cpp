@@ -0,0 +1,257 @@
+#include "texture_loader.hpp"
+#include "compressed_texture.hpp"
+#include "mesh_cache.hpp"
+#include "upload_context.hpp"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+
+namespace Common {
+    namespace {
+        struct CompletedTexture {
+            unsigned int texture;
+            std::string path;
+            DecodedImage image;
+            bool ok;
+        };
+
+        void releaseImage(DecodedImage& image) {
+            if (image.pixels && image.release) {
+                image.release(image.pixels);
+            }
+            image.pixels = nullptr;
+        }
+    }
+
+    size_t decodedImageSize(const DecodedImage& image) {
+        if (!image.levels.empty()) {
+            const ImageLevel& last = image.levels.back();
+            return last.offset + last.size;
+        }
+        return static_cast<size_t>(image.width) * image.height * image.components;
+    }
+
+    ImageDecoder::ImageDecoder(Function function) : decode(function), key(hashBytes(&function, sizeof(function))) {
+    }
+
+    void specifyTextureImage(const DecodedImage& image, const unsigned char* base) {
+        GLenum format = image.components == 1 ? GL_RED : (image.components == 3 ? GL_RGB : GL_RGBA);
+        // rows of RGB / single channel images are not 4-byte aligned in general
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (image.levels.empty()) {
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, base);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        } else {
+            for (size_t level = 0; level < image.levels.size(); level++) {
+                const ImageLevel& mip = image.levels[level];
+                const void* data = base ? static_cast<const void*>(base + mip.offset) : (const void*)mip.offset;
+                if (image.compressedFormat != 0) {
+                    glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.compressedFormat, mip.width, mip.height,
+                                           0, (GLsizei)mip.size, data);
+                } else {
+                    glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, mip.width, mip.height, 0, format,
+                                 GL_UNSIGNED_BYTE, data);
+                }
+            }
+            // a chain that stops early is still complete up to its last level
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                            image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    struct TextureLoader::State {
+        mutable std::mutex mutex;
+        std::condition_variable completedCondition;
+        std::deque<CompletedTexture> completed;
+        size_t pending = 0;
+        size_t uploading = 0;  // decoded images handed to an UploadContext
+        std::unordered_set<unsigned int> inFlight;   // textures whose load has not completed
+        std::unordered_set<unsigned int> discarded;  // in flight, delete once they complete
+        TextureLoaderStats stats;
+
+        // Render thread, when texture's load completes. True if it was discarded meanwhile
+        // and has just been deleted.
+        bool completeLoad(unsigned int texture) {
+            bool discard;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight.erase(texture);
+                discard = discarded.erase(texture) > 0;
+            }
+            if (discard) {
+                glDeleteTextures(1, &texture);
+            }
+            return discard;
+        }
+
+        ~State() {
+            // images decoded after the GL side went away are only freed
+            for (auto& texture : completed) {
+                releaseImage(texture.image);
+            }
+        }
+    };
+
+    TextureLoader::TextureLoader(ThreadPool& pool) : state(std::make_shared<State>()), pool(pool) {
+    }
+
+    TextureLoader::~TextureLoader() {
+    }
+
+    unsigned int TextureLoader::load(const std::string& path, ImageDecodeFunction decode, const unsigned char* placeholder) {
+        static const unsigned char grey[4] = { 128, 128, 128, 255 };
+        // the decoders ask which block formats can stay compressed; this is the GL thread
+        static bool formatsDetected = false;
+        if (!formatsDetected) {
+            detectCompressedTextureSupport();
+            formatsDetected = true;
+        }
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder ? placeholder : grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // no mip chain yet, so the placeholder must not ask for one
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        UploadContext* uploads = UploadContext::shared();
+        if (uploads) {
+            // the placeholder must land before the loader context replaces it
+            uploads->handOff();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->pending++;
+            state->stats.requested++;
+            state->inFlight.insert(texture);
+        }
+        std::shared_ptr<State> shared = state;
+        pool.submit([shared, texture, path, decode, uploads]() {
+            CompletedTexture result = { texture, path, DecodedImage(), false };
+            auto start = std::chrono::steady_clock::now();
+            result.ok = decode(path, result.image) && result.image.pixels && result.image.width > 0
+                && result.image.height > 0 && (result.image.components == 1 || result.image.components == 3
+                                               || result.image.components == 4);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->stats.decodeSeconds += seconds;
+            if (result.ok && uploads && !shared->discarded.count(texture)) {
+                // the loader thread re-specifies the texture; the render thread only
+                // hears back once its fence has signalled
+                shared->uploading++;
+                uploads->submit([uploads, result]() mutable {
+                    uploads->uploadTexture(result.texture, result.image);
+                    releaseImage(result.image);
+                }, [shared, result]() {
+                    {
+                        std::lock_guard<std::mutex> lock(shared->mutex);
+                        shared->uploading--;
+                        shared->pending--;
+                        shared->stats.uploaded++;
+                    }
+                    if (shared->completeLoad(result.texture)) {
+                        return;
+                    }
+                    std::cout << "Texture loaded successfully: " << result.path << " (" << result.image.width
+                              << "x" << result.image.height << ")" << std::endl;
+                });
+            } else {
+                shared->completed.push_back(result);
+            }
+            shared->completedCondition.notify_all();
+        });
+        return texture;
+    }
+
+    size_t TextureLoader::uploadCompleted(size_t maxUploads) {
+        size_t uploads = 0;
+        while (uploads < maxUploads) {
+            CompletedTexture texture;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->completed.empty()) {
+                    break;
+                }
+                texture = state->completed.front();
+                state->completed.pop_front();
+                state->pending--;
+                if (texture.ok) {
+                    state->stats.uploaded++;
+                } else {
+                    state->stats.failed++;
+                }
+            }
+            if (state->completeLoad(texture.texture)) {
+                releaseImage(texture.image);
+                continue;
+            }
+            if (!texture.ok) {
+                std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+                releaseImage(texture.image);
+                continue;
+            }
+
+            glBindTexture(GL_TEXTURE_2D, texture.texture);
+            specifyTextureImage(texture.image, texture.image.pixels);
+            releaseImage(texture.image);
+            uploads++;
+            std::cout << "Texture loaded successfully: " << texture.path << " (" << texture.image.width << "x"
+                      << texture.image.height << ")" << std::endl;
+        }
+        return uploads;
+    }
+
+    void TextureLoader::finish() {
+        while (true) {
+            uploadCompleted();
+            if (UploadContext* uploads = UploadContext::shared()) {
+                uploads->finish();
+            }
+            std::unique_lock<std::mutex> lock(state->mutex);
+            if (state->pending == 0) {
+                return;
+            }
+            state->completedCondition.wait(lock, [this]() {
+                return !state->completed.empty() || state->uploading > 0;
+            });
+        }
+    }
+
+    void TextureLoader::discard(unsigned int texture) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->inFlight.count(texture)) {
+                state->discarded.insert(texture);
+                return;
+            }
+        }
+        glDeleteTextures(1, &texture);
+    }
+
+    size_t TextureLoader::pendingCount() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->pending;
+    }
+
+    TextureLoaderStats TextureLoader::stats() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->stats;
+    }
+
+    TextureLoader& TextureLoader::shared() {
+        static TextureLoader loader;
+        return loader;
+    }
+}
@@ -0,0 +1,88 @@
+#include "texture_manager.hpp"
+#include "mesh_cache.hpp"
+#include "resource_resolver.hpp"
+
+namespace Common {
+    TextureManager::TextureManager(TextureLoader& loader) : loader(loader) {
+    }
+
+    unsigned int TextureManager::acquire(const std::string& path, const ImageDecoder& decoder) {
+        const std::string normalized = ResourceResolver::normalize(path);
+        const std::string key = pathKey(normalized, decoder.key);
+        auto known = byPath.find(key);
+        if (known != byPath.end()) {
+            entries[known->second].references++;
+            counters.pathHits++;
+            return known->second;
+        }
+
+        // A new spelling: the content hash decides whether it is a new image. Hashing is
+        // a mapped read of the file, far cheaper than the decode it can save.
+        uint64_t contentHash = 0;
+        if (!hashFile(path, contentHash)) {
+            return 0;
+        }
+        contentHash = hashBytes(&decoder.key, sizeof(decoder.key), contentHash);  // another decoder, another image
+        auto same = byContent.find(contentHash);
+        if (same != byContent.end()) {
+            Entry& entry = entries[same->second];
+            entry.references++;
+            entry.paths.push_back(normalized);
+            byPath[key] = same->second;
+            counters.contentHits++;
+            return same->second;
+        }
+
+        unsigned int texture = loader.load(path, decoder.decode);
+        Entry entry = { contentHash, decoder.key, 1, { normalized } };
+        entries[texture] = entry;
+        byPath[key] = texture;
+        byContent[contentHash] = texture;
+        counters.loads++;
+        return texture;
+    }
+
+    void TextureManager::addReference(unsigned int texture) {
+        auto found = entries.find(texture);
+        if (found != entries.end()) {
+            found->second.references++;
+        }
+    }
+
+    void TextureManager::release(unsigned int texture) {
+        auto found = entries.find(texture);
+        if (found == entries.end() || --found->second.references > 0) {
+            return;
+        }
+        for (const auto& path : found->second.paths) {
+            byPath.erase(pathKey(path, found->second.decoderKey));
+        }
+        byContent.erase(found->second.contentHash);
+        entries.erase(found);
+        loader.discard(texture);
+        counters.deleted++;
+    }
+
+    size_t TextureManager::referenceCount(unsigned int texture) const {
+        auto found = entries.find(texture);
+        return found == entries.end() ? 0 : found->second.references;
+    }
+
+    TextureManagerStats TextureManager::stats() const {
+        TextureManagerStats result = counters;
+        result.textures = entries.size();
+        for (const auto& entry : entries) {
+            result.references += entry.second.references;
+        }
+        return result;
+    }
+
+    std::string TextureManager::pathKey(const std::string& path, uint64_t decoderKey) {
+        return path + '|' + std::to_string(decoderKey);
+    }
+
+    TextureManager& TextureManager::shared() {
+        static TextureManager manager;
+        return manager;
+    }
+}
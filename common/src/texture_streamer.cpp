@@ -0,0 +1,428 @@
+#include "texture_streamer.hpp"
+#include "mesh_cache.hpp"
+#include "resource_resolver.hpp"
+#include "upload_context.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+namespace Common {
+    namespace {
+        struct LoadedLevel {
+            unsigned int texture = 0;
+            unsigned int level = 0;
+            int width = 0;
+            int height = 0;
+            std::vector<unsigned char> data;  // emptied once uploaded
+            bool ok = false;
+            bool uploaded = false;            // by the UploadContext
+        };
+
+        // One level of the texture bound to GL_TEXTURE_2D
+        void specifyLevel(unsigned int level, unsigned int glFormat, int width, int height,
+                          const std::vector<unsigned char>& data) {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (glFormat != 0) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, glFormat, width, height, 0, (GLsizei)data.size(),
+                                       data.data());
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                             data.data());
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+
+        // A level's bytes as the GL takes them; blocks it lacks are decoded to RGBA8
+        bool readLevel(std::FILE* file, const CookedTextureLevel& level, bool decode, BlockFormat format,
+                       std::vector<unsigned char>& data) {
+            std::vector<unsigned char> bytes(static_cast<size_t>(level.size));
+            if (!seekFile(file, level.offset) || std::fread(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+                return false;
+            }
+            if (!decode) {
+                data.swap(bytes);
+                return true;
+            }
+            data.resize(size_t(level.width) * level.height * 4);
+            decodeBlocks(format, bytes.data(), level.width, level.height, data.data());
+            return true;
+        }
+    }
+
+    struct TextureStreamer::State {
+        std::mutex mutex;
+        std::deque<LoadedLevel> loaded;  // read (and maybe uploaded), waiting for update()
+    };
+
+    TextureStreamer::TextureStreamer(ThreadPool& pool) : state(std::make_shared<State>()), pool(pool) {
+    }
+
+    // Textures are left to the context's teardown: the shared streamer outlives it
+    TextureStreamer::~TextureStreamer() {
+    }
+
+    size_t TextureStreamer::levelBytes(const Entry& entry, unsigned int level) const {
+        const CookedTextureLevel& info = entry.levels[level];
+        return entry.glFormat != 0 ? static_cast<size_t>(info.size) : size_t(info.width) * info.height * 4;
+    }
+
+    unsigned int TextureStreamer::open(const std::string& path) {
+        const std::string key = ResourceResolver::normalize(path);
+        auto known = byPath.find(key);
+        if (known != byPath.end()) {
+            entries[known->second].references++;
+            return known->second;
+        }
+
+        // the block formats the GL takes; this is the GL thread
+        static bool formatsDetected = false;
+        if (!formatsDetected) {
+            detectCompressedTextureSupport();
+            formatsDetected = true;
+        }
+        Entry entry;
+        CookedTextureHeader header;
+        if (!readCookedTextureLevels(path, header, entry.levels)) {
+            return 0;
+        }
+        entry.path = path;
+        entry.key = key;
+        entry.references = 1;
+        if (header.glFormat != 0) {
+            blockFormatFromGL(header.glFormat, entry.blockFormat);
+            entry.decodeBlocks = !compressedFormatSupported(entry.blockFormat);
+            entry.glFormat = entry.decodeBlocks ? 0 : header.glFormat;
+        }
+        const unsigned int last = static_cast<unsigned int>(entry.levels.size()) - 1;
+        entry.tailLevel = last;
+        while (entry.tailLevel > 0 && entry.levels[entry.tailLevel - 1].width <= uint32_t(tailSize)
+               && entry.levels[entry.tailLevel - 1].height <= uint32_t(tailSize)) {
+            entry.tailLevel--;
+        }
+
+        // the tail is a few kilobytes: read and upload it now, so the texture is usable at once
+        std::vector<std::vector<unsigned char>> tail(last - entry.tailLevel + 1);
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        bool ok = file != nullptr;
+        for (unsigned int level = entry.tailLevel; level <= last && ok; level++) {
+            ok = readLevel(file, entry.levels[level], entry.decodeBlocks, entry.blockFormat,
+                           tail[level - entry.tailLevel]);
+        }
+        if (file) {
+            std::fclose(file);
+        }
+        if (!ok) {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return 0;
+        }
+
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (unsigned int level = entry.tailLevel; level <= last; level++) {
+            specifyLevel(level, entry.glFormat, entry.levels[level].width, entry.levels[level].height,
+                         tail[level - entry.tailLevel]);
+            residentBytes += levelBytes(entry, level);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)entry.tailLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)last);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, last > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        entry.residentLevel = entry.tailLevel;
+        entry.wantedLevel = entry.tailLevel;
+        entries[texture] = entry;
+        byPath[key] = texture;
+        return texture;
+    }
+
+    void TextureStreamer::close(unsigned int texture) {
+        auto found = entries.find(texture);
+        if (found == entries.end() || found->second.closed || --found->second.references > 0) {
+            return;
+        }
+        Entry& entry = found->second;
+        byPath.erase(entry.key);
+        if (entry.loading) {
+            // a level is still being read or uploaded into it
+            entry.closed = true;
+            return;
+        }
+        for (unsigned int level = entry.residentLevel; level < entry.levels.size(); level++) {
+            residentBytes -= levelBytes(entry, level);
+        }
+        glDeleteTextures(1, &texture);
+        entries.erase(found);
+    }
+
+    void TextureStreamer::request(unsigned int texture, float screenSize) {
+        auto found = entries.find(texture);
+        if (found != entries.end()) {
+            found->second.requestedSize = std::max(found->second.requestedSize, screenSize);
+            found->second.lastRequest = frame;
+        }
+    }
+
+    void TextureStreamer::startLoad(unsigned int texture, Entry& entry) {
+        const unsigned int level = entry.residentLevel - 1;
+        entry.loading = true;
+        pendingBytes += levelBytes(entry, level);
+
+        std::shared_ptr<State> shared = state;
+        UploadContext* uploads = UploadContext::shared();
+        if (uploads) {
+            // open() and evictions specify levels here; the loader's level goes after them
+            uploads->handOff();
+        }
+        const std::string path = entry.path;
+        const CookedTextureLevel source = entry.levels[level];
+        const bool decode = entry.decodeBlocks;
+        const BlockFormat format = entry.blockFormat;
+        const unsigned int glFormat = entry.glFormat;
+        pool.submit([shared, uploads, texture, level, path, source, decode, format, glFormat]() {
+            auto loaded = std::make_shared<LoadedLevel>();
+            loaded->texture = texture;
+            loaded->level = level;
+            loaded->width = static_cast<int>(source.width);
+            loaded->height = static_cast<int>(source.height);
+            if (std::FILE* file = std::fopen(path.c_str(), "rb")) {
+                loaded->ok = readLevel(file, source, decode, format, loaded->data);
+                std::fclose(file);
+            }
+            if (loaded->ok && uploads) {
+                // the level sits below GL_TEXTURE_BASE_LEVEL until update() adopts it, so the
+                // render thread never samples it half written
+                uploads->submit([loaded, glFormat]() {
+                    glBindTexture(GL_TEXTURE_2D, loaded->texture);
+                    specifyLevel(loaded->level, glFormat, loaded->width, loaded->height, loaded->data);
+                    std::vector<unsigned char>().swap(loaded->data);
+                    loaded->uploaded = true;
+                }, [shared, loaded]() {
+                    std::lock_guard<std::mutex> lock(shared->mutex);
+                    shared->loaded.push_back(std::move(*loaded));
+                });
+                return;
+            }
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->loaded.push_back(std::move(*loaded));
+        });
+    }
+
+    bool TextureStreamer::evictFrom(unsigned int texture, Entry& entry) {
+        if (entry.loading || entry.closed || entry.residentLevel >= entry.tailLevel) {
+            return false;
+        }
+        const unsigned int level = entry.residentLevel;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)(level + 1));
+        // an empty image gives the level's memory back
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        residentBytes -= levelBytes(entry, level);
+        entry.residentLevel = level + 1;
+        levelsEvicted++;
+        return true;
+    }
+
+    // Drops the finest level of the texture that needs it least: one holding more than it
+    // was asked for, then the one asked for longest ago, then the one that frees the most
+    bool TextureStreamer::evictOne(unsigned int keep, bool overResidentOnly) {
+        unsigned int victim = 0;
+        Entry* best = nullptr;
+        for (auto& candidate : entries) {
+            Entry& entry = candidate.second;
+            const bool over = entry.residentLevel < entry.wantedLevel;
+            if (candidate.first == keep || entry.loading || entry.closed || entry.residentLevel >= entry.tailLevel
+                || (overResidentOnly && !over)) {
+                continue;
+            }
+            if (best) {
+                const bool bestOver = best->residentLevel < best->wantedLevel;
+                if (over != bestOver) {
+                    if (!over) {
+                        continue;
+                    }
+                } else if (entry.lastRequest != best->lastRequest) {
+                    if (entry.lastRequest > best->lastRequest) {
+                        continue;
+                    }
+                } else if (levelBytes(entry, entry.residentLevel) <= levelBytes(*best, best->residentLevel)) {
+                    continue;
+                }
+            }
+            victim = candidate.first;
+            best = &entry;
+        }
+        return best && evictFrom(victim, *best);
+    }
+
+    void TextureStreamer::update(size_t maxUploads) {
+        // levels read (and uploaded) since the last frame
+        std::deque<LoadedLevel> loaded;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            loaded.swap(state->loaded);
+        }
+        size_t uploads = 0;
+        while (!loaded.empty()) {
+            LoadedLevel& level = loaded.front();
+            auto found = entries.find(level.texture);
+            if (found == entries.end()) {
+                loaded.pop_front();
+                continue;
+            }
+            Entry& entry = found->second;
+            if (entry.closed) {
+                pendingBytes -= levelBytes(entry, level.level);
+                for (unsigned int resident = entry.residentLevel; resident < entry.levels.size(); resident++) {
+                    residentBytes -= levelBytes(entry, resident);
+                }
+                glDeleteTextures(1, &level.texture);
+                entries.erase(found);
+                loaded.pop_front();
+                continue;
+            }
+            if (level.ok && !level.uploaded) {
+                if (uploads == maxUploads) {
+                    break;
+                }
+                glBindTexture(GL_TEXTURE_2D, level.texture);
+                specifyLevel(level.level, entry.glFormat, level.width, level.height, level.data);
+                uploads++;
+            }
+            pendingBytes -= levelBytes(entry, level.level);
+            entry.loading = false;
+            if (level.ok) {
+                glBindTexture(GL_TEXTURE_2D, level.texture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level.level);
+                entry.residentLevel = level.level;
+                residentBytes += levelBytes(entry, level.level);
+                levelsLoaded++;
+            } else {
+                // the file changed or vanished: keep what is resident and stop asking for more
+                std::cout << "Texture level failed to stream: " << entry.path << " (level " << level.level << ")"
+                          << std::endl;
+                entry.tailLevel = entry.residentLevel;
+            }
+            loaded.pop_front();
+        }
+        if (!loaded.empty()) {
+            // over this frame's upload allowance; first in line next frame
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->loaded.insert(state->loaded.begin(), std::make_move_iterator(loaded.begin()),
+                                 std::make_move_iterator(loaded.end()));
+        }
+
+        // the coarsest level still at least as large on screen as it was asked to be
+        std::vector<unsigned int> wanting;
+        for (auto& candidate : entries) {
+            Entry& entry = candidate.second;
+            entry.wantedLevel = entry.tailLevel;
+            if (entry.lastRequest == frame) {
+                unsigned int level = 0;
+                while (level < entry.tailLevel && std::max(entry.levels[level + 1].width, entry.levels[level + 1].height)
+                                                      >= entry.requestedSize) {
+                    level++;
+                }
+                entry.wantedLevel = level;
+            }
+            entry.requestedSize = 0.0f;
+            if (entry.wantedLevel < entry.residentLevel && !entry.loading && !entry.closed) {
+                wanting.push_back(candidate.first);
+            }
+        }
+
+        // a lowered budget is met first
+        while (residentBytes + pendingBytes > budgetBytes && evictOne(0, false)) {
+        }
+
+        // furthest from what they were asked for first
+        std::sort(wanting.begin(), wanting.end(), [this](unsigned int a, unsigned int b) {
+            const Entry& first = entries[a];
+            const Entry& second = entries[b];
+            return first.residentLevel - first.wantedLevel > second.residentLevel - second.wantedLevel;
+        });
+        deferredLoads = 0;
+        size_t started = 0;
+        for (unsigned int texture : wanting) {
+            Entry& entry = entries[texture];
+            if (started == maxUploads) {
+                break;
+            }
+            const size_t bytes = levelBytes(entry, entry.residentLevel - 1);
+            while (residentBytes + pendingBytes + bytes > budgetBytes && evictOne(texture, true)) {
+            }
+            if (residentBytes + pendingBytes + bytes > budgetBytes) {
+                deferredLoads++;
+                continue;
+            }
+            startLoad(texture, entry);
+            started++;
+        }
+        frame++;
+    }
+
+    void TextureStreamer::setBudget(size_t bytes) {
+        budgetBytes = bytes;
+    }
+
+    void TextureStreamer::setTailSize(int texels) {
+        tailSize = std::max(1, texels);
+    }
+
+    TextureStreamerStats TextureStreamer::stats() const {
+        TextureStreamerStats result;
+        for (const auto& candidate : entries) {
+            const Entry& entry = candidate.second;
+            if (entry.closed) {
+                continue;
+            }
+            result.textures++;
+            if (entry.residentLevel <= entry.wantedLevel) {
+                result.fullyResident++;
+            }
+            if (entry.loading) {
+                result.pendingLoads++;
+            }
+        }
+        result.residentBytes = residentBytes;
+        result.pendingBytes = pendingBytes;
+        result.budgetBytes = budgetBytes;
+        result.levelsLoaded = levelsLoaded;
+        result.levelsEvicted = levelsEvicted;
+        result.deferredLoads = deferredLoads;
+        return result;
+    }
+
+    bool TextureStreamer::textureInfo(unsigned int texture, StreamedTextureInfo& info) const {
+        auto found = entries.find(texture);
+        if (found == entries.end() || found->second.closed) {
+            return false;
+        }
+        const Entry& entry = found->second;
+        info.levelCount = static_cast<unsigned int>(entry.levels.size());
+        info.residentLevel = entry.residentLevel;
+        info.wantedLevel = entry.wantedLevel;
+        info.residentBytes = 0;
+        for (unsigned int level = entry.residentLevel; level < entry.levels.size(); level++) {
+            info.residentBytes += levelBytes(entry, level);
+        }
+        info.loading = entry.loading;
+        return true;
+    }
+
+    TextureStreamer& TextureStreamer::shared() {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    float projectedSize(float radius, float distance, float projectionScale) {
+        // inside the sphere it covers the screen
+        return 2.0f * radius * projectionScale / std::max(distance, radius);
+    }
+}
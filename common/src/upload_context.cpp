@@ -0,0 +1,192 @@
+#include "upload_context.hpp"
+#include "texture_loader.hpp"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+namespace Common {
+    namespace {
+        std::atomic<UploadContext*> sharedContext(nullptr);
+    }
+
+    UploadContext::UploadContext(GLFWwindow* shareWith) {
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        context = glfwCreateWindow(1, 1, "", nullptr, shareWith);
+        glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+        if (context == nullptr) {
+            std::cout << "Failed to create shared upload context, uploading on the render thread" << std::endl;
+            return;
+        }
+        thread = std::thread(&UploadContext::loaderLoop, this);
+        sharedContext = this;
+    }
+
+    UploadContext::~UploadContext() {
+        UploadContext* self = this;
+        sharedContext.compare_exchange_strong(self, nullptr);
+        if (context == nullptr) {
+            return;
+        }
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+        if (renderFence && !renderFenceTaken) {
+            glDeleteSync(static_cast<GLsync>(renderFence));
+        }
+        glfwDestroyWindow(context);
+    }
+
+    void UploadContext::submit(std::function<void()> upload, std::function<void()> complete) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(Job{ std::move(upload), std::move(complete), renderFence });
+            renderFenceTaken = renderFenceTaken || renderFence != nullptr;
+        }
+        condition.notify_all();
+    }
+
+    void UploadContext::handOff() {
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // the loader context can only wait for a fence that has reached the GPU
+        glFlush();
+        void* unused = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (renderFence && !renderFenceTaken) {
+                unused = renderFence;
+            }
+            renderFence = fence;
+            renderFenceTaken = false;
+        }
+        if (unused) {
+            glDeleteSync(static_cast<GLsync>(unused));
+        }
+    }
+
+    void UploadContext::loaderLoop() {
+        glfwMakeContextCurrent(context);
+        // GLAD's pointers were loaded on the render context; contexts sharing a pixel
+        // format resolve to the same entry points
+        glGenBuffers(1, &pixelBuffer);
+        void* waited = nullptr;  // jobs come in submission order, so their fences only move forward
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    break;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                running++;
+            }
+            if (job.waitFor && job.waitFor != waited) {
+                glWaitSync(static_cast<GLsync>(job.waitFor), 0, GL_TIMEOUT_IGNORED);
+                if (waited) {
+                    glDeleteSync(static_cast<GLsync>(waited));
+                }
+                waited = job.waitFor;
+            }
+            job.upload();
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // without a flush the fence might never reach the GPU, and the render thread
+            // would wait on it forever
+            glFlush();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fenced.push_back(Fenced{ fence, std::move(job.complete) });
+                running--;
+            }
+            condition.notify_all();
+        }
+        if (waited) {
+            glDeleteSync(static_cast<GLsync>(waited));
+        }
+        glDeleteBuffers(1, &pixelBuffer);
+        glFinish();
+        glfwMakeContextCurrent(nullptr);
+    }
+
+    void UploadContext::uploadTexture(unsigned int texture, const DecodedImage& image) {
+        const size_t bytes = decodedImageSize(image);
+        // Orphaning the buffer each time lets the driver hand out fresh storage while a
+        // previous transfer out of it is still in flight
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        const unsigned char* source = image.pixels;
+        if (mapped) {
+            std::memcpy(mapped, image.pixels, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            source = nullptr;  // offsets into the bound buffer
+        } else {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        specifyTextureImage(image, source);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    size_t UploadContext::pollCompleted() {
+        size_t completed = 0;
+        while (true) {
+            Fenced done;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (fenced.empty()) {
+                    break;
+                }
+                GLenum status = glClientWaitSync(static_cast<GLsync>(fenced.front().fence), 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                    break;
+                }
+                done = std::move(fenced.front());
+                fenced.pop_front();
+            }
+            glDeleteSync(static_cast<GLsync>(done.fence));
+            // the callback may submit more work, so it runs outside the lock
+            if (done.complete) {
+                done.complete();
+            }
+            completed++;
+        }
+        return completed;
+    }
+
+    void UploadContext::finish() {
+        while (true) {
+            void* fence = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return !fenced.empty() || (jobs.empty() && running == 0); });
+                if (fenced.empty()) {
+                    return;
+                }
+                fence = fenced.back().fence;
+            }
+            // fences signal in order, so once the newest is done every older one is too
+            glClientWaitSync(static_cast<GLsync>(fence), 0, GL_TIMEOUT_IGNORED);
+            pollCompleted();
+        }
+    }
+
+    size_t UploadContext::pendingCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return jobs.size() + running + fenced.size();
+    }
+
+    UploadContext* UploadContext::shared() {
+        return sharedContext;
+    }
+}
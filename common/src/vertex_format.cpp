@@ -0,0 +1,327 @@
+#include "vertex_format.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace Common {
+    namespace {
+        // GL enum values; this file does not depend on a GL loader
+        const uint32_t kGLUnsignedByte = 0x1401;
+        const uint32_t kGLShort = 0x1402;
+        const uint32_t kGLUnsignedShort = 0x1403;
+        const uint32_t kGLInt = 0x1404;
+        const uint32_t kGLFloat = 0x1406;
+        const uint32_t kGLHalfFloat = 0x140B;
+
+        const uint32_t kPosition = 0;
+        const uint32_t kNormal = 1;
+        const uint32_t kTexCoord = 2;
+        const uint32_t kTangent = 3;
+        const uint32_t kBitangent = 4;
+        const uint32_t kBoneIds = 5;
+        const uint32_t kBoneWeights = 6;
+
+        const float* element(const float* stream, size_t stride, size_t vertex) {
+            return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(stream) + vertex * stride);
+        }
+
+        const CookedAttribute* findAttribute(const VertexLayout& layout, uint32_t location) {
+            for (const auto& attribute : layout.attributes) {
+                if (attribute.location == location) {
+                    return &attribute;
+                }
+            }
+            return nullptr;
+        }
+
+        void writeDirection(const CookedAttribute& attribute, const float* value, unsigned char* out) {
+            if (attribute.glType == kGLFloat) {
+                std::memcpy(out, value, sizeof(float) * 3);
+            } else {
+                int16_t encoded[2];
+                octEncode(value, encoded);
+                std::memcpy(out, encoded, sizeof(encoded));
+            }
+        }
+
+        int16_t quantizeSnorm16(float value) {
+            value = std::max(-1.0f, std::min(1.0f, value));
+            return static_cast<int16_t>(std::lround(value * 32767.0f));
+        }
+    }
+
+    VertexLayout makeVertexLayout(const VertexFormat& format, const VertexStreams& streams,
+                                  const float* boundsMin, const float* boundsMax) {
+        VertexLayout layout;
+        auto add = [&layout](uint32_t location, uint32_t components, uint32_t glType, bool normalized, uint32_t bytes) {
+            layout.attributes.push_back(CookedAttribute{ location, components, glType, normalized ? 1u : 0u, layout.stride });
+            layout.stride += bytes;  // every attribute stays 4-byte aligned
+        };
+
+        // 16-bit positions take 4 components' room so the next attribute stays aligned
+        switch (format.position) {
+            case PositionEncoding::Half: add(kPosition, 3, kGLHalfFloat, false, 8); break;
+            case PositionEncoding::Unorm16: add(kPosition, 3, kGLUnsignedShort, true, 8); break;
+            default: add(kPosition, 3, kGLFloat, false, 12); break;
+        }
+        // octahedral directions arrive as vec2; the shader decodes them back to vec3
+        const uint32_t directionType = format.octahedralNormals ? kGLShort : kGLFloat;
+        const uint32_t directionComponents = format.octahedralNormals ? 2 : 3;
+        const uint32_t directionBytes = format.octahedralNormals ? 4 : 12;
+        if (streams.normals && (format.streams & StreamNormals)) {
+            add(kNormal, directionComponents, directionType, format.octahedralNormals, directionBytes);
+        }
+        if (streams.texCoords && (format.streams & StreamTexCoords)) {
+            add(kTexCoord, 2, format.halfTexCoords ? kGLHalfFloat : kGLFloat, false, format.halfTexCoords ? 4 : 8);
+        }
+        if (streams.tangents && (format.streams & StreamTangents)) {
+            add(kTangent, directionComponents, directionType, format.octahedralNormals, directionBytes);
+        }
+        if (streams.bitangents && (format.streams & StreamTangents)) {
+            add(kBitangent, directionComponents, directionType, format.octahedralNormals, directionBytes);
+        }
+        if (streams.boneIds && (format.streams & StreamSkin)) {
+            add(kBoneIds, 4, format.compactSkin ? kGLShort : kGLInt, false, format.compactSkin ? 8 : 16);
+        }
+        if (streams.boneWeights && (format.streams & StreamSkin)) {
+            add(kBoneWeights, 4, format.compactSkin ? kGLUnsignedByte : kGLFloat, format.compactSkin, format.compactSkin ? 4 : 16);
+        }
+
+        float low[3] = { 0.0f, 0.0f, 0.0f };
+        float high[3] = { 0.0f, 0.0f, 0.0f };
+        if (boundsMin && boundsMax) {
+            std::memcpy(low, boundsMin, sizeof(low));
+            std::memcpy(high, boundsMax, sizeof(high));
+        } else if (streams.positions && streams.count > 0) {
+            std::fill(low, low + 3, FLT_MAX);
+            std::fill(high, high + 3, -FLT_MAX);
+            for (size_t v = 0; v < streams.count; ++v) {
+                const float* position = element(streams.positions, streams.stride, v);
+                for (int axis = 0; axis < 3; ++axis) {
+                    low[axis] = std::min(low[axis], position[axis]);
+                    high[axis] = std::max(high[axis], position[axis]);
+                }
+            }
+        }
+        layout.decode = vertexDecodeFor(layout.attributes, low, high);
+        return layout;
+    }
+
+    VertexDecode vertexDecodeFor(const std::vector<CookedAttribute>& attributes,
+                                 const float boundsMin[3], const float boundsMax[3]) {
+        VertexDecode decode;
+        for (const auto& attribute : attributes) {
+            if (attribute.location == kPosition && attribute.glType == kGLUnsignedShort) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    decode.positionScale[axis] = boundsMax[axis] - boundsMin[axis];
+                    decode.positionOffset[axis] = boundsMin[axis];
+                }
+            } else if (attribute.location == kPosition && attribute.glType == kGLHalfFloat) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    decode.positionOffset[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+                }
+            } else if (attribute.location == kNormal && attribute.components == 2) {
+                decode.octahedralNormals = true;
+            }
+        }
+        return decode;
+    }
+
+    void packVertices(const VertexLayout& layout, const VertexStreams& streams, void* destination) {
+        unsigned char* out = static_cast<unsigned char*>(destination);
+        const CookedAttribute* position = findAttribute(layout, kPosition);
+        const CookedAttribute* normal = findAttribute(layout, kNormal);
+        const CookedAttribute* texCoord = findAttribute(layout, kTexCoord);
+        const CookedAttribute* tangent = findAttribute(layout, kTangent);
+        const CookedAttribute* bitangent = findAttribute(layout, kBitangent);
+        const CookedAttribute* boneIds = findAttribute(layout, kBoneIds);
+        const CookedAttribute* boneWeights = findAttribute(layout, kBoneWeights);
+        const VertexDecode& decode = layout.decode;
+
+        std::memset(out, 0, streams.count * layout.stride);
+        for (size_t v = 0; v < streams.count; ++v, out += layout.stride) {
+            if (position && streams.positions) {
+                const float* value = element(streams.positions, streams.stride, v);
+                unsigned char* slot = out + position->offset;
+                if (position->glType == kGLFloat) {
+                    std::memcpy(slot, value, sizeof(float) * 3);
+                } else {
+                    uint16_t packed[3];
+                    for (int axis = 0; axis < 3; ++axis) {
+                        float local = value[axis] - decode.positionOffset[axis];
+                        if (position->glType == kGLHalfFloat) {
+                            packed[axis] = floatToHalf(local);
+                        } else {
+                            float scale = decode.positionScale[axis];
+                            float unit = scale > 0.0f ? std::max(0.0f, std::min(1.0f, local / scale)) : 0.0f;
+                            packed[axis] = static_cast<uint16_t>(std::lround(unit * 65535.0f));
+                        }
+                    }
+                    std::memcpy(slot, packed, sizeof(packed));
+                }
+            }
+            if (normal && streams.normals) {
+                writeDirection(*normal, element(streams.normals, streams.stride, v), out + normal->offset);
+            }
+            if (tangent && streams.tangents) {
+                writeDirection(*tangent, element(streams.tangents, streams.stride, v), out + tangent->offset);
+            }
+            if (bitangent && streams.bitangents) {
+                writeDirection(*bitangent, element(streams.bitangents, streams.stride, v), out + bitangent->offset);
+            }
+            if (texCoord && streams.texCoords) {
+                const float* value = element(streams.texCoords, streams.stride, v);
+                if (texCoord->glType == kGLFloat) {
+                    std::memcpy(out + texCoord->offset, value, sizeof(float) * 2);
+                } else {
+                    uint16_t packed[2] = { floatToHalf(value[0]), floatToHalf(value[1]) };
+                    std::memcpy(out + texCoord->offset, packed, sizeof(packed));
+                }
+            }
+            if (boneIds && streams.boneIds) {
+                const int* ids = reinterpret_cast<const int*>(reinterpret_cast<const unsigned char*>(streams.boneIds) + v * streams.stride);
+                if (boneIds->glType == kGLInt) {
+                    std::memcpy(out + boneIds->offset, ids, sizeof(int32_t) * 4);
+                } else {
+                    int16_t packed[4];
+                    for (int i = 0; i < 4; ++i) {
+                        packed[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, ids[i])));
+                    }
+                    std::memcpy(out + boneIds->offset, packed, sizeof(packed));
+                }
+            }
+            if (boneWeights && streams.boneWeights) {
+                const float* weights = element(streams.boneWeights, streams.stride, v);
+                if (boneWeights->glType == kGLFloat) {
+                    std::memcpy(out + boneWeights->offset, weights, sizeof(float) * 4);
+                } else {
+                    // round, then give the rounding remainder to the largest weight so a
+                    // fully weighted vertex still sums to exactly 1
+                    unsigned char packed[4];
+                    int sum = 0;
+                    int largest = 0;
+                    float total = 0.0f;
+                    for (int i = 0; i < 4; ++i) {
+                        float weight = std::max(0.0f, std::min(1.0f, weights[i]));
+                        packed[i] = static_cast<unsigned char>(std::lround(weight * 255.0f));
+                        sum += packed[i];
+                        total += weight;
+                        if (weights[i] > weights[largest]) {
+                            largest = i;
+                        }
+                    }
+                    int target = static_cast<int>(std::lround(std::min(1.0f, total) * 255.0f));
+                    int adjusted = static_cast<int>(packed[largest]) + target - sum;
+                    packed[largest] = static_cast<unsigned char>(std::max(0, std::min(255, adjusted)));
+                    std::memcpy(out + boneWeights->offset, packed, sizeof(packed));
+                }
+            }
+        }
+    }
+
+    void narrowIndices(const uint32_t* indices, size_t count, uint16_t* destination) {
+        for (size_t i = 0; i < count; ++i) {
+            destination[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000u;
+        const uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+        if (magnitude >= 0x7F800000u) {
+            // infinity stays infinity, NaN stays a (quiet) NaN
+            return static_cast<uint16_t>(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+        }
+        if (magnitude >= 0x477FF000u) {
+            // rounds past 65504, the largest half
+            return static_cast<uint16_t>(sign | 0x7C00u);
+        }
+        if (magnitude < 0x38800000u) {
+            // below 2^-14: half denormal (or zero)
+            if (magnitude < 0x33000000u) {
+                return static_cast<uint16_t>(sign);
+            }
+            const uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+            const int shift = 126 - static_cast<int>(magnitude >> 23);
+            uint32_t half = mantissa >> shift;
+            const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+            const uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        // rebias the exponent from 127 to 15 and round the dropped 13 mantissa bits
+        uint32_t half = (magnitude >> 13) - (112u << 10);
+        const uint32_t remainder = magnitude & 0x1FFFu;
+        if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    float halfToFloat(uint16_t value) {
+        const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1Fu;
+        uint32_t mantissa = value & 0x3FFu;
+        uint32_t bits;
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                bits = sign;
+            } else {
+                uint32_t shifts = 0;
+                while (!(mantissa & 0x400u)) {
+                    mantissa <<= 1;
+                    ++shifts;
+                }
+                bits = sign | ((113u - shifts) << 23) | ((mantissa & 0x3FFu) << 13);
+            }
+        } else if (exponent == 31) {
+            bits = sign | 0x7F800000u | (mantissa << 13);
+        } else {
+            bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    void octEncode(const float normal[3], int16_t encoded[2]) {
+        const float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+        if (length <= 0.0f) {
+            // degenerate normal: +Z
+            encoded[0] = 0;
+            encoded[1] = 0;
+            return;
+        }
+        float x = normal[0] / length;
+        float y = normal[1] / length;
+        if (normal[2] < 0.0f) {
+            // fold the lower hemisphere over the diagonals
+            const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        encoded[0] = quantizeSnorm16(x);
+        encoded[1] = quantizeSnorm16(y);
+    }
+
+    void octDecode(const int16_t encoded[2], float normal[3]) {
+        float x = std::max(-1.0f, encoded[0] / 32767.0f);
+        float y = std::max(-1.0f, encoded[1] / 32767.0f);
+        float z = 1.0f - std::fabs(x) - std::fabs(y);
+        const float t = std::max(-z, 0.0f);
+        x += x >= 0.0f ? -t : t;
+        y += y >= 0.0f ? -t : t;
+        const float length = std::sqrt(x * x + y * y + z * z);
+        normal[0] = x / length;
+        normal[1] = y / length;
+        normal[2] = z / length;
+    }
+}
@@ -71,7 +71,23 @@ public:
 			m_Scales.push_back(data);
 		}
 	}
-	
+
+	// builds a bone from already converted key tracks (procedural/synthetic clips, no Assimp scene needed)
+	Bone(const std::string& name, int ID, std::vector<KeyPosition> positions,
+		std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+		:
+		m_Positions(std::move(positions)),
+		m_Rotations(std::move(rotations)),
+		m_Scales(std::move(scales)),
+		m_LocalTransform(1.0f),
+		m_Name(name),
+		m_ID(ID)
+	{
+		m_NumPositions = static_cast<int>(m_Positions.size());
+		m_NumRotations = static_cast<int>(m_Rotations.size());
+		m_NumScalings = static_cast<int>(m_Scales.size());
+	}
+
 	void Update(float animationTime)
 	{
 		glm::vec3 tmp;
@@ -82,7 +98,7 @@ public:
 		m_LocalTransform = translation * rotation * scale;
 	}
 	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
-	std::string GetBoneName() const { return m_Name; }
+	const std::string& GetBoneName() const { return m_Name; }
 	int GetBoneID() { return m_ID; }
 	
 
@@ -0,0 +1,420 @@
+#pragma once
+
+/* Batched IK stage that runs on the flattened pose buffers of many Animators
+   after sampling. Jobs are gathered into structure-of-arrays batches of
+   IK_BATCH_WIDTH lanes; the per-lane math is plain float arithmetic (no trig,
+   no branches besides selects) so the compiler can vectorize it. Only the
+   subtree below each solved joint is re-propagated. */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <learnopengl/animator.h>
+
+const int IK_BATCH_WIDTH = 8;
+
+// flat node indices (see Animation::GetFlatNodes) of a chain such as thigh -> knee -> foot
+struct TwoBoneIKChain
+{
+	int root = -1;
+	int mid = -1;
+	int end = -1;
+
+	bool IsValid() const { return root >= 0 && mid >= 0 && end >= 0; }
+
+	static TwoBoneIKChain Find(const Animation& animation, const std::string& root, const std::string& mid, const std::string& end)
+	{
+		TwoBoneIKChain chain;
+		chain.root = animation.FindNodeIndex(root);
+		chain.mid = animation.FindNodeIndex(mid);
+		chain.end = animation.FindNodeIndex(end);
+		return chain;
+	}
+};
+
+struct IKStats
+{
+	int twoBoneSolved = 0;
+	int aimSolved = 0;
+	int skipped = 0; // jobs of characters whose IK LOD toggle is off
+	int batches = 0;
+	double gatherMicroseconds = 0.0;
+	double solveMicroseconds = 0.0;
+	double applyMicroseconds = 0.0;
+	double totalMicroseconds = 0.0;
+};
+
+class IKSolver
+{
+public:
+	// targets and pole vectors are in model space, the space of Animator::GetGlobalPose()
+	void AddTwoBone(Animator* animator, const TwoBoneIKChain& chain, const glm::vec3& target, const glm::vec3& pole, float weight = 1.0f)
+	{
+		if (!animator || !chain.IsValid())
+			return;
+		TwoBoneJob job;
+		job.animator = animator;
+		job.chain = chain;
+		job.target = target;
+		job.pole = pole;
+		job.weight = weight;
+		m_TwoBoneJobs.push_back(job);
+	}
+
+	// rotates `node` so that its local `axis` points at the target (look-at)
+	void AddAim(Animator* animator, int node, const glm::vec3& target, const glm::vec3& axis, float weight = 1.0f)
+	{
+		if (!animator || node < 0)
+			return;
+		AimJob job;
+		job.animator = animator;
+		job.node = node;
+		job.target = target;
+		job.axis = axis;
+		job.weight = weight;
+		m_AimJobs.push_back(job);
+	}
+
+	// solves all queued jobs (two-bone pass first, then aim) and clears the queue.
+	// Jobs of one character must drive disjoint subtrees within a pass.
+	void Solve()
+	{
+		m_Stats = IKStats();
+		auto start = Clock::now();
+
+		RemoveDisabled(m_TwoBoneJobs);
+		RemoveDisabled(m_AimJobs);
+
+		for (size_t first = 0; first < m_TwoBoneJobs.size(); first += IK_BATCH_WIDTH)
+			SolveTwoBoneBatch(first, std::min(m_TwoBoneJobs.size() - first, static_cast<size_t>(IK_BATCH_WIDTH)));
+		for (size_t first = 0; first < m_AimJobs.size(); first += IK_BATCH_WIDTH)
+			SolveAimBatch(first, std::min(m_AimJobs.size() - first, static_cast<size_t>(IK_BATCH_WIDTH)));
+
+		m_Stats.twoBoneSolved = static_cast<int>(m_TwoBoneJobs.size());
+		m_Stats.aimSolved = static_cast<int>(m_AimJobs.size());
+		m_Stats.totalMicroseconds = Microseconds(start);
+		m_TwoBoneJobs.clear();
+		m_AimJobs.clear();
+	}
+
+	const IKStats& GetStats() const { return m_Stats; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct TwoBoneJob
+	{
+		Animator* animator;
+		TwoBoneIKChain chain;
+		glm::vec3 target;
+		glm::vec3 pole;
+		float weight;
+	};
+
+	struct AimJob
+	{
+		Animator* animator;
+		int node;
+		glm::vec3 target;
+		glm::vec3 axis;
+		float weight;
+	};
+
+	// structure-of-arrays lane storage
+	struct Vec3Lanes { float x[IK_BATCH_WIDTH], y[IK_BATCH_WIDTH], z[IK_BATCH_WIDTH]; };
+	struct QuatLanes { float x[IK_BATCH_WIDTH], y[IK_BATCH_WIDTH], z[IK_BATCH_WIDTH], w[IK_BATCH_WIDTH]; };
+
+	std::vector<TwoBoneJob> m_TwoBoneJobs;
+	std::vector<AimJob> m_AimJobs;
+	IKStats m_Stats;
+
+	static double Microseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	}
+
+	template<typename Job>
+	void RemoveDisabled(std::vector<Job>& jobs)
+	{
+		size_t before = jobs.size();
+		jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+			[](const Job& job) { return !job.animator->IsIKEnabled(); }), jobs.end());
+		m_Stats.skipped += static_cast<int>(before - jobs.size());
+	}
+
+	static void Store(Vec3Lanes& lanes, int i, const glm::vec3& v)
+	{
+		lanes.x[i] = v.x; lanes.y[i] = v.y; lanes.z[i] = v.z;
+	}
+
+	static glm::quat Load(const QuatLanes& lanes, int i)
+	{
+		return glm::quat(lanes.w[i], lanes.x[i], lanes.y[i], lanes.z[i]);
+	}
+
+	// quaternion rotating unit vector u onto unit vector v (shortest arc), per lane
+	static inline void FromTo(float ux, float uy, float uz, float vx, float vy, float vz,
+		float& qx, float& qy, float& qz, float& qw)
+	{
+		float d = ux * vx + uy * vy + uz * vz;
+		qx = uy * vz - uz * vy;
+		qy = uz * vx - ux * vz;
+		qz = ux * vy - uy * vx;
+		qw = 1.0f + d;
+		// opposite vectors: rotate half a turn around any axis perpendicular to u
+		bool opposite = qw < 1.0e-6f;
+		float px = std::fabs(ux) < 0.9f ? 0.0f : -uz;
+		float py = std::fabs(ux) < 0.9f ? -uz : 0.0f;
+		float pz = std::fabs(ux) < 0.9f ? uy : ux;
+		qx = opposite ? px : qx;
+		qy = opposite ? py : qy;
+		qz = opposite ? pz : qz;
+		qw = opposite ? 0.0f : qw;
+		float len = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+		float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		qx *= inv; qy *= inv; qz *= inv; qw = len > 0.0f ? qw * inv : 1.0f;
+	}
+
+	// quaternion rotating by (angle1 - angle0) around unit axis n, both angles given as (cos, sin) pairs
+	static inline void DeltaAngle(float cos0, float sin0, float cos1, float sin1, float nx, float ny, float nz,
+		float& qx, float& qy, float& qz, float& qw)
+	{
+		float cosDelta = cos1 * cos0 + sin1 * sin0;
+		float sinDelta = sin1 * cos0 - cos1 * sin0;
+		float halfCos = std::sqrt(std::max(0.0f, (1.0f + cosDelta) * 0.5f));
+		float halfSin = std::sqrt(std::max(0.0f, (1.0f - cosDelta) * 0.5f));
+		halfSin = sinDelta < 0.0f ? -halfSin : halfSin;
+		qx = nx * halfSin; qy = ny * halfSin; qz = nz * halfSin; qw = halfCos;
+	}
+
+	// signed angle from u to v around unit axis n as a normalized (cos, sin) pair
+	static inline void SignedAngle(float ux, float uy, float uz, float vx, float vy, float vz, float nx, float ny, float nz,
+		float& cosAngle, float& sinAngle)
+	{
+		float c = ux * vx + uy * vy + uz * vz;
+		float s = nx * (uy * vz - uz * vy) + ny * (uz * vx - ux * vz) + nz * (ux * vy - uy * vx);
+		float len = std::sqrt(c * c + s * s);
+		float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		cosAngle = len > 0.0f ? c * inv : 1.0f;
+		sinAngle = s * inv;
+	}
+
+	static inline void Rotate(float qx, float qy, float qz, float qw, float& vx, float& vy, float& vz)
+	{
+		// v' = v + 2w(q x v) + 2 q x (q x v)
+		float tx = 2.0f * (qy * vz - qz * vy);
+		float ty = 2.0f * (qz * vx - qx * vz);
+		float tz = 2.0f * (qx * vy - qy * vx);
+		float rx = vx + qw * tx + (qy * tz - qz * ty);
+		float ry = vy + qw * ty + (qz * tx - qx * tz);
+		float rz = vz + qw * tz + (qx * ty - qy * tx);
+		vx = rx; vy = ry; vz = rz;
+	}
+
+	static inline void Multiply(float ax, float ay, float az, float aw, float bx, float by, float bz, float bw,
+		float& qx, float& qy, float& qz, float& qw)
+	{
+		qx = aw * bx + ax * bw + ay * bz - az * by;
+		qy = aw * by - ax * bz + ay * bw + az * bx;
+		qz = aw * bz + ax * by - ay * bx + az * bw;
+		qw = aw * bw - ax * bx - ay * by - az * bz;
+	}
+
+	// nlerp from identity, used for constraint weights
+	static inline void Weight(float weight, float& qx, float& qy, float& qz, float& qw)
+	{
+		float sign = qw < 0.0f ? -1.0f : 1.0f;
+		qx *= weight * sign; qy *= weight * sign; qz *= weight * sign;
+		qw = (1.0f - weight) + qw * weight * sign;
+		float len = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+		float inv = len > 0.0f ? 1.0f / len : 1.0f;
+		qx *= inv; qy *= inv; qz *= inv; qw *= inv;
+	}
+
+	// applies a model-space rotation around `pivot` to the node's local transform
+	static void RotateNode(Animator* animator, int node, const glm::vec3& pivot, const glm::quat& rotation)
+	{
+		PoseBuffer& local = animator->GetLocalPose();
+		const glm::mat4& global = animator->GetGlobalPose()[node];
+		glm::mat4 world = glm::translate(glm::mat4(1.0f), pivot) * glm::mat4_cast(rotation) * glm::translate(glm::mat4(1.0f), -pivot);
+		// new global = world * global  =>  new local = local * inverse(global) * world * global
+		local[node] = local[node] * glm::inverse(global) * world * global;
+	}
+
+	void SolveTwoBoneBatch(size_t first, size_t count)
+	{
+		Vec3Lanes a, b, c, t, p;
+		float weight[IK_BATCH_WIDTH];
+		QuatLanes rootRotation, midRotation;
+
+		auto gatherStart = Clock::now();
+		for (int i = 0; i < IK_BATCH_WIDTH; ++i)
+		{
+			// pad the batch by repeating the last job, its result is discarded
+			const TwoBoneJob& job = m_TwoBoneJobs[first + std::min(static_cast<size_t>(i), count - 1)];
+			const PoseBuffer& pose = job.animator->GetGlobalPose();
+			Store(a, i, glm::vec3(pose[job.chain.root][3]));
+			Store(b, i, glm::vec3(pose[job.chain.mid][3]));
+			Store(c, i, glm::vec3(pose[job.chain.end][3]));
+			Store(t, i, job.target);
+			Store(p, i, job.pole);
+			weight[i] = job.weight;
+		}
+		m_Stats.gatherMicroseconds += Microseconds(gatherStart);
+
+		auto solveStart = Clock::now();
+		for (int i = 0; i < IK_BATCH_WIDTH; ++i)
+		{
+			float abx = b.x[i] - a.x[i], aby = b.y[i] - a.y[i], abz = b.z[i] - a.z[i];
+			float bcx = c.x[i] - b.x[i], bcy = c.y[i] - b.y[i], bcz = c.z[i] - b.z[i];
+			float acx = c.x[i] - a.x[i], acy = c.y[i] - a.y[i], acz = c.z[i] - a.z[i];
+			float atx = t.x[i] - a.x[i], aty = t.y[i] - a.y[i], atz = t.z[i] - a.z[i];
+
+			float lab = std::sqrt(abx * abx + aby * aby + abz * abz);
+			float lcb = std::sqrt(bcx * bcx + bcy * bcy + bcz * bcz);
+			float lac = std::sqrt(acx * acx + acy * acy + acz * acz);
+			float lat = std::sqrt(atx * atx + aty * aty + atz * atz);
+			bool degenerate = lab < 1.0e-6f || lcb < 1.0e-6f || lac < 1.0e-6f || lat < 1.0e-6f;
+			lab = std::max(lab, 1.0e-6f); lcb = std::max(lcb, 1.0e-6f);
+			lac = std::max(lac, 1.0e-6f);
+			float reach = std::min(std::max(lat, 1.0e-4f), (lab + lcb) * 0.9999f);
+
+			// desired interior angles at the root and mid joints (law of cosines)
+			float cosRoot1 = std::min(1.0f, std::max(-1.0f, (lab * lab + reach * reach - lcb * lcb) / (2.0f * lab * reach)));
+			float cosMid1 = std::min(1.0f, std::max(-1.0f, (lab * lab + lcb * lcb - reach * reach) / (2.0f * lab * lcb)));
+			float sinRoot1 = std::sqrt(std::max(0.0f, 1.0f - cosRoot1 * cosRoot1));
+			float sinMid1 = std::sqrt(std::max(0.0f, 1.0f - cosMid1 * cosMid1));
+
+			// bend in the current plane of the chain (falls back to the pole plane when the chain is straight)
+			float nx = acy * abz - acz * aby, ny = acz * abx - acx * abz, nz = acx * aby - acy * abx;
+			float pax = p.x[i] - a.x[i], pay = p.y[i] - a.y[i], paz = p.z[i] - a.z[i];
+			float gx = acy * paz - acz * pay, gy = acz * pax - acx * paz, gz = acx * pay - acy * pax;
+			bool straight = std::sqrt(nx * nx + ny * ny + nz * nz) < 1.0e-4f * lac * lab;
+			nx = straight ? gx : nx; ny = straight ? gy : ny; nz = straight ? gz : nz;
+			float nlen = std::sqrt(nx * nx + ny * ny + nz * nz);
+			degenerate = degenerate || nlen < 1.0e-12f;
+			float ninv = nlen > 0.0f ? 1.0f / nlen : 0.0f;
+			nx *= ninv; ny *= ninv; nz *= ninv;
+
+			// current signed angles in that plane: root->end to root->mid, and mid->root to mid->end
+			float cosRoot0, sinRoot0, cosMid0, sinMid0;
+			SignedAngle(acx, acy, acz, abx, aby, abz, nx, ny, nz, cosRoot0, sinRoot0);
+			SignedAngle(-abx, -aby, -abz, bcx, bcy, bcz, nx, ny, nz, cosMid0, sinMid0);
+
+			float r0x, r0y, r0z, r0w, r1x, r1y, r1z, r1w;
+			DeltaAngle(cosRoot0, sinRoot0, cosRoot1, sinRoot1, nx, ny, nz, r0x, r0y, r0z, r0w);
+			DeltaAngle(cosMid0, sinMid0, cosMid1, sinMid1, nx, ny, nz, r1x, r1y, r1z, r1w);
+
+			// where the end effector lands after bending, then swing it onto the target
+			float b1x = abx, b1y = aby, b1z = abz;
+			Rotate(r0x, r0y, r0z, r0w, b1x, b1y, b1z);
+			float c1x = acx, c1y = acy, c1z = acz;
+			Rotate(r0x, r0y, r0z, r0w, c1x, c1y, c1z);
+			float mcx = c1x - b1x, mcy = c1y - b1y, mcz = c1z - b1z;
+			Rotate(r1x, r1y, r1z, r1w, mcx, mcy, mcz);
+			float ex = b1x + mcx, ey = b1y + mcy, ez = b1z + mcz;
+			float elen = std::sqrt(ex * ex + ey * ey + ez * ez);
+			float einv = elen > 0.0f ? 1.0f / elen : 0.0f;
+			float tinv = 1.0f / std::max(lat, 1.0e-6f);
+			float r2x, r2y, r2z, r2w;
+			FromTo(ex * einv, ey * einv, ez * einv, atx * tinv, aty * tinv, atz * tinv, r2x, r2y, r2z, r2w);
+
+			// twist around root->target so the mid joint points towards the pole
+			float tdx = atx * tinv, tdy = aty * tinv, tdz = atz * tinv;
+			float sbx = b1x, sby = b1y, sbz = b1z;
+			Rotate(r2x, r2y, r2z, r2w, sbx, sby, sbz);
+			float sbd = sbx * tdx + sby * tdy + sbz * tdz;
+			float pd = pax * tdx + pay * tdy + paz * tdz;
+			float cosTwist, sinTwist;
+			SignedAngle(sbx - tdx * sbd, sby - tdy * sbd, sbz - tdz * sbd, pax - tdx * pd, pay - tdy * pd, paz - tdz * pd,
+				tdx, tdy, tdz, cosTwist, sinTwist);
+			float r3x, r3y, r3z, r3w;
+			DeltaAngle(1.0f, 0.0f, cosTwist, sinTwist, tdx, tdy, tdz, r3x, r3y, r3z, r3w);
+			float sx, sy, sz, sw;
+			Multiply(r3x, r3y, r3z, r3w, r2x, r2y, r2z, r2w, sx, sy, sz, sw);
+
+			// root: twist * swing * bend; mid (model space, applied after the root moved): S * midBend * S^-1
+			float qx, qy, qz, qw;
+			Multiply(sx, sy, sz, sw, r0x, r0y, r0z, r0w, qx, qy, qz, qw);
+			Weight(degenerate ? 0.0f : weight[i], qx, qy, qz, qw);
+			rootRotation.x[i] = qx; rootRotation.y[i] = qy; rootRotation.z[i] = qz; rootRotation.w[i] = qw;
+
+			float mx, my, mz, mw;
+			Multiply(sx, sy, sz, sw, r1x, r1y, r1z, r1w, mx, my, mz, mw);
+			Multiply(mx, my, mz, mw, -sx, -sy, -sz, sw, qx, qy, qz, qw);
+			Weight(degenerate ? 0.0f : weight[i], qx, qy, qz, qw);
+			midRotation.x[i] = qx; midRotation.y[i] = qy; midRotation.z[i] = qz; midRotation.w[i] = qw;
+		}
+		m_Stats.solveMicroseconds += Microseconds(solveStart);
+
+		auto applyStart = Clock::now();
+		for (size_t i = 0; i < count; ++i)
+		{
+			const TwoBoneJob& job = m_TwoBoneJobs[first + i];
+			Animator* animator = job.animator;
+			glm::vec3 rootPos(a.x[i], a.y[i], a.z[i]);
+			glm::quat rootRot = Load(rootRotation, static_cast<int>(i));
+			RotateNode(animator, job.chain.root, rootPos, rootRot);
+			animator->PropagateSubtree(job.chain.root);
+
+			glm::vec3 midPos(animator->GetGlobalPose()[job.chain.mid][3]);
+			RotateNode(animator, job.chain.mid, midPos, Load(midRotation, static_cast<int>(i)));
+			animator->PropagateSubtree(job.chain.mid);
+		}
+		m_Stats.applyMicroseconds += Microseconds(applyStart);
+		m_Stats.batches++;
+	}
+
+	void SolveAimBatch(size_t first, size_t count)
+	{
+		Vec3Lanes position, forward, t;
+		float weight[IK_BATCH_WIDTH];
+		QuatLanes rotation;
+
+		auto gatherStart = Clock::now();
+		for (int i = 0; i < IK_BATCH_WIDTH; ++i)
+		{
+			const AimJob& job = m_AimJobs[first + std::min(static_cast<size_t>(i), count - 1)];
+			const glm::mat4& global = job.animator->GetGlobalPose()[job.node];
+			Store(position, i, glm::vec3(global[3]));
+			Store(forward, i, glm::vec3(global * glm::vec4(job.axis, 0.0f)));
+			Store(t, i, job.target);
+			weight[i] = job.weight;
+		}
+		m_Stats.gatherMicroseconds += Microseconds(gatherStart);
+
+		auto solveStart = Clock::now();
+		for (int i = 0; i < IK_BATCH_WIDTH; ++i)
+		{
+			float fx = forward.x[i], fy = forward.y[i], fz = forward.z[i];
+			float dx = t.x[i] - position.x[i], dy = t.y[i] - position.y[i], dz = t.z[i] - position.z[i];
+			float flen = std::sqrt(fx * fx + fy * fy + fz * fz);
+			float dlen = std::sqrt(dx * dx + dy * dy + dz * dz);
+			bool degenerate = flen < 1.0e-6f || dlen < 1.0e-6f;
+			float finv = degenerate ? 0.0f : 1.0f / flen;
+			float dinv = degenerate ? 0.0f : 1.0f / dlen;
+
+			float qx, qy, qz, qw;
+			FromTo(fx * finv, fy * finv, fz * finv, dx * dinv, dy * dinv, dz * dinv, qx, qy, qz, qw);
+			Weight(degenerate ? 0.0f : weight[i], qx, qy, qz, qw);
+			rotation.x[i] = qx; rotation.y[i] = qy; rotation.z[i] = qz; rotation.w[i] = qw;
+		}
+		m_Stats.solveMicroseconds += Microseconds(solveStart);
+
+		auto applyStart = Clock::now();
+		for (size_t i = 0; i < count; ++i)
+		{
+			const AimJob& job = m_AimJobs[first + i];
+			glm::vec3 pivot(position.x[i], position.y[i], position.z[i]);
+			RotateNode(job.animator, job.node, pivot, Load(rotation, static_cast<int>(i)));
+			job.animator->PropagateSubtree(job.node);
+		}
+		m_Stats.applyMicroseconds += Microseconds(applyStart);
+		m_Stats.batches++;
+	}
+};
@@ -19,8 +19,19 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <learnopengl/assimp_glm_helpers.h>
 #include <learnopengl/animdata.h>
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "texture_loader.hpp"
+#include "texture_manager.hpp"
+#include "compressed_texture.hpp"
+#include "texture_cache.hpp"
+#include "texture_streamer.hpp"
+#include <unordered_set>
 
 using namespace std;
 
@@ -49,24 +60,77 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// textures this model holds a Common::TextureManager reference on, one entry per image
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    unsigned int lodCount;
+    Common::VertexFormat vertexFormat;
+    bool streamTextures;
+    bool batchMaterials;
 	
 	
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. lodCount simplified levels are generated per mesh
+    // (bone weights stay valid: simplification only moves vertices onto existing ones).
+    // vertexFormat is the GPU vertex layout; packed formats need the decode in the vertex shader (see anim_model.vs).
+    // streamTextures opens the cooked textures through Common::TextureStreamer::shared(): only their small mips
+    // load up front and finer ones follow RequestTextures, within the streamer's memory budget.
+    // batchMaterials packs the textures into texture array pages instead (see MaterialLayers): meshes then
+    // draw without texture binds; it takes precedence over streamTextures. The pages are decoded (and, on a
+    // cold start, cooked) on the thread pool; until Draw finds them built the meshes show a grey placeholder.
+    Model(string const &path, bool gamma = false, unsigned int lodCount = 0, const Common::VertexFormat& vertexFormat = Common::VertexFormat::full(),
+          bool streamTextures = false, bool batchMaterials = false)
+        : gammaCorrection(gamma), lodCount(lodCount), vertexFormat(vertexFormat), streamTextures(streamTextures),
+          batchMaterials(batchMaterials)
     {
         loadModel(path);
+        if (batchMaterials)
+            StartMaterialPages();
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices)
+                boundingRadius = std::max(boundingRadius, glm::length(vertex.Position));
     }
 
+    // textures are shared with other models through Common::TextureManager (or the streamer) and released here
+    ~Model()
+    {
+        for (const Texture& texture : textures_loaded)
+            ReleaseTexture(texture.id);
+        materialPages.clear();
+        if (pagePlaceholder != 0)
+            glDeleteTextures(1, &pagePlaceholder);
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    void Draw(Shader &shader, unsigned int lod = 0)
     {
+        if (materialPages.pending() && materialPages.uploadCompleted())
+            ApplyMaterialPages();
+        // batched meshes on the same pages bind them once
+        unsigned int boundPages[4] = { 0, 0, 0, 0 };
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, lod, boundPages);
+    }
+
+    // coarsest level of detail that stays within maxPixelError pixels at distance
+    unsigned int SelectLod(float distance, float projectionScale, float maxPixelError = 1.0f) const
+    {
+        return SelectMeshLod(meshes, distance, projectionScale, maxPixelError);
+    }
+
+    // model-space radius around the origin that holds every vertex (bind pose)
+    float GetBoundingRadius() const { return boundingRadius; }
+
+    // streamed textures are wanted at about screenSize pixels across this frame, e.g.
+    // Common::projectedSize(GetBoundingRadius() * scale, distance, projectionScale)
+    void RequestTextures(float screenSize) const
+    {
+        for (unsigned int texture : streamedTextureIds)
+            Common::TextureStreamer::shared().request(texture, screenSize);
     }
     
 	auto& GetBoneInfoMap() { return m_BoneInfoMap; }
@@ -77,14 +141,111 @@ private:
 
 	std::map<string, BoneInfo> m_BoneInfoMap;
 	int m_BoneCounter = 0;
+	std::unordered_set<unsigned int> ownedTextureIds;  // ids in textures_loaded
+	std::unordered_set<unsigned int> streamedTextureIds;  // those opened by the streamer
+	float boundingRadius = 0.0f;
+	Common::TextureArrayPages materialPages;
+	std::map<string, size_t> materialPageIndex;  // texture path -> materialPages index
+	unsigned int pagePlaceholder = 0;  // 1x1 grey, drawn while the pages decode
+
+	// batchMaterials: queues the image for the texture array pages, cooked by the decode task
+	// like TextureFromFile
+	size_t QueueMaterialPage(const string& path)
+	{
+		return materialPages.add(directory + '/' + path, Common::cookingDecoder(DecodeImageFile));
+	}
+
+	// batchMaterials: starts decoding the pages on the pool; the meshes bind a placeholder meanwhile,
+	// so the first frames do not wait for the images (or their cook)
+	void StartMaterialPages()
+	{
+		materialPages.buildAsync();
+		const unsigned char grey[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &pagePlaceholder);
+		glBindTexture(GL_TEXTURE_2D, pagePlaceholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		for (Mesh& mesh : meshes)
+			for (Texture& texture : mesh.textures)
+				if (texture.id == 0)
+					texture.id = pagePlaceholder;
+	}
+
+	// batchMaterials, once the pages are built: gives each mesh its layers; a mesh with a texture that
+	// did not make it into a page (or of an unknown type) binds ordinary textures instead
+	void ApplyMaterialPages()
+	{
+		batchMaterials = false;  // loadTexture loads 2D textures for the fallbacks from here on
+		for (Mesh& mesh : meshes)
+		{
+			MaterialLayers layers;
+			bool complete = true;
+			for (const Texture& texture : mesh.textures)
+			{
+				const int slot = MaterialSlot(texture.type);
+				const Common::TextureLayer layer = materialPages.layer(materialPageIndex[texture.path]);
+				if (slot < 0 || layer.page == 0)
+				{
+					complete = false;
+					break;
+				}
+				if (layers.pages[slot] == 0)
+				{
+					layers.pages[slot] = layer.page;
+					layers.layers[slot] = layer.layer;
+				}
+			}
+			if (complete)
+			{
+				for (Texture& texture : mesh.textures)
+					texture.id = 0;
+				mesh.SetMaterialLayers(layers);
+				continue;
+			}
+			for (Texture& texture : mesh.textures)
+				if (texture.id == pagePlaceholder)
+					texture.id = loadTexture(texture.path, texture.type).id;
+			mesh.ResetMaterialBindings();
+		}
+		batchMaterials = true;
+		glDeleteTextures(1, &pagePlaceholder);
+		pagePlaceholder = 0;
+	}
+
+	void ReleaseTexture(unsigned int texture)
+	{
+		if (streamedTextureIds.count(texture))
+			Common::TextureStreamer::shared().close(texture);
+		else
+			Common::TextureManager::shared().release(texture);
+	}
 
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // The imported meshes and bone table are cached in <path>.cmesh; while the source file and the import
+    // flags are unchanged, the next launch reads that instead of running Assimp.
     void loadModel(string const &path)
     {
+        // tangents are only computed when a material has a normal or height map (see below)
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals;
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        const string cachePath = path + ".cmesh";
+        const string settingsKey = "assimp-import-2:" + std::to_string(importFlags) + ":vertex" + std::to_string(sizeof(Vertex)) + ":optimize1:lods" + std::to_string(lodCount);
+        const uint64_t settingsHash = Common::hashBytes(settingsKey.data(), settingsKey.size());
+        // a source whose size and modification time match the cache's header is not hashed again
+        uint64_t sourceHash = 0;
+        Common::FileStamp sourceStamp;
+        const bool hashed = Common::hashSourceFile(path, cachePath, sourceHash, sourceStamp);
+        if (hashed && loadCachedModel(cachePath, sourceHash, settingsHash))
+            return;
+
         // read file via ASSIMP
         std::cout << "  loadModel: Reading file with Assimp..." << std::endl;
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -92,13 +253,226 @@ private:
             return;
         }
         std::cout << "  loadModel: File read successfully" << std::endl;
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        if (SceneNeedsTangents(scene))
+        {
+            std::cout << "  loadModel: Computing tangents for normal mapped materials" << std::endl;
+            scene = importer.ApplyPostProcessing(aiProcess_CalcTangentSpace);
+            if (!scene)
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return;
+            }
+        }
 
         // process ASSIMP's root node recursively
         std::cout << "  loadModel: Processing nodes..." << std::endl;
         processNode(scene->mRootNode, scene);
         std::cout << "  loadModel: Done" << std::endl;
+
+        if (hashed)
+            writeCachedModel(cachePath, sourceHash, settingsHash, sourceStamp);
+    }
+
+    // Cooked layout: each Mesh's vertices and all of its index levels are contiguous. Every level
+    // is one submesh per Mesh (baseVertex marks where its vertices start); a mesh with fewer levels
+    // repeats its coarsest one. Each material string holds that mesh's uploaded streams as a
+    // "streams <Common::VertexStreamBits>" line, then its textures as "type path" lines,
+    // and the extra blob is the bone table: int32 bone count, then per bone int32 id, 16 floats
+    // offset, uint32 name length, name bytes.
+    void writeCachedModel(const string &cachePath, uint64_t sourceHash, uint64_t settingsHash, const Common::FileStamp& sourceStamp)
+    {
+        const vector<Common::CookedAttribute> attributes = {
+            { 0, 3, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, Position) },
+            { 1, 3, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, Normal) },
+            { 2, 2, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, TexCoords) },
+            { 3, 3, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, Tangent) },
+            { 4, 3, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, Bitangent) },
+            { 5, 4, GL_INT, 0, (uint32_t)offsetof(Vertex, m_BoneIDs) },
+            { 6, 4, GL_FLOAT, 0, (uint32_t)offsetof(Vertex, m_Weights) }
+        };
+        Common::CookedMeshWriter writer;
+        if (!writer.open(cachePath, sizeof(Vertex), attributes))
+            return;
+        writer.setSourceStamp(sourceStamp);
+
+        vector<string> materials;
+        vector<uint32_t> vertexBase, indexBase;
+        unsigned int levelCount = 1;
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (const Mesh& mesh : meshes)
+        {
+            string material = "streams " + std::to_string(mesh.GetVertexStreams()) + "\n";
+            for (const Texture& texture : mesh.textures)
+                material += texture.type + " " + texture.path + "\n";
+            materials.push_back(material);
+            for (const Vertex& vertex : mesh.vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.Position);
+                boundsMax = glm::max(boundsMax, vertex.Position);
+            }
+            vertexBase.push_back((uint32_t)writer.vertexCount());
+            writer.appendVertices(mesh.vertices.data(), mesh.vertices.size());
+            levelCount = std::max(levelCount, mesh.GetLodCount());
+        }
+        // indices go after all vertices
+        for (const Mesh& mesh : meshes)
+        {
+            indexBase.push_back((uint32_t)writer.indexCount());
+            writer.appendIndices(mesh.indices.data(), mesh.indices.size());
+        }
+        if (meshes.empty())
+            boundsMin = boundsMax = glm::vec3(0.0f);
+
+        vector<Common::CookedSubMesh> subMeshes;
+        vector<Common::CookedLod> lods;
+        for (unsigned int level = 0; level < levelCount; level++)
+        {
+            float error = 0.0f;
+            lods.push_back({ (uint32_t)subMeshes.size(), (uint32_t)meshes.size(), 0.0f, 0 });
+            for (size_t m = 0; m < meshes.size(); m++)
+            {
+                const Mesh& mesh = meshes[m];
+                MeshLod range = { 0, (unsigned int)mesh.indices.size(), 0.0f };
+                if (!mesh.lods.empty())
+                    range = mesh.lods[std::min<size_t>(level, mesh.lods.size() - 1)];
+                subMeshes.push_back({ indexBase[m] + range.indexOffset, range.indexCount, (uint32_t)m, vertexBase[m] });
+                error = std::max(error, range.error);
+            }
+            lods.back().error = error;
+        }
+        writer.setLods(lods);
+
+        vector<unsigned char> bones;
+        auto append = [&bones](const void* data, size_t bytes) {
+            const unsigned char* begin = static_cast<const unsigned char*>(data);
+            bones.insert(bones.end(), begin, begin + bytes);
+        };
+        int32_t boneCount = m_BoneCounter;
+        append(&boneCount, sizeof(boneCount));
+        for (const auto& bone : m_BoneInfoMap)
+        {
+            int32_t id = bone.second.id;
+            uint32_t nameLength = (uint32_t)bone.first.size();
+            append(&id, sizeof(id));
+            append(&bone.second.offset[0][0], sizeof(float) * 16);
+            append(&nameLength, sizeof(nameLength));
+            append(bone.first.data(), nameLength);
+        }
+        writer.setExtraData(bones.data(), bones.size());
+
+        if (writer.finish(subMeshes, materials, {}, &boundsMin.x, &boundsMax.x, sourceHash, settingsHash))
+            std::cout << "  loadModel: Wrote mesh cache " << cachePath << std::endl;
+        else
+            std::cout << "  loadModel: Could not write mesh cache " << cachePath << std::endl;
+    }
+
+    // Rebuilds meshes, textures and the bone table from a matching cache entry; false means re-import.
+    bool loadCachedModel(const string &cachePath, uint64_t sourceHash, uint64_t settingsHash)
+    {
+        Common::CookedMeshFile file;
+        if (!file.open(cachePath))
+            return false;
+        const size_t meshCount = file.materials.size();
+        if (!file.matches(sourceHash, settingsHash) || file.header.vertexStride != sizeof(Vertex)
+            || file.header.indexSize != sizeof(unsigned int) || file.lods.empty())
+        {
+            std::cout << "  loadModel: Mesh cache is stale, re-importing: " << cachePath << std::endl;
+            return false;
+        }
+        for (const Common::CookedLod& level : file.lods)
+        {
+            if (level.subMeshCount != meshCount)
+            {
+                std::cout << "  loadModel: Mesh cache levels are inconsistent, re-importing: " << cachePath << std::endl;
+                return false;
+            }
+        }
+
+        // bone table first, so a corrupt blob falls back to Assimp before any GL object is created
+        std::map<string, BoneInfo> boneInfoMap;
+        int32_t boneCount = 0;
+        size_t cursor = 0;
+        auto read = [&file, &cursor](void* out, size_t bytes) {
+            if (cursor + bytes > file.extra.size())
+                return false;
+            if (bytes > 0)
+                std::memcpy(out, file.extra.data() + cursor, bytes);
+            cursor += bytes;
+            return true;
+        };
+        bool ok = read(&boneCount, sizeof(boneCount));
+        while (ok && cursor < file.extra.size())
+        {
+            BoneInfo info;
+            int32_t id = 0;
+            uint32_t nameLength = 0;
+            ok = read(&id, sizeof(id)) && read(&info.offset[0][0], sizeof(float) * 16) && read(&nameLength, sizeof(nameLength))
+                && cursor + nameLength <= file.extra.size();
+            if (!ok)
+                break;
+            string name(reinterpret_cast<const char*>(file.extra.data()) + cursor, nameLength);
+            cursor += nameLength;
+            info.id = id;
+            boneInfoMap[name] = info;
+        }
+        if (!ok)
+        {
+            std::cout << "  loadModel: Mesh cache bone table is corrupt, re-importing: " << cachePath << std::endl;
+            return false;
+        }
+
+        std::cout << "  loadModel: Mesh cache hit " << cachePath << std::endl;
+        const Common::CookedSubMesh* full = &file.subMeshes[file.lods[0].firstSubMesh];
+        for (size_t m = 0; m < meshCount; m++)
+        {
+            // a mesh's vertices and index levels run up to where the next mesh's start
+            uint64_t vertexEnd = m + 1 < meshCount ? full[m + 1].baseVertex : file.header.vertexCount;
+            uint64_t indexEnd = m + 1 < meshCount ? full[m + 1].indexOffset : file.header.indexCount;
+            // Mesh keeps CPU copies (entity.h derives bounding volumes from them), so the
+            // mapped ranges are copied once rather than parsed
+            vector<Vertex> vertices((size_t)(vertexEnd - full[m].baseVertex));
+            vector<unsigned int> indices((size_t)(indexEnd - full[m].indexOffset));
+            if (!file.readVertexBytes((uint64_t)full[m].baseVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data())
+                || !file.readIndexBytes((uint64_t)full[m].indexOffset * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data()))
+            {
+                std::cout << "ERROR::MESH_CACHE:: Failed to read mesh " << m << " from " << cachePath << std::endl;
+                meshes.clear();
+                return false;
+            }
+
+            vector<MeshLod> lods;
+            if (file.lods.size() > 1)
+            {
+                for (const Common::CookedLod& level : file.lods)
+                {
+                    const Common::CookedSubMesh& range = file.subMeshes[level.firstSubMesh + m];
+                    MeshLod lod = { range.indexOffset - full[m].indexOffset, range.indexCount, level.error };
+                    // repeated coarsest level of a mesh that has fewer levels
+                    if (lods.empty() || lods.back().indexOffset != lod.indexOffset)
+                        lods.push_back(lod);
+                }
+            }
+
+            vector<Texture> textures;
+            Common::VertexFormat format = vertexFormat;
+            std::istringstream material(file.materials[m]);
+            string line;
+            while (std::getline(material, line))
+            {
+                size_t space = line.find(' ');
+                if (space == string::npos)
+                    continue;
+                if (line.compare(0, space, "streams") == 0)
+                    format.streams = (uint32_t)std::stoul(line.substr(space + 1));
+                else
+                    textures.push_back(loadTexture(line.substr(space + 1), line.substr(0, space)));
+            }
+            meshes.push_back(Mesh(vertices, indices, textures, lods, format));
+        }
+        m_BoneInfoMap = boneInfoMap;
+        m_BoneCounter = boneCount;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -137,12 +511,32 @@ private:
 		vector<unsigned int> indices;
 		vector<Texture> textures;
 
+		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+
+		// only the streams this mesh has and its material uses are uploaded
+		Common::VertexFormat format = vertexFormat;
+		format.streams = 0;
+		if (mesh->HasNormals())
+			format.streams |= Common::StreamNormals;
+		if (mesh->HasTextureCoords(0))
+			format.streams |= Common::StreamTexCoords;
+		if (mesh->HasTangentsAndBitangents() && MaterialNeedsTangents(material))
+			format.streams |= Common::StreamTangents;
+		if (mesh->HasBones())
+			format.streams |= Common::StreamSkin;
+
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
-			Vertex vertex;
+			Vertex vertex = {};
 			SetVertexBoneDataToDefault(vertex);
 			vertex.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
-			vertex.Normal = AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]);
+			if (format.streams & Common::StreamNormals)
+				vertex.Normal = AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]);
+			if (format.streams & Common::StreamTangents)
+			{
+				vertex.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+				vertex.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+			}
 			
 			if (mesh->mTextureCoords[0])
 			{
@@ -162,7 +556,6 @@ private:
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
 		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
@@ -175,7 +568,32 @@ private:
 
 		ExtractBoneWeightForVertices(vertices,mesh,scene);
 
-		return Mesh(vertices, indices, textures);
+		// vertex cache / overdraw triangle order, then vertices in fetch order (after the bone
+		// weights, which are addressed by Assimp's vertex ids)
+		Common::MeshOptimizationStats optimized = Common::optimizeMesh(vertices.data(), vertices.size(), sizeof(Vertex),
+			offsetof(Vertex, Position), indices.data(), indices.size());
+		vertices.resize(optimized.verticesAfter);
+		std::cout << "      Optimized: ACMR " << optimized.before.acmr << " -> " << optimized.after.acmr
+			<< ", ATVR " << optimized.before.atvr << " -> " << optimized.after.atvr << std::endl;
+
+		Mesh result(vertices, indices, textures, lodCount, format);
+		std::cout << "      Vertex layout: " << result.GetVertexStride() << " bytes per vertex (full Vertex: " << sizeof(Vertex) << ")" << std::endl;
+		return result;
+	}
+
+	// normal and height maps are the only consumers of tangents
+	static bool MaterialNeedsTangents(const aiMaterial* material)
+	{
+		return material->GetTextureCount(aiTextureType_HEIGHT) > 0 || material->GetTextureCount(aiTextureType_AMBIENT) > 0
+			|| material->GetTextureCount(aiTextureType_NORMALS) > 0;
+	}
+
+	static bool SceneNeedsTangents(const aiScene* scene)
+	{
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			if (MaterialNeedsTangents(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex]))
+				return true;
+		return false;
 	}
 
 	void SetVertexBoneData(Vertex& vertex, int boneID, float weight)
@@ -266,46 +684,64 @@ private:
 	}
 
 
+	// Returns at once with a placeholder texture; the file is decoded on the shared pool and
+	// uploaded when the render loop calls Common::TextureLoader::shared().uploadCompleted().
+	// Each call takes a Common::TextureManager reference, so an image already loaded by any
+	// model is reused. Images are block-compressed with their mip chain by the decode task on
+	// first use (<image>.ctex, see Common::cookingDecoder) and that file is loaded from then on;
+	// with streamTextures an existing one is opened through Common::TextureStreamer instead
+	// (on a cold start the image is cooked and loaded whole, and streams from the next launch).
 	unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false)
 	{
 		string filename = string(path);
 		filename = directory + '/' + filename;
-
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-		if (data)
+		if (streamTextures)
 		{
-			GLenum format;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-			stbi_image_free(data);
+			string cooked = Common::findCookedTexture(filename);
+			unsigned int texture = cooked.empty() ? 0 : Common::TextureStreamer::shared().open(cooked);
+			if (texture != 0)
+			{
+				streamedTextureIds.insert(texture);
+				return texture;
+			}
 		}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << filename << std::endl;
-		stbi_image_free(data);
+		return Common::TextureManager::shared().acquire(filename, Common::cookingDecoder(DecodeImageFile));
 	}
 
-		return textureID;
+	// worker-thread decode for Common::TextureLoader; DDS / KTX files keep their compressed
+	// blocks and mip chain, flipped like the stb_image output
+	static bool DecodeImageFile(const string& path, Common::DecodedImage& image)
+	{
+		if (Common::isCompressedTextureFile(path))
+			return Common::loadCompressedTexture(path, image, true);
+		image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+		image.release = stbi_image_free;
+		return image.pixels != nullptr;
 	}
     
+    // returns the texture at path, loading it only if no model has loaded it before
+    Texture loadTexture(const string &path, const string &typeName)
+    {
+        Texture texture;
+        texture.type = typeName;
+        texture.path = path;
+        if (batchMaterials)
+        {
+            // ApplyMaterialPages gives it a layer once the pages are built
+            texture.id = 0;
+            if (!materialPageIndex.count(path))
+                materialPageIndex[path] = QueueMaterialPage(path);
+            return texture;
+        }
+        texture.id = TextureFromFile(path.c_str(), this->directory);
+        // the model keeps one reference per image; a repeat lookup gives its extra one back
+        if (texture.id != 0 && !ownedTextureIds.insert(texture.id).second)
+            ReleaseTexture(texture.id);
+        else if (texture.id != 0)
+            textures_loaded.push_back(texture);
+        return texture;
+    }
+
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
@@ -320,26 +756,7 @@ private:
             // instead of 64-bit size_t, so the string data starts at offset 4, not offset 8
             const char* texturePath = reinterpret_cast<const char*>(&str) + 4;
             
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), texturePath) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(texturePath, this->directory);
-                texture.type = typeName;
-                texture.path = texturePath;
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(loadTexture(texturePath, typeName));
         }
         return textures;
     }